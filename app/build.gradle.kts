@@ -54,6 +54,76 @@ android {
         }
     }
     ndkVersion = "25.1.8937393"
+    sourceSets {
+        getByName("main") {
+            assets.srcDir(layout.buildDirectory.dir("generated/spirv"))
+        }
+    }
+}
+
+// The Vulkan backend loads the GLSL kernels as SPIR-V, one file per particle layout:
+// shaders/spirv/<shader>.<layout>.spv. glslc comes with the NDK and defines VULKAN.
+val compileShaders by tasks.registering {
+    val shaderDir = file("src/main/assets/shaders")
+    val outputDir = layout.buildDirectory.dir("generated/spirv/shaders/spirv")
+    val shaders = listOf(
+        "particle.comp", "particle_init.comp", "particle.vert", "particle.frag",
+        "density_splat.comp", "density.vert", "density.frag",
+        "lod_cells.comp", "lod_points.comp", "lod_splat.vert", "lod_splat.frag",
+        "neighbour_count.comp", "neighbour_scan.comp", "neighbour_scatter.comp", "neighbour_fluid.comp",
+        "particle_order.comp", "radix_histogram.comp", "radix_scan.comp", "radix_scatter.comp",
+        "particle_dispatch.comp", "particle_emit.comp"
+    )
+    // Optional features compiled in with defines, as shaders/spirv/<shader>.<variant>.<layout>.spv
+    val variants = mapOf(
+        "particle.comp" to mapOf(
+            "forces" to listOf("NEIGHBOUR_FORCES"),
+            "order" to listOf("PARTICLE_ORDER"),
+            "forces.order" to listOf("NEIGHBOUR_FORCES", "PARTICLE_ORDER"),
+            "life" to listOf("PARTICLE_LIFE")
+        )
+    )
+    // Layout name used by ParticleState::layoutName() -> define selecting it in the shaders
+    val layouts = mapOf(
+        "soa" to "LAYOUT_SOA",
+        "interleaved" to "LAYOUT_INTERLEAVED",
+        "half" to "LAYOUT_PACKED_HALF"
+    )
+    inputs.dir(shaderDir)
+    outputs.dir(outputDir)
+    doLast {
+        val os = System.getProperty("os.name").lowercase()
+        val host = when {
+            os.contains("mac") -> "darwin-x86_64"
+            os.contains("windows") -> "windows-x86_64"
+            else -> "linux-x86_64"
+        }
+        val glslc = android.ndkDirectory.resolve("shader-tools/$host/glslc")
+        val out = outputDir.get().asFile
+        out.mkdirs()
+        for (shader in shaders) {
+            val builds = listOf(shader to emptyList<String>()) +
+                (variants[shader] ?: emptyMap()).map { (variant, features) ->
+                    "$shader.$variant" to features.map { "-D$it=1" }
+                }
+            for ((output, features) in builds) {
+                for ((name, define) in layouts) {
+                    exec {
+                        commandLine(
+                            listOf(glslc.absolutePath, "--target-env=vulkan1.1", "-O", "-D$define=1") +
+                                features +
+                                listOf(shaderDir.resolve(shader).absolutePath,
+                                       "-o", out.resolve("$output.$name.spv").absolutePath)
+                        )
+                    }
+                }
+            }
+        }
+    }
+}
+
+tasks.named("preBuild") {
+    dependsOn(compileShaders)
 }
 
 dependencies {
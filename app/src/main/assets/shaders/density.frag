@@ -0,0 +1,58 @@
+#version 310 es
+precision highp float;  // Counts, speed sums and grid indices outgrow mediump
+precision highp int;
+
+// Density draw mode, second pass: colors every pixel from the grid density_splat.comp filled
+
+#define SPEED_SCALE 16.0  // Must match density_splat.comp
+
+#include "include/density_params.glsl"
+
+#ifdef VULKAN
+layout(std430, set = 1, binding = 1) readonly buffer DensityGrid {
+#else
+layout(std430, binding = 4) readonly buffer DensityGrid {
+#endif
+    uvec4 pointDraw;     // LOD mode only
+    uvec4 splatDraw;
+    uint cells[];
+};
+
+layout(location = 0) out vec4 fragColor;
+
+// Count and summed speed of a cell, nothing outside the grid
+vec2 fetchCell(ivec2 cell) {
+    if (any(lessThan(cell, ivec2(0))) || any(greaterThanEqual(cell, ivec2(gridSize)))) {
+        return vec2(0.0);
+    }
+    uint i = 2u * (uint(cell.y) * gridSize.x + uint(cell.x));
+    return vec2(float(cells[i]), float(cells[i + 1u]));
+}
+
+void main() {
+    vec2 pixel = gl_FragCoord.xy;
+#ifdef VULKAN
+    // Vulkan window coordinates start at the top left, the grid at the bottom left like GL's
+    pixel.y = float(viewportSize.y) - pixel.y;
+#endif
+
+    // Bilinear between the four nearest cell centres, so larger cells don't show as blocks
+    vec2 cellPosition = pixel / float(cellSize) - 0.5;
+    ivec2 base = ivec2(floor(cellPosition));
+    vec2 f = cellPosition - vec2(base);
+    vec2 value = mix(mix(fetchCell(base), fetchCell(base + ivec2(1, 0)), f.x),
+                     mix(fetchCell(base + ivec2(0, 1)), fetchCell(base + ivec2(1, 1)), f.x), f.y);
+    float count = value.x;
+    if (count <= 0.0) {
+        fragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // Same palette as particle.vert, driven by the mean speed of the cell
+    float normalizedSpeed = pow(value.y / (SPEED_SCALE * count) / 10.0, 1.5);
+    vec3 baseColor = vec3(144.0/255.0, 97.0/255.0, 249.0/255.0);
+    vec3 targetColor = vec3(124.0/255.0, 58.0/255.0, 237.0/255.0);
+    vec3 color = mix(baseColor, targetColor, smoothstep(0.3, 0.7, normalizedSpeed));
+
+    fragColor = vec4(color * (1.0 - exp(-gain * count)), 1.0);
+}
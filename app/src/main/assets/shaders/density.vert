@@ -0,0 +1,14 @@
+#version 310 es
+
+// Density draw mode: one triangle covering the screen, no vertex input
+
+#ifdef VULKAN
+#define VERTEX_INDEX gl_VertexIndex  // Vulkan GLSL has no gl_VertexID, there is no first vertex here
+#else
+#define VERTEX_INDEX gl_VertexID
+#endif
+
+void main() {
+    vec2 corner = vec2(float((VERTEX_INDEX << 1) & 2), float(VERTEX_INDEX & 2));
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
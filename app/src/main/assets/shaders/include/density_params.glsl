@@ -0,0 +1,21 @@
+// Parameters of the density and LOD draw modes, mirrors struct DensityParams in SimParams.h
+#ifndef DENSITY_PARAMS_GLSL
+#define DENSITY_PARAMS_GLSL
+
+#ifdef VULKAN
+layout(std140, set = 1, binding = 0) uniform DensityParams {
+#else
+layout(std140, binding = 2) uniform DensityParams {
+#endif
+    mat4 projection;
+    uvec2 gridSize;      // Cells
+    uvec2 viewportSize;  // Pixels
+    uint cellSize;       // Pixels per cell side
+    uint particleCount;
+    float rewind;        // As in particle.vert
+    float gain;          // Brightness and splat alpha are 1 - exp(-gain * particles)
+    uint lodThreshold;   // Particles a cell holds before the LOD mode draws it as a splat
+    uint pointCapacity;  // Size of the LOD point buffer, lodThreshold per cell
+};
+
+#endif // DENSITY_PARAMS_GLSL
@@ -0,0 +1,18 @@
+// Parameters of the neighbour grid passes, mirrors struct NeighbourParams in SimParams.h
+#ifndef NEIGHBOUR_PARAMS_GLSL
+#define NEIGHBOUR_PARAMS_GLSL
+
+#define TABLE_SIZE 65536u  // Must match NEIGHBOUR_TABLE_SIZE in SimParams.h
+
+#ifdef VULKAN
+layout(std140, set = 1, binding = 0) uniform NeighbourParams {
+#else
+layout(std140, binding = 3) uniform NeighbourParams {
+#endif
+    uint particleCount;
+    float cellSize;      // World units, also the interaction radius
+    float pressure;
+    float viscosity;
+};
+
+#endif // NEIGHBOUR_PARAMS_GLSL
@@ -0,0 +1,101 @@
+// Particle state, the layout is selected at init through a LAYOUT_* define (see ParticleState.h).
+// The state is double buffered: the step reads the front copy at bindings 0/1 and writes the back
+// copy at 2/3, while the frame draws the front copy.
+//
+// Which copies a shader sees is chosen by defining one of these before the #include:
+//   STATE_READ      the front copy, read only: loadParticle(). The default.
+//   STATE_STEP      the front copy read only and the back copy write only: loadParticle() and
+//                   storeParticle()
+//   STATE_APPEND    only the back copy, write only: storeParticle()
+//   STATE_IN_PLACE  one copy at the front bindings, read and written: loadParticle() and
+//                   storeParticle(). particle_init.comp fills the copies this way.
+#ifndef PARTICLE_STATE_GLSL
+#define PARTICLE_STATE_GLSL
+
+#if defined(STATE_IN_PLACE)
+#define STATE_FRONT_ACCESS
+#else
+#define STATE_FRONT_ACCESS readonly
+#endif
+#if !defined(STATE_APPEND)
+#define STATE_HAS_FRONT
+#endif
+#if defined(STATE_STEP) || defined(STATE_APPEND)
+#define STATE_HAS_BACK
+#endif
+
+#if defined(LAYOUT_INTERLEAVED)
+// Position in xy and velocity in zw, one fetch per particle
+#ifdef STATE_HAS_FRONT
+layout(std430, binding = 0) STATE_FRONT_ACCESS buffer ParticleBuffer {
+    vec4 particles[];
+};
+
+void loadParticle(uint i, out vec2 pos, out vec2 vel) { vec4 p = particles[i]; pos = p.xy; vel = p.zw; }
+#endif
+#ifdef STATE_HAS_BACK
+layout(std430, binding = 2) writeonly buffer ParticleOutBuffer {
+    vec4 particlesOut[];
+};
+
+void storeParticle(uint i, vec2 pos, vec2 vel) { particlesOut[i] = vec4(pos, vel); }
+#elif defined(STATE_IN_PLACE)
+void storeParticle(uint i, vec2 pos, vec2 vel) { particles[i] = vec4(pos, vel); }
+#endif
+
+#elif defined(LAYOUT_PACKED_HALF)
+// fp32 positions, velocities packed as two halfs per uint
+#ifdef STATE_HAS_FRONT
+layout(std430, binding = 0) STATE_FRONT_ACCESS buffer PositionBuffer {
+    vec2 positions[];
+};
+
+layout(std430, binding = 1) STATE_FRONT_ACCESS buffer VelocityBuffer {
+    uint velocities[];
+};
+
+void loadParticle(uint i, out vec2 pos, out vec2 vel) { pos = positions[i]; vel = unpackHalf2x16(velocities[i]); }
+#endif
+#ifdef STATE_HAS_BACK
+layout(std430, binding = 2) writeonly buffer PositionOutBuffer {
+    vec2 positionsOut[];
+};
+
+layout(std430, binding = 3) writeonly buffer VelocityOutBuffer {
+    uint velocitiesOut[];
+};
+
+void storeParticle(uint i, vec2 pos, vec2 vel) { positionsOut[i] = pos; velocitiesOut[i] = packHalf2x16(vel); }
+#elif defined(STATE_IN_PLACE)
+void storeParticle(uint i, vec2 pos, vec2 vel) { positions[i] = pos; velocities[i] = packHalf2x16(vel); }
+#endif
+
+#else
+// Separate buffers for positions and velocities (SoA)
+#ifdef STATE_HAS_FRONT
+layout(std430, binding = 0) STATE_FRONT_ACCESS buffer PositionBuffer {
+    vec2 positions[];
+};
+
+layout(std430, binding = 1) STATE_FRONT_ACCESS buffer VelocityBuffer {
+    vec2 velocities[];
+};
+
+void loadParticle(uint i, out vec2 pos, out vec2 vel) { pos = positions[i]; vel = velocities[i]; }
+#endif
+#ifdef STATE_HAS_BACK
+layout(std430, binding = 2) writeonly buffer PositionOutBuffer {
+    vec2 positionsOut[];
+};
+
+layout(std430, binding = 3) writeonly buffer VelocityOutBuffer {
+    vec2 velocitiesOut[];
+};
+
+void storeParticle(uint i, vec2 pos, vec2 vel) { positionsOut[i] = pos; velocitiesOut[i] = vel; }
+#elif defined(STATE_IN_PLACE)
+void storeParticle(uint i, vec2 pos, vec2 vel) { positions[i] = pos; velocities[i] = vel; }
+#endif
+#endif
+
+#endif // PARTICLE_STATE_GLSL
@@ -0,0 +1,20 @@
+// Hashing and random numbers for the particle kernels
+#ifndef RANDOM_GLSL
+#define RANDOM_GLSL
+
+const float TWO_PI = 6.28318530718;
+
+// PCG hash (Jarzynski & Olano, "Hash Functions for GPU Rendering")
+uint pcgHash(uint value) {
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Uniform float in [0, 1), advances the state
+float random01(inout uint state) {
+    state = pcgHash(state);
+    return float(state >> 8u) * (1.0 / 16777216.0);
+}
+
+#endif // RANDOM_GLSL
@@ -0,0 +1,28 @@
+// Per-frame parameters, mirrors struct SimParams in SimParams.h
+#ifndef SIM_PARAMS_GLSL
+#define SIM_PARAMS_GLSL
+
+#define MAX_ATTRACTORS 10  // Must match MAX_ATTRACTORS in SimParams.h
+#define MAX_EMITTERS 4     // Must match MAX_EMITTERS in SimParams.h
+
+#ifdef VULKAN
+layout(std140, set = 1, binding = 0) uniform SimParams {
+#else
+layout(std140, binding = 0) uniform SimParams {
+#endif
+    float deltaTime;  // Length of one step, already includes time scale from CPU
+    float damping;
+    float terminalVelocity;
+    int attractorCount;
+    uint particleCount;  // Active particles, the buffers are allocated for the device maximum
+    int stepCount;    // Fixed steps to take this dispatch, the state stays in registers between them
+    uint reorder;     // Non-zero if the step gathers the particles in Morton order, see particle.comp
+    vec4 attractors[MAX_ATTRACTORS];  // xy = position, z = strength (negative repels), w = falloff
+    float lifetime;   // Mean lifetime of a particle in seconds, with PARTICLE_LIFE
+    uint emitterCount;
+    uint emitCount;   // Particles particle_emit.comp emits this frame
+    uint emitSeed;    // New every frame
+    vec4 emitters[MAX_EMITTERS];  // xy = position, zw = velocity
+};
+
+#endif // SIM_PARAMS_GLSL
@@ -0,0 +1,18 @@
+#version 310 es
+precision mediump float;
+
+// LOD draw mode: a soft falloff over the quad of lod_splat.vert, blended like the sprites
+
+layout(location = 0) in vec2 splatOffset;
+layout(location = 1) in vec4 splatColor;
+
+layout(location = 0) out vec4 fragColor;
+
+void main() {
+    // Full at the cell, fading out over the neighbours
+    float falloff = 1.0 - smoothstep(0.5, 1.0, length(splatOffset));
+    if (falloff <= 0.0) {
+        discard;
+    }
+    fragColor = vec4(splatColor.rgb, splatColor.a * falloff);
+}
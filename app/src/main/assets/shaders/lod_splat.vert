@@ -0,0 +1,37 @@
+#version 310 es
+
+// LOD draw mode: one quad per dense cell from lod_cells.comp, two cells wide so neighbouring
+// splats blend into each other instead of showing the grid
+
+#ifdef VULKAN
+#define VERTEX_INDEX gl_VertexIndex  // As in density.vert
+#else
+#define VERTEX_INDEX gl_VertexID
+#endif
+
+layout(location = 0) in vec4 splat;  // Centre in pixels, particle count, mean speed
+
+#include "include/density_params.glsl"
+
+layout(location = 0) out vec2 splatOffset;  // -1 to 1 across the quad
+layout(location = 1) out vec4 splatColor;
+
+void main() {
+    // Triangle strip corners from the vertex index
+    vec2 corner = vec2(float(VERTEX_INDEX & 1), float(VERTEX_INDEX >> 1)) * 2.0 - 1.0;
+    vec2 pixel = splat.xy + corner * float(cellSize);
+    vec2 ndc = pixel / vec2(viewportSize) * 2.0 - 1.0;
+#ifdef VULKAN
+    // The grid starts at the bottom left like GL's window coordinates, Vulkan's NDC y points down
+    ndc.y = -ndc.y;
+#endif
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    splatOffset = corner;
+
+    // Same palette as particle.vert, driven by the mean speed of the cell
+    float normalizedSpeed = pow(splat.w / 10.0, 1.5);
+    vec3 baseColor = vec3(144.0/255.0, 97.0/255.0, 249.0/255.0);
+    vec3 targetColor = vec3(124.0/255.0, 58.0/255.0, 237.0/255.0);
+    vec3 color = mix(baseColor, targetColor, smoothstep(0.3, 0.7, normalizedSpeed));
+    splatColor = vec4(color, 1.0 - exp(-gain * splat.z));
+}
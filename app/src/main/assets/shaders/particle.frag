@@ -1,16 +1,40 @@
-#version 300 es
+#version 310 es
 precision mediump float;
 
+// Matched by name on GLES 3.0, see particle.vert
+#if __VERSION__ >= 310
+layout(location = 1) in vec4 particleColor;
+#else
 in vec4 particleColor;
-out vec4 fragColor;
+#endif
+#ifdef STRETCH
+// The streak in pixels and the sprite size, see particle.vert
+#if __VERSION__ >= 310
+layout(location = 0) in vec2 fragVelocity;
+layout(location = 2) in float spriteSize;
+#else
+in vec2 fragVelocity;
+in float spriteSize;
+#endif
+#endif
+layout(location = 0) out vec4 fragColor;
 
 void main() {
+#ifdef STRETCH
+    // Distance to the streak in radii of the round sprite, swept from its tail to its head. Point
+    // coordinates run down the window, the streak up. Fades towards the tail.
+    vec2 coord = (gl_PointCoord - vec2(0.5)) * vec2(1.0, -1.0) * spriteSize + 0.5 * fragVelocity;
+    float along = clamp(dot(coord, fragVelocity) / max(dot(fragVelocity, fragVelocity), 1e-4), 0.0, 1.0);
+    float r = length(coord - fragVelocity * along) / (0.5 * (spriteSize - length(fragVelocity)));
+    float alpha = (1.0 - smoothstep(0.0, 1.0, r)) * mix(0.5, 1.0, along);
+#else
     // Calculate distance from center of point sprite
     vec2 coord = gl_PointCoord - vec2(0.5);
     float r = length(coord) * 2.0;
     
     // Create smooth circle with anti-aliased edges
     float alpha = 1.0 - smoothstep(0.0, 1.0, r);
+#endif
     
     // Output color with calculated alpha for smooth dots
     fragColor = vec4(particleColor.rgb, particleColor.a * alpha);
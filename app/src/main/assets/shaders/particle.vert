@@ -1,21 +1,71 @@
-#version 300 es
+#version 310 es
 
 layout(location = 0) in vec2 position;
+#if defined(LAYOUT_PACKED_HALF)
+layout(location = 1) in uint packedVelocity;  // Two halfs, see ParticleState.h
+#else
 layout(location = 1) in vec2 velocity;
+#endif
 
+// uRewind is how far, in simulation seconds, to move each particle back along its velocity. The
+// last step moved it by velocity * deltaTime, so this blends between that step's start and end
+// for display while the simulation runs at a fixed step. uPointSize is the sprite size in pixels
+// of the target drawn into, see Config::pointSize.
+#ifdef VULKAN
+// glslc defines VULKAN, the uniforms come as push constants there
+layout(push_constant) uniform PushConstants {
+    mat4 uProjection;
+    float uRewind;
+    float uPointSize;
+};
+#else
 uniform mat4 uProjection;
+uniform float uRewind;
+uniform float uPointSize;
+#endif
 
-out vec2 fragVelocity;
-out vec4 particleColor;
+#ifdef STRETCH
+// Trails draw mode: each sprite is stretched over the way the particle moved in the last uStretch
+// simulation seconds, but no longer than uMaxStretch pixels. uViewportSize is the target's size.
+uniform float uStretch;
+uniform float uMaxStretch;
+uniform vec2 uViewportSize;
+#endif
+
+// GLES 3.0 has no locations on varyings, GlBackend builds this as 300 es for the CPU simulation
+// on contexts without 3.1
+#if __VERSION__ >= 310
+#define VARYING_LOCATION(n) layout(location = n)
+#else
+#define VARYING_LOCATION(n)
+#endif
+VARYING_LOCATION(0) out vec2 fragVelocity;
+VARYING_LOCATION(1) out vec4 particleColor;
+#ifdef STRETCH
+VARYING_LOCATION(2) out float spriteSize;
+#endif
 
 void main() {
-    gl_Position = uProjection * vec4(position, 0.0, 1.0);
-    
-    // Calculate a size that looks good in our projection
-    float baseSize = 14.0;  // Base size in pixels
-    gl_PointSize = baseSize;
-    
+#if defined(LAYOUT_PACKED_HALF)
+    vec2 velocity = unpackHalf2x16(packedVelocity);
+#endif
+    vec2 center = position - velocity * uRewind;
+    gl_PointSize = uPointSize;
     fragVelocity = velocity;
+
+#ifdef STRETCH
+    // The streak in pixels, the projection has no rotation. The sprite is centered on its middle
+    // and grows to hold it, fragVelocity hands it to particle.frag.
+    vec2 streak = mat2(uProjection) * (velocity * uStretch) * 0.5 * uViewportSize;
+    float fit = min(1.0, uMaxStretch / max(length(streak), 1e-6));
+    streak *= fit;
+    center -= velocity * (0.5 * uStretch * fit);
+    gl_PointSize = uPointSize + length(streak);
+    fragVelocity = streak;
+    spriteSize = gl_PointSize;
+#endif
+
+    gl_Position = uProjection * vec4(center, 0.0, 1.0);
     
     float speed = length(velocity);
     
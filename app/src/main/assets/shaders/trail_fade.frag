@@ -0,0 +1,13 @@
+#version 310 es
+precision mediump float;
+
+// Trails draw mode: fades the trails before the frame's sprites go on. GlBackend blends it with
+// GL_FUNC_REVERSE_SUBTRACT, which keeps 1 - alpha of what is there and takes the color off on top.
+
+uniform float uDecay;  // Share of the brightness each frame keeps
+
+layout(location = 0) out vec4 fragColor;
+
+void main() {
+    fragColor = vec4(vec3(1.0 / 255.0), 1.0 - uDecay);
+}
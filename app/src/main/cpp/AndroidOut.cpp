@@ -1,4 +1,130 @@
 #include "AndroidOut.h"
 
-AndroidOut androidOut("AO");
-std::ostream aout(&androidOut);
\ No newline at end of file
+#include <cstring>
+
+static constexpr const char *LOG_TAG = "AO";
+
+static int androidPriority(LogLevel level) {
+    switch (level) {
+        case LogLevel::Verbose: return ANDROID_LOG_VERBOSE;
+        case LogLevel::Debug: return ANDROID_LOG_DEBUG;
+        case LogLevel::Info: return ANDROID_LOG_INFO;
+        case LogLevel::Warn: return ANDROID_LOG_WARN;
+        case LogLevel::Error: return ANDROID_LOG_ERROR;
+    }
+    return ANDROID_LOG_DEBUG;
+}
+
+Logger &Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() :
+        head_(0),
+        tail_(0),
+        producer_(std::thread::id()),
+        dropped_(0),
+        running_(true) {
+    thread_ = std::thread(&Logger::drain, this);
+}
+
+Logger::~Logger() {
+    running_.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    wakeup_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Logger::write(LogLevel level, const std::string &message) {
+    if (message.empty()) {
+        return;
+    }
+
+    // The first thread to log owns the ring
+    auto self = std::this_thread::get_id();
+    auto producer = producer_.load(std::memory_order_relaxed);
+    if (producer == std::thread::id()) {
+        producer_.compare_exchange_strong(producer, self, std::memory_order_relaxed);
+        producer = producer_.load(std::memory_order_relaxed);
+    }
+
+    if (producer != self || message.size() > SLOT_SIZE) {
+        __android_log_write(androidPriority(level), LOG_TAG, message.c_str());
+        return;
+    }
+
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= SLOT_COUNT) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto &slot = slots_[head % SLOT_COUNT];
+    slot.level = level;
+    slot.length = message.size();
+    memcpy(slot.text, message.data(), message.size());
+    head_.store(head + 1, std::memory_order_seq_cst);
+
+    // The drain thread sleeps on an empty ring, so only the line that ends one wakes it. Sequentially
+    // consistent with its tail store: either this sees the ring emptied, or it sees the new head.
+    if (tail_.load(std::memory_order_seq_cst) == head) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        wakeup_.notify_one();
+    }
+}
+
+void Logger::drain() {
+    char line[SLOT_SIZE + 1];
+    for (;;) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_seq_cst)) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait(lock, [this, tail] {
+                return tail != head_.load(std::memory_order_seq_cst) || !running_.load(std::memory_order_acquire);
+            });
+            if (tail == head_.load(std::memory_order_acquire)) {
+                break;
+            }
+            continue;
+        }
+
+        auto &slot = slots_[tail % SLOT_COUNT];
+        memcpy(line, slot.text, slot.length);
+        line[slot.length] = '\0';
+        LogLevel level = slot.level;
+        tail_.store(tail + 1, std::memory_order_seq_cst);
+
+        __android_log_write(androidPriority(level), LOG_TAG, line);
+
+        uint32_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Log ring full, dropped %u lines", dropped);
+        }
+    }
+}
+
+bool LogRateLimiter::allow(uint32_t *outSuppressed) {
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t last = last_.load(std::memory_order_relaxed);
+    if (last != 0 && now - last < intervalMillis_) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (!last_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    *outSuppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+AndroidOut androidOut(LogLevel::Debug);
+std::ostream aout(&androidOut);
@@ -2,16 +2,160 @@
 #define ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 
 #include <android/log.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <thread>
 
 /*!
  * Use this to log strings out to logcat. Note that you should use std::endl to commit the line
  *
  * ex:
  *  aout << "Hello World" << std::endl;
+ *
+ * Render thread only: it's one stream over one buffer, so using it from two threads at once is a
+ * data race. Other threads, and anything that can run every frame or every input event, should use
+ * the LOG_* macros below instead.
  */
 extern std::ostream aout;
 
+//! Log priorities, in the order of their logcat counterparts
+enum class LogLevel {
+    Verbose = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4
+};
+
+// Levels below this are compiled out. Debug builds keep everything, Release keeps Info and up.
+#ifndef LOG_MIN_LEVEL
+#ifdef DEBUG
+#define LOG_MIN_LEVEL 0
+#else
+#define LOG_MIN_LEVEL 2
+#endif
+#endif
+
+/*!
+ * Writes log lines to logcat from a background thread.
+ *
+ * The thread that logs first becomes the producer of a lock-free single producer, single consumer
+ * ring; that's the render thread in practice. Submitting a line is a copy into the ring and never
+ * blocks: when the ring is full the line is dropped and counted. Lines from other threads, and
+ * lines too long for a slot, are written to logcat directly. The drain thread sleeps while the
+ * ring is empty and is woken by the line that fills it again.
+ */
+class Logger {
+public:
+    static Logger &instance();
+
+    ~Logger();
+
+    //! Queues @a message for logcat
+    void write(LogLevel level, const std::string &message);
+
+private:
+    static constexpr size_t SLOT_COUNT = 256;
+    static constexpr size_t SLOT_SIZE = 480;
+
+    struct Slot {
+        LogLevel level;
+        size_t length;
+        char text[SLOT_SIZE];
+    };
+
+    Logger();
+    void drain();
+
+    std::array<Slot, SLOT_COUNT> slots_;
+    std::atomic<size_t> head_;  // Next slot to write, only the producer stores it
+    std::atomic<size_t> tail_;  // Next slot to read, only the drain thread stores it
+    std::atomic<std::thread::id> producer_;
+    std::atomic<uint32_t> dropped_;
+    std::atomic<bool> running_;
+    std::mutex mutex_;                  // Only taken to sleep on, or wake, an empty ring
+    std::condition_variable wakeup_;
+    std::thread thread_;
+};
+
+/*!
+ * Collects one line for the Logger, it's submitted when the line goes out of scope
+ */
+class LogLine {
+public:
+    explicit LogLine(LogLevel level) : level_(level) {}
+    ~LogLine() { Logger::instance().write(level_, stream_.str()); }
+
+    template<typename T>
+    LogLine &operator<<(const T &value) {
+        stream_ << value;
+        return *this;
+    }
+
+    //! Manipulators such as std::hex
+    LogLine &operator<<(std::ios_base &(*manipulator)(std::ios_base &)) {
+        stream_ << manipulator;
+        return *this;
+    }
+
+private:
+    LogLevel level_;
+    std::ostringstream stream_;
+};
+
+/*!
+ * Lets through one line per interval for a log site, counting the ones it held back
+ */
+class LogRateLimiter {
+public:
+    explicit LogRateLimiter(int intervalMillis) : intervalMillis_(intervalMillis), last_(0), suppressed_(0) {}
+
+    //! True if the site may log now, @a outSuppressed is how many lines were held back before it
+    bool allow(uint32_t *outSuppressed);
+
+private:
+    int64_t intervalMillis_;
+    std::atomic<int64_t> last_;
+    std::atomic<uint32_t> suppressed_;
+};
+
+#define LOG_AT(level, message) \
+    do { \
+        if constexpr (static_cast<int>(level) >= LOG_MIN_LEVEL) { \
+            LogLine(level) << message; \
+        } \
+    } while (0)
+
+#define LOG_VERBOSE(message) LOG_AT(LogLevel::Verbose, message)
+#define LOG_DEBUG(message) LOG_AT(LogLevel::Debug, message)
+#define LOG_INFO(message) LOG_AT(LogLevel::Info, message)
+#define LOG_WARN(message) LOG_AT(LogLevel::Warn, message)
+#define LOG_ERROR(message) LOG_AT(LogLevel::Error, message)
+
+/*!
+ * Like LOG_AT but logs at most once every @a intervalMillis from this call site, e.g.
+ *  LOG_EVERY_MS(LogLevel::Warn, 1000, "GL error 0x" << std::hex << error);
+ */
+#define LOG_EVERY_MS(level, intervalMillis, message) \
+    do { \
+        if constexpr (static_cast<int>(level) >= LOG_MIN_LEVEL) { \
+            static LogRateLimiter logLimiter(intervalMillis); \
+            uint32_t logSuppressed; \
+            if (logLimiter.allow(&logSuppressed)) { \
+                LogLine logLine(level); \
+                logLine << message; \
+                if (logSuppressed > 0) { \
+                    logLine << " (" << logSuppressed << " suppressed)"; \
+                } \
+            } \
+        } \
+    } while (0)
+
 /*!
  * Use this class to create an output stream that writes to logcat. By default, a global one is
  * defined as @a aout
@@ -20,19 +164,24 @@ class AndroidOut: public std::stringbuf {
 public:
     /*!
      * Creates a new output stream for logcat
-     * @param kLogTag the log tag to output
+     * @param level the priority its lines are logged with
      */
-    inline AndroidOut(const char* kLogTag) : logTag_(kLogTag){}
+    inline AndroidOut(LogLevel level) : level_(level) {}
 
 protected:
     virtual int sync() override {
-        __android_log_print(ANDROID_LOG_DEBUG, logTag_, "%s", str().c_str());
+        // Logcat adds its own line break
+        std::string line = str();
+        if (!line.empty() && line.back() == '\n') {
+            line.pop_back();
+        }
+        Logger::instance().write(level_, line);
         str("");
         return 0;
     }
 
 private:
-    const char* logTag_;
+    LogLevel level_;
 };
 
-#endif //ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
\ No newline at end of file
+#endif //ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
@@ -0,0 +1,181 @@
+#include "Benchmark.h"
+
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+// The sweep, configurations the GPU can't hold are dropped
+static constexpr int PARTICLE_COUNTS[] = {100000, 250000, 500000, 1000000, 2000000, 4000000};
+static constexpr int LOCAL_SIZES[] = {64, 128, 256, 512};
+
+// Frames per configuration, the warmup also drains timer queries still in flight from the previous one
+static constexpr int WARMUP_FRAMES = 60;
+static constexpr int MEASURED_FRAMES = 300;
+
+// Simulated step, one 60 Hz frame at the default time scale
+static constexpr float FIXED_DELTA_TIME = 0.80f / 60.0f;
+
+// Scripted gravity points
+static constexpr int SCRIPTED_ATTRACTORS = 2;
+static constexpr float SCRIPT_STRENGTH = 9.0f;
+
+//! Driver strings go into the report as JSON strings, quotes, backslashes and controls escaped
+static std::string jsonEscape(const std::string &value) {
+    std::ostringstream escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+        } else {
+            escaped << c;
+        }
+    }
+    return escaped.str();
+}
+
+bool Benchmark::isRequested(android_app *app) {
+    return Utility::getIntentExtra(app, "benchmark") == "1"
+            || Utility::getSystemProperty("debug.particles.benchmark") == "1";
+}
+
+Benchmark::Benchmark(int maxParticles, int maxLocalSize) :
+        current_(0),
+        frame_(0),
+        deltaTime_(FIXED_DELTA_TIME) {
+    for (int count : PARTICLE_COUNTS) {
+        if (count > maxParticles) {
+            aout << "Benchmark: skipping " << count << " particles, over the storage limit" << std::endl;
+            continue;
+        }
+        for (int localSize : LOCAL_SIZES) {
+            if (localSize <= maxLocalSize) {
+                configs_.push_back({count, localSize});
+            }
+        }
+    }
+    results_.reserve(configs_.size());
+    if (!configs_.empty()) {
+        results_.push_back({configs_.front(), {}, {}});
+    }
+    aout << "Benchmark: " << configs_.size() << " configurations, seed 0x" << std::hex << SEED
+         << std::dec << std::endl;
+}
+
+int Benchmark::maxParticleCount() const {
+    int maxCount = 0;
+    for (auto &config : configs_) {
+        maxCount = std::max(maxCount, config.particleCount);
+    }
+    return maxCount;
+}
+
+void Benchmark::scriptAttractors(SimParams &params) const {
+    // Two points on Lissajous paths through the middle of the view, the same on every run
+    float t = frame_ * deltaTime_;
+    for (int i = 0; i < SCRIPTED_ATTRACTORS; i++) {
+        float phase = i * static_cast<float>(M_PI);
+        auto &attractor = params.attractors[i];
+        attractor.position[0] = 8.0f * std::sin(0.7f * t + phase);
+        attractor.position[1] = 5.0f * std::sin(1.1f * t + 0.5f * phase);
+        attractor.strength = SCRIPT_STRENGTH;
+        attractor.falloff = 0.0f;
+    }
+    params.attractorCount = SCRIPTED_ATTRACTORS;
+}
+
+bool Benchmark::addFrame(float frameMillis, const std::vector<float> &gpuMillis) {
+    if (finished()) {
+        return false;
+    }
+
+    if (frame_ >= WARMUP_FRAMES) {
+        auto &result = results_.back();
+        result.frameMillis.push_back(frameMillis);
+        result.gpuMillis.insert(result.gpuMillis.end(), gpuMillis.begin(), gpuMillis.end());
+    }
+
+    if (++frame_ < WARMUP_FRAMES + MEASURED_FRAMES) {
+        return false;
+    }
+
+    auto &result = results_.back();
+    aout << "Benchmark: " << result.config.particleCount << " particles, local size "
+         << result.config.localSize << ", GPU p50 " << Utility::percentile(result.gpuMillis, 0.5f)
+         << " ms, frame p50 " << Utility::percentile(result.frameMillis, 0.5f) << " ms" << std::endl;
+
+    frame_ = 0;
+    if (++current_ < configs_.size()) {
+        results_.push_back({configs_[current_], {}, {}});
+    }
+    return true;
+}
+
+std::string Benchmark::writeReport(const std::string &directory, const std::string &renderer,
+                                   const std::string &version, bool gpuTiming, const char *layout,
+                                   const char *drawMode, const char *interaction) const {
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    std::string base = directory + "/benchmark-" + stamp;
+
+    std::ofstream json(base + ".json");
+    std::ofstream csv(base + ".csv");
+    if (!json || !csv) {
+        aout << "Benchmark: can't write report to " << base << std::endl;
+        return "";
+    }
+
+    json << std::fixed << std::setprecision(4);
+    json << "{\n"
+         << "  \"renderer\": \"" << jsonEscape(renderer) << "\",\n"
+         << "  \"version\": \"" << jsonEscape(version) << "\",\n"
+         << "  \"layout\": \"" << layout << "\",\n"
+         << "  \"draw\": \"" << drawMode << "\",\n"
+         << "  \"interaction\": \"" << interaction << "\",\n"
+         << "  \"timing\": \"" << (gpuTiming ? "gpu" : "frame_interval") << "\",\n"
+         << "  \"seed\": " << SEED << ",\n"
+         << "  \"delta_time\": " << deltaTime_ << ",\n"
+         << "  \"results\": [\n";
+    csv << std::fixed << std::setprecision(4);
+    csv << "particles,local_size,frames,frame_p50_ms,frame_p90_ms,frame_p99_ms,"
+           "gpu_p50_ms,gpu_p90_ms,gpu_p99_ms,particles_per_ms\n";
+
+    for (size_t i = 0; i < results_.size(); i++) {
+        auto &result = results_[i];
+        float frameP50 = Utility::percentile(result.frameMillis, 0.5f);
+        float frameP90 = Utility::percentile(result.frameMillis, 0.9f);
+        float frameP99 = Utility::percentile(result.frameMillis, 0.99f);
+        float gpuP50 = Utility::percentile(result.gpuMillis, 0.5f);
+        float gpuP90 = Utility::percentile(result.gpuMillis, 0.9f);
+        float gpuP99 = Utility::percentile(result.gpuMillis, 0.99f);
+
+        // Throughput from the typical cost of a frame, the GPU time when we have it
+        float typical = gpuTiming ? gpuP50 : frameP50;
+        float particlesPerMs = typical > 0.0f ? result.config.particleCount / typical : 0.0f;
+
+        json << "    {\"particles\": " << result.config.particleCount
+             << ", \"local_size\": " << result.config.localSize
+             << ", \"frames\": " << result.frameMillis.size()
+             << ", \"frame_ms\": {\"p50\": " << frameP50 << ", \"p90\": " << frameP90
+             << ", \"p99\": " << frameP99 << "}"
+             << ", \"gpu_ms\": {\"p50\": " << gpuP50 << ", \"p90\": " << gpuP90
+             << ", \"p99\": " << gpuP99 << "}"
+             << ", \"particles_per_ms\": " << particlesPerMs << "}"
+             << (i + 1 < results_.size() ? "," : "") << "\n";
+        csv << result.config.particleCount << ',' << result.config.localSize << ','
+            << result.frameMillis.size() << ',' << frameP50 << ',' << frameP90 << ',' << frameP99
+            << ',' << gpuP50 << ',' << gpuP90 << ',' << gpuP99 << ',' << particlesPerMs << '\n';
+    }
+    json << "  ]\n}\n";
+
+    aout << "Benchmark report written to " << base << ".json" << std::endl;
+    return base + ".json";
+}
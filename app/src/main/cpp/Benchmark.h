@@ -0,0 +1,96 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BENCHMARK_H
+#define ANDROIDGLINVESTIGATIONS_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SimParams.h"
+
+struct android_app;
+
+/*!
+ * Scripted, repeatable performance run.
+ *
+ * Sweeps particle counts and compute workgroup sizes. Every configuration starts from the same
+ * fixed-seed state, steps with a fixed deltaTime and drives the gravity points along scripted
+ * paths, so runs on different devices and builds are comparable. Each configuration gets a warmup
+ * before its frames are measured. The report goes to the app's internal storage as JSON and CSV.
+ *
+ * Start it with `adb shell am start -n <activity> --es benchmark 1` or by setting the system
+ * property `debug.particles.benchmark` to 1.
+ */
+class Benchmark {
+public:
+    //! Seed for the initial particle state of every configuration
+    static constexpr uint32_t SEED = 0x5eed1234;
+
+    //! One point of the sweep
+    struct Config {
+        int particleCount;
+        int localSize;
+    };
+
+    //! True if the app was launched with the benchmark intent extra or the property is set
+    static bool isRequested(android_app *app);
+
+    /*!
+     * Builds the sweep, dropping configurations this GPU can't run
+     * @param maxParticles largest particle count the state buffers may hold
+     * @param maxLocalSize GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS
+     */
+    Benchmark(int maxParticles, int maxLocalSize);
+
+    //! Largest particle count of the sweep, what the state buffers have to be sized for
+    int maxParticleCount() const;
+
+    bool finished() const { return current_ >= configs_.size(); }
+    const Config &config() const { return configs_[current_]; }
+
+    //! The fixed simulation step
+    float deltaTime() const { return deltaTime_; }
+
+    //! Places the gravity points for the current frame of the script
+    void scriptAttractors(SimParams &params) const;
+
+    /*!
+     * Records one frame of the current configuration
+     * @param frameMillis the interval since the previous frame
+     * @param gpuMillis GPU times of the frames whose timer queries finished since the last call
+     * @return true if the configuration changed, the caller has to reset the particle state and
+     *     recompile the compute shader for config()
+     */
+    bool addFrame(float frameMillis, const std::vector<float> &gpuMillis);
+
+    /*!
+     * Writes benchmark-<timestamp>.json and .csv
+     * @param directory where to write the report, usually the activity's internal data path
+     * @param renderer device name reported by the render backend
+     * @param version API version reported by the render backend
+     * @param gpuTiming whether GPU times were measured, otherwise only intervals are valid
+     * @param layout name of the particle state layout the run used
+     * @param drawMode name of the draw mode the run used
+     * @param interaction name of the interaction the run used
+     * @return the path of the JSON report, empty on failure
+     */
+    std::string writeReport(const std::string &directory, const std::string &renderer,
+                            const std::string &version, bool gpuTiming, const char *layout,
+                            const char *drawMode, const char *interaction) const;
+
+private:
+    //! Measured samples of one configuration
+    struct Result {
+        Config config;
+        std::vector<float> frameMillis;
+        std::vector<float> gpuMillis;
+    };
+
+    std::vector<Config> configs_;
+    std::vector<Result> results_;
+    size_t current_;
+    int frame_;
+    float deltaTime_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_BENCHMARK_H
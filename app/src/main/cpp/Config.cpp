@@ -0,0 +1,166 @@
+#include "Config.h"
+
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+#include <jni.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+namespace {
+
+//! A key and the member it sets, exactly one of the three pointers is set. Numbers are clamped
+//! to [min, max], past those the renderer divides by zero or runs backwards.
+struct Field {
+    const char *key;
+    int Config::*integer;
+    float Config::*real;
+    bool Config::*flag;
+    float min;
+    float max;
+};
+
+const Field FIELDS[] = {
+        {"particle_count", &Config::particleCount, nullptr, nullptr, 1000.0f, 16000000.0f},
+        {"time_scale", nullptr, &Config::timeScale, nullptr, 0.0f, 10.0f},
+        {"view_height", nullptr, &Config::viewHeight, nullptr, 0.1f, 1000.0f},
+        {"point_size", nullptr, &Config::pointSize, nullptr, 1.0f, 256.0f},
+        {"attraction_strength", nullptr, &Config::attractionStrength, nullptr, -100.0f, 100.0f},
+        {"attractor_falloff", nullptr, &Config::attractorFalloff, nullptr, 0.0f, 100.0f},
+        {"terminal_velocity", nullptr, &Config::terminalVelocity, nullptr, 0.0f, 1000.0f},
+        {"damping", nullptr, &Config::damping, nullptr, 0.0f, 1.0f},
+        {"sim_hz", nullptr, &Config::stepRate, nullptr, 15.0f, 240.0f},
+        {"prediction", nullptr, &Config::maxPredictionMs, nullptr, 0.0f, 100.0f},
+        {"hud", nullptr, nullptr, &Config::hud, 0.0f, 0.0f},
+        {"trail_half_life", nullptr, &Config::trailHalfLifeMs, nullptr, 0.0f, 10000.0f},
+        {"trail_stretch", nullptr, &Config::trailStretch, nullptr, 0.0f, 16.0f},
+        {"governor", nullptr, nullptr, &Config::governor, 0.0f, 0.0f},
+};
+
+std::string trim(const std::string &text) {
+    auto begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    auto end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Written by the broadcast receiver, taken by the render thread
+std::mutex reloadMutex;
+bool reloadPending = false;
+std::string reloadOverrides;
+
+} // namespace
+
+Config Config::load(android_app *app) {
+    Config config;
+    if (app && app->activity && app->activity->assetManager) {
+        // Optional, a build without the asset runs on the defaults
+        if (AAsset *asset = AAssetManager_open(app->activity->assetManager, "config.txt", AASSET_MODE_BUFFER)) {
+            AAsset_close(asset);
+            config.apply(Utility::loadAsset(app->activity->assetManager, "config.txt"), "config.txt");
+        }
+    }
+    config.apply(Utility::getIntentExtra(app, "config"), "intent");
+
+    std::string properties;
+    for (auto &field : FIELDS) {
+        auto value = Utility::getSystemProperty((std::string("debug.particles.") + field.key).c_str());
+        if (!value.empty()) {
+            properties += std::string(field.key) + "=" + value + "\n";
+        }
+    }
+    config.apply(properties, "properties");
+    return config;
+}
+
+int Config::apply(const std::string &text, const char *source) {
+    int applied = 0;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find_first_of("\n;", start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        auto line = trim(text.substr(start, end - start));
+        start = end + 1;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        auto separator = line.find('=');
+        auto key = trim(line.substr(0, separator));
+        auto value = separator == std::string::npos ? "" : trim(line.substr(separator + 1));
+        if (set(key, value)) {
+            aout << "Config from " << source << ": " << key << " = " << value << std::endl;
+            applied++;
+        } else {
+            aout << "Config from " << source << ": ignoring \"" << line << "\"" << std::endl;
+        }
+    }
+    return applied;
+}
+
+bool Config::set(const std::string &key, const std::string &value) {
+    if (value.empty()) {
+        return false;
+    }
+    for (auto &field : FIELDS) {
+        if (key != field.key) {
+            continue;
+        }
+        char *end = nullptr;
+        if (field.integer) {
+            long parsed = std::strtol(value.c_str(), &end, 10);
+            if (*end != '\0') return false;
+            long clamped = std::clamp(parsed, static_cast<long>(field.min), static_cast<long>(field.max));
+            if (clamped != parsed) {
+                aout << "Config: " << key << " clamped to " << clamped << std::endl;
+            }
+            this->*field.integer = static_cast<int>(clamped);
+        } else if (field.real) {
+            float parsed = std::strtof(value.c_str(), &end);
+            if (*end != '\0' || !Utility::isFinite(parsed)) return false;
+            float clamped = std::clamp(parsed, field.min, field.max);
+            if (clamped != parsed) {
+                aout << "Config: " << key << " clamped to " << clamped << std::endl;
+            }
+            this->*field.real = clamped;
+        } else {
+            if (value != "0" && value != "1" && value != "true" && value != "false") return false;
+            this->*field.flag = value == "1" || value == "true";
+        }
+        return true;
+    }
+    return false;
+}
+
+bool Config::takeReload(std::string *outOverrides) {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    if (!reloadPending) {
+        return false;
+    }
+    reloadPending = false;
+    *outOverrides = std::move(reloadOverrides);
+    reloadOverrides.clear();
+    return true;
+}
+
+//! Called by MainActivity's reload receiver with the broadcast's extras as "key=value" lines
+extern "C" JNIEXPORT void JNICALL
+Java_dev_oasdflkjo_particles_MainActivity_nativeReloadConfig(JNIEnv *env, jobject, jstring overrides) {
+    // Null if the string is, or if the JVM is out of memory and has an exception pending
+    const char *chars = overrides ? env->GetStringUTFChars(overrides, nullptr) : nullptr;
+    if (!chars) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    reloadOverrides += chars;
+    reloadOverrides += "\n";
+    reloadPending = true;
+    env->ReleaseStringUTFChars(overrides, chars);
+}
@@ -0,0 +1,60 @@
+#ifndef ANDROIDGLINVESTIGATIONS_CONFIG_H
+#define ANDROIDGLINVESTIGATIONS_CONFIG_H
+
+#include <string>
+
+struct android_app;
+
+/*!
+ * The tunable parameters of the simulation and the renderer, in one place so they can be swept
+ * on a device without a rebuild. Each has a key, and later sources override earlier ones:
+ *
+ *  1. the defaults below
+ *  2. "key = value" lines in assets/config.txt
+ *  3. the "config" intent extra, "key=value" pairs separated by ';', e.g.
+ *     `adb shell am start -n dev.oasdflkjo.particles/.MainActivity --es config "time_scale=1;damping=0.9999"`
+ *  4. debug.particles.<key> system properties
+ *
+ * Debuggable builds reload it on the dev.oasdflkjo.particles.RELOAD_CONFIG broadcast, whose extras
+ * go on top, e.g. `adb shell am broadcast -a dev.oasdflkjo.particles.RELOAD_CONFIG --ef point_size 8`.
+ * The particle count is only read at startup, the buffers are sized for it. Numbers out of their
+ * field's range are clamped to it.
+ */
+struct Config {
+    int particleCount = 100000;        // particle_count: budget at 60 Hz, doubled on faster panels
+    float timeScale = 0.8f;            // time_scale: simulated seconds per wall-clock second
+    float viewHeight = 20.0f;          // view_height: world units from the bottom of the view to the top
+    float pointSize = 14.0f;           // point_size: sprite size in surface pixels
+    float attractionStrength = 9.0f;   // attraction_strength
+    float attractorFalloff = 0.0f;     // attractor_falloff: 0 pulls the same at any distance
+    float terminalVelocity = 9.5f;     // terminal_velocity
+    float damping = 0.99988f;          // damping: kept per 60 Hz step at any sim_hz
+    float stepRate = 60.0f;            // sim_hz: fixed steps per second, 15 to 240
+    float maxPredictionMs = 32.0f;     // prediction: how far touches are extrapolated, 0 turns it off
+    bool hud = false;                  // hud: the profiler overlay
+    float trailHalfLifeMs = 150.0f;    // trail_half_life: how fast the trails draw mode fades, 0 for no trails
+    float trailStretch = 1.0f;         // trail_stretch: frames of motion each sprite is stretched over
+    bool governor = true;              // governor: give up quality as the device heats up, see QualityGovernor
+
+    //! The configuration from all startup sources, logging what each changed
+    static Config load(android_app *app);
+
+    /*!
+     * Applies "key=value" pairs separated by newlines or ';'. Lines starting with '#' are
+     * comments, unknown keys and bad values are logged and skipped.
+     * @param source named in the log
+     * @return how many values were set
+     */
+    int apply(const std::string &text, const char *source);
+
+    //! Sets the value of @a key, false if there is no such key or @a value doesn't parse
+    bool set(const std::string &key, const std::string &value);
+
+    /*!
+     * True once after a reload broadcast. @a outOverrides gets its extras, to apply() over a fresh
+     * load(). Any thread may ask, the broadcast arrives on the main Java thread.
+     */
+    static bool takeReload(std::string *outOverrides);
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_CONFIG_H
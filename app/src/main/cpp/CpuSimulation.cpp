@@ -0,0 +1,275 @@
+#include "CpuSimulation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "ParticleState.h"
+
+// Particles per chunk of the thread pool, a whole number of NEON vectors. Small enough that the
+// chunks of a budget's worth of particles outnumber the cores several times over.
+static constexpr int CHUNK_PARTICLES = 2048;
+static constexpr int VECTOR_WIDTH = 4;
+
+static constexpr float TWO_PI = 6.28318530718f;
+
+// PCG hash (Jarzynski & Olano, "Hash Functions for GPU Rendering"), as in particle_init.comp
+static uint32_t pcgHash(uint32_t value) {
+    uint32_t state = value * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Uniform float in [0, 1), advances the state
+static float random01(uint32_t &state) {
+    state = pcgHash(state);
+    return static_cast<float>(state >> 8u) * (1.0f / 16777216.0f);
+}
+
+// Smooth value noise in [0, 1) over a lattice seeded by the init seed
+static float latticeValue(int x, int y, uint32_t seed) {
+    return static_cast<float>(pcgHash(static_cast<uint32_t>(x) ^ pcgHash(static_cast<uint32_t>(y) ^ seed)) >> 8u)
+            * (1.0f / 16777216.0f);
+}
+
+static float valueNoise(float px, float py, uint32_t seed) {
+    int cellX = static_cast<int>(std::floor(px));
+    int cellY = static_cast<int>(std::floor(py));
+    float fx = px - std::floor(px);
+    float fy = py - std::floor(py);
+    float ux = fx * fx * (3.0f - 2.0f * fx);
+    float uy = fy * fy * (3.0f - 2.0f * fy);
+    float a = latticeValue(cellX, cellY, seed);
+    float b = latticeValue(cellX + 1, cellY, seed);
+    float c = latticeValue(cellX, cellY + 1, seed);
+    float d = latticeValue(cellX + 1, cellY + 1, seed);
+    float bottom = a + (b - a) * ux;
+    float top = c + (d - c) * ux;
+    return bottom + (top - bottom) * uy;
+}
+
+CpuSimulation::CpuSimulation(int capacity, bool vectorized) :
+        capacity_((capacity + VECTOR_WIDTH - 1) / VECTOR_WIDTH * VECTOR_WIDTH),
+        vectorized_(vectorized),
+        positionsX_(capacity_),
+        positionsY_(capacity_),
+        velocitiesX_(capacity_),
+        velocitiesY_(capacity_) {}
+
+void CpuSimulation::reset(const InitParams &params) {
+    int count = std::min(static_cast<int>(params.particleCount), capacity_);
+    pool_.parallelFor(count, CHUNK_PARTICLES, [&](int begin, int end) {
+        float centerX = params.origin[0] + 0.5f * params.extent[0];
+        float centerY = params.origin[1] + 0.5f * params.extent[1];
+        float radius = 0.5f * std::min(params.extent[0], params.extent[1]);
+        for (int index = begin; index < end; index++) {
+            // Each particle gets its own stream, the same one the init kernel gives it
+            uint32_t rng = pcgHash(static_cast<uint32_t>(index) ^ pcgHash(params.seed));
+            float x;
+            float y;
+            float vx;
+            float vy;
+            auto distribution = static_cast<ParticleDistribution>(params.distribution);
+            if (distribution == ParticleDistribution::Disc) {
+                float r = std::sqrt(random01(rng)) * radius;
+                float angle = random01(rng) * TWO_PI;
+                x = centerX + r * std::cos(angle);
+                y = centerY + r * std::sin(angle);
+                float velAngle = random01(rng) * TWO_PI;
+                float speed = random01(rng) * params.maxSpeed;
+                vx = std::cos(velAngle) * speed;
+                vy = std::sin(velAngle) * speed;
+            } else if (distribution == ParticleDistribution::Ring) {
+                float r = radius * (0.8f + 0.2f * random01(rng));
+                float angle = random01(rng) * TWO_PI;
+                float dirX = std::cos(angle);
+                float dirY = std::sin(angle);
+                x = centerX + r * dirX;
+                y = centerY + r * dirY;
+                float speed = (0.5f + 0.5f * random01(rng)) * params.maxSpeed;
+                vx = -dirY * speed;
+                vy = dirX * speed;
+            } else if (distribution == ParticleDistribution::Noise) {
+                x = params.origin[0] + random01(rng) * params.extent[0];
+                y = params.origin[1] + random01(rng) * params.extent[1];
+                float velAngle = valueNoise(x * 0.25f, y * 0.25f, params.seed) * 2.0f * TWO_PI;
+                float speed = (0.5f + 0.5f * random01(rng)) * params.maxSpeed;
+                vx = std::cos(velAngle) * speed;
+                vy = std::sin(velAngle) * speed;
+            } else {
+                if (static_cast<uint32_t>(index) < params.gridCount) {
+                    x = params.origin[0] + static_cast<float>(index % params.gridColumns) * params.spacing[0];
+                    y = params.origin[1] + static_cast<float>(index / params.gridColumns) * params.spacing[1];
+                } else {
+                    x = params.origin[0] + random01(rng) * params.extent[0];
+                    y = params.origin[1] + random01(rng) * params.extent[1];
+                }
+                float velAngle = random01(rng) * TWO_PI;
+                float speed = random01(rng) * params.maxSpeed;
+                vx = std::cos(velAngle) * speed;
+                vy = std::sin(velAngle) * speed;
+            }
+            positionsX_[index] = x;
+            positionsY_[index] = y;
+            velocitiesX_[index] = vx;
+            velocitiesY_[index] = vy;
+        }
+    });
+}
+
+void CpuSimulation::step(const SimParams &params, float *outPositions, float *outVelocities) {
+    // Whole vectors, the padding past particleCount is stepped along and never drawn
+    int count = std::min(static_cast<int>(params.particleCount), capacity_);
+    count = (count + VECTOR_WIDTH - 1) / VECTOR_WIDTH * VECTOR_WIDTH;
+    pool_.parallelFor(count, CHUNK_PARTICLES, [&](int begin, int end) {
+        stepRange(params, begin, end, outPositions, outVelocities);
+    });
+}
+
+void CpuSimulation::stepRange(const SimParams &params, int begin, int end,
+                              float *outPositions, float *outVelocities) {
+    // Without NEON both go one particle at a time
+    if (vectorized_) {
+#if defined(__ARM_NEON)
+        stepRangeNeon(params, begin, end, outPositions, outVelocities);
+        return;
+#endif
+    }
+    stepRangeScalar(params, begin, end, outPositions, outVelocities);
+}
+
+#if defined(__ARM_NEON)
+
+//! 1 / sqrt(x), the estimate refined twice as inversesqrt() would be
+static inline float32x4_t inverseSqrt(float32x4_t x) {
+    float32x4_t estimate = vrsqrteq_f32(x);
+    estimate = vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(x, estimate), estimate));
+    return vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(x, estimate), estimate));
+}
+
+static inline float32x4_t divide(float32x4_t a, float32x4_t b) {
+#if defined(__aarch64__)
+    return vdivq_f32(a, b);
+#else
+    // ARMv7 NEON has no divide, the reciprocal estimate is refined twice instead
+    float32x4_t reciprocal = vrecpeq_f32(b);
+    reciprocal = vmulq_f32(vrecpsq_f32(b, reciprocal), reciprocal);
+    reciprocal = vmulq_f32(vrecpsq_f32(b, reciprocal), reciprocal);
+    return vmulq_f32(a, reciprocal);
+#endif
+}
+
+void CpuSimulation::stepRangeNeon(const SimParams &params, int begin, int end,
+                                  float *outPositions, float *outVelocities) {
+    const float32x4_t deltaTime = vdupq_n_f32(params.deltaTime);
+    const float32x4_t damping = vdupq_n_f32(params.damping);
+    const float32x4_t terminalVelocity = vdupq_n_f32(params.terminalVelocity);
+    const float32x4_t terminalSq = vdupq_n_f32(params.terminalVelocity * params.terminalVelocity);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    int attractorCount = std::min(params.attractorCount, MAX_ATTRACTORS);
+
+    for (int i = begin; i < end; i += VECTOR_WIDTH) {
+        // Four particles stay in registers over all steps, as in the kernel
+        float32x4_t x = vld1q_f32(&positionsX_[i]);
+        float32x4_t y = vld1q_f32(&positionsY_[i]);
+        float32x4_t vx = vld1q_f32(&velocitiesX_[i]);
+        float32x4_t vy = vld1q_f32(&velocitiesY_[i]);
+
+        for (int step = 0; step < params.stepCount; step++) {
+            float32x4_t forceX = vdupq_n_f32(0.0f);
+            float32x4_t forceY = vdupq_n_f32(0.0f);
+            for (int a = 0; a < attractorCount; a++) {
+                const auto &attractor = params.attractors[a];
+                float32x4_t toX = vsubq_f32(vdupq_n_f32(attractor.position[0]), x);
+                float32x4_t toY = vsubq_f32(vdupq_n_f32(attractor.position[1]), y);
+                float32x4_t distSq = vmlaq_f32(vmulq_f32(toX, toX), toY, toY);
+
+                // Direction times strength / (1 + falloff * distSq), falloff 0 skips the divide
+                float32x4_t pull = vdupq_n_f32(attractor.strength);
+                if (attractor.falloff != 0.0f) {
+                    pull = divide(pull, vmlaq_f32(one, vdupq_n_f32(attractor.falloff), distSq));
+                }
+                float32x4_t scale = vmulq_f32(inverseSqrt(distSq), pull);
+                forceX = vmlaq_f32(forceX, toX, scale);
+                forceY = vmlaq_f32(forceY, toY, scale);
+            }
+
+            vx = vmlaq_f32(vx, forceX, deltaTime);
+            vy = vmlaq_f32(vy, forceY, deltaTime);
+
+            // Clamp to the terminal velocity, lanes under it keep a scale of 1
+            float32x4_t speedSq = vmlaq_f32(vmulq_f32(vx, vx), vy, vy);
+            float32x4_t clamp = vmulq_f32(terminalVelocity, inverseSqrt(speedSq));
+            float32x4_t scale = vbslq_f32(vcgtq_f32(speedSq, terminalSq), clamp, one);
+            scale = vmulq_f32(scale, damping);
+            vx = vmulq_f32(vx, scale);
+            vy = vmulq_f32(vy, scale);
+
+            x = vmlaq_f32(x, vx, deltaTime);
+            y = vmlaq_f32(y, vy, deltaTime);
+        }
+
+        vst1q_f32(&positionsX_[i], x);
+        vst1q_f32(&positionsY_[i], y);
+        vst1q_f32(&velocitiesX_[i], vx);
+        vst1q_f32(&velocitiesY_[i], vy);
+
+        // Interleaved into vec2s on the way out
+        vst2q_f32(outPositions + 2 * i, (float32x4x2_t{{x, y}}));
+        vst2q_f32(outVelocities + 2 * i, (float32x4x2_t{{vx, vy}}));
+    }
+}
+
+#endif
+
+// Emulators and other CPUs without NEON step one particle at a time, same arithmetic
+void CpuSimulation::stepRangeScalar(const SimParams &params, int begin, int end,
+                                    float *outPositions, float *outVelocities) {
+    int attractorCount = std::min(params.attractorCount, MAX_ATTRACTORS);
+    for (int i = begin; i < end; i++) {
+        float x = positionsX_[i];
+        float y = positionsY_[i];
+        float vx = velocitiesX_[i];
+        float vy = velocitiesY_[i];
+
+        for (int step = 0; step < params.stepCount; step++) {
+            float forceX = 0.0f;
+            float forceY = 0.0f;
+            for (int a = 0; a < attractorCount; a++) {
+                const auto &attractor = params.attractors[a];
+                float toX = attractor.position[0] - x;
+                float toY = attractor.position[1] - y;
+                float distSq = toX * toX + toY * toY;
+                float scale = attractor.strength / ((1.0f + attractor.falloff * distSq) * std::sqrt(distSq));
+                forceX += toX * scale;
+                forceY += toY * scale;
+            }
+
+            vx += forceX * params.deltaTime;
+            vy += forceY * params.deltaTime;
+
+            float speedSq = vx * vx + vy * vy;
+            float scale = params.damping;
+            if (speedSq > params.terminalVelocity * params.terminalVelocity) {
+                scale *= params.terminalVelocity / std::sqrt(speedSq);
+            }
+            vx *= scale;
+            vy *= scale;
+
+            x += vx * params.deltaTime;
+            y += vy * params.deltaTime;
+        }
+
+        positionsX_[i] = x;
+        positionsY_[i] = y;
+        velocitiesX_[i] = vx;
+        velocitiesY_[i] = vy;
+        outPositions[2 * i] = x;
+        outPositions[2 * i + 1] = y;
+        outVelocities[2 * i] = vx;
+        outVelocities[2 * i + 1] = vy;
+    }
+}
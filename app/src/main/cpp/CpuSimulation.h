@@ -0,0 +1,54 @@
+#ifndef ANDROIDGLINVESTIGATIONS_CPUSIMULATION_H
+#define ANDROIDGLINVESTIGATIONS_CPUSIMULATION_H
+
+#include <vector>
+#include "SimParams.h"
+#include "ThreadPool.h"
+
+/*!
+ * The particle simulation on the CPU, for GPUs without working compute shaders. It runs the
+ * integrator of particle.comp, attractors, terminal velocity and damping, over SoA float arrays,
+ * four particles at a time with NEON where the CPU has it, and fills the state the way
+ * particle_init.comp does. The loops are split over a ThreadPool.
+ *
+ * Only the attractors are simulated: no interactions, reordering or lifetimes. Takes no GL calls,
+ * so it doubles as a reference for the GPU kernels.
+ */
+class CpuSimulation {
+public:
+    /*!
+     * Allocates state for @a capacity particles, filled by reset()
+     * @param vectorized steps four particles at a time with NEON where the CPU has it. Off, they
+     *        are stepped one at a time as without NEON, which the tests compare it with.
+     */
+    explicit CpuSimulation(int capacity, bool vectorized = true);
+
+    int capacity() const { return capacity_; }
+
+    //! Fills the first particleCount particles as particle_init.comp does with the same @a params
+    void reset(const InitParams &params);
+
+    /*!
+     * Takes the steps of @a params over its first particleCount particles and writes their
+     * state as the SoA32 vertex buffers expect it, vec2 positions and vec2 velocities. Without
+     * steps the state is written as it is.
+     */
+    void step(const SimParams &params, float *outPositions, float *outVelocities);
+
+private:
+    void stepRange(const SimParams &params, int begin, int end, float *outPositions, float *outVelocities);
+    void stepRangeScalar(const SimParams &params, int begin, int end, float *outPositions, float *outVelocities);
+#if defined(__ARM_NEON)
+    void stepRangeNeon(const SimParams &params, int begin, int end, float *outPositions, float *outVelocities);
+#endif
+
+    int capacity_;  // Rounded up to whole NEON vectors
+    bool vectorized_;
+    std::vector<float> positionsX_;
+    std::vector<float> positionsY_;
+    std::vector<float> velocitiesX_;
+    std::vector<float> velocitiesY_;
+    ThreadPool pool_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_CPUSIMULATION_H
@@ -0,0 +1,79 @@
+#include "DisplayMonitor.h"
+
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+#include <android/choreographer.h>
+
+#include "AndroidOut.h"
+
+static constexpr float DEFAULT_REFRESH_RATE = 60.0f;
+
+DisplayMonitor::DisplayMonitor(android_app *app) :
+        choreographer_(AChoreographer_getInstance()),
+        refreshRate_(DEFAULT_REFRESH_RATE) {
+    float rate = queryRefreshRate(app);
+    if (rate > 0.0f) {
+        aout << "Display refresh rate: " << rate << " Hz" << std::endl;
+        refreshRate_.store(rate, std::memory_order_relaxed);
+    } else {
+        aout << "Could not get refresh rate, defaulting to 60 Hz" << std::endl;
+    }
+
+    // Changes of display mode, a panel switching between 60 and 120 Hz for one
+    if (choreographer_) {
+        AChoreographer_registerRefreshRateCallback(choreographer_, onRefreshRateChanged, this);
+    }
+}
+
+DisplayMonitor::~DisplayMonitor() {
+    if (choreographer_) {
+        AChoreographer_unregisterRefreshRateCallback(choreographer_, onRefreshRateChanged, this);
+    }
+}
+
+void DisplayMonitor::onRefreshRateChanged(int64_t vsyncPeriodNanos, void *data) {
+    if (vsyncPeriodNanos <= 0) {
+        return;
+    }
+    auto *monitor = reinterpret_cast<DisplayMonitor *>(data);
+    float rate = 1e9f / static_cast<float>(vsyncPeriodNanos);
+    if (rate != monitor->refreshRate()) {
+        aout << "Display refresh rate changed to " << rate << " Hz" << std::endl;
+        monitor->refreshRate_.store(rate, std::memory_order_relaxed);
+    }
+}
+
+float DisplayMonitor::queryRefreshRate(android_app *app) {
+    float rate = 0.0f;
+    if (app && app->activity && app->activity->vm) {
+        JNIEnv* env;
+        app->activity->vm->AttachCurrentThread(&env, nullptr);
+        
+        // Get the NativeActivity instance
+        jobject activity = app->activity->javaGameActivity;
+        
+        // Get the WindowManager service
+        jclass activityClass = env->FindClass("android/app/NativeActivity");
+        jmethodID getWindowManager = env->GetMethodID(activityClass, "getWindowManager", "()Landroid/view/WindowManager;");
+        jobject windowManager = env->CallObjectMethod(activity, getWindowManager);
+        
+        // Get the default display
+        jclass windowManagerClass = env->FindClass("android/view/WindowManager");
+        jmethodID getDefaultDisplay = env->GetMethodID(windowManagerClass, "getDefaultDisplay", "()Landroid/view/Display;");
+        jobject display = env->CallObjectMethod(windowManager, getDefaultDisplay);
+        
+        // Get the refresh rate
+        jclass displayClass = env->FindClass("android/view/Display");
+        jmethodID getRefreshRate = env->GetMethodID(displayClass, "getRefreshRate", "()F");
+        rate = env->CallFloatMethod(display, getRefreshRate);
+        
+        // Clean up local references
+        env->DeleteLocalRef(displayClass);
+        env->DeleteLocalRef(display);
+        env->DeleteLocalRef(windowManagerClass);
+        env->DeleteLocalRef(windowManager);
+        env->DeleteLocalRef(activityClass);
+        
+        app->activity->vm->DetachCurrentThread();
+    }
+    return rate;
+}
@@ -0,0 +1,35 @@
+#ifndef ANDROIDGLINVESTIGATIONS_DISPLAYMONITOR_H
+#define ANDROIDGLINVESTIGATIONS_DISPLAYMONITOR_H
+
+#include <atomic>
+
+struct AChoreographer;
+struct android_app;
+
+/*!
+ * Keeps the display refresh rate at hand. It is asked of the window manager over JNI once, after
+ * that AChoreographer reports every change, so reading it is only an atomic load. Refresh rate
+ * callbacks run on the looper of the thread that created the monitor.
+ */
+class DisplayMonitor {
+public:
+    explicit DisplayMonitor(android_app *app);
+    ~DisplayMonitor();
+
+    DisplayMonitor(const DisplayMonitor&) = delete;
+    DisplayMonitor& operator=(const DisplayMonitor&) = delete;
+
+    //! Current refresh rate in Hz, 60 if the display never said
+    float refreshRate() const { return refreshRate_.load(std::memory_order_relaxed); }
+
+private:
+    static void onRefreshRateChanged(int64_t vsyncPeriodNanos, void *data);
+
+    //! Display.getRefreshRate() of the default display, 0 if it can't be asked
+    static float queryRefreshRate(android_app *app);
+
+    AChoreographer *choreographer_;  // Null if this thread has none, the rate stays as queried
+    std::atomic<float> refreshRate_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_DISPLAYMONITOR_H
@@ -0,0 +1,114 @@
+#include "FramePacer.h"
+
+#include <android/choreographer.h>
+#include <thread>
+
+#include "AndroidOut.h"
+
+namespace {
+
+/*!
+ * Paces frames off display vsync. A frame callback is kept in flight at all times; when it fires
+ * the looper returns ALOOPER_POLL_CALLBACK and the next call to frameDue() reports the frame and
+ * posts the following callback.
+ */
+class ChoreographerPacer : public FramePacer {
+public:
+    explicit ChoreographerPacer(AChoreographer *choreographer) :
+            choreographer_(choreographer),
+            frameReady_(false) {
+        postCallback();
+    }
+
+    Mode mode() const override { return Mode::Choreographer; }
+
+    int swapInterval() const override { return 1; }
+
+    void setRefreshRate(float) override {
+        // Vsync callbacks already follow the display rate
+    }
+
+    int pollTimeoutMillis() const override { return frameReady_ ? 0 : -1; }
+
+    bool frameDue() override {
+        if (!frameReady_) {
+            return false;
+        }
+        frameReady_ = false;
+        postCallback();
+        return true;
+    }
+
+private:
+    static void onFrame(int64_t, void *data) {
+        reinterpret_cast<ChoreographerPacer *>(data)->frameReady_ = true;
+    }
+
+    void postCallback() {
+        AChoreographer_postFrameCallback64(choreographer_, onFrame, this);
+    }
+
+    AChoreographer *choreographer_;
+    bool frameReady_;
+};
+
+/*!
+ * Paces frames by sleeping until a deadline derived from the display refresh rate. The coarse part
+ * of the wait happens in ALooper_pollOnce so events are still serviced; the sub-millisecond
+ * remainder is a plain sleep.
+ */
+class SleepPacer : public FramePacer {
+public:
+    SleepPacer() :
+            period_(std::chrono::nanoseconds(1000000000LL / 60)),
+            deadline_(std::chrono::steady_clock::now()) {}
+
+    Mode mode() const override { return Mode::Sleep; }
+
+    int swapInterval() const override { return 0; }
+
+    void setRefreshRate(float refreshRate) override {
+        if (refreshRate > 0.0f) {
+            period_ = std::chrono::nanoseconds(static_cast<long long>(1000000000.0f / refreshRate));
+        }
+    }
+
+    int pollTimeoutMillis() const override {
+        auto remaining = deadline_ - std::chrono::steady_clock::now();
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
+        return millis > 0 ? static_cast<int>(millis) : 0;
+    }
+
+    bool frameDue() override {
+        auto now = std::chrono::steady_clock::now();
+        if (now + std::chrono::milliseconds(1) < deadline_) {
+            return false;
+        }
+        std::this_thread::sleep_until(deadline_);
+
+        deadline_ += period_;
+        // Don't try to catch up on frames we missed, just restart the cadence
+        if (deadline_ < now) {
+            deadline_ = now + period_;
+        }
+        return true;
+    }
+
+private:
+    std::chrono::steady_clock::duration period_;
+    std::chrono::steady_clock::time_point deadline_;
+};
+
+} // namespace
+
+FramePacer *FramePacer::create(Mode preferred) {
+    if (preferred == Mode::Choreographer) {
+        if (auto *choreographer = AChoreographer_getInstance()) {
+            aout << "Frame pacing: Choreographer" << std::endl;
+            return new ChoreographerPacer(choreographer);
+        }
+        aout << "Choreographer unavailable on this thread, falling back to sleep pacing" << std::endl;
+    }
+    aout << "Frame pacing: sleep until deadline" << std::endl;
+    return new SleepPacer();
+}
@@ -0,0 +1,49 @@
+#ifndef ANDROIDGLINVESTIGATIONS_FRAMEPACER_H
+#define ANDROIDGLINVESTIGATIONS_FRAMEPACER_H
+
+#include <chrono>
+#include <cstdint>
+
+/*!
+ * Decides when the next frame should be produced.
+ *
+ * The main loop asks the pacer how long it may block in ALooper_pollOnce and then whether a frame
+ * is due, so the render thread sleeps between frames instead of spinning on the clock. Pacers live
+ * for the whole of android_main because Choreographer callbacks cannot be cancelled once posted.
+ */
+class FramePacer {
+public:
+    enum class Mode {
+        //! Frames are started from AChoreographer vsync callbacks, swap interval 1
+        Choreographer,
+        //! Frames are started by sleeping until the next refresh deadline, swap interval 0
+        Sleep
+    };
+
+    /*!
+     * Creates a pacer for the calling thread, which must own an ALooper. Falls back to
+     * @a Mode::Sleep if the preferred mode is not available on this device.
+     *
+     * @param preferred the mode to try first
+     * @return a new pacer, owned by the caller
+     */
+    static FramePacer *create(Mode preferred = Mode::Choreographer);
+
+    virtual ~FramePacer() = default;
+
+    virtual Mode mode() const = 0;
+
+    //! The EGL swap interval that matches this pacing mode
+    virtual int swapInterval() const = 0;
+
+    //! Tells the pacer the display refresh rate, used by modes that keep their own deadline
+    virtual void setRefreshRate(float refreshRate) = 0;
+
+    //! How long the main loop may block waiting for events before the next frame, -1 for forever
+    virtual int pollTimeoutMillis() const = 0;
+
+    //! Returns true exactly once per frame when it is time to render, consuming the frame
+    virtual bool frameDue() = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_FRAMEPACER_H
@@ -0,0 +1,1246 @@
+#include "GlBackend.h"
+
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+#include "AndroidOut.h"
+#include "FramePacer.h"
+#include "Utility.h"
+
+// Smallest debug.particles.render_scale, below it sprites are a few blurry pixels
+static constexpr float MIN_RENDER_SCALE = 0.25f;
+
+GlBackend::GlBackend(android_app *app, FramePacer *pacer) :
+        app_(app),
+        pacer_(pacer),
+        display_(EGL_NO_DISPLAY),
+        surface_(EGL_NO_SURFACE),
+        context_(EGL_NO_CONTEXT),
+        config_(nullptr),
+        width_(-1),
+        height_(-1),
+        pointSize_(DEFAULT_POINT_SIZE),
+        configuredScale_(1.0f),
+        renderScale_(1.0f),
+        renderWidth_(0),
+        renderHeight_(0),
+        sceneFramebuffer_(0),
+        sceneColor_(0),
+        es31_(false),
+        layout_(ParticleLayout::SoA32),
+        kernel_{0, 1},
+        computeShader_(nullptr),
+        initShader_(nullptr),
+        particleShader_(nullptr),
+        drawMode_(DrawMode::Sprites),
+        densityClearShader_(nullptr),
+        densitySplatShader_(nullptr),
+        densityShader_(nullptr),
+        densityGrid_(0),
+        densityParams_{},
+        lodCellsShader_(nullptr),
+        lodPointsShader_(nullptr),
+        lodSplatShader_(nullptr),
+        lodPointShader_(nullptr),
+        lodSplats_(0),
+        lodPoints_(0),
+        lodSplatArray_(0),
+        lodPointArray_(0),
+        trailFadeShader_(nullptr),
+        trailFramebuffer_(0),
+        trailColor_(0),
+        trailWidth_(0),
+        trailHeight_(0),
+        trailDecay_(0.0f),
+        trailStretch_(0.0f),
+        maxPointSize_(1.0f),
+        interaction_(Interaction::None),
+        reorder_(false),
+        orderShader_(nullptr),
+        lifetimes_(false),
+        cpuSimulation_(false),
+        streamed_(0),
+        initParams_{},
+        projection_{} {
+    // Only color: nothing is depth tested, and every frame clears, so the swap needn't preserve
+    // anything. Configs are sorted smallest depth and stencil first.
+    constexpr EGLint attribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+            EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+            EGL_BLUE_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_RED_SIZE, 8,
+            EGL_DEPTH_SIZE, 0,
+            EGL_STENCIL_SIZE, 0,
+            EGL_NONE
+    };
+
+    display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display_ == EGL_NO_DISPLAY) {
+        throw std::runtime_error("Failed to get display");
+    }
+
+    // Nothing is half built if this throws: the window has to be free for the Vulkan fallback
+    try {
+        if (!eglInitialize(display_, nullptr, nullptr)) {
+            throw std::runtime_error("Failed to initialize display");
+        }
+
+        EGLint numConfigs;
+        if (!eglChooseConfig(display_, attribs, nullptr, 0, &numConfigs) || numConfigs == 0) {
+            throw std::runtime_error("Failed to get config count");
+        }
+
+        std::unique_ptr<EGLConfig[]> supportedConfigs(new EGLConfig[numConfigs]);
+        if (!eglChooseConfig(display_, attribs, supportedConfigs.get(), numConfigs, &numConfigs)) {
+            throw std::runtime_error("Failed to get configs");
+        }
+
+        config_ = supportedConfigs[0]; // Just take the first config for now
+
+        if (!createSurface(app_->window) || !createContext()) {
+            throw std::runtime_error("Failed to create EGL surface and context");
+        }
+
+        // Print OpenGL info
+        aout << "OpenGL Vendor: " << glGetString(GL_VENDOR) << std::endl;
+        aout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << std::endl;
+        aout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
+
+        // Without compute shaders the particles are simulated on the CPU, and only drawn here
+        cpuSimulation_ = Utility::getSystemProperty("debug.particles.simulation") == "cpu";
+        GLint maxComputeWorkGroupCount[3] = {0};
+        if (es31_) {
+            glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxComputeWorkGroupCount[0]);
+        }
+        if (!es31_ || glGetError() != GL_NO_ERROR || maxComputeWorkGroupCount[0] == 0) {
+            aout << "Device does not support compute shaders, simulating on the CPU" << std::endl;
+            cpuSimulation_ = true;
+        } else if (cpuSimulation_) {
+            aout << "Simulating on the CPU, as debug.particles.simulation asks" << std::endl;
+        }
+
+        // debug.particles.render_scale draws the particles at a fraction of the surface size, up to 1
+        configuredScale_ = static_cast<float>(std::atof(
+                Utility::getSystemProperty("debug.particles.render_scale", "1").c_str()));
+        configuredScale_ = configuredScale_ > 0.0f ? std::min(std::max(configuredScale_, MIN_RENDER_SCALE), 1.0f)
+                                                   : 1.0f;
+        renderScale_ = configuredScale_;
+        aout << "Render scale: " << renderScale_ << std::endl;
+
+        // Skips compiling and linking on later launches, needs the context for the GL strings
+        programCache_ = std::make_unique<ProgramCache>(ProgramCache::cacheDirectory(app_->activity));
+        createShaderLibrary();
+        createGpuTimers();
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+GlBackend::~GlBackend() {
+    destroy();
+}
+
+void GlBackend::destroy() {
+    if (display_ != EGL_NO_DISPLAY) {
+        // GL objects have to go while the context is still current
+        simulateTimer_.reset();
+        drawTimer_.reset();
+        sortTimer_.reset();
+        neighbourGrid_.reset();
+        radixSort_.reset();
+        life_.reset();
+        stream_.reset();
+        particleState_.reset();
+        shaders_.reset();
+        if (sceneFramebuffer_) {
+            glDeleteFramebuffers(1, &sceneFramebuffer_);
+            glDeleteRenderbuffers(1, &sceneColor_);
+        }
+        simParamsBuffer_.reset();
+        initParamsBuffer_.reset();
+        densityParamsBuffer_.reset();
+        if (densityGrid_) {
+            glDeleteBuffers(1, &densityGrid_);
+        }
+        if (lodSplats_) {
+            glDeleteBuffers(1, &lodSplats_);
+            glDeleteBuffers(1, &lodPoints_);
+            glDeleteVertexArrays(1, &lodSplatArray_);
+            glDeleteVertexArrays(1, &lodPointArray_);
+        }
+        if (trailFramebuffer_) {
+            glDeleteFramebuffers(1, &trailFramebuffer_);
+            glDeleteTextures(1, &trailColor_);
+        }
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context_ != EGL_NO_CONTEXT) {
+            eglDestroyContext(display_, context_);
+            context_ = EGL_NO_CONTEXT;
+        }
+        if (surface_ != EGL_NO_SURFACE) {
+            eglDestroySurface(display_, surface_);
+            surface_ = EGL_NO_SURFACE;
+        }
+        eglTerminate(display_);
+        display_ = EGL_NO_DISPLAY;
+    }
+}
+
+std::string GlBackend::deviceName() const {
+    auto value = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+    return value ? value : "";
+}
+
+std::string GlBackend::apiVersion() const {
+    auto value = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+    return value ? value : "";
+}
+
+int GlBackend::maxCapacity(ParticleLayout layout) const {
+    if (cpuSimulation_) {
+        // No storage blocks, ES 3.0 doesn't know their limit. RAM bounds the CPU arrays.
+        return ParticleStream::maxCapacity();
+    }
+    return ParticleState::maxCapacity(layout);
+}
+
+int GlBackend::maxLocalSize() const {
+    if (cpuSimulation_) {
+        return 0;
+    }
+    // The kernels are one dimensional, so the X size limits them as much as the invocations
+    GLint maxInvocations = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+    GLint maxSizeX = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxSizeX);
+    return std::min(maxInvocations, maxSizeX);
+}
+
+bool GlBackend::createSurface(ANativeWindow *window) {
+    surface_ = eglCreateWindowSurface(display_, config_, window, nullptr);
+    if (surface_ == EGL_NO_SURFACE) {
+        aout << "Failed to create surface" << std::endl;
+        return false;
+    }
+
+    // A new surface may have a new size, the next frame picks it up
+    width_ = -1;
+    height_ = -1;
+    return true;
+}
+
+bool GlBackend::createContext() {
+    // GLES 3.1 for the compute shaders, 3.0 is still enough to draw what the CPU simulates
+    for (EGLint minorVersion : {1, 0}) {
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, minorVersion,
+            EGL_NONE
+        };
+        context_ = eglCreateContext(display_, config_, nullptr, contextAttribs);
+        if (context_ != EGL_NO_CONTEXT) {
+            es31_ = minorVersion == 1;
+            break;
+        }
+        aout << "Failed to create OpenGL ES 3." << minorVersion << " context, error: " << eglGetError()
+             << std::endl;
+    }
+    if (context_ == EGL_NO_CONTEXT) {
+        return false;
+    }
+
+    if (!eglMakeCurrent(display_, surface_, surface_, context_)) {
+        aout << "Failed to make context current" << std::endl;
+        return false;
+    }
+
+    // Let the pacer pick vsync behaviour; Choreographer pacing swaps on vsync, sleep pacing doesn't
+    EGLint swapInterval = pacer_->swapInterval();
+    if (!eglSwapInterval(display_, swapInterval)) {
+        aout << "Failed to set swap interval " << swapInterval << ", error: " << eglGetError() << std::endl;
+    }
+
+    // Setup GL state first
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Pure black background
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    return true;
+}
+
+void GlBackend::createShaderLibrary() {
+    // debug.particles.shader_reload=1 takes shader files pushed to the app's external files dir
+    // over the assets, and rebuilds what uses them when they change
+    std::string devDirectory;
+    if (Utility::getSystemProperty("debug.particles.shader_reload") == "1" && app_->activity->externalDataPath) {
+        devDirectory = app_->activity->externalDataPath;
+    }
+    shaders_ = std::make_unique<ShaderLibrary>(app_->activity->assetManager, programCache_.get(), devDirectory);
+}
+
+void GlBackend::createGpuTimers() {
+    if (cpuSimulation_) {
+        aout << "Simulating on the CPU, profiling CPU time only" << std::endl;
+    } else if (GpuTimer::isSupported()) {
+        simulateTimer_ = std::make_unique<GpuTimer>();
+        drawTimer_ = std::make_unique<GpuTimer>();
+        sortTimer_ = std::make_unique<GpuTimer>();
+    } else {
+        aout << "GL_EXT_disjoint_timer_query not available, profiling CPU time only" << std::endl;
+    }
+}
+
+void GlBackend::initParticles(ParticleLayout layout, int capacity, const StepKernel &kernel,
+                              DrawMode drawMode, Interaction interaction, bool reorder, bool lifetimes) {
+    layout_ = layout;
+    kernel_ = kernel;
+    drawMode_ = drawMode;
+    interaction_ = interaction;
+    reorder_ = reorder;
+    lifetimes_ = lifetimes;
+    if (cpuSimulation_) {
+        initCpuSimulation(capacity);
+        return;
+    }
+
+    // Everything but the sprite draw and the step reads the first particleCount particles, dead or
+    // alive, so lifetimes only go with those
+    if (lifetimes_ && ((drawMode_ != DrawMode::Sprites && drawMode_ != DrawMode::Trails)
+                       || interaction_ != Interaction::None)) {
+        aout << "Particle lifetimes need the sprite or trails draw and no interaction, particles live forever"
+             << std::endl;
+        lifetimes_ = false;
+    }
+    if (lifetimes_ && reorder_) {
+        aout << "No particle reordering with lifetimes" << std::endl;
+        reorder_ = false;
+    }
+
+    // The forces and the sorted order each take the step one storage block past the state, and
+    // GLES 3.1 only guarantees four. Reordering goes first when there aren't enough.
+    GLint computeBlocks = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS, &computeBlocks);
+    int stateBlocks = 2 * (ParticleState::bufferStride(layout_, 1) > 0 ? 2 : 1);
+    if (reorder_ && computeBlocks < stateBlocks + (interaction_ != Interaction::None) + 1) {
+        aout << "Only " << computeBlocks << " compute storage blocks, no particle reordering" << std::endl;
+        reorder_ = false;
+    }
+    if (interaction_ != Interaction::None && computeBlocks < stateBlocks + 1) {
+        aout << "Only " << computeBlocks << " compute storage blocks, no particle interactions" << std::endl;
+        interaction_ = Interaction::None;
+    }
+    if (lifetimes_ && computeBlocks < stateBlocks + 2) {
+        aout << "Only " << computeBlocks << " compute storage blocks, no particle lifetimes" << std::endl;
+        lifetimes_ = false;
+    }
+
+    // The extra blocks also sit at fixed bindings past the state's, which the device has to have
+    GLint bindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &bindings);
+    if (reorder_ && bindings <= static_cast<GLint>(std::max(PARTICLE_ORDER_BINDING, RADIX_HISTOGRAM_BINDING))) {
+        aout << "Only " << bindings << " storage buffer bindings, no particle reordering" << std::endl;
+        reorder_ = false;
+    }
+    if (interaction_ != Interaction::None && bindings <= static_cast<GLint>(NEIGHBOUR_FORCE_BINDING)) {
+        aout << "Only " << bindings << " storage buffer bindings, no particle interactions" << std::endl;
+        interaction_ = Interaction::None;
+    }
+    if (lifetimes_ && bindings <= static_cast<GLint>(LIFE_OUTPUT_BINDING)) {
+        aout << "Only " << bindings << " storage buffer bindings, no particle lifetimes" << std::endl;
+        lifetimes_ = false;
+    }
+    GLuint drawBinding = drawMode_ == DrawMode::Lod ? LOD_POINT_BINDING : DENSITY_GRID_BINDING;
+    if ((drawMode_ == DrawMode::Density || drawMode_ == DrawMode::Lod) && bindings <= static_cast<GLint>(drawBinding)) {
+        aout << "Only " << bindings << " storage buffer bindings, drawing sprites" << std::endl;
+        drawMode_ = DrawMode::Sprites;
+    }
+    loadShaders();
+
+    // Allocate the state in the layout the shaders were compiled for, resetParticles() fills it
+    particleState_ = std::make_unique<ParticleState>(layout_, capacity);
+    if (interaction_ != Interaction::None) {
+        neighbourGrid_ = std::make_unique<NeighbourGrid>(shaders_.get(), layout_, capacity, interaction_);
+    }
+    if (reorder_) {
+        radixSort_ = std::make_unique<RadixSort>(shaders_.get(), capacity);
+    }
+    if (lifetimes_) {
+        life_ = std::make_unique<ParticleLife>(shaders_.get(), layout_, capacity, kernel_.groupParticles());
+    }
+
+    // Uniform buffers for the per-frame parameters, streamed so an upload never waits on a frame in flight
+    simParamsBuffer_ = std::make_unique<StreamingBuffer>(GL_UNIFORM_BUFFER, sizeof(SimParams));
+    initParamsBuffer_ = std::make_unique<StreamingBuffer>(GL_UNIFORM_BUFFER, sizeof(InitParams));
+
+    // The density grid is sized on the first draw, it follows the surface
+    if (drawMode_ == DrawMode::Density || drawMode_ == DrawMode::Lod) {
+        densityParamsBuffer_ = std::make_unique<StreamingBuffer>(GL_UNIFORM_BUFFER, sizeof(DensityParams));
+        glGenBuffers(1, &densityGrid_);
+        densityParams_ = {};
+    }
+
+    // The LOD buffers are sized along with the grid, the vertex arrays only name them
+    if (drawMode_ == DrawMode::Lod) {
+        glGenBuffers(1, &lodSplats_);
+        glGenBuffers(1, &lodPoints_);
+        glGenVertexArrays(1, &lodSplatArray_);
+        glGenVertexArrays(1, &lodPointArray_);
+
+        // One vec4 per dense cell, advanced per instance
+        glBindVertexArray(lodSplatArray_);
+        glBindBuffer(GL_ARRAY_BUFFER, lodSplats_);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+        glVertexAttribDivisor(0, 1);
+        glEnableVertexAttribArray(0);
+
+        // Points are interleaved whatever the state layout, as Interleaved32
+        glBindVertexArray(lodPointArray_);
+        glBindBuffer(GL_ARRAY_BUFFER, lodPoints_);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                              reinterpret_cast<const void *>(2 * sizeof(float)));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Verify setup
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        aout << "Error after buffer setup: 0x" << std::hex << error << std::dec << std::endl;
+    }
+}
+
+void GlBackend::initCpuSimulation(int capacity) {
+    // Everything past the attractors and the sprite and trail draws is a compute pass
+    bool trails = drawMode_ == DrawMode::Trails;
+    if ((drawMode_ != DrawMode::Sprites && !trails) || interaction_ != Interaction::None || reorder_
+            || lifetimes_) {
+        aout << "The CPU simulation only draws sprites or trails, without interactions, reordering or lifetimes"
+             << std::endl;
+    }
+    drawMode_ = trails ? DrawMode::Trails : DrawMode::Sprites;
+    interaction_ = Interaction::None;
+    reorder_ = false;
+    lifetimes_ = false;
+
+    // The simulation holds the state, a lost context only takes the stream with it
+    if (!cpu_) {
+        cpu_ = std::make_unique<CpuSimulation>(capacity);
+    }
+    stream_ = std::make_unique<ParticleStream>(cpu_->capacity());
+    streamed_ = 0;
+
+    // The stream is SoA32 whatever the state layout, and a 3.0 context needs the 3.0 language
+    particleShader_ = shaders_->graphics("shaders/particle.vert", "shaders/particle.frag",
+                                         spriteDefines(ParticleLayout::SoA32), "position",
+                                         "uProjection", es31_ ? "" : "300 es");
+    if (!particleShader_) {
+        throw std::runtime_error("Failed to create particle shader");
+    }
+    if (trails) {
+        loadTrailShaders();
+    }
+    std::fill(std::begin(projection_), std::end(projection_), 0.0f);
+}
+
+void GlBackend::loadShaders() {
+    try {
+        // Load particle shaders
+        aout << "Loading particle vertex shader..." << std::endl;
+        particleShader_ = shaders_->graphics("shaders/particle.vert", "shaders/particle.frag",
+                                             spriteDefines(layout_), "position", "uProjection");
+        if (!particleShader_) {
+            throw std::runtime_error("Failed to create particle shader");
+        }
+
+        // Load the compute shaders, the init kernel fills the state and the step kernel advances it
+        aout << "Loading compute shaders..." << std::endl;
+        initShader_ = shaders_->compute("shaders/particle_init.comp", ParticleState::defines(layout_));
+        if (!initShader_) {
+            throw std::runtime_error("Failed to create particle init shader");
+        }
+
+        computeShader_ = loadComputeShader(kernel_);
+        if (!computeShader_) {
+            throw std::runtime_error("Failed to create compute shader");
+        }
+
+        if (reorder_) {
+            orderShader_ = shaders_->compute("shaders/particle_order.comp", ParticleState::defines(layout_));
+            if (!orderShader_) {
+                throw std::runtime_error("Failed to create particle order shader");
+            }
+        }
+
+        if (drawMode_ == DrawMode::Trails) {
+            loadTrailShaders();
+        } else if (drawMode_ != DrawMode::Sprites) {
+            loadDensityShaders();
+        }
+
+    } catch (const std::exception& e) {
+        throw std::runtime_error(std::string("Error loading shader files: ") + e.what());
+    }
+
+    // The projection goes into the new program on the next draw
+    std::fill(std::begin(projection_), std::end(projection_), 0.0f);
+}
+
+Shader::Defines GlBackend::spriteDefines(ParticleLayout layout) const {
+    auto defines = ParticleState::defines(layout);
+    if (drawMode_ == DrawMode::Trails) {
+        defines.emplace_back("STRETCH", "1");
+    }
+    return defines;
+}
+
+void GlBackend::loadTrailShaders() {
+    // The fade covers the screen with the density draw's triangle
+    trailFadeShader_ = shaders_->graphics("shaders/density.vert", "shaders/trail_fade.frag", {}, "", "",
+                                          es31_ ? "" : "300 es");
+    if (!trailFadeShader_) {
+        throw std::runtime_error("Failed to create trail shaders");
+    }
+    GLfloat pointSizes[2] = {1.0f, 1.0f};
+    glGetFloatv(GL_ALIASED_POINT_SIZE_RANGE, pointSizes);
+    maxPointSize_ = pointSizes[1];
+}
+
+void GlBackend::loadDensityShaders() {
+    // GLES 3.1 doesn't require storage buffers outside compute, and the density resolve reads one
+    if (drawMode_ == DrawMode::Density) {
+        GLint fragmentBlocks = 0;
+        glGetIntegerv(GL_MAX_FRAGMENT_SHADER_STORAGE_BLOCKS, &fragmentBlocks);
+        if (fragmentBlocks < 1) {
+            aout << "No fragment shader storage blocks, drawing sprites instead of density" << std::endl;
+            drawMode_ = DrawMode::Sprites;
+            return;
+        }
+    }
+
+    auto defines = ParticleState::defines(layout_);
+    densityClearShader_ = shaders_->compute("shaders/density_clear.comp");
+    densitySplatShader_ = shaders_->compute("shaders/density_splat.comp", defines);
+    if (!densityClearShader_ || !densitySplatShader_) {
+        throw std::runtime_error("Failed to create density shaders");
+    }
+
+    if (drawMode_ == DrawMode::Density) {
+        densityShader_ = shaders_->graphics("shaders/density.vert", "shaders/density.frag");
+        if (!densityShader_) {
+            throw std::runtime_error("Failed to create density shaders");
+        }
+        return;
+    }
+
+    lodCellsShader_ = shaders_->compute("shaders/lod_cells.comp");
+    lodPointsShader_ = shaders_->compute("shaders/lod_points.comp", defines);
+    lodSplatShader_ = shaders_->graphics("shaders/lod_splat.vert", "shaders/lod_splat.frag");
+    lodPointShader_ = shaders_->graphics("shaders/particle.vert", "shaders/particle.frag",
+                                         ParticleState::defines(ParticleLayout::Interleaved32), "position",
+                                         "uProjection");
+    if (!lodCellsShader_ || !lodPointsShader_ || !lodSplatShader_ || !lodPointShader_) {
+        throw std::runtime_error("Failed to create LOD shaders");
+    }
+}
+
+Shader *GlBackend::loadComputeShader(const StepKernel &kernel) {
+    auto defines = ParticleState::defines(layout_);
+    defines.emplace_back("LOCAL_SIZE_X", std::to_string(kernel.localSize));
+    defines.emplace_back("PARTICLES_PER_INVOCATION", std::to_string(kernel.particlesPerInvocation) + "u");
+    if (interaction_ != Interaction::None) {
+        defines.emplace_back("NEIGHBOUR_FORCES", "1");
+    }
+    if (reorder_) {
+        defines.emplace_back("PARTICLE_ORDER", "1");
+    }
+    if (lifetimes_) {
+        defines.emplace_back("PARTICLE_LIFE", "1");
+    }
+    return shaders_->compute("shaders/particle.comp", defines);
+}
+
+void GlBackend::setStepKernel(const StepKernel &kernel) {
+    if (kernel == kernel_) {
+        return;
+    }
+    // Kernels swept before are still in the library, switching back to one doesn't rebuild it
+    auto *shader = loadComputeShader(kernel);
+    if (!shader) {
+        aout << "Failed to create the step kernel for " << kernel.localSize << " x "
+             << kernel.particlesPerInvocation << ", keeping the current one" << std::endl;
+        return;
+    }
+    computeShader_ = shader;
+    if (life_) {
+        life_->setGroupParticles(kernel.groupParticles());
+    }
+    kernel_ = kernel;
+}
+
+void GlBackend::resetParticles(const InitParams &params) {
+    if (cpu_) {
+        // The next simulate() streams the fresh state, with or without steps
+        initParams_ = params;
+        cpu_->reset(params);
+        streamed_ = 0;
+        return;
+    }
+    if (!initShader_) return;
+    initParams_ = params;
+
+    // A pending step must not be swapped in over the fresh state
+    particleState_->advance();
+
+    // Resets come one after another between benchmark configurations, none waits for the last
+    initParamsBuffer_->upload(&params, sizeof(InitParams));
+    initParamsBuffer_->bindRange(INIT_PARAMS_BINDING);
+
+    // Both copies, the step only writes the active range and the budget may grow into the rest
+    initShader_->activate();
+    for (int copy = 0; copy < 2; copy++) {
+        particleState_->bindStorage(copy);
+        glDispatchCompute((params.particleCount + 255) / 256, 1, 1);
+    }
+    initShader_->deactivate();
+    if (life_) {
+        life_->reset(particleState_->front(), static_cast<int>(params.aliveCount));
+    }
+
+    // The state is next read by the step kernel, the vertex fetch or a snapshot restore
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+                    | GL_BUFFER_UPDATE_BARRIER_BIT);
+    initParamsBuffer_->fence();
+}
+
+void GlBackend::onSurfaceDestroyed(int activeParticles) {
+    if (surface_ == EGL_NO_SURFACE) {
+        return;
+    }
+
+    // The context usually outlives the surface, but keep a copy of the state in case it doesn't.
+    // Not with lifetimes: how many are alive is only known on the GPU, and the lifetimes live in
+    // buffers of their own, so a lost context starts over from the last reset instead.
+    if (particleState_ && !life_) {
+        particleState_->advance();
+        snapshot_ = particleState_->snapshot(activeParticles);
+        aout << "Saved " << snapshot_.size() / 1024 << " KiB particle snapshot" << std::endl;
+    }
+
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(display_, surface_);
+    surface_ = EGL_NO_SURFACE;
+}
+
+void GlBackend::onSurfaceCreated(ANativeWindow *window) {
+    if (surface_ != EGL_NO_SURFACE || !createSurface(window)) {
+        return;
+    }
+
+    if (!eglMakeCurrent(display_, surface_, surface_, context_)) {
+        EGLint error = eglGetError();
+        if (error != EGL_CONTEXT_LOST) {
+            aout << "Failed to make context current: 0x" << std::hex << error << std::dec << std::endl;
+            return;
+        }
+        recoverContext();
+    } else {
+        aout << "Resumed on the existing context" << std::endl;
+        snapshot_.clear();
+    }
+}
+
+void GlBackend::recoverContext() {
+    aout << "EGL context lost, rebuilding GL objects" << std::endl;
+
+    // Everything we hold names for died with the old context. Nothing is current while the
+    // wrappers go, so their deletes can't hit objects of the new context.
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    int capacity = cpu_ ? cpu_->capacity() : particleState_ ? particleState_->capacity() : 0;
+    simulateTimer_.reset();
+    drawTimer_.reset();
+    sortTimer_.reset();
+    neighbourGrid_.reset();
+    radixSort_.reset();
+    life_.reset();
+    stream_.reset();
+    particleState_.reset();
+    shaders_.reset();
+    computeShader_ = nullptr;
+    initShader_ = nullptr;
+    particleShader_ = nullptr;
+    densityClearShader_ = nullptr;
+    densitySplatShader_ = nullptr;
+    densityShader_ = nullptr;
+    lodCellsShader_ = nullptr;
+    lodPointsShader_ = nullptr;
+    lodSplatShader_ = nullptr;
+    lodPointShader_ = nullptr;
+    orderShader_ = nullptr;
+    simParamsBuffer_.reset();
+    initParamsBuffer_.reset();
+    densityParamsBuffer_.reset();
+    densityGrid_ = 0;
+    lodSplats_ = 0;
+    lodPoints_ = 0;
+    lodSplatArray_ = 0;
+    lodPointArray_ = 0;
+    trailFadeShader_ = nullptr;
+    trailFramebuffer_ = 0;
+    trailColor_ = 0;
+    trailWidth_ = 0;
+    trailHeight_ = 0;
+    sceneFramebuffer_ = 0;
+    sceneColor_ = 0;
+    width_ = -1;
+    height_ = -1;
+    eglDestroyContext(display_, context_);
+    context_ = EGL_NO_CONTEXT;
+
+    if (!createContext()) {
+        return;
+    }
+    createShaderLibrary();
+    createGpuTimers();
+    if (capacity == 0) {
+        return;
+    }
+
+    try {
+        initParticles(layout_, capacity, kernel_, drawMode_, interaction_, reorder_, lifetimes_);
+    } catch (const std::exception& e) {
+        aout << "Error rebuilding GL objects: " << e.what() << std::endl;
+        return;
+    }
+
+    // The CPU simulation's state is still there, the next simulate() streams it
+    if (cpu_) {
+        aout << "The CPU simulation continues where it was" << std::endl;
+        snapshot_.clear();
+        return;
+    }
+
+    // Inactive particles get fresh values, the active ones continue from the snapshot. Without one,
+    // after a loss in present() or with lifetimes, the reset's state and live count stand.
+    resetParticles(initParams_);
+    if (!snapshot_.empty()) {
+        int restored = particleState_->restore(snapshot_);
+        aout << "Restored " << restored << " particles from the snapshot" << std::endl;
+    }
+    snapshot_.clear();
+}
+
+bool GlBackend::collectGpuTimes(float *outSimulateMillis, float *outDrawMillis) {
+    // Both timers run every frame, so their rings stay in step
+    if (!simulateTimer_ || !simulateTimer_->collect(outSimulateMillis)) {
+        return false;
+    }
+    return drawTimer_->collect(outDrawMillis);
+}
+
+bool GlBackend::collectSortTime(float *outMillis) {
+    return sortTimer_ && sortTimer_->collect(outMillis);
+}
+
+void GlBackend::beginFrame(int *outWidth, int *outHeight) {
+    EGLint width;
+    eglQuerySurface(display_, surface_, EGL_WIDTH, &width);
+    EGLint height;
+    eglQuerySurface(display_, surface_, EGL_HEIGHT, &height);
+
+    if (width != width_ || height != height_) {
+        width_ = width;
+        height_ = height;
+        resizeScene();
+    }
+    *outWidth = width_;
+    *outHeight = height_;
+
+    // The disjoint flag is cleared by reading it, so it is read once here, before this frame's
+    // results are collected, and all timers drop their queries together to stay in step
+    if (simulateTimer_ && GpuTimer::disjoint()) {
+        simulateTimer_->discard();
+        drawTimer_->discard();
+        sortTimer_->discard();
+    }
+
+    // Rebuilt programs start with default uniforms, the projection is only set when it changes
+    if (shaders_ && shaders_->reload() > 0) {
+        std::fill(std::begin(projection_), std::end(projection_), 0.0f);
+    }
+
+    // The particles go into the scene, if there is one
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer_);
+    glViewport(0, 0, renderWidth_, renderHeight_);
+
+    // Clear to background color
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Pure black background
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void GlBackend::resizeScene() {
+    renderWidth_ = std::max(1, static_cast<EGLint>(std::lround(width_ * renderScale_)));
+    renderHeight_ = std::max(1, static_cast<EGLint>(std::lround(height_ * renderScale_)));
+    if (renderScale_ >= 1.0f) {
+        // Back at full scale after setRenderScale() lowered it
+        if (sceneFramebuffer_) {
+            glDeleteFramebuffers(1, &sceneFramebuffer_);
+            glDeleteRenderbuffers(1, &sceneColor_);
+            sceneFramebuffer_ = 0;
+            sceneColor_ = 0;
+        }
+        renderWidth_ = width_;
+        renderHeight_ = height_;
+        return;
+    }
+
+    if (!sceneFramebuffer_) {
+        glGenFramebuffers(1, &sceneFramebuffer_);
+        glGenRenderbuffers(1, &sceneColor_);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, sceneColor_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, renderWidth_, renderHeight_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, sceneColor_);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        // Full size then, the scene is only an optimization
+        aout << "Scene framebuffer incomplete: 0x" << std::hex << status << std::dec
+             << ", rendering at full size" << std::endl;
+        glDeleteFramebuffers(1, &sceneFramebuffer_);
+        glDeleteRenderbuffers(1, &sceneColor_);
+        sceneFramebuffer_ = 0;
+        sceneColor_ = 0;
+        configuredScale_ = 1.0f;
+        renderScale_ = 1.0f;
+        renderWidth_ = width_;
+        renderHeight_ = height_;
+        return;
+    }
+    aout << "Scene: " << renderWidth_ << "x" << renderHeight_ << " for a " << width_ << "x" << height_
+         << " surface" << std::endl;
+}
+
+void GlBackend::setRenderScale(float scale) {
+    float renderScale = std::min(std::max(configuredScale_ * scale, MIN_RENDER_SCALE), 1.0f);
+    if (renderScale == renderScale_) {
+        return;
+    }
+    renderScale_ = renderScale;
+
+    // The next beginFrame() resizes the scene as if the surface had changed
+    width_ = -1;
+    height_ = -1;
+    aout << "Render scale: " << renderScale_ << std::endl;
+}
+
+void GlBackend::resolveScene() {
+    glViewport(0, 0, width_, height_);
+    if (!sceneFramebuffer_) {
+        return;
+    }
+
+    // Bilinear upscale into the surface, which it covers entirely. The scene isn't needed
+    // afterwards, a tiler needn't write it back to memory.
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, renderWidth_, renderHeight_, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    const GLenum attachment = GL_COLOR_ATTACHMENT0;
+    glInvalidateFramebuffer(GL_READ_FRAMEBUFFER, 1, &attachment);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GlBackend::simulate(const SimParams &params) {
+    if (cpu_) {
+        simulateOnCpu(params);
+        return;
+    }
+    if (!computeShader_) return;
+
+    // Last frame's step becomes the state this step reads and this frame draws. Its barrier sits
+    // here rather than after the dispatch, so this frame's draw doesn't wait for this frame's step.
+    advanceState();
+
+    // Timed on its own, a sort every few seconds would only add noise to the step's times
+    if (radixSort_ && params.reorder && params.stepCount > 0) {
+        if (sortTimer_) sortTimer_->begin();
+        sortParticles(static_cast<int>(params.particleCount));
+        if (sortTimer_) sortTimer_->end();
+    }
+    if (simulateTimer_) simulateTimer_->begin();
+
+    // Nothing to step this frame, the draw keeps blending towards the copy it has
+    if (params.stepCount == 0) {
+        if (simulateTimer_) simulateTimer_->end();
+        return;
+    }
+
+    // Forces between neighbours from the front copy, they stay bound at NEIGHBOUR_FORCE_BINDING
+    if (neighbourGrid_) {
+        neighbourGrid_->update(*particleState_, static_cast<int>(params.particleCount));
+    }
+
+    computeShader_->activate();
+
+    // Read the front copy, write the back copy, in the sorted order if this frame reorders
+    particleState_->bindStep();
+    if (radixSort_) {
+        radixSort_->bindPairs(PARTICLE_ORDER_BINDING);
+    }
+
+    // Upload this frame's parameters in one go, into a region no frame in flight reads. The
+    // attractors are taken last, everything queued before this doesn't need them.
+    SimParams latched = params;
+    latchAttractors(latched);
+    simParamsBuffer_->upload(&latched, sizeof(SimParams));
+    simParamsBuffer_->bindRange(SIM_PARAMS_BINDING);
+
+    if (life_) {
+        // Over the live particles only, the count never comes back to the CPU
+        life_->dispatch(particleState_->front());
+        computeShader_->activate();
+        glDispatchComputeIndirect(LIFE_DISPATCH_OFFSET);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        life_->emit(params.emitCount);
+    } else {
+        int groupParticles = kernel_.groupParticles();
+        int numGroups = (static_cast<int>(params.particleCount) + groupParticles - 1) / groupParticles;
+        glDispatchCompute(numGroups, 1, 1);
+    }
+    computeShader_->deactivate();
+    simParamsBuffer_->fence();
+    if (simulateTimer_) simulateTimer_->end();
+}
+
+void GlBackend::advanceState() {
+    if (particleState_->advance()) {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+                        | (life_ ? GL_COMMAND_BARRIER_BIT : 0));
+    }
+}
+
+bool GlBackend::requestSnapshot(int count) {
+    // Lifetimes live in buffers of their own, and the CPU simulation's state never reaches the GPU
+    if (!particleState_ || life_ || cpu_) {
+        return false;
+    }
+    advanceState();
+    return particleState_->beginCapture(count);
+}
+
+bool GlBackend::collectSnapshot(std::vector<uint8_t> *outBlob) {
+    return particleState_ && particleState_->collectCapture(outBlob);
+}
+
+int GlBackend::restoreSnapshot(const std::vector<uint8_t> &blob) {
+    if (!particleState_ || life_ || cpu_) {
+        return 0;
+    }
+    advanceState();
+    return particleState_->restore(blob);
+}
+
+void GlBackend::simulateOnCpu(const SimParams &params) {
+    // Without steps the last slot is drawn again, unless the budget grew past what it holds
+    if (!stream_ || (params.stepCount == 0 && static_cast<int>(params.particleCount) <= streamed_)) {
+        return;
+    }
+
+    // The pool steps straight into the next slot, which the GPU is done drawing
+    float *positions;
+    float *velocities;
+    stream_->beginWrite(&positions, &velocities);
+    SimParams latched = params;
+    latchAttractors(latched);
+    cpu_->step(latched, positions, velocities);
+    stream_->endWrite();
+    streamed_ = static_cast<int>(params.particleCount);
+}
+
+void GlBackend::sortParticles(int count) {
+    // Morton keys of the front copy, with each particle's index as the value
+    particleState_->bindStorage(particleState_->front());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_OUTPUT_BINDING, radixSort_->pairs());
+    orderShader_->activate();
+    glUniform1ui(orderShader_->uniformLocation("uCount"), count);
+    glUniform1f(orderShader_->uniformLocation("uCellSize"), ORDER_CELL_SIZE);
+    glDispatchCompute((count + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    radixSort_->sort(count, ORDER_KEY_BITS);
+}
+
+void GlBackend::draw(const float *projection, int count, float rewind) {
+    if (!particleShader_) {
+        resolveScene();
+        return;
+    }
+    if (drawTimer_) drawTimer_->begin();
+
+    switch (drawMode_) {
+        case DrawMode::Sprites:
+            drawSprites(projection, count, rewind);
+            break;
+        case DrawMode::Density:
+            countDensity(projection, count, rewind);
+            drawDensity();
+            break;
+        case DrawMode::Lod:
+            countDensity(projection, count, rewind);
+            drawLod(count);
+            break;
+        case DrawMode::Trails:
+            drawTrails(projection, count, rewind);
+            break;
+    }
+    if (densityParamsBuffer_) {
+        densityParamsBuffer_->fence();
+    }
+    resolveScene();
+
+    // Check for errors
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        LOG_EVERY_MS(LogLevel::Error, 1000, "Error after particle draw: 0x" << std::hex << error);
+    }
+    if (drawTimer_) drawTimer_->end();
+}
+
+void GlBackend::drawSprites(const float *projection, int count, float rewind) {
+    particleShader_->activate();
+
+    // The location was cached when the program was linked, only upload when the matrix changes
+    if (std::memcmp(projection_, projection, sizeof(projection_)) != 0) {
+        std::memcpy(projection_, projection, sizeof(projection_));
+        particleShader_->setProjectionMatrix(projection_);
+    }
+    glUniform1f(particleShader_->uniformLocation("uRewind"), rewind);
+    glUniform1f(particleShader_->uniformLocation("uPointSize"), pointSize_ * renderScale_);
+    if (drawMode_ == DrawMode::Trails) {
+        glUniform1f(particleShader_->uniformLocation("uStretch"), trailStretch_);
+        glUniform1f(particleShader_->uniformLocation("uMaxStretch"),
+                    std::max(0.0f, maxPointSize_ - pointSize_ * renderScale_));
+        glUniform2f(particleShader_->uniformLocation("uViewportSize"), static_cast<float>(renderWidth_),
+                    static_cast<float>(renderHeight_));
+    }
+
+    // Use alpha blending instead of additive
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // The front copy, the step still in flight writes the other one. The CPU simulation's last
+    // slot, the next frame writes another one.
+    glBindVertexArray(stream_ ? stream_->vertexArray() : particleState_->vertexArray());
+
+    // Draw particles, with lifetimes as many as the front copy has alive
+    if (life_) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, life_->buffer(particleState_->front()));
+        glDrawArraysIndirect(GL_POINTS, reinterpret_cast<const void *>(LIFE_DRAW_OFFSET));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        glDrawArrays(GL_POINTS, 0, stream_ ? std::min(count, streamed_) : count);
+    }
+    if (stream_) {
+        stream_->fence();
+    }
+
+    particleShader_->deactivate();
+}
+
+void GlBackend::drawTrails(const float *projection, int count, float rewind) {
+    if (trailWidth_ != renderWidth_ || trailHeight_ != renderHeight_) {
+        resizeTrails();
+    }
+    if (!trailFramebuffer_) {
+        drawSprites(projection, count, rewind);
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, trailFramebuffer_);
+
+    // Reverse subtract keeps trailDecay_ of what the frames before left, and takes the fade's color
+    // off on top. Scaling alone never takes the last 8 bit levels to zero, they would stay as a haze.
+    // Alpha is left at the clear's 1, the fade would take it to 0 along with the color.
+    trailFadeShader_->activate();
+    glUniform1f(trailFadeShader_->uniformLocation("uDecay"), trailDecay_);
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
+    glBindVertexArray(0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glBlendEquation(GL_FUNC_ADD);
+    trailFadeShader_->deactivate();
+
+    // This frame's sprites on top, then all of it replaces the scene
+    drawSprites(projection, count, rewind);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, trailFramebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFramebuffer_);
+    glBlitFramebuffer(0, 0, renderWidth_, renderHeight_, 0, 0, renderWidth_, renderHeight_,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer_);
+}
+
+void GlBackend::resizeTrails() {
+    // The texture is immutable, a new size gets a new one and the trails start over
+    if (trailFramebuffer_) {
+        glDeleteFramebuffers(1, &trailFramebuffer_);
+        glDeleteTextures(1, &trailColor_);
+        trailFramebuffer_ = 0;
+        trailColor_ = 0;
+    }
+    trailWidth_ = renderWidth_;
+    trailHeight_ = renderHeight_;
+
+    glGenTextures(1, &trailColor_);
+    glBindTexture(GL_TEXTURE_2D, trailColor_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, trailWidth_, trailHeight_);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &trailFramebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, trailFramebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, trailColor_, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        // The sprites are still stretched, only nothing persists
+        aout << "Trail framebuffer incomplete: 0x" << std::hex << status << std::dec
+             << ", drawing without trails" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer_);
+        glDeleteFramebuffers(1, &trailFramebuffer_);
+        glDeleteTextures(1, &trailColor_);
+        trailFramebuffer_ = 0;
+        trailColor_ = 0;
+        return;
+    }
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer_);
+    aout << "Trails: " << trailWidth_ << "x" << trailHeight_ << std::endl;
+}
+
+void GlBackend::countDensity(const float *projection, int count, float rewind) {
+    // The grid covers the surface in whole cells and is reallocated when the surface size changes
+    bool lod = drawMode_ == DrawMode::Lod;
+    // Cells cover the same part of the screen at any render scale, so the counts stay the same
+    GLuint cellSize = std::max(1L, std::lround((lod ? LOD_CELL_SIZE : DENSITY_CELL_SIZE) * renderScale_));
+    GLuint gridWidth = (renderWidth_ + cellSize - 1) / cellSize;
+    GLuint gridHeight = (renderHeight_ + cellSize - 1) / cellSize;
+    GLuint cellCount = gridWidth * gridHeight;
+    GLuint pointCapacity = lod ? LOD_THRESHOLD * cellCount : 0;
+    if (gridWidth != densityParams_.gridSize[0] || gridHeight != densityParams_.gridSize[1]) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, densityGrid_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, DENSITY_GRID_HEADER + 2 * cellCount * sizeof(GLuint),
+                     nullptr, GL_DYNAMIC_COPY);
+        if (lod) {
+            // At worst every cell is a splat, or every cell passes the threshold in points
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, lodSplats_);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, cellCount * 4 * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, lodPoints_);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, pointCapacity * 4 * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+        }
+    }
+
+    std::memcpy(densityParams_.projection, projection, sizeof(densityParams_.projection));
+    densityParams_.gridSize[0] = gridWidth;
+    densityParams_.gridSize[1] = gridHeight;
+    densityParams_.viewportSize[0] = renderWidth_;
+    densityParams_.viewportSize[1] = renderHeight_;
+    densityParams_.cellSize = cellSize;
+    densityParams_.particleCount = count;
+    densityParams_.rewind = rewind;
+    densityParams_.gain = lod ? LOD_GAIN : DENSITY_GAIN;
+    densityParams_.lodThreshold = LOD_THRESHOLD;
+    densityParams_.pointCapacity = pointCapacity;
+    densityParamsBuffer_->upload(&densityParams_, sizeof(DensityParams));
+    densityParamsBuffer_->bindRange(DENSITY_PARAMS_BINDING);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DENSITY_GRID_BINDING, densityGrid_);
+
+    // Clear, then count the front copy into the grid. Its barrier was issued before this frame's
+    // step, which writes the other copy.
+    densityClearShader_->activate();
+    glDispatchCompute((2 * cellCount + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    densitySplatShader_->activate();
+    particleState_->bindStorage(particleState_->front());
+    glDispatchCompute((count + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GlBackend::drawDensity() {
+    // One triangle covers the screen and writes every pixel, nothing to blend with
+    densityShader_->activate();
+    glDisable(GL_BLEND);
+    glBindVertexArray(0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    densityShader_->deactivate();
+}
+
+void GlBackend::drawLod(int count) {
+    // Split the grid: dense cells into splats, the particles of the others into points. The front
+    // copy is still bound from the count.
+    GLuint cellCount = densityParams_.gridSize[0] * densityParams_.gridSize[1];
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOD_SPLAT_BINDING, lodSplats_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOD_POINT_BINDING, lodPoints_);
+    lodCellsShader_->activate();
+    glDispatchCompute((cellCount + 255) / 256, 1, 1);
+    lodPointsShader_->activate();
+    glDispatchCompute((count + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    // The counts stay on the GPU, the draws read them from the grid's header
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, densityGrid_);
+
+    lodSplatShader_->activate();
+    glBindVertexArray(lodSplatArray_);
+    glDrawArraysIndirect(GL_TRIANGLE_STRIP, reinterpret_cast<const void *>(LOD_SPLAT_DRAW_OFFSET));
+
+    // Sparse particles over the splats, as sprites
+    lodPointShader_->activate();
+    lodPointShader_->setProjectionMatrix(densityParams_.projection);
+    glUniform1f(lodPointShader_->uniformLocation("uRewind"), densityParams_.rewind);
+    glUniform1f(lodPointShader_->uniformLocation("uPointSize"), pointSize_ * renderScale_);
+    glBindVertexArray(lodPointArray_);
+    glDrawArraysIndirect(GL_POINTS, reinterpret_cast<const void *>(LOD_POINT_DRAW_OFFSET));
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    lodPointShader_->deactivate();
+}
+
+void GlBackend::drawOverlay(const std::vector<Profiler::OverlayRect> &rects) {
+    if (rects.empty()) {
+        return;
+    }
+
+    // Scissored clears, GL window coordinates start at the bottom left
+    glEnable(GL_SCISSOR_TEST);
+    for (auto &rect : rects) {
+        glScissor(rect.x, height_ - rect.y - rect.height, rect.width, rect.height);
+        glClearColor(rect.color[0], rect.color[1], rect.color[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void GlBackend::present() {
+    if (eglSwapBuffers(display_, surface_) != EGL_TRUE) {
+        EGLint error = eglGetError();
+        if (error == EGL_CONTEXT_LOST) {
+            // No way to read the state back now, continue from the last snapshot if there is one
+            recoverContext();
+            return;
+        }
+        LOG_EVERY_MS(LogLevel::Error, 1000, "Failed to swap buffers: 0x" << std::hex << error);
+    }
+}
@@ -0,0 +1,219 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GLBACKEND_H
+#define ANDROIDGLINVESTIGATIONS_GLBACKEND_H
+
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+#include <memory>
+#include <vector>
+#include "CpuSimulation.h"
+#include "GpuTimer.h"
+#include "NeighbourGrid.h"
+#include "ParticleLife.h"
+#include "ParticleState.h"
+#include "ParticleStream.h"
+#include "ProgramCache.h"
+#include "RadixSort.h"
+#include "RenderBackend.h"
+#include "Shader.h"
+#include "ShaderLibrary.h"
+#include "StreamingBuffer.h"
+
+/*!
+ * OpenGL ES 3.1 backend: an EGL window surface and context, compute shaders over SSBOs that double
+ * as vertex buffers, and timer queries for GPU times. The step of a frame writes the back copy of
+ * the ParticleState while the draw fetches the front one; the barrier for the step's writes is
+ * issued at the start of the next frame's step, so there is none between a step and its draw.
+ *
+ * In the density draw mode the front copy is counted into a grid of DENSITY_CELL_SIZE pixel cells
+ * by density_splat.comp, and a fullscreen triangle colors the screen from it. The grid is read in
+ * the fragment shader, so devices without fragment storage buffers draw sprites.
+ *
+ * The LOD draw mode counts into LOD_CELL_SIZE pixel cells the same way. lod_cells.comp turns the
+ * dense cells into splat instances and lod_points.comp copies the particles of the others into a
+ * point buffer, both append with atomics to indirect draw commands in the grid buffer's header.
+ * The splats and points are then drawn with glDrawArraysIndirect, and since only compute reads
+ * storage buffers this works on every GLES 3.1 device.
+ *
+ * With an interaction the NeighbourGrid passes run over the front copy ahead of the step, and the
+ * step is built with NEIGHBOUR_FORCES to add their result. With reordering, particle_order.comp
+ * and RadixSort sort the front copy by Morton code on the frames Renderer asks for, and the step,
+ * built with PARTICLE_ORDER, gathers through the result. The sort goes before the step's timer
+ * query and has one of its own.
+ *
+ * The trails draw mode draws the sprites into a texture of the scene's size that persists between
+ * frames. A fullscreen pass fades it before each frame's sprites go on, then it is copied into the
+ * scene. particle.vert and particle.frag are built with STRETCH for it, which stretches each
+ * sprite along its motion since the frame before, so trails cost a pass per frame and the
+ * per-particle cost stays that of the sprites.
+ *
+ * With lifetimes ParticleLife keeps the live particles packed at the front of each copy, the
+ * step is built with PARTICLE_LIFE and dispatched indirectly, and the sprites are drawn
+ * indirectly from the same counts.
+ *
+ * Without compute shaders, or with debug.particles.simulation set to "cpu", CpuSimulation steps the
+ * particles on the CPU and streams them into a ParticleStream, which the sprites are drawn from.
+ * A GLES 3.0 context is enough for that. The sprite and trails draws are the only draw modes, and there are no
+ * interactions, reordering, lifetimes or GPU times.
+ *
+ * The context normally outlives the surface. When it doesn't (EGL_CONTEXT_LOST) every GL object is
+ * rebuilt and the particle state continues from the snapshot taken when the surface went away.
+ */
+class GlBackend : public RenderBackend {
+public:
+    /*!
+     * Creates the display, a surface on the app's window and a GLES 3.1 context
+     * @param pacer picks the swap interval, must outlive the backend
+     */
+    GlBackend(android_app *app, FramePacer *pacer);
+    ~GlBackend() override;
+
+    Type type() const override { return Type::GL; }
+    std::string deviceName() const override;
+    std::string apiVersion() const override;
+    int maxCapacity(ParticleLayout layout) const override;
+    int maxLocalSize() const override;
+
+    void initParticles(ParticleLayout layout, int capacity, const StepKernel &kernel,
+                       DrawMode drawMode, Interaction interaction, bool reorder, bool lifetimes) override;
+    DrawMode drawMode() const override { return drawMode_; }
+    Interaction interaction() const override { return interaction_; }
+    bool reorders() const override { return reorder_; }
+    bool hasLifetimes() const override { return life_ != nullptr; }
+    void setStepKernel(const StepKernel &kernel) override;
+    void resetParticles(const InitParams &params) override;
+    bool requestSnapshot(int count) override;
+    bool collectSnapshot(std::vector<uint8_t> *outBlob) override;
+    int restoreSnapshot(const std::vector<uint8_t> &blob) override;
+
+    bool hasSurface() const override { return surface_ != EGL_NO_SURFACE; }
+    void onSurfaceDestroyed(int activeParticles) override;
+    void onSurfaceCreated(ANativeWindow *window) override;
+
+    bool hasGpuTiming() const override { return simulateTimer_ != nullptr; }
+    bool collectGpuTimes(float *outSimulateMillis, float *outDrawMillis) override;
+    bool collectSortTime(float *outMillis) override;
+
+    void beginFrame(int *outWidth, int *outHeight) override;
+    void simulate(const SimParams &params) override;
+    void draw(const float *projection, int count, float rewind) override;
+    void drawOverlay(const std::vector<Profiler::OverlayRect> &rects) override;
+    void present() override;
+    void setPointSize(float pixels) override { pointSize_ = pixels; }
+    void setTrails(float decay, float stretch) override {
+        trailDecay_ = decay;
+        trailStretch_ = stretch;
+    }
+    void setRenderScale(float scale) override;
+    bool hasRenderScale() const override { return true; }
+
+private:
+    //! Releases the GL objects, the surface and the context, and terminates the display
+    void destroy();
+    bool createSurface(ANativeWindow *window);
+    bool createContext();
+    void loadShaders();
+    void loadDensityShaders();
+
+    //! Defines of the sprite program for the state in @a layout, stretched in the trails draw mode
+    Shader::Defines spriteDefines(ParticleLayout layout) const;
+    void loadTrailShaders();
+    void resizeTrails();
+    void resizeScene();
+    void resolveScene();
+
+    void drawSprites(const float *projection, int count, float rewind);
+    void countDensity(const float *projection, int count, float rewind);
+    void drawDensity();
+    void drawLod(int count);
+    void drawTrails(const float *projection, int count, float rewind);
+    void sortParticles(int count);
+
+    //! Swaps in the last step's result as the front copy, with the barrier for its writes
+    void advanceState();
+
+    void initCpuSimulation(int capacity);
+    void simulateOnCpu(const SimParams &params);
+    Shader *loadComputeShader(const StepKernel &kernel);
+    void createShaderLibrary();
+    void createGpuTimers();
+    void recoverContext();
+
+    android_app *app_;
+    FramePacer *pacer_;
+    EGLDisplay display_;
+    EGLSurface surface_;
+    EGLContext context_;
+    EGLConfig config_;
+    EGLint width_;
+    EGLint height_;
+    float pointSize_;  // On the surface, the scene's sprites are scaled down with it
+
+    // Below a render scale of 1 the particles are drawn into an offscreen scene of the scaled
+    // size, and draw() ends by stretching it over the surface. The overlay stays at full size.
+    // The sprites are drawn renderScale_ times smaller, so they keep their size on screen.
+    float configuredScale_;  // debug.particles.render_scale, 1 if the scene can't be rendered to
+    float renderScale_;      // What the scene is drawn at, lowered by setRenderScale()
+    EGLint renderWidth_;
+    EGLint renderHeight_;
+    GLuint sceneFramebuffer_;  // 0 at full scale
+    GLuint sceneColor_;
+    bool es31_;  // False on a GLES 3.0 context, which only the CPU simulation can draw with
+
+    ParticleLayout layout_;
+    StepKernel kernel_;  // What the step kernel was built with
+    std::unique_ptr<ProgramCache> programCache_;
+
+    // The programs are owned by shaders_, the members below only point into it and are null
+    // until the draw mode or feature they belong to loads them
+    std::unique_ptr<ShaderLibrary> shaders_;
+    Shader *computeShader_;
+    Shader *initShader_;
+    Shader *particleShader_;
+    DrawMode drawMode_;
+    Shader *densityClearShader_;
+    Shader *densitySplatShader_;
+    Shader *densityShader_;
+    std::unique_ptr<StreamingBuffer> densityParamsBuffer_;  // Null in the sprite draw mode
+    GLuint densityGrid_;
+    DensityParams densityParams_;  // Last upload, gridSize is what densityGrid_ is allocated for
+    Shader *lodCellsShader_;
+    Shader *lodPointsShader_;
+    Shader *lodSplatShader_;
+    Shader *lodPointShader_;  // particle.vert over the interleaved point buffer
+    GLuint lodSplats_;
+    GLuint lodPoints_;
+    GLuint lodSplatArray_;
+    GLuint lodPointArray_;
+    Shader *trailFadeShader_;
+    GLuint trailFramebuffer_;  // 0 until the first trails draw, or if it can't be rendered to
+    GLuint trailColor_;
+    EGLint trailWidth_;        // Of trailColor_, follows the scene
+    EGLint trailHeight_;
+    float trailDecay_;
+    float trailStretch_;
+    float maxPointSize_;       // Sprites are stretched no further than this
+    std::unique_ptr<ParticleState> particleState_;
+    Interaction interaction_;
+    std::unique_ptr<NeighbourGrid> neighbourGrid_;  // Null without an interaction
+    bool reorder_;
+    Shader *orderShader_;                           // Null without reordering, and the sort too
+    std::unique_ptr<RadixSort> radixSort_;
+    bool lifetimes_;
+    std::unique_ptr<ParticleLife> life_;            // Null without lifetimes
+    bool cpuSimulation_;
+    std::unique_ptr<CpuSimulation> cpu_;            // Null when the GPU simulates, survives a context loss
+    std::unique_ptr<ParticleStream> stream_;
+    int streamed_;  // Particles in the stream's last slot, 0 until simulate() writes a slot
+    std::unique_ptr<StreamingBuffer> simParamsBuffer_;
+    std::unique_ptr<StreamingBuffer> initParamsBuffer_;
+    InitParams initParams_;  // Last reset, replayed after a context loss
+    float projection_[16];  // Last projection uploaded to particleShader_
+    std::vector<uint8_t> snapshot_;  // Particle state saved while we have no surface
+
+    // Null without GL_EXT_disjoint_timer_query
+    std::unique_ptr<GpuTimer> simulateTimer_;
+    std::unique_ptr<GpuTimer> drawTimer_;
+    std::unique_ptr<GpuTimer> sortTimer_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_GLBACKEND_H
@@ -0,0 +1,75 @@
+#include "GpuTimer.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+//! Only the 64 bit result getter is missing from core ES 3.0 queries
+static PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v = nullptr;
+
+bool GpuTimer::isSupported() {
+    static int supported = -1;
+    if (supported == -1) {
+        supported = 0;
+        if (Utility::hasGlExtension("GL_EXT_disjoint_timer_query")) {
+            getQueryObjectui64v = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+                    eglGetProcAddress("glGetQueryObjectui64vEXT"));
+            supported = getQueryObjectui64v ? 1 : 0;
+        }
+        aout << "GPU timer queries " << (supported ? "available" : "unavailable") << std::endl;
+    }
+    return supported == 1;
+}
+
+bool GpuTimer::disjoint() {
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    return disjoint != 0;
+}
+
+GpuTimer::GpuTimer() : queries_{}, head_(0), pending_(0), active_(false) {
+    glGenQueries(QUERY_COUNT, queries_);
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(QUERY_COUNT, queries_);
+}
+
+void GpuTimer::begin() {
+    if (pending_ == QUERY_COUNT) {
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED_EXT, queries_[head_]);
+    active_ = true;
+}
+
+void GpuTimer::end() {
+    if (!active_) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+    active_ = false;
+    head_ = (head_ + 1) % QUERY_COUNT;
+    pending_++;
+}
+
+bool GpuTimer::collect(float *outMillis) {
+    if (pending_ == 0) {
+        return false;
+    }
+
+    GLuint oldest = queries_[(head_ - pending_ + QUERY_COUNT) % QUERY_COUNT];
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(oldest, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return false;
+    }
+
+    GLuint64 elapsedNanos = 0;
+    getQueryObjectui64v(oldest, GL_QUERY_RESULT, &elapsedNanos);
+    pending_--;
+    *outMillis = static_cast<float>(elapsedNanos) / 1.0e6f;
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GPUTIMER_H
+#define ANDROIDGLINVESTIGATIONS_GPUTIMER_H
+
+#include <GLES3/gl31.h>
+
+/*!
+ * Measures GPU time of a span of GL commands with GL_EXT_disjoint_timer_query.
+ *
+ * Queries are kept in a small ring and read back a few frames later, so collecting a result never
+ * stalls the pipeline. Only one TIME_ELAPSED query can be active at a time in GL, so spans measured
+ * by different timers must not overlap.
+ */
+class GpuTimer {
+public:
+    //! Returns true if timer queries work on the current context, loads the entry points once
+    static bool isSupported();
+
+    /*!
+     * True if a disjoint event (frequency change, context switch) invalidated the queries in flight.
+     * Reading clears the flag, so it is checked once per frame and every timer is discarded together.
+     */
+    static bool disjoint();
+
+    GpuTimer();
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    //! Starts timing, silently skipped if every query in the ring is still waiting for its result
+    void begin();
+    void end();
+
+    /*!
+     * Reads back the oldest finished query, if any
+     * @param outMillis receives the GPU time of that span in milliseconds
+     * @return true if a result was available
+     */
+    bool collect(float *outMillis);
+
+    //! Drops the queries in flight, after a disjoint event
+    void discard() { pending_ = 0; }
+
+private:
+    static constexpr int QUERY_COUNT = 4;
+
+    GLuint queries_[QUERY_COUNT];
+    int head_;      // Next query to begin
+    int pending_;   // Queries issued but not yet collected, oldest is head_ - pending_
+    bool active_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_GPUTIMER_H
@@ -0,0 +1,119 @@
+#include "InputThread.h"
+
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+#include <chrono>
+
+#include "AndroidOut.h"
+
+// How often the app's input buffers are checked while touched. Panels sample touches at 120 to
+// 240 Hz, this takes a move within a few milliseconds of it arriving.
+static constexpr std::chrono::milliseconds POLL_INTERVAL(2);
+
+// With no pointer down, and nothing for IDLE_AFTER, the buffers are only checked at about frame
+// rate: a new touch waits at most a frame, and an untouched app doesn't wake every 2 ms
+static constexpr std::chrono::milliseconds IDLE_POLL_INTERVAL(16);
+static constexpr std::chrono::milliseconds IDLE_AFTER(100);
+
+InputThread::InputThread(android_app *app) :
+        app_(app),
+        pending_{},
+        slots_{},
+        shared_(0),
+        writeSlot_(1),
+        readSlot_(2),
+        active_(true),
+        quit_(false),
+        thread_(&InputThread::run, this) {}
+
+InputThread::~InputThread() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void InputThread::setActive(bool active) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = active;
+    }
+    wake_.notify_one();
+}
+
+const TouchSnapshot &InputThread::latest() {
+    // Only swapped when there is something new, otherwise the slot read last is still the newest
+    if (shared_.load(std::memory_order_relaxed) & FRESH_BIT) {
+        readSlot_ = shared_.exchange(readSlot_, std::memory_order_acq_rel) & ~FRESH_BIT;
+    }
+    return slots_[readSlot_];
+}
+
+void InputThread::run() {
+    auto lastEvent = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_) {
+        if (!active_) {
+            wake_.wait(lock, [this] { return quit_ || active_; });
+            continue;
+        }
+        lock.unlock();
+        auto now = std::chrono::steady_clock::now();
+        if (drain()) {
+            publish();
+            lastEvent = now;
+        }
+        bool idle = tracker_.pointerCount() == 0 && now - lastEvent >= IDLE_AFTER;
+        lock.lock();
+        wake_.wait_for(lock, idle ? IDLE_POLL_INTERVAL : POLL_INTERVAL, [this] { return quit_ || !active_; });
+    }
+}
+
+bool InputThread::drain() {
+    auto *inputBuffer = android_app_swap_input_buffers(app_);
+    if (!inputBuffer) {
+        return false;
+    }
+
+    bool moved = inputBuffer->motionEventsCount > 0;
+    for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
+        auto &motionEvent = inputBuffer->motionEvents[i];
+        auto action = motionEvent.action;
+
+        // Every pointer in the event becomes an attractor
+        tracker_.onMotionEvent(motionEvent);
+        pending_.eventTime = motionEvent.eventTime;
+        pending_.sequence++;
+
+        // Moves arrive at the panel's sampling rate, only pointers coming and going are logged
+        switch (action & AMOTION_EVENT_ACTION_MASK) {
+            case AMOTION_EVENT_ACTION_DOWN:
+            case AMOTION_EVENT_ACTION_POINTER_DOWN:
+            case AMOTION_EVENT_ACTION_UP:
+            case AMOTION_EVENT_ACTION_POINTER_UP:
+            case AMOTION_EVENT_ACTION_CANCEL:
+                LOG_VERBOSE("Motion action " << (action & AMOTION_EVENT_ACTION_MASK) << ", tracking "
+                            << tracker_.pointerCount() << " attractors");
+                break;
+            default:
+                break;
+        }
+    }
+
+    android_app_clear_motion_events(inputBuffer);
+    android_app_clear_key_events(inputBuffer);
+    return moved;
+}
+
+void InputThread::publish() {
+    pending_.pointerCount = tracker_.pointerCount();
+    for (int i = 0; i < pending_.pointerCount; i++) {
+        pending_.pointers[i] = tracker_.pointer(i);
+    }
+    pending_.released = tracker_.released();
+
+    // The filled slot goes to the reader, whichever slot it gave back last is written next
+    slots_[writeSlot_] = pending_;
+    writeSlot_ = shared_.exchange(writeSlot_ | FRESH_BIT, std::memory_order_acq_rel) & ~FRESH_BIT;
+}
@@ -0,0 +1,71 @@
+#ifndef ANDROIDGLINVESTIGATIONS_INPUTTHREAD_H
+#define ANDROIDGLINVESTIGATIONS_INPUTTHREAD_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "TouchTracker.h"
+
+struct android_app;
+
+//! What the pointers looked like after the newest motion event
+struct TouchSnapshot {
+    std::array<TouchTracker::Pointer, TouchTracker::MAX_POINTERS> pointers;
+    int pointerCount;
+    bool released;      // As TouchTracker::released()
+    int64_t eventTime;  // Of the newest event reduced into the snapshot, 0 before the first
+    uint64_t sequence;  // Motion events reduced so far
+};
+
+/*!
+ * Takes motion events off the app on a thread of its own, so they are reduced as they arrive
+ * rather than in a burst before each frame. The render thread reads the result with latest(),
+ * which doesn't lock or wait: the snapshots are triple buffered and handed over with an atomic
+ * exchange, the reader always gets the newest complete one. It polls every few milliseconds while
+ * touched, and backs off to about frame rate once the pointers are up.
+ */
+class InputThread {
+public:
+    explicit InputThread(android_app *app);
+    ~InputThread();
+
+    InputThread(const InputThread&) = delete;
+    InputThread& operator=(const InputThread&) = delete;
+
+    //! Stops polling while the app has no window, no input can arrive then
+    void setActive(bool active);
+
+    //! The newest snapshot, valid until the next call. Only one thread may call this.
+    const TouchSnapshot &latest();
+
+private:
+    void run();
+
+    //! Reduces the app's pending motion events, true if there were any
+    bool drain();
+    void publish();
+
+    android_app *app_;
+    TouchTracker tracker_;
+    TouchSnapshot pending_;  // Input thread only
+
+    // Slots of the triple buffer: the input thread owns writeSlot_, the reader readSlot_, and
+    // shared_ holds the third with FRESH_BIT set while the reader hasn't taken it
+    static constexpr int FRESH_BIT = 4;
+    std::array<TouchSnapshot, 3> slots_;
+    std::atomic<int> shared_;
+    int writeSlot_;
+    int readSlot_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool active_;
+    bool quit_;
+    std::thread thread_;  // Last, it starts once everything else is set up
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_INPUTTHREAD_H
@@ -0,0 +1,163 @@
+#include "KernelTuner.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+// The candidates, workgroups the device can't build are dropped
+static constexpr int LOCAL_SIZES[] = {64, 128, 256, 512};
+static constexpr int PARTICLES_PER_INVOCATION[] = {1, 2, 4};
+
+// Frames per candidate. The warmup covers the timer latency, so the times measured afterwards all
+// belong to the candidate.
+static constexpr int WARMUP_FRAMES = 8;
+static constexpr int MEASURED_FRAMES = 32;
+
+// Keys are stored one per line, tab separated
+static std::string sanitize(std::string key) {
+    std::replace(key.begin(), key.end(), '\t', ' ');
+    std::replace(key.begin(), key.end(), '\n', ' ');
+    return key;
+}
+
+KernelTuner::KernelTuner(std::string path, std::string device, int maxLocalSize, bool gpuTiming) :
+        path_(std::move(path)),
+        device_(sanitize(std::move(device))),
+        current_(0),
+        frame_(0),
+        best_(DEFAULT_KERNEL) {
+    best_.localSize = std::min(best_.localSize, maxLocalSize);
+
+    auto mode = Utility::getSystemProperty("debug.particles.autotune", "1");
+    if (mode == "0") {
+        aout << "Kernel tuning disabled" << std::endl;
+        return;
+    }
+    if (mode != "force" && load()) {
+        aout << "Step kernel for " << device_ << ": local size " << best_.localSize << ", "
+             << best_.particlesPerInvocation << " particles per invocation" << std::endl;
+        return;
+    }
+    if (!gpuTiming) {
+        aout << "Kernel tuning needs GPU timing, using the default step kernel" << std::endl;
+        return;
+    }
+
+    // The default goes first, it is what is running before tuning starts
+    candidates_.push_back({best_});
+    for (int localSize : LOCAL_SIZES) {
+        for (int perInvocation : PARTICLES_PER_INVOCATION) {
+            StepKernel kernel{localSize, perInvocation};
+            if (localSize <= maxLocalSize && kernel != best_) {
+                candidates_.push_back({kernel});
+            }
+        }
+    }
+    aout << "Tuning the step kernel over " << candidates_.size() << " candidates" << std::endl;
+}
+
+void KernelTuner::addGpuTime(float simulateMillis) {
+    if (running() && frame_ >= WARMUP_FRAMES) {
+        candidates_[current_].millis += simulateMillis;
+    }
+}
+
+bool KernelTuner::addFrame(long long work) {
+    if (!running()) {
+        return false;
+    }
+    if (frame_ >= WARMUP_FRAMES) {
+        candidates_[current_].work += work;
+    }
+    if (++frame_ < WARMUP_FRAMES + MEASURED_FRAMES) {
+        return false;
+    }
+
+    frame_ = 0;
+    if (++current_ == candidates_.size()) {
+        finish();
+    }
+    return true;
+}
+
+void KernelTuner::finish() {
+    // Times and work are summed over the whole window, so frames without steps and the frame or
+    // two the times lag behind the work even out
+    const Candidate *best = nullptr;
+    for (auto &candidate : candidates_) {
+        if (candidate.work == 0 || candidate.millis <= 0.0) {
+            continue;
+        }
+        double nanosPerStep = candidate.millis * 1e6 / static_cast<double>(candidate.work);
+        aout << "Step kernel " << candidate.kernel.localSize << " x " << candidate.kernel.particlesPerInvocation
+             << ": " << nanosPerStep << " ns per particle step" << std::endl;
+        if (!best || candidate.millis * best->work < best->millis * candidate.work) {
+            best = &candidate;
+        }
+    }
+    if (!best) {
+        aout << "Kernel tuning measured nothing, keeping the default step kernel" << std::endl;
+        return;
+    }
+
+    best_ = best->kernel;
+    aout << "Step kernel for " << device_ << ": local size " << best_.localSize << ", "
+         << best_.particlesPerInvocation << " particles per invocation" << std::endl;
+    store();
+}
+
+bool KernelTuner::load() {
+    std::string prefix = device_ + '\t';
+    std::ifstream file(path_);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        std::istringstream values(line.substr(prefix.size()));
+        StepKernel kernel{};
+        if (values >> kernel.localSize >> kernel.particlesPerInvocation
+            && kernel.localSize > 0 && kernel.particlesPerInvocation > 0) {
+            best_ = kernel;
+            return true;
+        }
+    }
+    return false;
+}
+
+void KernelTuner::store() const {
+    // Keep the lines of other devices and drivers
+    std::string prefix = device_ + '\t';
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(path_);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.compare(0, prefix.size(), prefix) != 0) {
+                lines.push_back(line);
+            }
+        }
+    }
+    lines.push_back(device_ + '\t' + std::to_string(best_.localSize) + '\t'
+                    + std::to_string(best_.particlesPerInvocation));
+
+    // Written aside and renamed, so a crash never leaves half a file
+    std::string temporary = path_ + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        for (auto &line : lines) {
+            file << line << '\n';
+        }
+        if (!file) {
+            aout << "Can't write kernel tuning results to " << temporary << std::endl;
+            return;
+        }
+    }
+    if (std::rename(temporary.c_str(), path_.c_str()) != 0) {
+        aout << "Can't replace " << path_ << std::endl;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef ANDROIDGLINVESTIGATIONS_KERNELTUNER_H
+#define ANDROIDGLINVESTIGATIONS_KERNELTUNER_H
+
+#include <string>
+#include <vector>
+
+#include "RenderBackend.h"
+
+/*!
+ * Picks the fastest step kernel for this GPU. The best workgroup size and particles per invocation
+ * differ between Adreno, Mali and PowerVR, so on the first run every candidate the device can
+ * build steps the live simulation for a while and the GPU time per particle step decides. All
+ * candidates compute the same thing, so tuning doesn't show on screen.
+ *
+ * The winner is stored per device, driver and particle layout, later runs start with it. Set
+ * debug.particles.autotune to 0 to keep the default kernel, or to "force" to tune again.
+ */
+class KernelTuner {
+public:
+    //! Used when tuning is off or can't measure anything
+    static constexpr StepKernel DEFAULT_KERNEL = {256, 1};
+
+    /*!
+     * Loads a stored winner for @a device, otherwise prepares the candidates
+     * @param path file the winners are kept in, one line per device
+     * @param device identifies the GPU and driver, e.g. backend, device name and API version
+     * @param maxLocalSize largest workgroup the backend can build
+     * @param gpuTiming false if the backend can't time the step, tuning is skipped then
+     */
+    KernelTuner(std::string path, std::string device, int maxLocalSize, bool gpuTiming);
+
+    //! True while candidates are still being timed
+    bool running() const { return current_ < candidates_.size(); }
+
+    //! The candidate being timed, or the winner once tuning is done
+    const StepKernel &kernel() const { return running() ? candidates_[current_].kernel : best_; }
+
+    //! Adds the simulate time of a frame whose GPU timer finished
+    void addGpuTime(float simulateMillis);
+
+    /*!
+     * Counts one submitted frame
+     * @param work particle steps the frame dispatched, particles times steps
+     * @return true if kernel() changed, the caller has to rebuild the step kernel
+     */
+    bool addFrame(long long work);
+
+private:
+    struct Candidate {
+        StepKernel kernel;
+        double millis = 0.0;   // GPU time measured after the warmup
+        long long work = 0;    // Particle steps dispatched after the warmup
+    };
+
+    bool load();
+    void finish();
+    void store() const;
+
+    std::string path_;
+    std::string device_;
+    std::vector<Candidate> candidates_;
+    size_t current_;
+    int frame_;          // Frames the current candidate has run
+    StepKernel best_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_KERNELTUNER_H
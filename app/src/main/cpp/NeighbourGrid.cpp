@@ -0,0 +1,94 @@
+#include "NeighbourGrid.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include "AndroidOut.h"
+#include "ShaderLibrary.h"
+
+NeighbourGrid::NeighbourGrid(ShaderLibrary *shaders, ParticleLayout layout, int capacity,
+                             Interaction interaction) :
+        countShader_(nullptr),
+        scanShader_(nullptr),
+        scatterShader_(nullptr),
+        forceShader_(nullptr),
+        buffers_{},
+        paramsBuffer_(GL_UNIFORM_BUFFER, sizeof(NeighbourParams)),
+        params_{} {
+    auto load = [&](const char *path, const Shader::Defines &defines) {
+        auto *shader = shaders->compute(path, defines);
+        if (!shader) {
+            throw std::runtime_error(std::string("Failed to create ") + path);
+        }
+        return shader;
+    };
+    auto defines = ParticleState::defines(layout);
+    countShader_ = load("shaders/neighbour_count.comp", defines);
+    scanShader_ = load("shaders/neighbour_scan.comp", {});
+    scatterShader_ = load("shaders/neighbour_scatter.comp", {});
+    switch (interaction) {
+        case Interaction::Fluid:
+            forceShader_ = load("shaders/neighbour_fluid.comp", defines);
+            params_.pressure = FLUID_PRESSURE;
+            params_.viscosity = FLUID_VISCOSITY;
+            params_.cellSize = FLUID_RADIUS;
+            break;
+        case Interaction::None:
+            throw std::runtime_error("The neighbour grid needs a force model");
+    }
+
+    // The scan clears the counts after reading them, they only start at zero here
+    GLsizeiptr count = capacity;
+    std::vector<GLuint> zeros(NEIGHBOUR_TABLE_SIZE, 0);
+    glGenBuffers(BUFFER_COUNT, buffers_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers_[COUNTS]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(GLuint), zeros.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers_[CELLS]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers_[GRID]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (2 * NEIGHBOUR_TABLE_SIZE + count) * sizeof(GLuint), nullptr,
+                 GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers_[FORCES]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * 2 * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    aout << "Neighbour grid: " << NEIGHBOUR_TABLE_SIZE << " cells of " << params_.cellSize
+         << " units, " << RenderBackend::interactionName(interaction) << " forces" << std::endl;
+}
+
+NeighbourGrid::~NeighbourGrid() {
+    glDeleteBuffers(BUFFER_COUNT, buffers_);
+}
+
+void NeighbourGrid::update(const ParticleState &state, int count) {
+    params_.particleCount = count;
+    paramsBuffer_.upload(&params_, sizeof(NeighbourParams));
+    paramsBuffer_.bindRange(NEIGHBOUR_PARAMS_BINDING);
+
+    // The barrier for the last step's writes was issued after ParticleState::advance()
+    state.bindStorage(state.front());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NEIGHBOUR_COUNT_BINDING, buffers_[COUNTS]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NEIGHBOUR_CELL_BINDING, buffers_[CELLS]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NEIGHBOUR_GRID_BINDING, buffers_[GRID]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NEIGHBOUR_FORCE_BINDING, buffers_[FORCES]);
+
+    GLuint groups = (count + 255) / 256;
+    countShader_->activate();
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // One workgroup scans the whole table
+    scanShader_->activate();
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    scatterShader_->activate();
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    forceShader_->activate();
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    forceShader_->deactivate();
+    paramsBuffer_.fence();
+}
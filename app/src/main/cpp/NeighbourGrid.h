@@ -0,0 +1,65 @@
+#ifndef ANDROIDGLINVESTIGATIONS_NEIGHBOURGRID_H
+#define ANDROIDGLINVESTIGATIONS_NEIGHBOURGRID_H
+
+#include <GLES3/gl31.h>
+#include <memory>
+#include "ParticleState.h"
+#include "RenderBackend.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
+
+class ShaderLibrary;
+
+/*!
+ * Neighbour search for particle interactions on GL. Particle indices are grouped by hashed world
+ * cell with a counting sort, so a force model only looks at the particles in the 3x3 cells around
+ * each particle instead of all of them:
+ *
+ *  - neighbour_count.comp counts the particles per table entry and keeps each particle's slot,
+ *  - neighbour_scan.comp turns the counts into a range of sorted slots per entry,
+ *  - neighbour_scatter.comp writes every index into its slot.
+ *
+ * The force model then reads the grid at NEIGHBOUR_GRID_BINDING and writes one acceleration per
+ * particle into forces(), which particle.comp adds when built with NEIGHBOUR_FORCES. Another
+ * model is another kernel over the same grid, neighbour_fluid.comp shows the loop.
+ */
+class NeighbourGrid {
+public:
+    /*!
+     * Gets the kernels for @a layout and @a interaction from @a shaders and allocates the grid for
+     * @a capacity particles, throws std::runtime_error on failure
+     */
+    NeighbourGrid(ShaderLibrary *shaders, ParticleLayout layout, int capacity, Interaction interaction);
+    ~NeighbourGrid();
+
+    NeighbourGrid(const NeighbourGrid&) = delete;
+    NeighbourGrid& operator=(const NeighbourGrid&) = delete;
+
+    /*!
+     * Sorts the first @a count particles of the front copy of @a state into the grid and runs the
+     * force model over them. Ends with the barrier the step needs to read forces().
+     */
+    void update(const ParticleState &state, int count);
+
+    //! One vec2 acceleration per particle, for NEIGHBOUR_FORCE_BINDING
+    GLuint forces() const { return buffers_[FORCES]; }
+
+private:
+    enum Buffer {
+        COUNTS,  // A uint per table entry
+        CELLS,   // Table entry and slot per particle
+        GRID,    // Range per table entry, then the sorted indices
+        FORCES,
+        BUFFER_COUNT
+    };
+
+    Shader *countShader_;  // Owned by the ShaderLibrary, like the others
+    Shader *scanShader_;
+    Shader *scatterShader_;
+    Shader *forceShader_;
+    GLuint buffers_[BUFFER_COUNT];
+    StreamingBuffer paramsBuffer_;
+    NeighbourParams params_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_NEIGHBOURGRID_H
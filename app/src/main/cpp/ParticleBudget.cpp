@@ -0,0 +1,124 @@
+#include "ParticleBudget.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unistd.h>
+
+#include "AndroidOut.h"
+
+// Smoothing factor for the sample average
+static constexpr float SAMPLE_SMOOTHING = 0.2f;
+
+// Samples to ignore after a change, covers the timer query latency plus a few frames to settle
+static constexpr int COOLDOWN_SAMPLES = 12;
+
+// Grow only while comfortably below the target, and then in small steps
+static constexpr float GROW_THRESHOLD = 0.8f;
+static constexpr float GROW_STEP = 1.05f;
+
+// Shrink aggressively enough to recover within a few frames, but never more than this at once
+static constexpr float MAX_SHRINK_STEP = 0.7f;
+
+ParticleBudget::ParticleBudget(int minCount, int maxCount, int initialCount) :
+        minCount_((std::max(GRANULARITY, minCount) + GRANULARITY - 1) / GRANULARITY * GRANULARITY),
+        maxCount_(std::max(minCount_, maxCount)),
+        count_(0),
+        limit_(maxCount_),
+        cappedCount_(0),
+        targetMillis_(0.0f),
+        canGrow_(false),
+        smoothedMillis_(0.0f),
+        cooldown_(COOLDOWN_SAMPLES) {
+    // The first frames include startup work and shader warmup, they don't count
+    setCount(initialCount);
+}
+
+void ParticleBudget::setTarget(float targetMillis, bool canGrow) {
+    targetMillis_ = targetMillis;
+    canGrow_ = canGrow;
+}
+
+void ParticleBudget::addSample(float millis) {
+    if (targetMillis_ <= 0.0f || millis <= 0.0f) {
+        return;
+    }
+
+    smoothedMillis_ = smoothedMillis_ == 0.0f
+            ? millis
+            : smoothedMillis_ + SAMPLE_SMOOTHING * (millis - smoothedMillis_);
+
+    if (cooldown_ > 0) {
+        cooldown_--;
+        return;
+    }
+
+    // Cost scales roughly linearly with the particle count
+    int newCount = count_;
+    if (smoothedMillis_ > targetMillis_) {
+        float ratio = std::max(MAX_SHRINK_STEP, 0.95f * targetMillis_ / smoothedMillis_);
+        newCount = static_cast<int>(count_ * ratio);
+    } else if (canGrow_ && smoothedMillis_ < targetMillis_ * GROW_THRESHOLD) {
+        // At least one granule, below 20 of them the step would floor back to the same count
+        newCount = std::max(static_cast<int>(count_ * GROW_STEP), count_ + GRANULARITY);
+    }
+
+    int oldCount = count_;
+    setCount(newCount);
+    if (count_ != oldCount) {
+        // Predict the cost at the new count so the average doesn't lag behind the change
+        smoothedMillis_ *= static_cast<float>(count_) / oldCount;
+        cooldown_ = COOLDOWN_SAMPLES;
+        aout << "Particle budget: " << oldCount << " -> " << count_
+             << " (" << smoothedMillis_ << " ms est, target " << targetMillis_ << " ms)" << std::endl;
+    }
+}
+
+void ParticleBudget::setLimit(int count) {
+    int limit = std::clamp(count, minCount_, maxCount_);
+    if (limit == limit_) {
+        return;
+    }
+    int oldCount = count_;
+    limit_ = limit;
+    if (count_ > limit_) {
+        cappedCount_ = std::max(cappedCount_, count_);
+        setCount(limit_);
+    } else if (!canGrow_ && cappedCount_ > count_) {
+        setCount(cappedCount_);
+    }
+    if (count_ >= cappedCount_ || limit_ == maxCount_) {
+        cappedCount_ = 0;
+    }
+    if (count_ != oldCount) {
+        // Whatever was averaged was measured at the old count
+        smoothedMillis_ *= static_cast<float>(count_) / oldCount;
+        cooldown_ = COOLDOWN_SAMPLES;
+    }
+    aout << "Particle budget limit: " << limit_ << ", " << oldCount << " -> " << count_ << std::endl;
+}
+
+void ParticleBudget::setCount(int count) {
+    count = std::clamp(count, minCount_, limit_);
+    count_ = std::max(GRANULARITY, count / GRANULARITY * GRANULARITY);
+}
+
+int ParticleBudget::deviceMaxParticles(int storageLimit) {
+    int64_t totalRam = static_cast<int64_t>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+    constexpr int64_t GiB = 1024LL * 1024 * 1024;
+
+    int maxParticles;
+    if (totalRam >= 8 * GiB) {
+        maxParticles = 2000000;
+    } else if (totalRam >= 4 * GiB) {
+        maxParticles = 1000000;
+    } else {
+        maxParticles = 400000;
+    }
+
+    // Stay inside what a single storage block may address on this GPU
+    maxParticles = std::min(maxParticles, storageLimit);
+
+    aout << "Device RAM " << totalRam / (1024 * 1024) << " MiB, particle capacity " << maxParticles
+         << std::endl;
+    return maxParticles;
+}
@@ -0,0 +1,65 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PARTICLEBUDGET_H
+#define ANDROIDGLINVESTIGATIONS_PARTICLEBUDGET_H
+
+/*!
+ * Grows or shrinks the number of simulated particles so the measured frame cost stays under a
+ * target. The particle buffers are allocated for the maximum up front, so a budget change is only
+ * a different count in glDispatchCompute/glDrawArrays.
+ *
+ * Samples are smoothed, and after every change the controller waits for the timer latency to
+ * pass before it reacts again, so it settles instead of oscillating.
+ */
+class ParticleBudget {
+public:
+    //! Counts are kept at a multiple of this so dispatches never run partially filled workgroups
+    static constexpr int GRANULARITY = 256;
+
+    /*!
+     * @param minCount the budget never drops below this, rounded up to GRANULARITY
+     * @param maxCount the budget never exceeds this, normally the buffer capacity
+     * @param initialCount where to start
+     */
+    ParticleBudget(int minCount, int maxCount, int initialCount);
+
+    /*!
+     * Sets the cost the controller aims for
+     * @param targetMillis samples above this shrink the budget
+     * @param canGrow false if samples can't tell how much headroom there is, e.g. when they are
+     *     vsync-bound frame intervals rather than GPU times; the budget then only shrinks
+     */
+    void setTarget(float targetMillis, bool canGrow);
+
+    //! Feeds one cost sample measured at the current count
+    void addSample(float millis);
+
+    /*!
+     * Caps the count below maxCount(), e.g. while the device runs hot. A count over the cap drops
+     * to it right away. Once the cap is raised the controller grows back if it can, otherwise the
+     * count goes back to where the cap found it.
+     */
+    void setLimit(int count);
+
+    int activeCount() const { return count_; }
+    int maxCount() const { return maxCount_; }
+
+    /*!
+     * Picks the largest particle count worth preallocating on this device, from its total RAM and
+     * @a storageLimit, the most particles a single state buffer can hold on the render backend
+     */
+    static int deviceMaxParticles(int storageLimit);
+
+private:
+    void setCount(int count);
+
+    int minCount_;
+    int maxCount_;
+    int count_;
+    int limit_;
+    int cappedCount_;  // What the cap took the count down from, 0 if it didn't
+    float targetMillis_;
+    bool canGrow_;
+    float smoothedMillis_;
+    int cooldown_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PARTICLEBUDGET_H
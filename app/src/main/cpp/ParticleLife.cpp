@@ -0,0 +1,80 @@
+#include "ParticleLife.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "ShaderLibrary.h"
+#include "SimParams.h"
+
+// Emitted particles per workgroup of particle_emit.comp
+static constexpr GLuint EMIT_GROUP_SIZE = 256;
+
+ParticleLife::ParticleLife(ShaderLibrary *shaders, ParticleLayout layout, int capacity, int groupParticles) :
+        shaders_(shaders),
+        capacity_(capacity),
+        dispatchShader_(nullptr),
+        emitShader_(nullptr),
+        buffers_{} {
+    emitShader_ = shaders_->compute("shaders/particle_emit.comp", ParticleState::defines(layout));
+    if (!emitShader_) {
+        throw std::runtime_error("Failed to create particle emit shader");
+    }
+    setGroupParticles(groupParticles);
+
+    glGenBuffers(2, buffers_);
+    for (GLuint buffer : buffers_) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, LIFE_HEADER + static_cast<GLsizeiptr>(capacity) * sizeof(float),
+                     nullptr, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+ParticleLife::~ParticleLife() {
+    glDeleteBuffers(2, buffers_);
+}
+
+void ParticleLife::setGroupParticles(int groupParticles) {
+    auto *shader = shaders_->compute("shaders/particle_dispatch.comp",
+                                     {{"GROUP_PARTICLES", std::to_string(groupParticles) + "u"}});
+    if (!shader) {
+        throw std::runtime_error("Failed to create particle dispatch shader");
+    }
+    dispatchShader_ = shader;
+}
+
+void ParticleLife::reset(int front, int alive) {
+    // Only at startup and between benchmark configurations, a plain upload is fine
+    std::vector<GLuint> contents(LIFE_HEADER / sizeof(GLuint) + capacity_, 0);
+    for (int copy = 0; copy < 2; copy++) {
+        GLuint header[] = {copy == front ? static_cast<GLuint>(alive) : 0u, 1, 0, 0,
+                           0, 1, 1, 0};
+        std::copy(std::begin(header), std::end(header), contents.begin());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers_[copy]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, contents.size() * sizeof(GLuint), contents.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void ParticleLife::dispatch(int front) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIFE_INPUT_BINDING, buffers_[front]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIFE_OUTPUT_BINDING, buffers_[1 - front]);
+    dispatchShader_->activate();
+    glDispatchCompute(1, 1, 1);
+    dispatchShader_->deactivate();
+
+    // The step reads the dispatch as a command and appends to the count of the back copy
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffers_[front]);
+}
+
+void ParticleLife::emit(GLuint count) {
+    if (count == 0) return;
+
+    // After the step's survivors, so behind its atomics
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    emitShader_->activate();
+    glDispatchCompute((count + EMIT_GROUP_SIZE - 1) / EMIT_GROUP_SIZE, 1, 1);
+    emitShader_->deactivate();
+}
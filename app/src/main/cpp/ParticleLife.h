@@ -0,0 +1,72 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PARTICLELIFE_H
+#define ANDROIDGLINVESTIGATIONS_PARTICLELIFE_H
+
+#include <GLES3/gl31.h>
+#include <memory>
+#include "ParticleState.h"
+#include "Shader.h"
+
+class ShaderLibrary;
+
+/*!
+ * Particle lifetimes and emission on GL. Each copy of the ParticleState gets a buffer of seconds
+ * left per particle behind a LIFE_HEADER: the copy's indirect draw command, whose count is how many
+ * of its particles are alive, and the indirect dispatch of the step over them. A frame that steps
+ * goes through
+ *
+ *  - dispatch(), particle_dispatch.comp sizes the step to the live particles of the front copy
+ *    and empties the back copy,
+ *  - the step, built with PARTICLE_LIFE and run with glDispatchComputeIndirect(), which packs the
+ *    survivors at the front of the back copy,
+ *  - emit(), particle_emit.comp appends the frame's new particles behind them,
+ *
+ * and the draw takes the front copy's count with glDrawArraysIndirect(). The counts stay on the
+ * GPU, dead particles cost neither a step nor a vertex.
+ */
+class ParticleLife {
+public:
+    /*!
+     * Gets the kernels for @a layout from @a shaders and allocates lifetimes for @a capacity
+     * particles per copy, throws std::runtime_error on failure
+     * @param groupParticles particles one workgroup of the step covers, see setGroupParticles()
+     */
+    ParticleLife(ShaderLibrary *shaders, ParticleLayout layout, int capacity, int groupParticles);
+    ~ParticleLife();
+
+    ParticleLife(const ParticleLife&) = delete;
+    ParticleLife& operator=(const ParticleLife&) = delete;
+
+    //! Switches to the particle_dispatch.comp variant for a step kernel of another workgroup size
+    void setGroupParticles(int groupParticles);
+
+    /*!
+     * Makes the first @a alive particles of copy @a front alive and the back copy empty. Their
+     * lifetimes start at zero, the first step gives them a random part of SimParams::lifetime.
+     */
+    void reset(int front, int alive);
+
+    /*!
+     * Binds the lifetimes of copy @a front and the back copy for the step, sizes its dispatch and
+     * leaves the header bound as the GL_DISPATCH_INDIRECT_BUFFER. The uniform block of the frame
+     * has to be bound already.
+     */
+    void dispatch(int front);
+
+    /*!
+     * Emits @a count particles behind the step's survivors, with the step's state bindings and
+     * SimParams still bound
+     */
+    void emit(GLuint count);
+
+    //! Lifetime buffer of copy @a copy, with the copy's draw command at LIFE_DRAW_OFFSET
+    GLuint buffer(int copy) const { return buffers_[copy]; }
+
+private:
+    ShaderLibrary *shaders_;
+    int capacity_;
+    Shader *dispatchShader_;  // Owned by shaders_, like emitShader_
+    Shader *emitShader_;
+    GLuint buffers_[2];
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PARTICLELIFE_H
@@ -0,0 +1,346 @@
+#include "ParticleState.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "AndroidOut.h"
+
+ParticleState::ParticleState(ParticleLayout layout, int capacity) :
+        layout_(layout),
+        capacity_(capacity),
+        buffers_{},
+        vaos_{0, 0},
+        front_(0),
+        stepped_(false),
+        captureBuffer_(0),
+        captureFence_(nullptr),
+        captureCount_(0) {
+    if (capacity_ <= 0) {
+        throw std::runtime_error("Particle state needs a positive capacity");
+    }
+
+    GLsizeiptr count = capacity_;
+    glGenBuffers(4, &buffers_[0][0]);
+    glGenVertexArrays(2, vaos_);
+    for (int copy = 0; copy < 2; copy++) {
+        GLuint *buffers = buffers_[copy];
+        switch (layout_) {
+            case ParticleLayout::SoA32:
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, count * 2 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, count * 2 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+                break;
+            case ParticleLayout::Interleaved32:
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, count * 4 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+                break;
+            case ParticleLayout::PackedHalf:
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, count * 2 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+                break;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glBindVertexArray(vaos_[copy]);
+        switch (layout_) {
+            case ParticleLayout::SoA32:
+                // Position attribute (vec2)
+                glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+                // Velocity attribute (vec2)
+                glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+                break;
+            case ParticleLayout::Interleaved32:
+                // Position in xy and velocity in zw of the same vec4
+                glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                                      reinterpret_cast<const void *>(2 * sizeof(float)));
+                break;
+            case ParticleLayout::PackedHalf:
+                glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+                // Packed half velocity as a raw uint, unpacked in particle.vert
+                glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+                glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(uint32_t), nullptr);
+                break;
+        }
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    aout << "Particle state: " << layoutName(layout_) << ", " << capacity_ << " particles, 2 x "
+         << (bytesPerParticle(layout_) * capacity_) / (1024 * 1024) << " MiB" << std::endl;
+}
+
+ParticleState::~ParticleState() {
+    if (captureFence_) {
+        glDeleteSync(captureFence_);
+    }
+    glDeleteBuffers(1, &captureBuffer_);
+    glDeleteVertexArrays(2, vaos_);
+    glDeleteBuffers(4, &buffers_[0][0]);
+}
+
+namespace {
+
+//! Leads every snapshot blob
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t layout;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(SnapshotHeader) == ParticleState::SNAPSHOT_HEADER_SIZE, "Snapshot header size mismatch");
+constexpr uint32_t SNAPSHOT_MAGIC = 0x50534e50;  // "PSNP"
+
+} // namespace
+
+size_t ParticleState::bufferStride(ParticleLayout layout, int buffer) {
+    switch (layout) {
+        case ParticleLayout::SoA32:
+            return 2 * sizeof(float);
+        case ParticleLayout::Interleaved32:
+            return buffer == 0 ? 4 * sizeof(float) : 0;
+        case ParticleLayout::PackedHalf:
+            return buffer == 0 ? 2 * sizeof(float) : sizeof(uint32_t);
+    }
+    return 0;
+}
+
+std::vector<uint8_t> ParticleState::snapshot(int count) const {
+    count = std::clamp(count, 0, capacity_);
+    SnapshotHeader header = {SNAPSHOT_MAGIC, static_cast<uint32_t>(layout_), static_cast<uint32_t>(count), 0};
+    std::vector<uint8_t> blob(sizeof(header) + count * bytesPerParticle(layout_));
+    memcpy(blob.data(), &header, sizeof(header));
+
+    // Compute writes have to land before the buffers are mapped
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    size_t offset = sizeof(header);
+    for (int i = 0; i < 2; i++) {
+        size_t size = bufferStride(layout_, i) * count;
+        if (size == 0) {
+            continue;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, buffers_[front_][i]);
+        auto *data = glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (!data) {
+            aout << "Failed to map particle buffer " << i << " for a snapshot" << std::endl;
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            return {};
+        }
+        memcpy(blob.data() + offset, data, size);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        offset += size;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return blob;
+}
+
+bool ParticleState::beginCapture(int count) {
+    if (captureFence_) {
+        return false;
+    }
+    if (!captureBuffer_) {
+        glGenBuffers(1, &captureBuffer_);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, captureBuffer_);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(capacity_) * bytesPerParticle(layout_),
+                     nullptr, GL_STREAM_READ);
+    }
+    captureCount_ = std::clamp(count, 0, capacity_);
+
+    // The buffers go back to back, as in the blob
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, captureBuffer_);
+    GLintptr offset = 0;
+    for (int i = 0; i < 2; i++) {
+        auto size = static_cast<GLsizeiptr>(bufferStride(layout_, i) * captureCount_);
+        if (size == 0) {
+            continue;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, buffers_[front_][i]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, size);
+        offset += size;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    captureFence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    return true;
+}
+
+bool ParticleState::collectCapture(std::vector<uint8_t> *outBlob) {
+    if (!captureFence_) {
+        return false;
+    }
+    GLenum status = glClientWaitSync(captureFence_, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(captureFence_);
+    captureFence_ = nullptr;
+    if (status == GL_WAIT_FAILED) {
+        aout << "Particle capture fence failed, dropping the capture" << std::endl;
+        return false;
+    }
+
+    SnapshotHeader header = {SNAPSHOT_MAGIC, static_cast<uint32_t>(layout_), static_cast<uint32_t>(captureCount_), 0};
+    size_t size = captureCount_ * bytesPerParticle(layout_);
+    outBlob->resize(sizeof(header) + size);
+    memcpy(outBlob->data(), &header, sizeof(header));
+    if (size == 0) {
+        return true;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, captureBuffer_);
+    auto *data = glMapBufferRange(GL_COPY_READ_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT);
+    if (!data) {
+        aout << "Failed to map the particle capture" << std::endl;
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return false;
+    }
+    memcpy(outBlob->data() + sizeof(header), data, size);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return true;
+}
+
+int ParticleState::restore(const std::vector<uint8_t> &blob) {
+    SnapshotHeader header;
+    if (blob.size() < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, blob.data(), sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.layout != static_cast<uint32_t>(layout_)
+            || header.count > static_cast<uint32_t>(capacity_)
+            || blob.size() != sizeof(header) + header.count * bytesPerParticle(layout_)) {
+        aout << "Particle snapshot doesn't match this state, ignoring it" << std::endl;
+        return 0;
+    }
+
+    size_t offset = sizeof(header);
+    for (int i = 0; i < 2; i++) {
+        size_t size = bufferStride(layout_, i) * header.count;
+        if (size == 0) {
+            continue;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers_[front_][i]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, blob.data() + offset);
+        offset += size;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return static_cast<int>(header.count);
+}
+
+void ParticleState::bindStorage(int copy) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers_[copy][0]);
+    if (layout_ != ParticleLayout::Interleaved32) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers_[copy][1]);
+    }
+}
+
+void ParticleState::bindStep() {
+    int back = 1 - front_;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers_[front_][0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, buffers_[back][0]);
+    if (layout_ != ParticleLayout::Interleaved32) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers_[front_][1]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, buffers_[back][1]);
+    }
+    stepped_ = true;
+}
+
+bool ParticleState::advance() {
+    if (!stepped_) {
+        return false;
+    }
+    front_ = 1 - front_;
+    stepped_ = false;
+    return true;
+}
+
+Shader::Defines ParticleState::defines(ParticleLayout layout) {
+    switch (layout) {
+        case ParticleLayout::Interleaved32:
+            return {{"LAYOUT_INTERLEAVED", "1"}};
+        case ParticleLayout::PackedHalf:
+            return {{"LAYOUT_PACKED_HALF", "1"}};
+        case ParticleLayout::SoA32:
+        default:
+            return {{"LAYOUT_SOA", "1"}};
+    }
+}
+
+const char *ParticleState::layoutName(ParticleLayout layout) {
+    switch (layout) {
+        case ParticleLayout::SoA32:
+            return "soa";
+        case ParticleLayout::Interleaved32:
+            return "interleaved";
+        case ParticleLayout::PackedHalf:
+            return "half";
+    }
+    return "unknown";
+}
+
+size_t ParticleState::bytesPerParticle(ParticleLayout layout) {
+    switch (layout) {
+        case ParticleLayout::SoA32:
+        case ParticleLayout::Interleaved32:
+            return 4 * sizeof(float);
+        case ParticleLayout::PackedHalf:
+            return 2 * sizeof(float) + sizeof(uint32_t);
+    }
+    return 0;
+}
+
+int ParticleState::maxCapacity(ParticleLayout layout) {
+    GLint64 maxBlockSize = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+
+    // The biggest block is the interleaved one at a full vec4, SoA blocks are never larger than that
+    int64_t perBlock = layout == ParticleLayout::Interleaved32 ? 4 * sizeof(float) : 2 * sizeof(float);
+    int64_t limit = maxBlockSize / perBlock;
+    return static_cast<int>(std::min<int64_t>(limit, INT32_MAX));
+}
+
+ParticleLayout ParticleState::parseLayout(const std::string &name, ParticleLayout fallback) {
+    for (auto layout : {ParticleLayout::SoA32, ParticleLayout::Interleaved32, ParticleLayout::PackedHalf}) {
+        if (name == layoutName(layout)) {
+            return layout;
+        }
+    }
+    return fallback;
+}
+
+const char *ParticleState::distributionName(ParticleDistribution distribution) {
+    switch (distribution) {
+        case ParticleDistribution::Grid:
+            return "grid";
+        case ParticleDistribution::Disc:
+            return "disc";
+        case ParticleDistribution::Ring:
+            return "ring";
+        case ParticleDistribution::Noise:
+            return "noise";
+    }
+    return "unknown";
+}
+
+ParticleDistribution ParticleState::parseDistribution(const std::string &name, ParticleDistribution fallback) {
+    for (auto distribution : {ParticleDistribution::Grid, ParticleDistribution::Disc,
+                              ParticleDistribution::Ring, ParticleDistribution::Noise}) {
+        if (name == distributionName(distribution)) {
+            return distribution;
+        }
+    }
+    return fallback;
+}
@@ -0,0 +1,147 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PARTICLESTATE_H
+#define ANDROIDGLINVESTIGATIONS_PARTICLESTATE_H
+
+#include <GLES3/gl31.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Shader.h"
+
+/*!
+ * How particle positions and velocities are laid out in GPU memory. The layout is picked once at
+ * init; the compute and vertex shaders are compiled with the matching LAYOUT_* define.
+ */
+enum class ParticleLayout {
+    //! fp32 vec2 positions and fp32 vec2 velocities in two buffers, 16 bytes per particle
+    SoA32,
+    //! One fp32 vec4 per particle (position in xy, velocity in zw), a single fetch per particle
+    Interleaved32,
+    //! fp32 vec2 positions plus velocities packed into one uint with packHalf2x16, 12 bytes
+    PackedHalf
+};
+
+/*!
+ * How particle_init.comp places the initial particles, values match its DISTRIBUTION_* defines
+ */
+enum class ParticleDistribution {
+    //! A 4:3 grid, with particles past the grid scattered over the spawn area
+    Grid = 0,
+    //! Uniformly filled disc
+    Disc = 1,
+    //! Thin band orbiting the center
+    Ring = 2,
+    //! Scattered, with velocities following a smooth noise field
+    Noise = 3
+};
+
+/*!
+ * Owns the storage buffers holding the particle state in a given layout, plus the vertex arrays
+ * that feed them to particle.vert. The same buffers are bound as SSBOs for the compute passes,
+ * particle_init.comp fills them and particle.comp steps them.
+ *
+ * The state is double buffered. The step reads the front copy and writes the back copy, and the
+ * frame draws the front copy, so the draw doesn't wait for the step of the same frame. The copies
+ * swap at the next advance(), which is where the step's writes have to be made visible.
+ */
+class ParticleState {
+public:
+    /*!
+     * Allocates uninitialized buffers for @a capacity particles
+     * @param layout the memory layout to use
+     * @param capacity how many particles the buffers hold
+     */
+    ParticleState(ParticleLayout layout, int capacity);
+
+    ~ParticleState();
+
+    ParticleState(const ParticleState&) = delete;
+    ParticleState& operator=(const ParticleState&) = delete;
+
+    //! Bytes of the header that starts a snapshot blob
+    static constexpr size_t SNAPSHOT_HEADER_SIZE = 16;
+
+    /*!
+     * Reads the first @a count particles of the front copy back into a compact blob: a small header
+     * followed by each buffer's range in the GPU layout, no conversion
+     */
+    std::vector<uint8_t> snapshot(int count) const;
+
+    /*!
+     * Uploads a blob made by snapshot() on a state with the same layout into the front copy
+     * @return the number of particles restored, 0 if the blob doesn't match this state
+     */
+    int restore(const std::vector<uint8_t>& blob);
+
+    /*!
+     * Starts copying the first @a count particles of the front copy into a buffer of its own on the
+     * GPU, fenced, for collectCapture(). Unlike snapshot() nothing waits for the copy.
+     * @return false if the last capture hasn't been collected yet
+     */
+    bool beginCapture(int count);
+
+    /*!
+     * Maps the capture once its fence has signaled and reads it into @a outBlob, in the format of
+     * snapshot(). Doesn't wait.
+     * @return true if a capture was ready
+     */
+    bool collectCapture(std::vector<uint8_t> *outBlob);
+
+    //! Binds copy @a copy (0 or 1) as SSBOs starting at binding 0, the layout particle_init.comp expects
+    void bindStorage(int copy) const;
+
+    /*!
+     * Binds the front copy at bindings 0 and 1 and the back copy at 2 and 3, the layout particle.comp
+     * expects, and marks the back copy as written. A pending step has to be advance()d first.
+     */
+    void bindStep();
+
+    /*!
+     * Makes the copy written by the last step the front one
+     * @return true if there was a step, the caller issues the barrier for its writes
+     */
+    bool advance();
+
+    ParticleLayout layout() const { return layout_; }
+    int capacity() const { return capacity_; }
+
+    //! Vertex array over the front copy
+    GLuint vertexArray() const { return vaos_[front_]; }
+
+    //! The copy drawn this frame, for bindStorage()
+    int front() const { return front_; }
+
+    //! The defines to compile particle shaders with for @a layout
+    static Shader::Defines defines(ParticleLayout layout);
+
+    static const char* layoutName(ParticleLayout layout);
+    static size_t bytesPerParticle(ParticleLayout layout);
+
+    //! Bytes one particle takes in state buffer @a buffer of @a layout, 0 if the layout doesn't use it
+    static size_t bufferStride(ParticleLayout layout, int buffer);
+
+    //! Largest capacity a single storage block on this GPU can hold in @a layout
+    static int maxCapacity(ParticleLayout layout);
+
+    //! Parses "soa", "interleaved" or "half", returning @a fallback for anything else
+    static ParticleLayout parseLayout(const std::string& name, ParticleLayout fallback);
+
+    static const char* distributionName(ParticleDistribution distribution);
+
+    //! Parses "grid", "disc", "ring" or "noise", returning @a fallback for anything else
+    static ParticleDistribution parseDistribution(const std::string& name, ParticleDistribution fallback);
+
+private:
+    ParticleLayout layout_;
+    int capacity_;
+    GLuint buffers_[2][2];  // [copy][buffer]
+    GLuint vaos_[2];
+    int front_;
+    bool stepped_;  // The back copy holds a step that advance() hasn't swapped in yet
+
+    // Read back copy of the front copy for beginCapture(), allocated on the first capture
+    GLuint captureBuffer_;
+    GLsync captureFence_;  // Set while a capture is in flight
+    int captureCount_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PARTICLESTATE_H
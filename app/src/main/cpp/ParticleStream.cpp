@@ -0,0 +1,48 @@
+#include "ParticleStream.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+#include "AndroidOut.h"
+
+ParticleStream::ParticleStream(int capacity) :
+        buffer_(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity) * 4 * sizeof(float)),
+        vertexArrays_{} {
+    GLsizeiptr slotSize = buffer_.regionSize();
+    aout << "Particle stream: " << SLOT_COUNT << " slots of " << slotSize / 1024 << " KiB, "
+         << (buffer_.persistent() ? "persistently mapped" : "mapped per frame") << std::endl;
+
+    // Positions then velocities in each slot, as the SoA32 vertex array of ParticleState
+    glGenVertexArrays(SLOT_COUNT, vertexArrays_);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_.buffer());
+    for (int slot = 0; slot < SLOT_COUNT; slot++) {
+        auto offset = static_cast<uintptr_t>(buffer_.offset(slot));
+        glBindVertexArray(vertexArrays_[slot]);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), reinterpret_cast<const void *>(offset));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                              reinterpret_cast<const void *>(offset + slotSize / 2));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (glGetError() != GL_NO_ERROR) {
+        throw std::runtime_error("Failed to create the particle stream");
+    }
+}
+
+int ParticleStream::maxCapacity() {
+    // GLsizeiptr is 32 bits on 32-bit ABIs
+    return static_cast<int>(INT32_MAX / (SLOT_COUNT * 4 * sizeof(float)));
+}
+
+ParticleStream::~ParticleStream() {
+    glDeleteVertexArrays(SLOT_COUNT, vertexArrays_);
+}
+
+void ParticleStream::beginWrite(float **outPositions, float **outVelocities) {
+    auto slot = static_cast<char *>(buffer_.beginWrite());
+    *outPositions = reinterpret_cast<float *>(slot);
+    *outVelocities = reinterpret_cast<float *>(slot + buffer_.regionSize() / 2);
+}
@@ -0,0 +1,46 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PARTICLESTREAM_H
+#define ANDROIDGLINVESTIGATIONS_PARTICLESTREAM_H
+
+#include <GLES3/gl31.h>
+
+#include "StreamingBuffer.h"
+
+/*!
+ * Vertex buffers for particles written by the CPU, in the SoA32 layout particle.vert reads. Each
+ * region of a StreamingBuffer holds vec2 positions then vec2 velocities and gets a vertex array.
+ */
+class ParticleStream {
+public:
+    static constexpr int SLOT_COUNT = StreamingBuffer::REGION_COUNT;
+
+    //! Most particles the slots can hold, the size of all of them has to fit a GLsizeiptr
+    static int maxCapacity();
+
+    //! Allocates SLOT_COUNT slots of @a capacity particles
+    explicit ParticleStream(int capacity);
+    ~ParticleStream();
+
+    ParticleStream(const ParticleStream&) = delete;
+    ParticleStream& operator=(const ParticleStream&) = delete;
+
+    /*!
+     * Moves on to the next slot, waiting for the GPU to finish drawing it, and maps it. Both
+     * arrays have room for the capacity, 2 floats per particle.
+     */
+    void beginWrite(float **outPositions, float **outVelocities);
+
+    //! Unmaps the slot, draws read it from now on
+    void endWrite() { buffer_.endWrite(); }
+
+    //! Vertex array of the slot last written
+    GLuint vertexArray() const { return vertexArrays_[buffer_.region()]; }
+
+    //! Called after the draw of vertexArray(), the slot can't be written again before it is done
+    void fence() { buffer_.fence(); }
+
+private:
+    StreamingBuffer buffer_;
+    GLuint vertexArrays_[SLOT_COUNT];
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PARTICLESTREAM_H
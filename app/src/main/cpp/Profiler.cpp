@@ -0,0 +1,218 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <android/trace.h>
+#include <iomanip>
+
+#include "AndroidOut.h"
+
+// Refresh the percentiles this often, the overlay reads the cached values
+static constexpr int STATS_INTERVAL_FRAMES = 30;
+
+// Log a summary line this often
+static constexpr auto SUMMARY_INTERVAL = std::chrono::seconds(5);
+
+// Overlay geometry, in pixels
+static constexpr int OVERLAY_MARGIN = 32;
+static constexpr int OVERLAY_ROW_HEIGHT = 24;
+static constexpr int OVERLAY_BAR_GAP = 4;
+
+Profiler::Profiler(bool gpuTiming) :
+        gpuTiming_(gpuTiming),
+        overlayEnabled_(false),
+        stats_{},
+        gpuFrames_{},
+        gpuFrameHead_(0),
+        gpuFrameCount_(0),
+        framesSinceStats_(0),
+        particlesSinceStats_(0),
+        particlesPerSecond_(0.0f),
+        maxParticlesPerSecond_(0.0f),
+        thermalHeadroom_(-1.0f),
+        qualityTier_(0) {
+    statsTime_ = std::chrono::steady_clock::now();
+    summaryTime_ = statsTime_;
+}
+
+void Profiler::addGpuFrame(float simulateMillis, float drawMillis) {
+    gpuSamples_[static_cast<int>(Pass::Simulate)].add(simulateMillis);
+    gpuSamples_[static_cast<int>(Pass::Draw)].add(drawMillis);
+
+    gpuFrames_[gpuFrameHead_] = simulateMillis + drawMillis;
+    gpuFrameHead_ = (gpuFrameHead_ + 1) % SAMPLE_COUNT;
+    gpuFrameCount_ = std::min(gpuFrameCount_ + 1, SAMPLE_COUNT);
+}
+
+void Profiler::beginPass(Pass pass) {
+    int index = static_cast<int>(pass);
+    ATrace_beginSection(passName(pass));
+    passStart_[index] = std::chrono::steady_clock::now();
+}
+
+void Profiler::endPass(Pass pass) {
+    int index = static_cast<int>(pass);
+    auto elapsed = std::chrono::steady_clock::now() - passStart_[index];
+    cpuSamples_[index].add(std::chrono::duration<float, std::milli>(elapsed).count());
+    ATrace_endSection();
+}
+
+void Profiler::endFrame(int particleCount) {
+    particlesSinceStats_ += particleCount;
+    if (++framesSinceStats_ >= STATS_INTERVAL_FRAMES) {
+        updateStats();
+    }
+}
+
+bool Profiler::collectGpuFrame(float *outMillis) {
+    if (gpuFrameCount_ == 0) {
+        return false;
+    }
+    int oldest = (gpuFrameHead_ - gpuFrameCount_ + SAMPLE_COUNT) % SAMPLE_COUNT;
+    *outMillis = gpuFrames_[oldest];
+    gpuFrameCount_--;
+    return true;
+}
+
+void Profiler::updateStats() {
+    auto now = std::chrono::steady_clock::now();
+    float seconds = std::chrono::duration<float>(now - statsTime_).count();
+    if (seconds > 0.0f) {
+        particlesPerSecond_ = static_cast<float>(particlesSinceStats_) / seconds;
+        maxParticlesPerSecond_ = std::max(maxParticlesPerSecond_, particlesPerSecond_);
+    }
+    statsTime_ = now;
+    framesSinceStats_ = 0;
+    particlesSinceStats_ = 0;
+
+    for (int i = 0; i < PASS_COUNT; i++) {
+        auto &passStats = stats_[i];
+        cpuSamples_[i].percentiles(&passStats.cpuP50, &passStats.cpuP99);
+        gpuSamples_[i].percentiles(&passStats.gpuP50, &passStats.gpuP99);
+    }
+
+    if (now - summaryTime_ < SUMMARY_INTERVAL) {
+        return;
+    }
+    summaryTime_ = now;
+
+    // One line per summary so it stays greppable in logcat
+    aout << std::fixed << std::setprecision(2) << "Perf (p50/p99 ms):";
+    for (int i = 0; i < PASS_COUNT; i++) {
+        auto &passStats = stats_[i];
+        aout << " " << passName(static_cast<Pass>(i))
+             << " cpu " << passStats.cpuP50 << "/" << passStats.cpuP99;
+        if (hasGpuTiming(i)) {
+            aout << " gpu " << passStats.gpuP50 << "/" << passStats.gpuP99;
+        }
+        aout << ",";
+    }
+    if (sortSamples_.size > 0) {
+        float sortP50, sortP99;
+        sortSamples_.percentiles(&sortP50, &sortP99);
+        aout << " Sort gpu " << sortP50 << "/" << sortP99 << ",";
+    }
+    aout << " " << particlesPerSecond_ / 1.0e6f << " Mparticles/s";
+    if (thermalHeadroom_ >= 0.0f) {
+        aout << ", thermal headroom " << thermalHeadroom_;
+    }
+    aout << ", quality tier " << qualityTier_ << std::endl;
+    aout << std::defaultfloat;
+}
+
+std::vector<Profiler::OverlayRect> Profiler::overlay(int width, int height, float framePeriodMillis) const {
+    std::vector<OverlayRect> rects;
+    if (!overlayEnabled_ || width <= 0 || height <= 0 || framePeriodMillis <= 0.0f) {
+        return rects;
+    }
+
+    int fullWidth = width / 2;
+    auto barWidth = [&](float millis) {
+        return std::clamp(static_cast<int>(millis / framePeriodMillis * fullWidth), 1, width - 2 * OVERLAY_MARGIN);
+    };
+    auto bar = [&](int barY, int w, int h, float r, float g, float b) {
+        rects.push_back({OVERLAY_MARGIN, barY, w, h, {r, g, b}});
+    };
+
+    int y = OVERLAY_MARGIN;
+    for (int i = 0; i < PASS_COUNT; i++) {
+        auto &passStats = stats_[i];
+        bool gpu = hasGpuTiming(i);
+        float p50 = gpu ? passStats.gpuP50 : passStats.cpuP50;
+        float p99 = gpu ? passStats.gpuP99 : passStats.cpuP99;
+
+        int halfRow = (OVERLAY_ROW_HEIGHT - OVERLAY_BAR_GAP) / 2;
+        // p50 bright on top, p99 dim underneath. GPU rows are green, CPU-only rows are blue.
+        if (gpu) {
+            bar(y, barWidth(p50), halfRow, 0.3f, 0.9f, 0.3f);
+            bar(y + halfRow, barWidth(p99), halfRow, 0.1f, 0.4f, 0.1f);
+        } else {
+            bar(y, barWidth(p50), halfRow, 0.3f, 0.5f, 1.0f);
+            bar(y + halfRow, barWidth(p99), halfRow, 0.1f, 0.2f, 0.5f);
+        }
+        y += OVERLAY_ROW_HEIGHT + OVERLAY_BAR_GAP;
+    }
+
+    // Throughput relative to the best seen this session
+    if (maxParticlesPerSecond_ > 0.0f) {
+        int throughputWidth = static_cast<int>(particlesPerSecond_ / maxParticlesPerSecond_ * fullWidth);
+        bar(y + OVERLAY_ROW_HEIGHT / 2, std::max(1, throughputWidth), OVERLAY_ROW_HEIGHT / 2, 0.9f, 0.6f, 0.2f);
+        y += OVERLAY_ROW_HEIGHT;
+    }
+
+    // Headroom from green to red as it nears 1, where the device throttles, and a block per tier
+    if (thermalHeadroom_ >= 0.0f || qualityTier_ > 0) {
+        int rowY = y + OVERLAY_ROW_HEIGHT / 2;
+        int halfRow = OVERLAY_ROW_HEIGHT / 2;
+        if (thermalHeadroom_ >= 0.0f) {
+            float heat = std::clamp(thermalHeadroom_, 0.0f, 1.0f);
+            int headroomWidth = std::clamp(static_cast<int>(thermalHeadroom_ * fullWidth), 1,
+                                           width - 2 * OVERLAY_MARGIN);
+            bar(rowY, headroomWidth, halfRow, heat, 1.0f - heat, 0.1f);
+        }
+        for (int i = 0; i < qualityTier_; i++) {
+            rects.push_back({OVERLAY_MARGIN + i * (halfRow + OVERLAY_BAR_GAP), rowY + halfRow + OVERLAY_BAR_GAP,
+                             halfRow, halfRow, {1.0f, 0.9f, 0.2f}});
+        }
+        y += 2 * OVERLAY_ROW_HEIGHT;
+    }
+
+    // Frame period marker across all rows
+    rects.push_back({OVERLAY_MARGIN + fullWidth, OVERLAY_MARGIN, 2, y - OVERLAY_MARGIN, {1.0f, 0.2f, 0.2f}});
+    return rects;
+}
+
+const char *Profiler::passName(Pass pass) {
+    switch (pass) {
+        case Pass::Simulate:
+            return "simulate";
+        case Pass::Draw:
+            return "draw";
+        case Pass::Present:
+            return "present";
+        default:
+            return "unknown";
+    }
+}
+
+void Profiler::SampleRing::add(float value) {
+    samples[next] = value;
+    next = (next + 1) % SAMPLE_COUNT;
+    size = std::min(size + 1, SAMPLE_COUNT);
+}
+
+void Profiler::SampleRing::percentiles(float *outP50, float *outP99) const {
+    if (size == 0) {
+        *outP50 = 0.0f;
+        *outP99 = 0.0f;
+        return;
+    }
+    std::array<float, SAMPLE_COUNT> sorted;
+    std::copy(samples.begin(), samples.begin() + size, sorted.begin());
+    auto end = sorted.begin() + size;
+    auto p50 = sorted.begin() + size / 2;
+    auto p99 = sorted.begin() + std::min(size - 1, (size * 99) / 100);
+    std::nth_element(sorted.begin(), p50, end);
+    *outP50 = *p50;
+    std::nth_element(sorted.begin(), p99, end);
+    *outP99 = *p99;
+}
@@ -0,0 +1,135 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PROFILER_H
+#define ANDROIDGLINVESTIGATIONS_PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Lightweight per-pass frame profiler.
+ *
+ * Every pass is timed on the CPU with steady_clock. When the render backend can time its passes on
+ * the GPU it hands those times in with addGpuFrame(). Passes are also marked with ATrace sections
+ * so they show up in systrace/Perfetto. Samples go into fixed size rings; percentiles are computed
+ * from them a few times a second for the optional overlay and a periodic logcat summary.
+ */
+class Profiler {
+public:
+    enum class Pass {
+        Simulate,
+        Draw,
+        Present,
+        Count
+    };
+
+    //! Summary of the recent samples of one pass, in milliseconds
+    struct PassStats {
+        float cpuP50;
+        float cpuP99;
+        float gpuP50;   // 0 if the pass has no GPU timing
+        float gpuP99;
+    };
+
+    //! A solid rectangle of the overlay, in pixels from the top left corner of the surface
+    struct OverlayRect {
+        int x;
+        int y;
+        int width;
+        int height;
+        float color[3];
+    };
+
+    //! @param gpuTiming whether the backend will report GPU times for Simulate and Draw
+    explicit Profiler(bool gpuTiming);
+
+    void beginPass(Pass pass);
+    void endPass(Pass pass);
+
+    //! Closes the frame, @a particleCount is what was simulated and drawn this frame
+    void endFrame(int particleCount);
+
+    //! True if GPU pass times are measured
+    bool hasGpuTiming() const { return gpuTiming_; }
+
+    //! Records the GPU times of one finished frame, as reported by the backend
+    void addGpuFrame(float simulateMillis, float drawMillis);
+
+    /*!
+     * Returns GPU frame times, simulate plus draw, as they become available. Call in a loop until
+     * it returns false.
+     */
+    bool collectGpuFrame(float *outMillis);
+
+    //! Records the GPU time of one particle sort, summarized apart from the passes
+    void addSortTime(float millis) { sortSamples_.add(millis); }
+
+    const PassStats &stats(Pass pass) const { return stats_[static_cast<int>(pass)]; }
+    float particlesPerSecond() const { return particlesPerSecond_; }
+
+    void setOverlayEnabled(bool enabled) { overlayEnabled_ = enabled; }
+
+    /*!
+     * The thermal state for the overlay and the summary
+     * @param headroom forecast thermal headroom, negative if unknown
+     * @param tier the quality governor's tier, 0 at full quality
+     */
+    void setThermal(float headroom, int tier) {
+        thermalHeadroom_ = headroom;
+        qualityTier_ = tier;
+    }
+
+    /*!
+     * Lays out the HUD as solid rectangles, which backends draw as scissored clears so it needs no
+     * shaders or geometry. One row per pass with the p50 bar over the p99 bar, scaled so that
+     * @a framePeriodMillis spans the marked width, and a throughput bar. At the bottom the thermal
+     * headroom, with 1 at the mark, and a block per quality tier given up.
+     * @return nothing if the overlay is disabled
+     */
+    std::vector<OverlayRect> overlay(int width, int height, float framePeriodMillis) const;
+
+    static const char *passName(Pass pass);
+
+private:
+    static constexpr int PASS_COUNT = static_cast<int>(Pass::Count);
+    static constexpr int SAMPLE_COUNT = 256;
+
+    //! Ring of the most recent samples of one series
+    struct SampleRing {
+        std::array<float, SAMPLE_COUNT> samples{};
+        int next = 0;
+        int size = 0;
+
+        void add(float value);
+        void percentiles(float *outP50, float *outP99) const;
+    };
+
+    void updateStats();
+
+    //! Simulate and Draw get GPU times when the backend has them, Present is CPU only
+    bool hasGpuTiming(int pass) const { return gpuTiming_ && pass != static_cast<int>(Pass::Present); }
+
+    bool gpuTiming_;
+    bool overlayEnabled_;
+    std::array<std::chrono::steady_clock::time_point, PASS_COUNT> passStart_;
+    std::array<SampleRing, PASS_COUNT> cpuSamples_;
+    std::array<SampleRing, PASS_COUNT> gpuSamples_;
+    SampleRing sortSamples_;
+    std::array<PassStats, PASS_COUNT> stats_;
+
+    // Frame totals from the GPU, waiting to be handed to collectGpuFrame()
+    std::array<float, SAMPLE_COUNT> gpuFrames_;
+    int gpuFrameHead_;
+    int gpuFrameCount_;
+
+    int framesSinceStats_;
+    int64_t particlesSinceStats_;
+    float particlesPerSecond_;
+    float maxParticlesPerSecond_;
+    float thermalHeadroom_;
+    int qualityTier_;
+    std::chrono::steady_clock::time_point statsTime_;
+    std::chrono::steady_clock::time_point summaryTime_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PROFILER_H
@@ -0,0 +1,194 @@
+#include "ProgramCache.h"
+
+#include <game-activity/GameActivity.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "AndroidOut.h"
+
+namespace {
+
+//! Leads every cache file
+struct BinaryHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;     // Of the binary, which follows the key
+    uint32_t keyLength;  // Of the key, which follows the header
+    uint64_t hash;       // Of the key, also in the file name
+};
+
+constexpr uint32_t BINARY_MAGIC = 0x32424e43;  // "2BNC", files before the stored key were "PBNC"
+
+// 64-bit FNV-1a
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+uint64_t hashBytes(const std::string &bytes) {
+    uint64_t hash = FNV_OFFSET;
+    for (unsigned char c : bytes) {
+        hash = (hash ^ c) * FNV_PRIME;
+    }
+    return hash;
+}
+
+std::string glString(GLenum name) {
+    auto value = reinterpret_cast<const char *>(glGetString(name));
+    return value ? value : "";
+}
+
+} // namespace
+
+ProgramCache::ProgramCache(std::string directory) :
+        directory_(std::move(directory)),
+        deviceId_(glString(GL_RENDERER) + "\n" + glString(GL_VERSION)) {
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    supported_ = formatCount > 0 && !directory_.empty();
+    aout << "Program binary cache " << (supported_ ? "in " + directory_ : std::string("unavailable"))
+         << std::endl;
+}
+
+std::string ProgramCache::cacheDirectory(GameActivity *activity) {
+    std::string directory;
+    if (!activity || !activity->vm) {
+        return directory;
+    }
+    JNIEnv *env;
+    activity->vm->AttachCurrentThread(&env, nullptr);
+
+    jobject context = activity->javaGameActivity;
+    jclass contextClass = env->GetObjectClass(context);
+    jmethodID getCacheDir = env->GetMethodID(contextClass, "getCacheDir", "()Ljava/io/File;");
+    jobject file = env->CallObjectMethod(context, getCacheDir);
+    if (file) {
+        jclass fileClass = env->GetObjectClass(file);
+        jmethodID getAbsolutePath = env->GetMethodID(fileClass, "getAbsolutePath", "()Ljava/lang/String;");
+        auto path = static_cast<jstring>(env->CallObjectMethod(file, getAbsolutePath));
+        if (path) {
+            const char *chars = env->GetStringUTFChars(path, nullptr);
+            directory = chars;
+            env->ReleaseStringUTFChars(path, chars);
+            env->DeleteLocalRef(path);
+        }
+        env->DeleteLocalRef(fileClass);
+        env->DeleteLocalRef(file);
+    }
+    env->DeleteLocalRef(contextClass);
+
+    activity->vm->DetachCurrentThread();
+    return directory;
+}
+
+std::string ProgramCache::key(const std::vector<std::string> &sources) const {
+    std::string key = std::to_string(deviceId_.size()) + ":" + deviceId_;
+    for (const auto &source : sources) {
+        key += std::to_string(source.size()) + ":" + source;
+    }
+    return key;
+}
+
+std::string ProgramCache::path(uint64_t hash) const {
+    std::ostringstream name;
+    name << directory_ << "/program-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return name.str();
+}
+
+void ProgramCache::prepare(GLuint program) const {
+    if (supported_) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+GLuint ProgramCache::load(const std::vector<std::string> &sources) const {
+    if (!supported_) {
+        return 0;
+    }
+
+    std::string programKey = key(sources);
+    uint64_t hash = hashBytes(programKey);
+    std::ifstream file(path(hash), std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+
+    BinaryHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))
+            || header.magic != BINARY_MAGIC || header.hash != hash || header.length == 0) {
+        aout << "Ignoring malformed program binary " << path(hash) << std::endl;
+        return 0;
+    }
+
+    // Another program with the same hash, it is replaced once this one is linked
+    if (header.keyLength != programKey.size()) {
+        return 0;
+    }
+    std::string storedKey(header.keyLength, '\0');
+    if (!file.read(&storedKey[0], storedKey.size()) || storedKey != programKey) {
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size())) {
+        aout << "Ignoring truncated program binary " << path(hash) << std::endl;
+        return 0;
+    }
+
+    // The driver may still refuse the binary, e.g. after an update that kept the version string
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        aout << "Cached program binary rejected, compiling from source" << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    aout << "Loaded program " << program << " from the binary cache" << std::endl;
+    return program;
+}
+
+void ProgramCache::store(GLuint program, const std::vector<std::string> &sources) const {
+    if (!supported_ || !program) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    if (length <= 0) {
+        return;
+    }
+
+    std::string programKey = key(sources);
+    uint64_t hash = hashBytes(programKey);
+    BinaryHeader header = {BINARY_MAGIC, format, static_cast<uint32_t>(length),
+                           static_cast<uint32_t>(programKey.size()), hash};
+
+    // Write to a temporary file first so a crash can't leave a half-written entry behind
+    std::string finalPath = path(hash);
+    std::string tempPath = finalPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char *>(&header), sizeof(header))
+                || !file.write(programKey.data(), static_cast<std::streamsize>(programKey.size()))
+                || !file.write(binary.data(), length)) {
+            aout << "Failed to write program binary " << tempPath << std::endl;
+            return;
+        }
+    }
+    if (std::rename(tempPath.c_str(), finalPath.c_str()) != 0) {
+        aout << "Failed to move program binary into place: " << strerror(errno) << std::endl;
+        std::remove(tempPath.c_str());
+        return;
+    }
+    aout << "Stored " << length / 1024 << " KiB program binary " << finalPath << std::endl;
+}
@@ -0,0 +1,56 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PROGRAMCACHE_H
+#define ANDROIDGLINVESTIGATIONS_PROGRAMCACHE_H
+
+#include <GLES3/gl31.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct GameActivity;
+
+/*!
+ * Stores linked program binaries on disk so later launches can skip compiling and linking.
+ *
+ * Entries are keyed by the final shader sources (defines included) together with GL_RENDERER and
+ * GL_VERSION, so a driver update or a shader change simply misses. Files are named by a hash of
+ * the key and store the key itself, a hash collision is a miss too. Anything that fails to load is
+ * treated as a miss and the caller compiles from source.
+ */
+class ProgramCache {
+public:
+    /*!
+     * @param directory where binaries are kept, usually cacheDirectory()
+     */
+    explicit ProgramCache(std::string directory);
+
+    //! The activity's cache dir, from Context.getCacheDir(). Empty if it can't be queried.
+    static std::string cacheDirectory(GameActivity *activity);
+
+    //! False if the driver exposes no binary formats, load() and store() then do nothing
+    bool isSupported() const { return supported_; }
+
+    /*!
+     * Creates a program from the cached binary for @a sources
+     * @return the linked program, or 0 on a miss
+     */
+    GLuint load(const std::vector<std::string>& sources) const;
+
+    //! Saves the binary of a freshly linked @a program built from @a sources
+    void store(GLuint program, const std::vector<std::string>& sources) const;
+
+    /*!
+     * Hints the driver to keep the binary of @a program retrievable, call before linking it
+     */
+    void prepare(GLuint program) const;
+
+private:
+    //! The device id and the sources, each prefixed with its length so they can't run together
+    std::string key(const std::vector<std::string>& sources) const;
+    std::string path(uint64_t hash) const;
+
+    std::string directory_;
+    std::string deviceId_;  // GL_RENDERER and GL_VERSION, part of every key
+    bool supported_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PROGRAMCACHE_H
@@ -0,0 +1,169 @@
+#include "QualityGovernor.h"
+
+#include <android/performance_hint.h>
+#include <android/thermal.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+// How often the thermal state is read, the headroom may not be asked more often than this
+static constexpr auto POLL_INTERVAL = std::chrono::seconds(1);
+
+// Seconds ahead the headroom is forecast, enough to step down before the throttling starts
+static constexpr int HEADROOM_FORECAST_SECONDS = 10;
+
+// Forecast headroom over HOT_HEADROOM steps down, under COOL_HEADROOM counts as cool. The gap
+// between them keeps a tier from flipping back and forth at the edge.
+static constexpr float HOT_HEADROOM = 0.85f;
+static constexpr float COOL_HEADROOM = 0.65f;
+
+// A step down shows in the temperature only after a while, and a step up is only taken after
+// being cool for long enough that it will likely stay
+static constexpr auto STEP_DOWN_INTERVAL = std::chrono::seconds(10);
+static constexpr auto STEP_UP_DELAY = std::chrono::seconds(30);
+
+QualityGovernor::QualityGovernor(float framePeriodMillis) :
+        thermal_(AThermal_acquireManager()),
+        getHeadroom_(reinterpret_cast<GetHeadroom>(dlsym(RTLD_DEFAULT, "AThermal_getThermalHeadroom"))),
+        session_(nullptr),
+        updateTarget_(reinterpret_cast<UpdateTarget>(
+                dlsym(RTLD_DEFAULT, "APerformanceHint_updateTargetWorkDuration"))),
+        reportWork_(reinterpret_cast<ReportWork>(
+                dlsym(RTLD_DEFAULT, "APerformanceHint_reportActualWorkDuration"))),
+        closeSession_(reinterpret_cast<CloseSession>(dlsym(RTLD_DEFAULT, "APerformanceHint_closeSession"))),
+        enabled_(true),
+        available_{true, true, true, true, true},
+        tier_(Tier::Full),
+        headroom_(-1.0f),
+        status_(ATHERMAL_STATUS_NONE),
+        cool_(true) {
+    lastPoll_ = std::chrono::steady_clock::now() - POLL_INTERVAL;
+    lastChange_ = lastPoll_;
+    coolSince_ = lastPoll_;
+
+    auto getManager = reinterpret_cast<GetHintManager>(dlsym(RTLD_DEFAULT, "APerformanceHint_getManager"));
+    auto createSession = reinterpret_cast<CreateSession>(dlsym(RTLD_DEFAULT, "APerformanceHint_createSession"));
+    APerformanceHintManager *manager = getManager ? getManager() : nullptr;
+    if (manager && createSession && updateTarget_ && reportWork_ && closeSession_) {
+        int32_t thread = gettid();
+        session_ = createSession(manager, &thread, 1,
+                                 static_cast<int64_t>(framePeriodMillis * 1.0e6f));
+    }
+    aout << "Quality governor: thermal " << (thermal_ ? (getHeadroom_ ? "status and headroom" : "status only")
+                                                    : "unavailable")
+         << ", performance hints " << (session_ ? "on" : "unavailable") << std::endl;
+}
+
+QualityGovernor::~QualityGovernor() {
+    if (session_) {
+        closeSession_(session_);
+    }
+    if (thermal_) {
+        AThermal_releaseManager(thermal_);
+    }
+}
+
+void QualityGovernor::setFramePeriod(float millis) {
+    if (session_) {
+        updateTarget_(session_, static_cast<int64_t>(millis * 1.0e6f));
+    }
+}
+
+void QualityGovernor::setEnabled(bool enabled) {
+    enabled_ = enabled;
+    if (!enabled_) {
+        tier_ = Tier::Full;
+    }
+}
+
+void QualityGovernor::setTierAvailable(Tier tier, bool available) {
+    // Full is where every other tier falls back to, it's always there
+    if (tier != Tier::Full) {
+        available_[static_cast<int>(tier)] = available;
+    }
+    if (!available && tier_ == tier) {
+        tier_ = nearestTier(tier, -1);
+    }
+}
+
+QualityGovernor::Tier QualityGovernor::nearestTier(Tier tier, int step) const {
+    while (tier != Tier::Full && !available_[static_cast<int>(tier)]) {
+        int next = static_cast<int>(tier) + step;
+        if (next >= static_cast<int>(Tier::Count)) {
+            return tier_;
+        }
+        tier = static_cast<Tier>(next);
+    }
+    return tier;
+}
+
+bool QualityGovernor::endFrame(std::chrono::nanoseconds work) {
+    if (session_ && work.count() > 0) {
+        reportWork_(session_, work.count());
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!thermal_ || now - lastPoll_ < POLL_INTERVAL) {
+        return false;
+    }
+    lastPoll_ = now;
+    poll();
+    if (!enabled_) {
+        return false;
+    }
+
+    // Moderate is where the platform starts throttling, light is still fine
+    bool known = headroom_ >= 0.0f;
+    bool hot = status_ >= ATHERMAL_STATUS_MODERATE || (known && headroom_ > HOT_HEADROOM);
+    bool cool = status_ <= ATHERMAL_STATUS_LIGHT && (!known || headroom_ < COOL_HEADROOM);
+    if (cool && !cool_) {
+        coolSince_ = now;
+    }
+    cool_ = cool;
+
+    Tier tier = tier_;
+    if (hot && tier_ < Tier::SubSteps && now - lastChange_ >= STEP_DOWN_INTERVAL) {
+        tier = nearestTier(static_cast<Tier>(static_cast<int>(tier_) + 1), 1);
+    } else if (cool && tier_ > Tier::Full && now - coolSince_ >= STEP_UP_DELAY
+               && now - lastChange_ >= STEP_UP_DELAY) {
+        tier = nearestTier(static_cast<Tier>(static_cast<int>(tier_) - 1), -1);
+    }
+    if (tier == tier_) {
+        return false;
+    }
+    aout << "Quality tier: " << tierName(tier_) << " -> " << tierName(tier) << " (thermal status "
+         << status_ << ", headroom " << headroom_ << ")" << std::endl;
+    tier_ = tier;
+    lastChange_ = now;
+    return true;
+}
+
+void QualityGovernor::poll() {
+    status_ = AThermal_getCurrentThermalStatus(thermal_);
+    if (getHeadroom_) {
+        // NaN when asked too often or before the thermal service has samples. Not std::isnan,
+        // -ffast-math folds that to false.
+        float headroom = getHeadroom_(thermal_, HEADROOM_FORECAST_SECONDS);
+        headroom_ = Utility::isFinite(headroom) ? headroom : -1.0f;
+    }
+}
+
+const char *QualityGovernor::tierName(Tier tier) {
+    switch (tier) {
+        case Tier::Full:
+            return "full";
+        case Tier::Particles:
+            return "particles";
+        case Tier::RenderScale:
+            return "render scale";
+        case Tier::StepRate:
+            return "step rate";
+        case Tier::SubSteps:
+            return "sub-steps";
+        case Tier::Count:
+            break;
+    }
+    return "unknown";
+}
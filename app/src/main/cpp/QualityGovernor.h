@@ -0,0 +1,110 @@
+#ifndef ANDROIDGLINVESTIGATIONS_QUALITYGOVERNOR_H
+#define ANDROIDGLINVESTIGATIONS_QUALITYGOVERNOR_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+struct AThermalManager;
+struct APerformanceHintManager;
+struct APerformanceHintSession;
+
+/*!
+ * Trades quality for heat before the device throttles. The thermal status and the forecast
+ * headroom are polled once a second; while the device heats up the governor steps down through
+ * its tiers one at a time, and only steps back up once it has been cool for a while. Steps down are
+ * spaced out too, a tier takes some seconds to show in the temperature. Sustained sessions settle
+ * on a tier instead of sawtoothing between full quality and throttled clocks.
+ *
+ * The render thread's work per frame goes to an ADPF hint session with the frame period as the
+ * target, so the CPU clocks follow what a frame actually needs.
+ *
+ * The headroom and the hint session are looked up at runtime, they need API 31 and 33. Without
+ * headroom the status alone drives the tiers, without a hint session nothing is reported.
+ */
+class QualityGovernor {
+public:
+    //! What is given up, in order. Each tier keeps the cuts of the ones before.
+    enum class Tier {
+        Full,
+        Particles,    // The particle budget is capped at PARTICLE_SCALE of its maximum
+        RenderScale,  // The scene is drawn at RENDER_SCALE of the configured render scale
+        StepRate,     // The simulation steps at STEP_RATE_SCALE of the configured rate
+        SubSteps,     // One step per frame at most, a slow frame slows the simulation down
+        Count
+    };
+
+    static constexpr float PARTICLE_SCALE = 0.7f;
+    static constexpr float RENDER_SCALE = 0.75f;
+    static constexpr float STEP_RATE_SCALE = 0.5f;
+
+    //! Opens the hint session for the calling thread, which should be the render thread
+    explicit QualityGovernor(float framePeriodMillis);
+    ~QualityGovernor();
+
+    QualityGovernor(const QualityGovernor&) = delete;
+    QualityGovernor& operator=(const QualityGovernor&) = delete;
+
+    //! The frame period the hint session aims for, follows the refresh rate
+    void setFramePeriod(float millis);
+
+    //! Disabled, the tier goes back to Full and stays there. Work is still reported.
+    void setEnabled(bool enabled);
+
+    //! Tiers whose cut can't be applied, such as RenderScale on a backend without one, are skipped
+    void setTierAvailable(Tier tier, bool available);
+
+    /*!
+     * Reports the render thread's work of one frame and polls the thermal state when it is due
+     * @return true if the tier changed
+     */
+    bool endFrame(std::chrono::nanoseconds work);
+
+    Tier tier() const { return tier_; }
+
+    //! Forecast thermal headroom, 1 is where the device throttles hard. Negative if unknown.
+    float headroom() const { return headroom_; }
+
+    float particleScale() const { return tier_ >= Tier::Particles ? PARTICLE_SCALE : 1.0f; }
+    float renderScale() const { return tier_ >= Tier::RenderScale ? RENDER_SCALE : 1.0f; }
+    float stepRateScale() const { return tier_ >= Tier::StepRate ? STEP_RATE_SCALE : 1.0f; }
+
+    //! The most steps a frame may take, @a nominal until the SubSteps tier
+    int maxSteps(int nominal) const { return tier_ >= Tier::SubSteps ? 1 : nominal; }
+
+    static const char *tierName(Tier tier);
+
+private:
+    //! Reads the thermal state into headroom_ and status_
+    void poll();
+
+    //! The first available tier from @a tier on, @a step -1 looks down and 1 looks up
+    Tier nearestTier(Tier tier, int step) const;
+
+    using GetHeadroom = float (*)(AThermalManager *, int);
+    using GetHintManager = APerformanceHintManager *(*)();
+    using CreateSession = APerformanceHintSession *(*)(APerformanceHintManager *, const int32_t *, size_t,
+                                                       int64_t);
+    using UpdateTarget = int (*)(APerformanceHintSession *, int64_t);
+    using ReportWork = int (*)(APerformanceHintSession *, int64_t);
+    using CloseSession = void (*)(APerformanceHintSession *);
+
+    AThermalManager *thermal_;
+    GetHeadroom getHeadroom_;
+    APerformanceHintSession *session_;  // Null without ADPF
+    UpdateTarget updateTarget_;
+    ReportWork reportWork_;
+    CloseSession closeSession_;
+
+    bool enabled_;
+    bool available_[static_cast<int>(Tier::Count)];
+    Tier tier_;
+    float headroom_;
+    int status_;  // An AThermalStatus
+    std::chrono::steady_clock::time_point lastPoll_;
+    std::chrono::steady_clock::time_point lastChange_;
+    std::chrono::steady_clock::time_point coolSince_;  // Of the current cool streak
+    bool cool_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_QUALITYGOVERNOR_H
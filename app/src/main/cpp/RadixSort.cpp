@@ -0,0 +1,87 @@
+#include "RadixSort.h"
+
+#include <stdexcept>
+
+#include "ShaderLibrary.h"
+#include "SimParams.h"
+
+// Keys per workgroup of the histogram and scatter kernels
+static constexpr int GROUP_SIZE = 256;
+
+RadixSort::RadixSort(ShaderLibrary *shaders, int capacity) :
+        histogramShader_(nullptr),
+        scanShader_(nullptr),
+        scatterShader_(nullptr),
+        pairs_{},
+        histograms_(0) {
+    auto load = [&](const char *path) {
+        auto *shader = shaders->compute(path);
+        if (!shader) {
+            throw std::runtime_error(std::string("Failed to create ") + path);
+        }
+        return shader;
+    };
+    histogramShader_ = load("shaders/radix_histogram.comp");
+    scanShader_ = load("shaders/radix_scan.comp");
+    scatterShader_ = load("shaders/radix_scatter.comp");
+
+    GLsizeiptr groups = (capacity + GROUP_SIZE - 1) / GROUP_SIZE;
+    glGenBuffers(2, pairs_);
+    for (GLuint buffer : pairs_) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(capacity) * 2 * sizeof(GLuint),
+                     nullptr, GL_DYNAMIC_COPY);
+    }
+    glGenBuffers(1, &histograms_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, histograms_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, groups * (1 << RADIX_BITS) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+RadixSort::~RadixSort() {
+    glDeleteBuffers(2, pairs_);
+    glDeleteBuffers(1, &histograms_);
+}
+
+void RadixSort::bindPairs(GLuint binding) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, pairs_[0]);
+}
+
+void RadixSort::setPass(const Shader &shader, GLuint count, GLuint shift, GLuint entries) {
+    // Uniforms a kernel doesn't use are -1, which GL ignores
+    glUniform1ui(shader.uniformLocation("uCount"), count);
+    glUniform1ui(shader.uniformLocation("uShift"), shift);
+    glUniform1ui(shader.uniformLocation("uEntries"), entries);
+}
+
+void RadixSort::sort(int count, int keyBits) {
+    if (count <= 0) return;
+    GLuint groups = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+    GLuint entries = groups << RADIX_BITS;
+    int passes = (keyBits + RADIX_BITS - 1) / RADIX_BITS;
+    passes += passes % 2;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_HISTOGRAM_BINDING, histograms_);
+    for (int pass = 0; pass < passes; pass++) {
+        GLuint shift = pass * RADIX_BITS;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_INPUT_BINDING, pairs_[pass % 2]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RADIX_OUTPUT_BINDING, pairs_[1 - pass % 2]);
+
+        histogramShader_->activate();
+        setPass(*histogramShader_, count, shift, entries);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // One workgroup scans all histograms
+        scanShader_->activate();
+        setPass(*scanShader_, count, shift, entries);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        scatterShader_->activate();
+        setPass(*scatterShader_, count, shift, entries);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    scatterShader_->deactivate();
+}
@@ -0,0 +1,63 @@
+#ifndef ANDROIDGLINVESTIGATIONS_RADIXSORT_H
+#define ANDROIDGLINVESTIGATIONS_RADIXSORT_H
+
+#include <GLES3/gl31.h>
+#include <memory>
+#include "Shader.h"
+
+class ShaderLibrary;
+
+/*!
+ * Stable GPU radix sort of uint key/value pairs on GL, RADIX_BITS of the key per pass. Every pass
+ * is three kernels, each binding at most three storage blocks:
+ *
+ *  - radix_histogram.comp counts the digits of every workgroup of 256 pairs,
+ *  - radix_scan.comp turns the counts into the first output slot per digit and workgroup,
+ *  - radix_scatter.comp ranks every pair within its workgroup and moves it there.
+ *
+ * Passes ping-pong between pairs() and a second buffer, and the pass count is rounded up to an
+ * even number, so the result always ends up back in pairs(). A pass over bits no key has just
+ * copies the pairs in order.
+ *
+ * The caller fills pairs() with a kernel of its own, particle_order.comp is one, and binds it
+ * with bindPairs() afterwards to read the sorted values.
+ */
+class RadixSort {
+public:
+    //! Key bits per pass, must match RADIX in the radix kernels
+    static constexpr int RADIX_BITS = 4;
+
+    /*!
+     * Gets the kernels from @a shaders and allocates the buffers for up to @a capacity pairs, throws
+     * std::runtime_error on failure
+     */
+    RadixSort(ShaderLibrary *shaders, int capacity);
+    ~RadixSort();
+
+    RadixSort(const RadixSort&) = delete;
+    RadixSort& operator=(const RadixSort&) = delete;
+
+    /*!
+     * Sorts the first @a count pairs by the low @a keyBits of their keys. Expects the writes to
+     * pairs() to be visible already and ends with the barrier its readers need.
+     */
+    void sort(int count, int keyBits);
+
+    //! A uvec2 per pair, key in x and value in y
+    GLuint pairs() const { return pairs_[0]; }
+
+    //! Binds pairs() as storage buffer @a binding
+    void bindPairs(GLuint binding) const;
+
+private:
+    //! Sets the per pass uniforms of the active @a shader
+    static void setPass(const Shader &shader, GLuint count, GLuint shift, GLuint entries);
+
+    Shader *histogramShader_;  // Owned by the ShaderLibrary, like the other two
+    Shader *scanShader_;
+    Shader *scatterShader_;
+    GLuint pairs_[2];
+    GLuint histograms_;   // RADIX entries per workgroup
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_RADIXSORT_H
@@ -0,0 +1,118 @@
+#include "Recorder.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+
+#include "AndroidOut.h"
+
+Recorder::Recorder(const std::string &path, uint32_t backend, uint32_t layout, int capacity,
+                   int snapshotInterval) :
+        path_(path),
+        // The fastest level, most of a frame record is the same as the one before
+        file_(gzopen(path.c_str(), "wb1")),
+        snapshotInterval_(snapshotInterval),
+        frame_{},
+        nextSnapshot_(0),
+        snapshotFrame_(-1),
+        written_(0),
+        quit_(false) {
+    if (!file_) {
+        throw std::runtime_error("Can't create recording " + path);
+    }
+    RecordingHeader header = {RECORDING_MAGIC, RECORDING_VERSION, backend, layout,
+                              static_cast<uint32_t>(capacity), {}};
+    gzwrite(file_, &header, sizeof(header));
+    thread_ = std::thread(&Recorder::run, this);
+    aout << "Recording to " << path << ", a snapshot every " << snapshotInterval << " frames" << std::endl;
+}
+
+Recorder::~Recorder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    gzclose(file_);
+    aout << "Recorded " << frame_.frame << " frames, " << written_ / 1024 << " KiB before compression"
+         << std::endl;
+}
+
+void Recorder::addReset(const InitParams &params) {
+    queue(RecordingChunkType::Reset, &params, sizeof(params));
+}
+
+void Recorder::beginFrame(const SimParams &params, float drawRewind) {
+    frame_.drawRewind = drawRewind;
+    frame_.params = params;
+}
+
+void Recorder::latch(const SimParams &params) {
+    frame_.params.attractorCount = params.attractorCount;
+    std::memcpy(frame_.params.attractors, params.attractors, sizeof(params.attractors));
+}
+
+void Recorder::endFrame() {
+    queue(RecordingChunkType::Frame, &frame_, sizeof(frame_));
+    frame_.frame++;
+}
+
+bool Recorder::snapshotDue() const {
+    return snapshotInterval_ > 0 && snapshotFrame_ < 0 && frame_.frame >= nextSnapshot_;
+}
+
+void Recorder::snapshotStarted() {
+    snapshotFrame_ = frame_.frame;
+    nextSnapshot_ = frame_.frame + snapshotInterval_;
+}
+
+void Recorder::disableSnapshots() {
+    aout << "The backend can't capture its state here, recording frames only" << std::endl;
+    snapshotInterval_ = 0;
+}
+
+void Recorder::addSnapshot(std::vector<uint8_t> &&blob) {
+    if (snapshotFrame_ < 0) {
+        return;
+    }
+    auto frame = static_cast<uint32_t>(snapshotFrame_);
+    queue(RecordingChunkType::Snapshot, &frame, sizeof(frame), std::move(blob));
+    snapshotFrame_ = -1;
+}
+
+void Recorder::queue(RecordingChunkType type, const void *data, size_t size, std::vector<uint8_t> &&tail) {
+    // The chunk header and the small part are copied, a snapshot's state goes in as its own entry
+    RecordingChunk chunk = {static_cast<uint32_t>(type), static_cast<uint32_t>(size + tail.size())};
+    std::vector<uint8_t> bytes(sizeof(chunk) + size);
+    std::memcpy(bytes.data(), &chunk, sizeof(chunk));
+    std::memcpy(bytes.data() + sizeof(chunk), data, size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(bytes));
+        if (!tail.empty()) {
+            pending_.push_back(std::move(tail));
+        }
+    }
+    wake_.notify_one();
+}
+
+void Recorder::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return quit_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            return;
+        }
+
+        // Compression can take a while for a snapshot, the render thread keeps queueing meanwhile
+        auto bytes = std::move(pending_.front());
+        pending_.pop_front();
+        lock.unlock();
+        if (gzwrite(file_, bytes.data(), static_cast<unsigned>(bytes.size())) != static_cast<int>(bytes.size())) {
+            LOG_EVERY_MS(LogLevel::Error, 1000, "Failed to write to " << path_);
+        }
+        written_ += bytes.size();
+        lock.lock();
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef ANDROIDGLINVESTIGATIONS_RECORDER_H
+#define ANDROIDGLINVESTIGATIONS_RECORDER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SimParams.h"
+
+struct gzFile_s;
+
+/*!
+ * Layout of a recording, a gzip stream of a RecordingHeader and then chunks: a RecordingChunk
+ * followed by its payload
+ */
+static constexpr uint32_t RECORDING_MAGIC = 0x43455250;  // "PREC"
+static constexpr uint32_t RECORDING_VERSION = 1;
+
+struct RecordingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t backend;   // A RenderBackend::Type
+    uint32_t layout;    // A ParticleLayout, of the snapshots
+    uint32_t capacity;  // Particles the state buffers hold
+    uint32_t padding[3];
+};
+
+enum class RecordingChunkType : uint32_t {
+    Reset = 1,     // InitParams
+    Frame = 2,     // RecordedFrame
+    Snapshot = 3,  // uint32_t frame, then a ParticleState snapshot blob
+};
+
+struct RecordingChunk {
+    uint32_t type;  // A RecordingChunkType
+    uint32_t size;  // Bytes of payload that follow
+};
+
+//! What one frame passed to the simulation, the attractors as the backend latched them
+struct RecordedFrame {
+    uint32_t frame;
+    float drawRewind;  // RenderBackend::draw() rewind
+    uint32_t padding[2];
+    SimParams params;  // The active count is params.particleCount
+};
+
+/*!
+ * Writes what the simulation is fed to a file as it runs: the reset, every frame's SimParams and
+ * draw rewind, and every so often a snapshot of the whole state, so a Replay can step the same
+ * frames again from the start or from a snapshot. Chunks are compressed and written on a thread
+ * of its own, the render thread only queues them.
+ *
+ * A snapshot is taken before the step of the frame it is recorded for, it is what that frame's
+ * step read.
+ */
+class Recorder {
+public:
+    /*!
+     * Starts a new recording at @a path, throws std::runtime_error if it can't be created
+     * @param snapshotInterval frames between snapshots, 0 for none
+     */
+    Recorder(const std::string &path, uint32_t backend, uint32_t layout, int capacity,
+             int snapshotInterval);
+
+    //! Writes out what is still queued and closes the file
+    ~Recorder();
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    void addReset(const InitParams &params);
+
+    //! Starts the record of this frame with the parameters as passed to the simulation
+    void beginFrame(const SimParams &params, float drawRewind);
+
+    //! Takes the attractors the backend latched into this frame's record
+    void latch(const SimParams &params);
+
+    //! Queues this frame's record, the next one starts
+    void endFrame();
+
+    //! True if this frame should capture the state, and no capture is in flight
+    bool snapshotDue() const;
+
+    //! The backend started a capture of the state this frame's step reads
+    void snapshotStarted();
+
+    //! The backend couldn't capture its state, the recording goes on with frames only
+    void disableSnapshots();
+
+    //! The capture started by snapshotStarted() finished with @a blob, which is queued as it is
+    void addSnapshot(std::vector<uint8_t> &&blob);
+
+private:
+    //! Queues a chunk of @a size bytes at @a data, then @a tail, moved in without a copy
+    void queue(RecordingChunkType type, const void *data, size_t size, std::vector<uint8_t> &&tail = {});
+    void run();
+
+    std::string path_;
+    gzFile_s *file_;
+    int snapshotInterval_;
+    RecordedFrame frame_;
+    uint32_t nextSnapshot_;
+    int64_t snapshotFrame_;  // Frame of the capture in flight, -1 for none
+
+    // Chunks for the writer thread
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::vector<uint8_t>> pending_;
+    uint64_t written_;  // Uncompressed bytes, writer thread only
+    bool quit_;
+    std::thread thread_;  // Last, it starts once everything else is set up
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_RECORDER_H
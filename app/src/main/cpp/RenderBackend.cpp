@@ -0,0 +1,89 @@
+#include "RenderBackend.h"
+
+#include <stdexcept>
+
+#include "AndroidOut.h"
+#include "GlBackend.h"
+#include "Utility.h"
+#include "VulkanBackend.h"
+
+RenderBackend *RenderBackend::create(android_app *app, FramePacer *pacer) {
+    auto requested = Utility::getSystemProperty("debug.particles.backend", "auto");
+    Type preferred;
+    if (requested == "gl") {
+        preferred = Type::GL;
+    } else if (requested == "vulkan") {
+        preferred = Type::Vulkan;
+    } else {
+        if (requested != "auto") {
+            aout << "Unknown backend " << requested << ", choosing one for this device" << std::endl;
+        }
+        preferred = VulkanBackend::isSupported() ? Type::Vulkan : Type::GL;
+    }
+
+    Type candidates[] = {preferred, preferred == Type::GL ? Type::Vulkan : Type::GL};
+    for (auto type : candidates) {
+        try {
+            aout << "Creating " << typeName(type) << " backend" << std::endl;
+            if (type == Type::Vulkan) {
+                return new VulkanBackend(app, pacer);
+            }
+            return new GlBackend(app, pacer);
+        } catch (const std::exception& e) {
+            aout << typeName(type) << " backend failed: " << e.what() << std::endl;
+        }
+    }
+    throw std::runtime_error("No render backend works on this device");
+}
+
+DrawMode RenderBackend::parseDrawMode(const std::string &name, DrawMode fallback) {
+    for (auto mode : {DrawMode::Sprites, DrawMode::Density, DrawMode::Lod, DrawMode::Trails}) {
+        if (name == drawModeName(mode)) {
+            return mode;
+        }
+    }
+    return fallback;
+}
+
+const char *RenderBackend::drawModeName(DrawMode mode) {
+    switch (mode) {
+        case DrawMode::Sprites:
+            return "sprites";
+        case DrawMode::Density:
+            return "density";
+        case DrawMode::Lod:
+            return "lod";
+        case DrawMode::Trails:
+            return "trails";
+    }
+    return "unknown";
+}
+
+Interaction RenderBackend::parseInteraction(const std::string &name, Interaction fallback) {
+    for (auto interaction : {Interaction::None, Interaction::Fluid}) {
+        if (name == interactionName(interaction)) {
+            return interaction;
+        }
+    }
+    return fallback;
+}
+
+const char *RenderBackend::interactionName(Interaction interaction) {
+    switch (interaction) {
+        case Interaction::None:
+            return "none";
+        case Interaction::Fluid:
+            return "fluid";
+    }
+    return "unknown";
+}
+
+const char *RenderBackend::typeName(Type type) {
+    switch (type) {
+        case Type::GL:
+            return "gl";
+        case Type::Vulkan:
+            return "vulkan";
+    }
+    return "unknown";
+}
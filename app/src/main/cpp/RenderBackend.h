@@ -0,0 +1,258 @@
+#ifndef ANDROIDGLINVESTIGATIONS_RENDERBACKEND_H
+#define ANDROIDGLINVESTIGATIONS_RENDERBACKEND_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Profiler.h"
+#include "SimParams.h"
+
+struct android_app;
+struct ANativeWindow;
+class FramePacer;
+enum class ParticleLayout;
+
+//! How the particles get on screen
+enum class DrawMode {
+    Sprites,  // A blended point sprite per particle
+    Density,  // Particles counted per grid cell in a compute pass, one fullscreen pass colors the cells
+    Lod,      // Dense cells of a coarse grid drawn as one splat each, sprites only where it is sparse
+    Trails    // Sprites stretched along their motion into a texture that fades a little every frame
+};
+
+//! Forces between particles, on top of the attractors
+enum class Interaction {
+    None,   // Particles only feel the attractors
+    Fluid   // Pressure and viscosity between neighbours, through the neighbour grid passes
+};
+
+//! Sprite size in surface pixels before setPointSize(), as Config::pointSize
+static constexpr float DEFAULT_POINT_SIZE = 14.0f;
+
+//! Compile time parameters of the step kernel
+struct StepKernel {
+    int localSize;               // Workgroup size
+    int particlesPerInvocation;  // Strided by the workgroup size, see particle.comp
+
+    //! Particles one workgroup steps
+    int groupParticles() const { return localSize * particlesPerInvocation; }
+
+    bool operator==(const StepKernel &other) const {
+        return localSize == other.localSize && particlesPerInvocation == other.particlesPerInvocation;
+    }
+    bool operator!=(const StepKernel &other) const { return !(*this == other); }
+};
+
+/*!
+ * The graphics API side of the particle system: it owns the surface, the particle state buffers
+ * and the kernels, and runs one frame as simulate(), draw(), drawOverlay() and present().
+ * Renderer only drives the simulation and never makes API calls itself.
+ *
+ * Backends throw std::runtime_error when they can't initialize; afterwards errors are logged and
+ * the frame goes on.
+ */
+class RenderBackend {
+public:
+    enum class Type {
+        GL,
+        Vulkan
+    };
+
+    /*!
+     * Creates the backend named by debug.particles.backend ("gl" or "vulkan"). With "auto", or when
+     * the property is not set, Vulkan is used if the device has a Vulkan 1.1 GPU with a queue that
+     * does graphics, compute and present, GL otherwise. If the chosen backend fails to initialize the
+     * other one is tried.
+     * @return a new backend, owned by the caller
+     */
+    static RenderBackend *create(android_app *app, FramePacer *pacer);
+
+    static const char *typeName(Type type);
+
+    //! Parses debug.particles.draw values, "sprites", "density", "lod" or "trails"; anything else gives @a fallback
+    static DrawMode parseDrawMode(const std::string &name, DrawMode fallback);
+    static const char *drawModeName(DrawMode mode);
+
+    //! Parses debug.particles.interaction values, "none" or "fluid"; anything else gives @a fallback
+    static Interaction parseInteraction(const std::string &name, Interaction fallback);
+    static const char *interactionName(Interaction interaction);
+
+    virtual ~RenderBackend() = default;
+
+    virtual Type type() const = 0;
+
+    //! Device and API version strings, for logs and benchmark reports
+    virtual std::string deviceName() const = 0;
+    virtual std::string apiVersion() const = 0;
+
+    //! Largest capacity a single state buffer can hold in @a layout
+    virtual int maxCapacity(ParticleLayout layout) const = 0;
+
+    //! Largest workgroup size the step kernel can be built with, 0 if the CPU simulates
+    virtual int maxLocalSize() const = 0;
+
+    /*!
+     * Builds the kernels and the draw pipeline for @a layout and allocates uninitialized state for
+     * @a capacity particles. Called once, throws on failure.
+     * @param drawMode falls back to sprites if the device can't draw in that mode, see drawMode()
+     * @param interaction falls back to none if the device can't run it, see interaction()
+     * @param reorder builds the Morton sort and the step that gathers through it, off if the
+     *        device can't run them, see reorders()
+     * @param lifetimes gives particles lifetimes and emitters, see hasLifetimes(). Only with
+     *        sprites or trails (GL) and no interaction, and reordering is off with them.
+     */
+    virtual void initParticles(ParticleLayout layout, int capacity, const StepKernel &kernel,
+                               DrawMode drawMode, Interaction interaction, bool reorder,
+                               bool lifetimes) = 0;
+
+    //! The mode draw() uses, set by initParticles()
+    virtual DrawMode drawMode() const = 0;
+
+    //! The forces simulate() adds between particles, set by initParticles()
+    virtual Interaction interaction() const = 0;
+
+    //! True if simulate() sorts the particles when SimParams::reorder is set, see initParticles()
+    virtual bool reorders() const = 0;
+
+    /*!
+     * True if particles die after SimParams::lifetime and SimParams::emitters add new ones, see
+     * initParticles(). How many are alive is only known on the GPU then.
+     */
+    virtual bool hasLifetimes() const = 0;
+
+    //! Rebuilds the step kernel with other parameters, a no-op if they didn't change
+    virtual void setStepKernel(const StepKernel &kernel) = 0;
+
+    /*!
+     * Runs particle_init.comp over the first params.particleCount particles of the state. With
+     * lifetimes the first params.aliveCount are alive afterwards.
+     */
+    virtual void resetParticles(const InitParams &params) = 0;
+
+    /*!
+     * Starts reading back the first @a count particles of the state the next simulate() steps
+     * from, for collectSnapshot(). The copy runs behind the frame, nothing waits for it.
+     * @return false if the backend can't capture its state, or the last capture is still pending
+     */
+    virtual bool requestSnapshot(int count) = 0;
+
+    /*!
+     * The state of the last requestSnapshot() once it has been read back, a blob for
+     * restoreSnapshot(). Doesn't wait.
+     * @return true if it was ready
+     */
+    virtual bool collectSnapshot(std::vector<uint8_t> *outBlob) = 0;
+
+    /*!
+     * Replaces the state the next simulate() steps from with a blob of collectSnapshot() taken from
+     * a backend of the same layout and capacity
+     * @return the particles restored, 0 if the blob doesn't fit
+     */
+    virtual int restoreSnapshot(const std::vector<uint8_t> &blob) = 0;
+
+    //! False between onSurfaceDestroyed() and onSurfaceCreated(), nothing can be rendered then
+    virtual bool hasSurface() const = 0;
+
+    /*!
+     * Releases the window surface, everything else stays alive
+     * @param activeParticles how much of the state is worth saving in case it doesn't survive
+     */
+    virtual void onSurfaceDestroyed(int activeParticles) = 0;
+
+    //! Attaches to the app's new window
+    virtual void onSurfaceCreated(ANativeWindow *window) = 0;
+
+    //! True if collectGpuTimes() reports anything
+    virtual bool hasGpuTiming() const = 0;
+
+    /*!
+     * Reads back the GPU time of the oldest finished frame, if any
+     * @return true if a result was available
+     */
+    virtual bool collectGpuTimes(float *outSimulateMillis, float *outDrawMillis) = 0;
+
+    /*!
+     * Reads back the GPU time of the oldest finished particle sort, if any. Sorts are timed apart
+     * from the step, collectGpuTimes() doesn't include them.
+     * @return true if a result was available
+     */
+    virtual bool collectSortTime(float *outMillis) = 0;
+
+    /*!
+     * Starts a frame on the current surface and clears it
+     * @param outWidth receives the surface width in pixels
+     * @param outHeight receives the surface height in pixels
+     */
+    virtual void beginFrame(int *outWidth, int *outHeight) = 0;
+
+    /*!
+     * Steps the first params.particleCount particles params.stepCount times in one dispatch. The
+     * state is double buffered, the result is what the next frame draws, so this frame's draw
+     * doesn't have to wait for it. With no steps the state is left as is. With an interaction the
+     * neighbour grid is built over the front copy first and its forces are held over the steps.
+     * With params.reorder the front copy is sorted by Morton code before that, and the step
+     * writes the back copy in sorted order. With lifetimes the step is dispatched indirectly over
+     * the live particles of the front copy, packs the survivors into the back copy and
+     * params.emitCount new particles go in behind them, up to params.particleCount.
+     */
+    virtual void simulate(const SimParams &params) = 0;
+
+    //! Fills in SimParams::attractorCount and SimParams::attractors from the newest input
+    using AttractorLatch = std::function<void(SimParams &params)>;
+
+    /*!
+     * Has simulate() take the attractors from @a latch as late as the backend still can: GL right
+     * before the step's parameters are uploaded, after the sort and the neighbour grid, and Vulkan
+     * right before the step is submitted in present(). Without a latch the attractors passed to
+     * simulate() are stepped with.
+     */
+    void setAttractorLatch(AttractorLatch latch) { attractorLatch_ = std::move(latch); }
+
+    /*!
+     * Draws the first @a count particles of the last step's result with a column-major 4x4 @a projection.
+     * With lifetimes the live ones are drawn indirectly instead, @a count is ignored.
+     * @param rewind simulation seconds to move each particle back along its velocity, blends the
+     *        result of the last step with the state before it
+     */
+    virtual void draw(const float *projection, int count, float rewind) = 0;
+
+    //! Draws the profiler HUD over the particles
+    virtual void drawOverlay(const std::vector<Profiler::OverlayRect> &rects) = 0;
+
+    //! Submits the frame and presents it
+    virtual void present() = 0;
+
+    //! Size of the particle sprites in surface pixels, DEFAULT_POINT_SIZE until set
+    virtual void setPointSize(float pixels) = 0;
+
+    /*!
+     * Look of the trails draw mode, ignored by the others
+     * @param decay share of the trails' brightness each frame keeps of the frame before, 0 to 1
+     * @param stretch simulation seconds of motion each sprite is stretched over, the time between
+     *        two frames draws unbroken trails
+     */
+    virtual void setTrails(float decay, float stretch) = 0;
+
+    /*!
+     * Draws the particles at @a scale of the render scale the backend was configured with, at
+     * most 1, for the quality governor. Backends without a render scale ignore it.
+     */
+    virtual void setRenderScale(float scale) = 0;
+
+    //! True if setRenderScale() has an effect
+    virtual bool hasRenderScale() const = 0;
+
+protected:
+    //! Replaces the attractors of @a params with the latch's, if there is one
+    void latchAttractors(SimParams &params) const {
+        if (attractorLatch_) {
+            attractorLatch_(params);
+        }
+    }
+
+private:
+    AttractorLatch attractorLatch_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_RENDERBACKEND_H
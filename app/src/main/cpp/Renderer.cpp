@@ -1,575 +1,684 @@
 #include "Renderer.h"
 
 #include <game-activity/native_app_glue/android_native_app_glue.h>
-#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
 #include <memory>
 #include <vector>
-#include <android/imagedecoder.h>
 #include <chrono>
-#include <sstream>
-#include <iomanip>
-#include <thread>
+#include <random>
 
 #include "AndroidOut.h"
-#include "Shader.h"
 #include "Utility.h"
-#include "TextureAsset.h"
-
-//! executes glGetString and outputs the result to logcat
-#define PRINT_GL_STRING(s) {aout << #s": "<< glGetString(s) << std::endl;}
-
-/*!
- * @brief if glGetString returns a space separated list of elements, prints each one on a new line
- *
- * This works by creating an istringstream of the input c-style string. Then that is used to create
- * a vector -- each element of the vector is a new element in the input string. Finally a foreach
- * loop consumes this and outputs it to logcat using @a aout
- */
-#define PRINT_GL_STRING_AS_LIST(s) { \
-std::istringstream extensionStream((const char *) glGetString(s));\
-std::vector<std::string> extensionList(\
-        std::istream_iterator<std::string>{extensionStream},\
-        std::istream_iterator<std::string>());\
-aout << #s":\n";\
-for (auto& extension: extensionList) {\
-    aout << extension << "\n";\
-}\
-aout << std::endl;\
-}
 
-//! Color for cornflower blue. Can be sent directly to glClearColor
-#define CORNFLOWER_BLUE 100 / 255.f, 149 / 255.f, 237 / 255.f, 1
+// Share of the frame period the particle passes may use on the GPU
+static constexpr float GPU_BUDGET_FRACTION = 0.7f;
 
-// Base number of particles (will be scaled based on refresh rate)
-static constexpr int BASE_PARTICLE_COUNT = 100000;
+// Without GPU timers, frame intervals this much over the period count as a missed frame
+static constexpr float FRAME_INTERVAL_SLACK = 1.2f;
 
-Renderer::~Renderer() {
-    if (display_ != EGL_NO_DISPLAY) {
-        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
-        if (context_ != EGL_NO_CONTEXT) {
-            eglDestroyContext(display_, context_);
-            context_ = EGL_NO_CONTEXT;
-        }
-        if (surface_ != EGL_NO_SURFACE) {
-            eglDestroySurface(display_, surface_);
-            surface_ = EGL_NO_SURFACE;
-        }
-        eglTerminate(display_);
-        display_ = EGL_NO_DISPLAY;
-    }
-}
+// Emitters orbit the center at this radius and angular speed, and spawn along the orbit
+static constexpr int EMITTER_COUNT = 3;
+static constexpr float EMITTER_ORBIT_RADIUS = 6.0f;
+static constexpr float EMITTER_ORBIT_SPEED = 0.5f;  // Radians per second
+static constexpr float EMITTER_SPEED = 3.0f;
+static_assert(EMITTER_COUNT <= MAX_EMITTERS, "too many emitters");
+
+// Recordings go to the app's external files dir, where adb can pull them, or its internal one
+static constexpr const char *RECORDING_FILE = "recording.particles";
+static constexpr int DEFAULT_SNAPSHOT_INTERVAL = 600;
+
+// Members go in reverse order, so the backend outlives everything else
+Renderer::~Renderer() = default;
 
 void Renderer::render() {
-    static float targetFPS = 0.0f;
-    static const auto getRefreshRate = [this]() -> float {
-        if (app_ && app_->activity && app_->activity->vm) {
-            JNIEnv* env;
-            app_->activity->vm->AttachCurrentThread(&env, nullptr);
-            
-            // Get the NativeActivity instance
-            jobject activity = app_->activity->javaGameActivity;
-            
-            // Get the WindowManager service
-            jclass activityClass = env->FindClass("android/app/NativeActivity");
-            jmethodID getWindowManager = env->GetMethodID(activityClass, "getWindowManager", "()Landroid/view/WindowManager;");
-            jobject windowManager = env->CallObjectMethod(activity, getWindowManager);
-            
-            // Get the default display
-            jclass windowManagerClass = env->FindClass("android/view/WindowManager");
-            jmethodID getDefaultDisplay = env->GetMethodID(windowManagerClass, "getDefaultDisplay", "()Landroid/view/Display;");
-            jobject display = env->CallObjectMethod(windowManager, getDefaultDisplay);
-            
-            // Get the refresh rate
-            jclass displayClass = env->FindClass("android/view/Display");
-            jmethodID getRefreshRate = env->GetMethodID(displayClass, "getRefreshRate", "()F");
-            float rate = env->CallFloatMethod(display, getRefreshRate);
-            
-            // Clean up local references
-            env->DeleteLocalRef(displayClass);
-            env->DeleteLocalRef(display);
-            env->DeleteLocalRef(windowManagerClass);
-            env->DeleteLocalRef(windowManager);
-            env->DeleteLocalRef(activityClass);
-            
-            app_->activity->vm->DetachCurrentThread();
-            
-            if (rate > 0.0f) {
-                aout << "Display refresh rate: " << rate << " Hz" << std::endl;
-                return rate;
-            }
-        }
-        // Default to 60 Hz if we can't get the refresh rate
-        aout << "Could not get refresh rate, defaulting to 60 Hz" << std::endl;
-        return 60.0f;
-    };
-    
-    // Initialize target FPS on first frame
-    if (targetFPS == 0.0f) {
-        targetFPS = getRefreshRate();
-    }
-    
-    // Frame timing based on display refresh rate
-    static const auto targetFrameTime = std::chrono::nanoseconds(static_cast<long long>(1000000000.0f / targetFPS));
-    static auto lastFrameTime = std::chrono::steady_clock::now();
-    
-    // Calculate time since last frame
-    auto now = std::chrono::steady_clock::now();
-    auto frameTime = now - lastFrameTime;
-    
-    // If we're ahead of schedule, spin until we hit our target
-    while (frameTime < targetFrameTime) {
-        now = std::chrono::steady_clock::now();
-        frameTime = now - lastFrameTime;
+    // Frame timing is owned by the FramePacer, by the time we get here the frame is due
+    auto frameStart = std::chrono::steady_clock::now();
+    std::string overrides;
+    if (Config::takeReload(&overrides)) {
+        // The particle count stays, the buffers were sized for it
+        int particleCount = config_.particleCount;
+        config_ = Config::load(app_);
+        config_.apply(overrides, "broadcast");
+        config_.particleCount = particleCount;
+        applyConfig();
     }
-    
-    lastFrameTime = now;
-    
+    updateRefreshRate();
     updateRenderArea();
-    
-    // Clear to background color
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Pure black background
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    if (computeShader_ && particleShader_) {
-        updateParticles();
-        renderParticles();
-    }
+    collectGpuTimes();
 
-    if (eglSwapBuffers(display_, surface_) != EGL_TRUE) {
-        aout << "Failed to swap buffers: 0x" << std::hex << eglGetError() << std::endl;
+    if (benchmark_) {
+        updateBenchmark();
+    } else if (!replay_) {
+        updateBudget();
     }
-}
 
-void Renderer::initRenderer() {
-    aout << "Starting initRenderer" << std::endl;
-    
-    // Choose your render attributes
-    constexpr EGLint attribs[] = {
-            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
-            EGL_SURFACE_TYPE, EGL_WINDOW_BIT | EGL_SWAP_BEHAVIOR_PRESERVED_BIT,
-            EGL_BLUE_SIZE, 8,
-            EGL_GREEN_SIZE, 8,
-            EGL_RED_SIZE, 8,
-            EGL_DEPTH_SIZE, 24,
-            EGL_NONE
-    };
-
-    display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-    if (display_ == EGL_NO_DISPLAY) {
-        aout << "Failed to get display" << std::endl;
-        return;
-    }
+    profiler_->beginPass(Profiler::Pass::Simulate);
+    updateParticles();
+    profiler_->endPass(Profiler::Pass::Simulate);
 
-    if (!eglInitialize(display_, nullptr, nullptr)) {
-        aout << "Failed to initialize display" << std::endl;
-        return;
-    }
+    profiler_->beginPass(Profiler::Pass::Draw);
+    backend_->draw(projection_, numParticles_, drawRewind_);
+    profiler_->endPass(Profiler::Pass::Draw);
 
-    EGLint numConfigs;
-    if (!eglChooseConfig(display_, attribs, nullptr, 0, &numConfigs)) {
-        aout << "Failed to get config count" << std::endl;
-        return;
-    }
+    backend_->drawOverlay(profiler_->overlay(width_, height_, 1000.0f / refreshRate_));
 
-    std::unique_ptr<EGLConfig[]> supportedConfigs(new EGLConfig[numConfigs]);
-    if (!eglChooseConfig(display_, attribs, supportedConfigs.get(), numConfigs, &numConfigs)) {
-        aout << "Failed to get configs" << std::endl;
-        return;
-    }
+    // The swap may wait for the display, that isn't work the performance hints should see
+    auto work = std::chrono::steady_clock::now() - frameStart;
 
-    auto config = supportedConfigs[0]; // Just take the first config for now
+    profiler_->beginPass(Profiler::Pass::Present);
+    backend_->present();
+    profiler_->endPass(Profiler::Pass::Present);
 
-    EGLint format;
-    eglGetConfigAttrib(display_, config, EGL_NATIVE_VISUAL_ID, &format);
-    surface_ = eglCreateWindowSurface(display_, config, app_->window, nullptr);
-    if (surface_ == EGL_NO_SURFACE) {
-        aout << "Failed to create surface" << std::endl;
-        return;
+    if (governor_) {
+        if (governor_->endFrame(std::chrono::duration_cast<std::chrono::nanoseconds>(work))) {
+            applyGovernor();
+        }
+        profiler_->setThermal(governor_->headroom(), static_cast<int>(governor_->tier()));
     }
 
-    // Create a GLES 3.1 context
-    const EGLint contextAttribs[] = {
-        EGL_CONTEXT_MAJOR_VERSION, 3,
-        EGL_CONTEXT_MINOR_VERSION, 1,
-        EGL_NONE
-    };
-    
-    context_ = eglCreateContext(display_, config, nullptr, contextAttribs);
-    if (context_ == EGL_NO_CONTEXT) {
-        aout << "Failed to create OpenGL ES 3.1 context, error: " << eglGetError() << std::endl;
-        return;
+    // Vulkan latches the attractors in present(), the frame's record is complete only now
+    if (recorder_) {
+        std::vector<uint8_t> blob;
+        if (backend_->collectSnapshot(&blob)) {
+            recorder_->addSnapshot(std::move(blob));
+        }
+        recorder_->endFrame();
     }
+    profiler_->endFrame(numParticles_);
+}
 
-    if (!eglMakeCurrent(display_, surface_, surface_, context_)) {
-        aout << "Failed to make context current" << std::endl;
-        return;
-    }
+void Renderer::initRenderer() {
+    aout << "Starting initRenderer" << std::endl;
 
-    // Disable VSync
-    if (!eglSwapInterval(display_, 0)) {
-        aout << "Failed to set swap interval 0, error: " << eglGetError() << std::endl;
+    // Asset, intent and property overrides of the tunables
+    config_ = Config::load(app_);
+
+    // Used by the pacer when it keeps its own deadline, and followed while the app runs
+    display_ = std::make_unique<DisplayMonitor>(app_);
+    refreshRate_ = display_->refreshRate();
+    pacer_->setRefreshRate(refreshRate_);
+
+    // Motion events are reduced on their own thread from here on
+    input_ = std::make_unique<InputThread>(app_);
+
+    // GL or Vulkan, depending on the device and debug.particles.backend
+    backend_ = std::unique_ptr<RenderBackend>(RenderBackend::create(app_, pacer_));
+    aout << "Render backend: " << RenderBackend::typeName(backend_->type()) << ", "
+         << backend_->deviceName() << ", " << backend_->apiVersion() << std::endl;
+
+    // The state layout is fixed for the lifetime of the renderer, shaders are specialized for it
+    particleLayout_ = ParticleState::parseLayout(
+            Utility::getSystemProperty("debug.particles.layout"), ParticleLayout::SoA32);
+    aout << "Particle state layout: " << ParticleState::layoutName(particleLayout_) << std::endl;
+    distribution_ = ParticleState::parseDistribution(
+            Utility::getSystemProperty("debug.particles.distribution"), ParticleDistribution::Grid);
+    
+    // Benchmark runs pick their own workgroup sizes and storage size
+    StepKernel kernel = KernelTuner::DEFAULT_KERNEL;
+    if (Benchmark::isRequested(app_)) {
+        benchmark_ = std::make_unique<Benchmark>(
+                backend_->maxCapacity(particleLayout_), backend_->maxLocalSize());
+        if (benchmark_->finished()) {
+            aout << "Benchmark has nothing to run on this device" << std::endl;
+            benchmark_.reset();
+        } else {
+            kernel = {benchmark_->config().localSize, 1};
+        }
     }
-
-    // Print OpenGL info
-    aout << "OpenGL Vendor: " << glGetString(GL_VENDOR) << std::endl;
-    aout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << std::endl;
-    aout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
-
-    // Check for compute shader support
-    GLint maxComputeWorkGroupCount[3] = {0};
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxComputeWorkGroupCount[0]);
-    if (glGetError() != GL_NO_ERROR) {
-        aout << "Device does not support compute shaders!" << std::endl;
-        return;
+    if (!benchmark_) {
+        // The backend takes the attractors again right before the step needs them, predicted up
+        // to the configured prediction ahead. A replay steps with the recorded ones instead.
+        backend_->setAttractorLatch([this](SimParams &params) {
+            if (replay_) {
+                return;
+            }
+            latchAttractors(params);
+            if (recorder_) {
+                recorder_->latch(params);
+            }
+        });
+
+        // The fastest step kernel for this GPU, driver and layout, timed on the first run. The CPU
+        // simulation has no kernel, and its times must not end up stored as the GPU's.
+        if (backend_->maxLocalSize() > 0) {
+            tuner_ = std::make_unique<KernelTuner>(
+                    std::string(app_->activity->internalDataPath) + "/step_kernels.txt",
+                    std::string(RenderBackend::typeName(backend_->type())) + ", " + backend_->deviceName()
+                            + ", " + backend_->apiVersion() + ", " + ParticleState::layoutName(particleLayout_),
+                    backend_->maxLocalSize(), backend_->hasGpuTiming());
+            kernel = tuner_->kernel();
+        }
     }
-
-    // Initialize width and height
-    width_ = -1;
-    height_ = -1;
-
-    // Setup GL state first
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Pure black background
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
-    // Initialize shaders with error checking
     try {
-        auto assetManager = app_->activity->assetManager;
-        if (!assetManager) {
-            throw std::runtime_error("Failed to get asset manager");
+        // Initialize particle system
+        initParticleSystem(kernel);
+        if (!benchmark_) {
+            // Reports the frames' work for the CPU clocks and gives up quality when it gets hot
+            governor_ = std::make_unique<QualityGovernor>(1000.0f / refreshRate_);
+            governor_->setTierAvailable(QualityGovernor::Tier::RenderScale, backend_->hasRenderScale());
         }
-        
-        try {
-            // Load particle shaders
-            aout << "Loading particle vertex shader..." << std::endl;
-            std::string vertSrc = Utility::loadAsset(assetManager, "shaders/particle.vert");
-            std::string fragSrc = Utility::loadAsset(assetManager, "shaders/particle.frag");
-            
-            particleShader_ = std::unique_ptr<Shader>(
-                Shader::loadShader(vertSrc, fragSrc, "position", "", "uProjection"));
-            if (!particleShader_) {
-                throw std::runtime_error("Failed to create particle shader");
-            }
-            
-            // Load compute shader
-            aout << "Loading compute shader..." << std::endl;
-            std::string computeSrc = Utility::loadAsset(assetManager, "shaders/particle.comp");
-            computeShader_ = std::unique_ptr<Shader>(
-                Shader::loadComputeShader(computeSrc));
-            if (!computeShader_) {
-                throw std::runtime_error("Failed to create compute shader");
-            }
-            
-        } catch (const std::exception& e) {
-            throw std::runtime_error(std::string("Error loading shader files: ") + e.what());
+        profiler_ = std::make_unique<Profiler>(backend_->hasGpuTiming());
+        applyConfig();
+        if (!benchmark_) {
+            initRecording();
         }
-
-        // Initialize particle system
-        initParticleSystem();
         aout << "Particle system initialized" << std::endl;
 
     } catch (const std::exception& e) {
-        aout << "Error during initialization: " << e.what() << std::endl;
-        return;
+        throw std::runtime_error(std::string("Error during initialization: ") + e.what());
     }
 
-    // Set initial gravity point to center (0,0)
-    gravityPoint_[0] = 0.0f;
-    gravityPoint_[1] = 0.0f;
-    aout << "Initial gravity point set to: (" << gravityPoint_[0] << ", " << gravityPoint_[1] << ")" << std::endl;
-
     aout << "Renderer initialization complete" << std::endl;
 }
 
+void Renderer::onSurfaceDestroyed() {
+    if (backend_->hasSurface()) {
+        backend_->onSurfaceDestroyed(numParticles_);
+    }
+    input_->setActive(false);
+}
+
+void Renderer::onSurfaceCreated() {
+    if (backend_->hasSurface()) {
+        return;
+    }
+    backend_->onSurfaceCreated(app_->window);
+    input_->setActive(true);
+
+    // Time spent in the background is not simulated
+    lastFrameTime_ = std::chrono::steady_clock::now();
+    lastBudgetTime_ = lastFrameTime_;
+    stepAccumulator_ = 0.0f;
+}
+
 void Renderer::updateRenderArea() {
-    EGLint width;
-    eglQuerySurface(display_, surface_, EGL_WIDTH, &width);
-    EGLint height;
-    eglQuerySurface(display_, surface_, EGL_HEIGHT, &height);
+    // Starts the backend's frame, which also reports the current surface size
+    int width;
+    int height;
+    backend_->beginFrame(&width, &height);
 
-    if (width != width_ || height != height_) {
+    if ((width != width_ || height != height_) && width > 0 && height > 0) {
         width_ = width;
         height_ = height;
         
-        glViewport(0, 0, width_, height_);
-        
-        // Calculate orthographic projection matrix
-        float projectionMatrix[16] = {0};
+        // Calculate orthographic projection matrix, the backend uploads it with the draw
+        std::fill(std::begin(projection_), std::end(projection_), 0.0f);
         
         // Use aspect ratio for scaling, but maintain original zoom level (was -5 to +5 = 10 units total)
         float aspectRatio = (float)width_ / height_;
-        float baseScale = 2.0f / 20.0f;  // Changed from 10.0f to 20.0f to zoom out
+        float baseScale = 2.0f / config_.viewHeight;
         
         // Scale Y by baseScale and X by baseScale * aspect ratio to maintain proper display proportions
-        projectionMatrix[0] = baseScale / aspectRatio;  // Scale X
-        projectionMatrix[5] = baseScale;                // Scale Y
-        projectionMatrix[10] = -1.0f;
-        projectionMatrix[15] = 1.0f;
+        projection_[0] = baseScale / aspectRatio;  // Scale X
+        projection_[5] = baseScale;                // Scale Y
+        projection_[10] = -1.0f;
+        projection_[15] = 1.0f;
         
         worldWidth_ = FLT_MAX;   // Use float limits instead of artificial bounds
         worldHeight_ = FLT_MAX;
-        
-        // Update projection for particle shader
-        if (particleShader_) {
-            particleShader_->activate();
-            GLint projLoc = glGetUniformLocation(particleShader_->program(), "uProjection");
-            if (projLoc != -1) {
-                glUniformMatrix4fv(projLoc, 1, GL_FALSE, projectionMatrix);
-            }
-            particleShader_->deactivate();
+    }
+}
+
+void Renderer::updateRefreshRate() {
+    // The budget and the pacer follow the display into its new mode, the buffers were sized for the maximum
+    float rate = display_->refreshRate();
+    if (rate != refreshRate_) {
+        refreshRate_ = rate;
+        pacer_->setRefreshRate(refreshRate_);
+        updateTrails();
+        if (governor_) {
+            governor_->setFramePeriod(1000.0f / refreshRate_);
         }
     }
 }
 
-void Renderer::handleInput() {
-    auto *inputBuffer = android_app_swap_input_buffers(app_);
-    if (!inputBuffer) {
+void Renderer::applyGovernor() {
+    updateStepRate();
+    if (!governor_) {
         return;
     }
 
-    for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
-        auto &motionEvent = inputBuffer->motionEvents[i];
-        auto action = motionEvent.action;
-
-        // Get the pointer index
-        auto pointerIndex = (action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK)
-                >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
-        auto &pointer = motionEvent.pointers[pointerIndex];
-        
-        // Get screen coordinates
-        auto x = GameActivityPointerAxes_getX(&pointer);
-        auto y = GameActivityPointerAxes_getY(&pointer);
+    // The budget keeps adapting under the cap, so a tier costs particles only where they don't fit
+    budget_->setLimit(static_cast<int>(static_cast<float>(budget_->maxCount()) * governor_->particleScale()));
+    backend_->setRenderScale(governor_->renderScale());
+}
 
-        // Convert screen coordinates to world coordinates using the same scale as our projection matrix
-        float baseScale = 20.0f;  // Changed from 10.0f to 20.0f to match projection matrix
-        float aspectRatio = (float)width_ / height_;
-        float worldX = ((x / width_ - 0.5f) * baseScale * aspectRatio);
-        float worldY = -((y / height_ - 0.5f) * baseScale);  // Flip Y coordinate
-        
-        switch (action & AMOTION_EVENT_ACTION_MASK) {
-            case AMOTION_EVENT_ACTION_DOWN:
-            case AMOTION_EVENT_ACTION_MOVE:
-                // Update gravity point
-                gravityPoint_[0] = worldX;
-                gravityPoint_[1] = worldY;
-                aout << "Updated gravity point to: (" << gravityPoint_[0] << ", " << gravityPoint_[1] 
-                     << ") from screen coords: (" << x << ", " << y << ")" << std::endl;
-                break;
-
-            case AMOTION_EVENT_ACTION_POINTER_DOWN:
-                aout << "(" << pointer.id << ", " << x << ", " << y << ") "
-                     << "Pointer Down";
-                break;
-
-            case AMOTION_EVENT_ACTION_CANCEL:
-            case AMOTION_EVENT_ACTION_UP:
-            case AMOTION_EVENT_ACTION_POINTER_UP:
-                aout << "(" << pointer.id << ", " << x << ", " << y << ") "
-                     << "Pointer Up";
-                break;
-
-            default:
-                // Handle other pointer events
-                if ((action & AMOTION_EVENT_ACTION_MASK) == AMOTION_EVENT_ACTION_MOVE) {
-                    for (auto index = 0; index < motionEvent.pointerCount; index++) {
-                        pointer = motionEvent.pointers[index];
-                        x = GameActivityPointerAxes_getX(&pointer);
-                        y = GameActivityPointerAxes_getY(&pointer);
-                        aout << "(" << pointer.id << ", " << x << ", " << y << ")";
-                        if (index != (motionEvent.pointerCount - 1)) aout << ",";
-                        aout << " ";
-                    }
-                    aout << "Pointer Move";
-                } else {
-                    aout << "Unknown MotionEvent Action: " << action;
-                }
-        }
-        aout << std::endl;
+void Renderer::updateStepRate() {
+    // The simulation steps at its own rate, the frames in between blend. Damping is per step, so
+    // it is adjusted to take the same off every second at any rate. Benchmarks step once per
+    // frame whatever the rate.
+    float stepRate = config_.stepRate;
+    if (benchmark_ || stepRate <= 0.0f) {
+        stepRate = DEFAULT_STEP_RATE;
+    }
+    if (governor_) {
+        stepRate *= governor_->stepRateScale();
     }
+    stepRate = std::min(std::max(stepRate, MIN_STEP_RATE), MAX_STEP_RATE);
+    simParams_.damping = std::pow(config_.damping, DEFAULT_STEP_RATE / stepRate);
+    stepPeriod_ = 1.0f / stepRate;
+    stepAccumulator_ = std::min(stepAccumulator_, stepPeriod_);
+    aout << "Simulation rate: " << stepRate << " Hz" << std::endl;
+}
 
-    android_app_clear_motion_events(inputBuffer);
-    android_app_clear_key_events(inputBuffer);
+void Renderer::updateTrails() {
+    // The trails fade to half in the same time at any refresh rate, and by default a sprite covers
+    // the way its particle moved since the frame before, so fast ones don't break up into dots
+    float halfLife = config_.trailHalfLifeMs / 1000.0f;
+    float decay = halfLife > 0.0f ? std::pow(0.5f, 1.0f / (halfLife * refreshRate_)) : 0.0f;
+    backend_->setTrails(decay, std::max(0.0f, config_.trailStretch) * timeScale_ / refreshRate_);
 }
 
-void Renderer::initParticleSystem() {
-    // Get the refresh rate first
-    float refreshRate = 0.0f;
-    if (app_ && app_->activity && app_->activity->vm) {
-        JNIEnv* env;
-        app_->activity->vm->AttachCurrentThread(&env, nullptr);
-        
-        jobject activity = app_->activity->javaGameActivity;
-        jclass activityClass = env->FindClass("android/app/NativeActivity");
-        jmethodID getWindowManager = env->GetMethodID(activityClass, "getWindowManager", "()Landroid/view/WindowManager;");
-        jobject windowManager = env->CallObjectMethod(activity, getWindowManager);
-        
-        jclass windowManagerClass = env->FindClass("android/view/WindowManager");
-        jmethodID getDefaultDisplay = env->GetMethodID(windowManagerClass, "getDefaultDisplay", "()Landroid/view/Display;");
-        jobject display = env->CallObjectMethod(windowManager, getDefaultDisplay);
-        
-        jclass displayClass = env->FindClass("android/view/Display");
-        jmethodID getRefreshRate = env->GetMethodID(displayClass, "getRefreshRate", "()F");
-        refreshRate = env->CallFloatMethod(display, getRefreshRate);
-        
-        env->DeleteLocalRef(displayClass);
-        env->DeleteLocalRef(display);
-        env->DeleteLocalRef(windowManagerClass);
-        env->DeleteLocalRef(windowManager);
-        env->DeleteLocalRef(activityClass);
-        
-        app_->activity->vm->DetachCurrentThread();
-    }
+void Renderer::initParticleSystem(const StepKernel &kernel) {
+    // Start from the old binary scaling - either 90fps capable (2x particles) or not - and let
+    // the budget controller take it from there
+    float scaleFactor = refreshRate_ >= 90.0f ? 2.0f : 1.0f;
+    int initialParticles = static_cast<int>(static_cast<float>(config_.particleCount) * scaleFactor);
+    
+    // Buffers are sized for the device class maximum so the budget can change without reallocating.
+    // A benchmark sizes them for its largest configuration instead.
+    int storageLimit = backend_->maxCapacity(particleLayout_);
+    int capacity = benchmark_
+            ? benchmark_->maxParticleCount()
+            : std::max(initialParticles, ParticleBudget::deviceMaxParticles(storageLimit));
+    capacity = (capacity + ParticleBudget::GRANULARITY - 1) / ParticleBudget::GRANULARITY
+            * ParticleBudget::GRANULARITY;
+    // Neither the configured count nor a benchmark may take the state past one storage block
+    capacity = std::min(capacity, storageLimit / ParticleBudget::GRANULARITY * ParticleBudget::GRANULARITY);
+    initialParticles = std::min(initialParticles, capacity);
+    budget_ = std::make_unique<ParticleBudget>(std::min(config_.particleCount / 4, capacity), capacity,
+                                               initialParticles);
+    numParticles_ = benchmark_ ? std::min(benchmark_->config().particleCount, capacity) : budget_->activeCount();
     
-    if (refreshRate <= 0.0f) {
-        refreshRate = 60.0f;  // Default to 60Hz if we couldn't get the rate
+    aout << "Particle scale factor: " << scaleFactor << std::endl;
+    aout << "Creating particle buffers for " << capacity << " particles, " << numParticles_
+         << " active" << std::endl;
+    
+    // Allocate the state in the selected layout, build the kernels for it and fill it. Sprites are
+    // drawn unless debug.particles.draw asks for the density grid, LOD or trails, and particles don't
+    // interact unless debug.particles.interaction names a force model. debug.particles.reorder_interval
+    // sets how many stepping frames go between Morton sorts, 0 turns them off, and
+    // debug.particles.lifetime gives particles a mean lifetime in seconds, 0 keeps them forever.
+    auto drawMode = RenderBackend::parseDrawMode(
+            Utility::getSystemProperty("debug.particles.draw"), DrawMode::Sprites);
+    auto interaction = RenderBackend::parseInteraction(
+            Utility::getSystemProperty("debug.particles.interaction"), Interaction::None);
+    reorderInterval_ = std::max(0, std::atoi(Utility::getSystemProperty(
+            "debug.particles.reorder_interval", std::to_string(DEFAULT_REORDER_INTERVAL)).c_str()));
+    lifetime_ = std::max(0.0f, static_cast<float>(std::atof(
+            Utility::getSystemProperty("debug.particles.lifetime", "0").c_str())));
+    backend_->initParticles(particleLayout_, capacity, kernel, drawMode, interaction, reorderInterval_ > 0,
+                            lifetime_ > 0.0f);
+    if (!backend_->reorders()) {
+        reorderInterval_ = 0;
+    }
+    if (!backend_->hasLifetimes()) {
+        lifetime_ = 0.0f;
     }
+    aout << "Draw mode: " << RenderBackend::drawModeName(backend_->drawMode()) << ", interaction: "
+         << RenderBackend::interactionName(backend_->interaction()) << ", reorder: "
+         << (reorderInterval_ > 0 ? "every " + std::to_string(reorderInterval_) + " frames" : "off")
+         << ", lifetime: " << (lifetime_ > 0.0f ? std::to_string(lifetime_) + " s" : "forever")
+         << std::endl;
+    resetParticles(numParticles_, benchmark_ ? Benchmark::SEED : std::random_device{}());
+    simParams_ = {};
+}
 
-    // Simple binary scaling - either 90fps capable (1.8x particles) or not
-    float scaleFactor = refreshRate >= 90.0f ? 2.0f : 1.0f;
-    
-    // Calculate total particles
-    numParticles_ = static_cast<int>(BASE_PARTICLE_COUNT * scaleFactor);
-    
+void Renderer::applyConfig() {
+    timeScale_ = config_.timeScale;
+    maxPrediction_ = std::max(0.0f, config_.maxPredictionMs) / 1000.0f;
+
+    // Terminal velocity and the attractors reach the kernels through SimParams, damping goes with
+    // the step rate
+    simParams_.terminalVelocity = config_.terminalVelocity;
+    backend_->setPointSize(config_.pointSize);
+    updateTrails();
+    profiler_->setOverlayEnabled(config_.hud);
+    if (governor_) {
+        // A replay runs at full quality throughout, the tiers would change what its frames do
+        governor_->setEnabled(config_.governor && !replay_);
+    }
+    applyGovernor();
+
+    // The view height is in the projection, which is only rebuilt when the size changes
+    width_ = 0;
+    height_ = 0;
+}
+
+void Renderer::resetParticles(int gridParticles, uint32_t seed) {
     // Calculate grid dimensions to maintain roughly 4:3 aspect ratio
     float aspectRatio = 4.0f / 3.0f;
-    int particlesPerCol = static_cast<int>(sqrt(numParticles_ / aspectRatio));
+    int particlesPerCol = static_cast<int>(sqrt(gridParticles / aspectRatio));
     int particlesPerRow = static_cast<int>(particlesPerCol * aspectRatio);
     
-    // Adjust to match total count as closely as possible
-    numParticles_ = particlesPerRow * particlesPerCol;
-    
-    aout << "Display refresh rate: " << refreshRate << " Hz" << std::endl;
-    aout << "Particle scale factor: " << scaleFactor << std::endl;
-    aout << "Creating particle buffers for " << numParticles_ << " particles" << std::endl;
-    aout << "Grid size: " << particlesPerRow << " x " << particlesPerCol << std::endl;
-    
-    // Create separate buffers for positions and velocities
-    glGenBuffers(1, &positionBuffer_);
-    glGenBuffers(1, &velocityBuffer_);
-    
-    // Initialize particles in a grid pattern with a reasonable initial spread
+    // Initialize particles with a reasonable initial spread
     float initialSpread = 16.0f;  // Match our view area (20 units tall, but leave some margin)
     
-    // Calculate spacing to distribute particles evenly
-    float spacingY = initialSpread / (particlesPerCol - 1);
-    float spacingX = (initialSpread * aspectRatio) / (particlesPerRow - 1);
-    
-    // Calculate start positions to center the grid
-    float startX = -initialSpread * aspectRatio / 2.0f;
-    float startY = -initialSpread / 2.0f;
-    
-    // Allocate aligned memory for positions and velocities
-    alignas(16) std::vector<float> positions(numParticles_ * 2);
-    alignas(16) std::vector<float> velocities(numParticles_ * 2);
-    
-    for(int i = 0; i < numParticles_; i++) {
-        int row = i / particlesPerRow;
-        int col = i % particlesPerRow;
-        
-        // Position relative to center
-        float xPos = startX + (col * spacingX);
-        float yPos = startY + (row * spacingY);
-        
-        // Initial velocities scaled to view area
-        float randAngle = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 2.0f * M_PI;
-        float randSpeed = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 2.0f;  // Adjusted for view area
-        
-        // Store in SoA format
-        positions[i * 2] = xPos;
-        positions[i * 2 + 1] = yPos;
-        velocities[i * 2] = cos(randAngle) * randSpeed;
-        velocities[i * 2 + 1] = sin(randAngle) * randSpeed;
+    InitParams params = {};
+    params.seed = seed;
+    params.particleCount = budget_->maxCount();
+    params.gridColumns = particlesPerRow;
+    params.gridCount = particlesPerRow * particlesPerCol;
+    
+    // Center the spawn area and spread the grid evenly over it
+    params.extent[0] = initialSpread * aspectRatio;
+    params.extent[1] = initialSpread;
+    params.origin[0] = -params.extent[0] / 2.0f;
+    params.origin[1] = -params.extent[1] / 2.0f;
+    params.spacing[0] = params.extent[0] / (particlesPerRow - 1);
+    params.spacing[1] = params.extent[1] / (particlesPerCol - 1);
+    params.maxSpeed = 2.0f;  // Scaled to the view area
+    params.distribution = static_cast<GLuint>(distribution_);
+    params.aliveCount = gridParticles;
+    emitAccumulator_ = 0.0f;
+    resetParams_ = params;
+    if (recorder_) {
+        recorder_->addReset(params);
     }
     
-    // Upload position data
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, positionBuffer_);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, 
-                 positions.size() * sizeof(float),
-                 positions.data(), 
-                 GL_DYNAMIC_DRAW);
-    
-    // Upload velocity data
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocityBuffer_);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, 
-                 velocities.size() * sizeof(float),
-                 velocities.data(), 
-                 GL_DYNAMIC_DRAW);
-    
-    // Set up VAO
-    glGenVertexArrays(1, &particleVAO_);
-    glBindVertexArray(particleVAO_);
-    
-    // Position attribute (vec2)
-    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer_);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
+    aout << "Initializing " << params.particleCount << " particles on the GPU: "
+         << ParticleState::distributionName(distribution_) << ", grid " << particlesPerRow << " x "
+         << particlesPerCol << ", seed " << seed << std::endl;
+    backend_->resetParticles(params);
+}
+
+void Renderer::collectGpuTimes() {
+    // Results arrive a few frames late, whatever finished since the last frame goes in now
+    float simulateMillis;
+    float drawMillis;
+    while (backend_->collectGpuTimes(&simulateMillis, &drawMillis)) {
+        profiler_->addGpuFrame(simulateMillis, drawMillis);
+        // Replayed frames aren't counted by the tuner, their times would go to the wrong candidate
+        if (replay_) {
+            replay_->addGpuTime(simulateMillis);
+        } else if (tuner_) {
+            tuner_->addGpuTime(simulateMillis);
+        }
+    }
+    float sortMillis;
+    while (backend_->collectSortTime(&sortMillis)) {
+        profiler_->addSortTime(sortMillis);
+    }
+}
+
+void Renderer::initRecording() {
+    // debug.particles.replay=1 runs the last recording again, from the newest snapshot at or before
+    // frame debug.particles.replay_start. Otherwise debug.particles.record=1 makes a new one with a
+    // snapshot every debug.particles.record_interval frames.
+    auto *activity = app_->activity;
+    std::string path = std::string(activity->externalDataPath ? activity->externalDataPath
+                                                              : activity->internalDataPath)
+            + "/" + RECORDING_FILE;
+    if (Utility::getSystemProperty("debug.particles.replay") == "1") {
+        int start = std::atoi(Utility::getSystemProperty("debug.particles.replay_start", "0").c_str());
+        try {
+            replay_ = std::make_unique<Replay>(path, start);
+        } catch (const std::exception &e) {
+            aout << "Not replaying: " << e.what() << std::endl;
+            return;
+        }
+        auto &header = replay_->header();
+        if (header.capacity > static_cast<uint32_t>(budget_->maxCount())) {
+            aout << "Not replaying, the recording holds " << header.capacity << " particles and the buffers "
+                 << budget_->maxCount() << std::endl;
+            replay_.reset();
+            return;
+        }
+        if (governor_) {
+            governor_->setEnabled(false);
+            applyGovernor();
+        }
+
+        // Snapshots are in the recording's layout, and only some backends can restore them
+        std::vector<uint8_t> blob;
+        if (header.layout == static_cast<uint32_t>(particleLayout_)) {
+            blob = replay_->takeSnapshot();
+        }
+        if (!blob.empty() && backend_->restoreSnapshot(blob) > 0) {
+            aout << "Replay starts from the snapshot of frame " << replay_->frame() << std::endl;
+        } else {
+            replay_->rewind();
+            backend_->resetParticles(replay_->reset());
+            aout << "Replay starts from the recorded reset" << std::endl;
+        }
+        return;
+    }
+
+    if (Utility::getSystemProperty("debug.particles.record") == "1") {
+        int interval = std::max(0, std::atoi(Utility::getSystemProperty(
+                "debug.particles.record_interval", std::to_string(DEFAULT_SNAPSHOT_INTERVAL)).c_str()));
+        try {
+            recorder_ = std::make_unique<Recorder>(path, static_cast<uint32_t>(backend_->type()),
+                                                   static_cast<uint32_t>(particleLayout_),
+                                                   budget_->maxCount(), interval);
+        } catch (const std::exception &e) {
+            aout << "Not recording: " << e.what() << std::endl;
+            return;
+        }
+        recorder_->addReset(resetParams_);
+    }
+}
+
+void Renderer::screenToWorld(float x, float y, float *outWorld) const {
+    // Convert screen coordinates to world coordinates using the same scale as our projection matrix
+    float baseScale = config_.viewHeight;
+    float aspectRatio = (float)width_ / height_;
+    outWorld[0] = ((x / width_ - 0.5f) * baseScale * aspectRatio);
+    outWorld[1] = -((y / height_ - 0.5f) * baseScale);  // Flip Y coordinate
+}
+
+void Renderer::latchAttractors(SimParams &params) const {
+    // Whatever the input thread last reduced the motion events to, moved on to where the fingers
+    // should be when the step's result is on screen: it is drawn by the next frame, which is
+    // presented PREDICTED_FRAMES periods from now
+    const auto &touch = input_->latest();
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    float presentDelay = static_cast<float>(PREDICTED_FRAMES) / refreshRate_;
+    int count = std::min(touch.pointerCount, MAX_ATTRACTORS);
+    for (int i = 0; i < count; i++) {
+        auto &pointer = touch.pointers[i];
+        float x = pointer.x;
+        float y = pointer.y;
+
+        // A finger that hasn't moved for a while is resting, not moving at its last velocity
+        int64_t age = now - pointer.time;
+        if (!touch.released && age >= 0 && age < TouchTracker::VELOCITY_WINDOW_NS) {
+            float horizon = std::min(static_cast<float>(age) * 1e-9f + presentDelay, maxPrediction_);
+            x += pointer.velocityX * horizon;
+            y += pointer.velocityY * horizon;
+        }
+
+        auto &attractor = params.attractors[i];
+        screenToWorld(x, y, attractor.position);
+        attractor.strength = config_.attractionStrength;
+        attractor.falloff = config_.attractorFalloff;
+    }
+
+    // Until the first touch, particles gather at the center of the screen
+    if (count == 0) {
+        params.attractors[0] = {{0.0f, 0.0f}, config_.attractionStrength, config_.attractorFalloff};
+        count = 1;
+    }
+    params.attractorCount = count;
+}
+
+void Renderer::updateEmitters(float seconds) {
+    simParams_.lifetime = lifetime_;
+    simParams_.emitCount = 0;
+    if (lifetime_ <= 0.0f) {
+        simParams_.emitterCount = 0;
+        return;
+    }
+
+    // Evenly spaced on the orbit, spawning along it so the particles trail behind
+    emitPhase_ = std::fmod(emitPhase_ + EMITTER_ORBIT_SPEED * seconds, 2.0f * static_cast<float>(M_PI));
+    for (int i = 0; i < EMITTER_COUNT; i++) {
+        float angle = emitPhase_ + 2.0f * static_cast<float>(M_PI) * i / EMITTER_COUNT;
+        auto &emitter = simParams_.emitters[i];
+        emitter.position[0] = EMITTER_ORBIT_RADIUS * std::cos(angle);
+        emitter.position[1] = EMITTER_ORBIT_RADIUS * std::sin(angle);
+        emitter.velocity[0] = -EMITTER_SPEED * std::sin(angle);
+        emitter.velocity[1] = EMITTER_SPEED * std::cos(angle);
+    }
+    simParams_.emitterCount = EMITTER_COUNT;
+
+    // numParticles_ / lifetime_ die every second on average once the reset's particles are gone.
+    // The emit kernel drops whatever doesn't fit under particleCount.
+    emitAccumulator_ += static_cast<float>(numParticles_) * seconds / lifetime_;
+    simParams_.emitCount = static_cast<GLuint>(emitAccumulator_);
+    emitAccumulator_ -= static_cast<float>(simParams_.emitCount);
+    simParams_.emitSeed++;
+}
+
+void Renderer::updateBudget() {
+    auto now = std::chrono::steady_clock::now();
+    float frameInterval = std::chrono::duration<float, std::milli>(now - lastBudgetTime_).count();
+    lastBudgetTime_ = now;
+    
+    // Hold the count while kernels are tuned, they are compared per particle but a slow candidate
+    // shouldn't cost particles
+    if (tuner_ && tuner_->running()) {
+        float gpuMillis;
+        while (profiler_->collectGpuFrame(&gpuMillis)) {
+        }
+        return;
+    }
+
+    float framePeriod = 1000.0f / refreshRate_;
+    if (profiler_->hasGpuTiming()) {
+        // Leave headroom in the frame for composition and the CPU side
+        budget_->setTarget(framePeriod * GPU_BUDGET_FRACTION, true);
+        float gpuMillis;
+        while (profiler_->collectGpuFrame(&gpuMillis)) {
+            budget_->addSample(gpuMillis);
+        }
+    } else {
+        // Frame intervals are vsync-bound, they only show when we are over budget
+        budget_->setTarget(framePeriod * FRAME_INTERVAL_SLACK, false);
+        budget_->addSample(frameInterval);
+    }
+    numParticles_ = budget_->activeCount();
+}
+
+void Renderer::updateBenchmark() {
+    auto now = std::chrono::steady_clock::now();
+    float frameInterval = std::chrono::duration<float, std::milli>(now - lastBudgetTime_).count();
+    lastBudgetTime_ = now;
     
-    // Velocity attribute (vec2)
-    glBindBuffer(GL_ARRAY_BUFFER, velocityBuffer_);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(1);
+    std::vector<float> gpuFrames;
+    float gpuMillis;
+    while (profiler_->collectGpuFrame(&gpuMillis)) {
+        gpuFrames.push_back(gpuMillis);
+    }
+    if (benchmark_->finished() || !benchmark_->addFrame(frameInterval, gpuFrames)) {
+        return;
+    }
     
-    // Verify setup
-    GLenum error = glGetError();
-    if (error != GL_NO_ERROR) {
-        aout << "Error after buffer setup: 0x" << std::hex << error << std::endl;
+    if (benchmark_->finished()) {
+        benchmark_->writeReport(app_->activity->internalDataPath, backend_->deviceName(),
+                                backend_->apiVersion(), profiler_->hasGpuTiming(),
+                                ParticleState::layoutName(particleLayout_),
+                                RenderBackend::drawModeName(backend_->drawMode()),
+                                RenderBackend::interactionName(backend_->interaction()));
+        GameActivity_finish(app_->activity);
+        return;
     }
+    
+    // Every configuration starts from the same state
+    auto &config = benchmark_->config();
+    numParticles_ = config.particleCount;
+    resetParticles(numParticles_, Benchmark::SEED);
+    backend_->setStepKernel({config.localSize, 1});
 }
 
 void Renderer::updateParticles() {
-    if (!computeShader_) return;
-    
-    computeShader_->activate();
-    
-    // Calculate delta time and apply time scale
     auto currentTime = std::chrono::steady_clock::now();
-    float deltaTime = std::chrono::duration<float>(currentTime - lastFrameTime_).count() * timeScale_;
+    float frameTime = std::chrono::duration<float>(currentTime - lastFrameTime_).count();
     lastFrameTime_ = currentTime;
-    
-    // Bind both buffers to their respective binding points
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positionBuffer_);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocityBuffer_);
-    
-    // Set uniforms
-    GLint gravityLoc = glGetUniformLocation(computeShader_->program(), "gravityPoint");
-    GLint deltaTimeLoc = glGetUniformLocation(computeShader_->program(), "deltaTime");
-    
-    if (gravityLoc != -1) {
-        glUniform2fv(gravityLoc, 1, gravityPoint_);
+
+    if (replay_ && replayFrame(frameTime)) {
+        return;
     }
-    
-    if (deltaTimeLoc != -1) {
-        glUniform1f(deltaTimeLoc, deltaTime);
+
+    // This frame draws the result of the previous frame's steps, which left the accumulator where
+    // it is now. Show that state as far back as the time it hasn't caught up with, so the display
+    // advances by the wall-clock time of each frame however the steps fall.
+    float blend = stepAccumulator_ / stepPeriod_;
+    drawRewind_ = (1.0f - blend) * stepPeriod_ * timeScale_;
+
+    int steps;
+    float stepTime;
+    if (benchmark_) {
+        // Exactly one step of the benchmark's length per frame and no blending, so runs compare
+        steps = 1;
+        stepTime = benchmark_->deltaTime();
+        drawRewind_ = 0.0f;
+    } else {
+        stepAccumulator_ += frameTime;
+        steps = static_cast<int>(stepAccumulator_ / stepPeriod_);
+        stepAccumulator_ -= static_cast<float>(steps) * stepPeriod_;
+        steps = std::min(steps, governor_ ? governor_->maxSteps(MAX_STEPS_PER_FRAME) : MAX_STEPS_PER_FRAME);
+        stepTime = stepPeriod_ * timeScale_;
+    }
+
+    // The backend uploads this frame's parameters in one go
+    simParams_.deltaTime = stepTime;
+    simParams_.stepCount = steps;
+    simParams_.particleCount = numParticles_;
+    simParams_.reorder = 0;
+    if (steps > 0 && reorderInterval_ > 0 && ++framesSinceReorder_ >= reorderInterval_) {
+        simParams_.reorder = 1;
+        framesSinceReorder_ = 0;
+    }
+    if (benchmark_) {
+        benchmark_->scriptAttractors(simParams_);
+    } else {
+        latchAttractors(simParams_);
+    }
+    updateEmitters(static_cast<float>(steps) * stepTime);
+
+    // The snapshot is of the state this frame's step reads
+    if (recorder_) {
+        recorder_->beginFrame(simParams_, drawRewind_);
+        if (recorder_->snapshotDue()) {
+            if (backend_->requestSnapshot(budget_->maxCount())) {
+                recorder_->snapshotStarted();
+            } else {
+                recorder_->disableSnapshots();
+            }
+        }
+    }
+    backend_->simulate(simParams_);
+
+    if (tuner_ && tuner_->addFrame(static_cast<long long>(steps) * numParticles_)) {
+        backend_->setStepKernel(tuner_->kernel());
     }
-    
-    // Dispatch compute shader
-    int numGroups = (numParticles_ + 255) / 256;
-    glDispatchCompute(numGroups, 1, 1);
-    
-    // Ensure compute shader writes are visible
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-    computeShader_->deactivate();
 }
 
-void Renderer::renderParticles() {
-    if (!particleShader_) return;
-    
-    particleShader_->activate();
-    
-    // Use alpha blending instead of additive
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    glBindVertexArray(particleVAO_);
-    
-    // Draw particles
-    glDrawArrays(GL_POINTS, 0, numParticles_);
-    
-    // Check for errors
-    GLenum error = glGetError();
-    if (error != GL_NO_ERROR) {
-        aout << "Error after particle draw: 0x" << std::hex << error << std::endl;
+bool Renderer::replayFrame(float frameTime) {
+    if (replay_->finished()) {
+        // The live simulation takes over from where the replay left the particles
+        replay_->report();
+        replay_.reset();
+        if (governor_) {
+            governor_->setEnabled(config_.governor);
+        }
+        stepAccumulator_ = 0.0f;
+        aout << "Replay finished, back to live input" << std::endl;
+        return false;
     }
-    
-    particleShader_->deactivate();
+
+    // The recorded parameters in place of the clock, the budget and the input. The tuner doesn't
+    // see these frames, so the kernel stays as it is.
+    replay_->addFrameTime(frameTime * 1000.0f);
+    const auto &frame = replay_->nextFrame();
+    numParticles_ = std::min(static_cast<int>(frame.params.particleCount), budget_->maxCount());
+    drawRewind_ = frame.drawRewind;
+    backend_->simulate(frame.params);
+    return true;
 }
@@ -1,71 +1,175 @@
 #ifndef ANDROIDGLINVESTIGATIONS_RENDERER_H
 #define ANDROIDGLINVESTIGATIONS_RENDERER_H
 
-#include <EGL/egl.h>
-#include <GLES3/gl31.h>
 #include <memory>
 #include <vector>
 #include <chrono>
 #include <string>
-#include "Model.h"
-#include "Shader.h"
+#include "Benchmark.h"
+#include "Config.h"
+#include "DisplayMonitor.h"
+#include "FramePacer.h"
+#include "InputThread.h"
+#include "KernelTuner.h"
+#include "ParticleBudget.h"
+#include "Profiler.h"
+#include "ParticleState.h"
+#include "QualityGovernor.h"
+#include "Recorder.h"
+#include "RenderBackend.h"
+#include "Replay.h"
+#include "SimParams.h"
 
 struct android_app;
 
 class Renderer {
 public:
-    explicit Renderer(android_app *pApp) :
+    /*!
+     * @param pApp the app to render into
+     * @param pacer the frame pacer driving the main loop, must outlive the renderer
+     */
+    Renderer(android_app *pApp, FramePacer *pacer) :
             app_(pApp),
-            display_(EGL_NO_DISPLAY),
-            surface_(EGL_NO_SURFACE),
-            context_(EGL_NO_CONTEXT),
+            pacer_(pacer),
             width_(0),
             height_(0),
-            gravityPoint_{0.0f, 0.0f},
+            refreshRate_(60.0f),
             timeScale_(0.80f),
-            positionBuffer_(0),
-            velocityBuffer_(0),
-            particleVAO_(0),
-            numParticles_(0) {
+            particleLayout_(ParticleLayout::SoA32),
+            distribution_(ParticleDistribution::Grid),
+            numParticles_(0),
+            projection_{},
+            stepPeriod_(1.0f / DEFAULT_STEP_RATE),
+            stepAccumulator_(0.0f),
+            drawRewind_(0.0f),
+            reorderInterval_(0),
+            framesSinceReorder_(0),
+            lifetime_(0.0f),
+            emitPhase_(0.0f),
+            emitAccumulator_(0.0f),
+            maxPrediction_(0.0f),
+            resetParams_{} {
         lastFrameTime_ = std::chrono::steady_clock::now();
+        lastBudgetTime_ = lastFrameTime_;
         initRenderer();
     }
 
     virtual ~Renderer();
 
-    void handleInput();
     void render();
 
+    /*!
+     * Releases the window surface when the app loses its window. The backend and the simulation
+     * stay alive.
+     */
+    void onSurfaceDestroyed();
+
+    //! Attaches the backend to the app's new window
+    void onSurfaceCreated();
+
+    //! False between onSurfaceDestroyed() and onSurfaceCreated(), nothing can be rendered then
+    bool hasSurface() const { return backend_->hasSurface(); }
+
 private:
     void initRenderer();
+
+    //! Takes the tunables of config_ into the simulation, the backend and the profiler
+    void applyConfig();
+
+    //! Takes the governor's tier into the budget, the backend and the step rate
+    void applyGovernor();
+
+    //! The configured step rate, cut by the governor's tier
+    void updateStepRate();
+
+    //! Follows the display into a new refresh rate
+    void updateRefreshRate();
+
+    //! Hands the trail look of config_ to the backend, for the current refresh rate
+    void updateTrails();
     void updateRenderArea();
-    void initParticleSystem();
+    void initParticleSystem(const StepKernel &kernel);
+    void resetParticles(int gridParticles, uint32_t seed);
+    void collectGpuTimes();
+
+    //! Starts the recording or the replay the debug.particles.record and replay properties ask for
+    void initRecording();
+    void screenToWorld(float x, float y, float *outWorld) const;
+
+    //! Attractors of @a params from the newest touches, predicted to when the step's result is shown
+    void latchAttractors(SimParams &params) const;
+
+    //! Moves the emitters and sets how many particles they spawn over @a seconds of steps
+    void updateEmitters(float seconds);
+    void updateBudget();
+    void updateBenchmark();
     void updateParticles();
-    void renderParticles();
+
+    //! Simulates the replay's next frame instead of the live one, false once the replay is over
+    bool replayFrame(float frameTime);
 
     android_app *app_;
-    EGLDisplay display_;
-    EGLSurface surface_;
-    EGLContext context_;
-    GLint width_;
-    GLint height_;
+    FramePacer *pacer_;
+    Config config_;
+    std::unique_ptr<RenderBackend> backend_;
+    int width_;
+    int height_;
+    std::unique_ptr<DisplayMonitor> display_;
+    float refreshRate_;  // What this frame is paced and budgeted for
     float worldWidth_;
     float worldHeight_;
-    float gravityPoint_[2];
-    float timeScale_;  // Time scale factor (0.75 = 75% speed)
+    std::unique_ptr<InputThread> input_;
+    float timeScale_;  // Time scale factor (0.75 = 75% speed), from config_
 
     // Particle system
-    GLuint positionBuffer_;
-    GLuint velocityBuffer_;
-    GLuint particleVAO_;
-    int numParticles_;
+    ParticleLayout particleLayout_;
+    ParticleDistribution distribution_;
+    SimParams simParams_;
+    int numParticles_;  // Active particles, the state buffers hold up to the budget maximum
+    std::unique_ptr<ParticleBudget> budget_;
+    std::unique_ptr<Profiler> profiler_;
+    std::unique_ptr<Benchmark> benchmark_;  // Only set for benchmark runs
+    std::unique_ptr<KernelTuner> tuner_;    // Not set for benchmark runs, they sweep kernels themselves
+    std::unique_ptr<QualityGovernor> governor_;  // Not set for benchmark runs, they run at full quality
+    float projection_[16];
+
+    // Fixed timestep. Wall-clock time is accumulated and taken off in steps of stepPeriod_ seconds,
+    // all of a frame's steps run in one dispatch. Panels faster than the step rate step on some
+    // frames only and blend between the last two states in between.
+    static constexpr float DEFAULT_STEP_RATE = 60.0f;
+    static constexpr float MIN_STEP_RATE = 15.0f;
+    static constexpr float MAX_STEP_RATE = 240.0f;
+    static constexpr int MAX_STEPS_PER_FRAME = 4;  // After a hitch the simulation slows down instead
+    float stepPeriod_;
+    float stepAccumulator_;  // Wall-clock seconds not stepped yet, less than stepPeriod_ between frames
+    float drawRewind_;       // Passed to RenderBackend::draw()
+
+    // The particles drift out of Morton order slowly, so they are sorted again every
+    // reorderInterval_ frames that step. 0 never sorts.
+    static constexpr int DEFAULT_REORDER_INTERVAL = 120;
+    int reorderInterval_;
+    int framesSinceReorder_;
+
+    // Mean particle lifetime in seconds, 0 when particles live forever. The emitters replace the
+    // particles that die, at the rate that keeps numParticles_ of them alive.
+    float lifetime_;
+    float emitPhase_;        // Angle of the emitter orbit in radians
+    float emitAccumulator_;  // Particles owed to the emitters, less than one between frames
+
+    // Touches are extrapolated along their velocity to the expected present time of the step's
+    // result, but no further than maxPrediction_ seconds: past that a turn overshoots visibly
+    static constexpr int PREDICTED_FRAMES = 2;
+    float maxPrediction_;
 
-    // Shaders
-    std::unique_ptr<Shader> computeShader_;
-    std::unique_ptr<Shader> particleShader_;
+    // Frames fed to the simulation go to recorder_ if set, and come from replay_ instead of the
+    // clock, the budget and the input while it is set. Never both, and neither for benchmark runs.
+    std::unique_ptr<Recorder> recorder_;
+    std::unique_ptr<Replay> replay_;
+    InitParams resetParams_;  // Of the last resetParticles(), the start of a recording
 
     // Timing
     std::chrono::steady_clock::time_point lastFrameTime_;
+    std::chrono::steady_clock::time_point lastBudgetTime_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_RENDERER_H
\ No newline at end of file
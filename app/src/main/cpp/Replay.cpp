@@ -0,0 +1,84 @@
+#include "Replay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <zlib.h>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+//! Reads exactly @a size bytes, false at the end of the file or on a truncated read
+static bool readFully(gzFile file, void *data, size_t size) {
+    return size == 0 || gzread(file, data, static_cast<unsigned>(size)) == static_cast<int>(size);
+}
+
+Replay::Replay(const std::string &path, int startFrame) : header_{}, reset_{}, snapshotFrame_(-1), next_(0) {
+    std::unique_ptr<gzFile_s, int (*)(gzFile)> file(gzopen(path.c_str(), "rb"), gzclose);
+    if (!file) {
+        throw std::runtime_error("Can't open recording " + path);
+    }
+    if (!readFully(file.get(), &header_, sizeof(header_)) || header_.magic != RECORDING_MAGIC
+            || header_.version != RECORDING_VERSION) {
+        throw std::runtime_error(path + " is not a recording of this version");
+    }
+
+    bool hasReset = false;
+    RecordingChunk chunk;
+    std::vector<uint8_t> payload;
+    while (readFully(file.get(), &chunk, sizeof(chunk))) {
+        payload.resize(chunk.size);
+        if (!readFully(file.get(), payload.data(), payload.size())) {
+            // Cut off by the app being killed, what came before is still good
+            aout << "Recording " << path << " ends in a partial chunk" << std::endl;
+            break;
+        }
+        auto type = static_cast<RecordingChunkType>(chunk.type);
+        if (type == RecordingChunkType::Reset && chunk.size == sizeof(InitParams) && !hasReset) {
+            std::memcpy(&reset_, payload.data(), sizeof(InitParams));
+            hasReset = true;
+        } else if (type == RecordingChunkType::Frame && chunk.size == sizeof(RecordedFrame)) {
+            RecordedFrame frame;
+            std::memcpy(&frame, payload.data(), sizeof(frame));
+            if (frame.frame != frames_.size()) {
+                throw std::runtime_error(path + " skips frame " + std::to_string(frames_.size()));
+            }
+            frames_.push_back(frame);
+        } else if (type == RecordingChunkType::Snapshot && chunk.size > sizeof(uint32_t)) {
+            // Captures finish a few frames late and are written when they do, keep the best so far
+            uint32_t frame;
+            std::memcpy(&frame, payload.data(), sizeof(uint32_t));
+            if (static_cast<int64_t>(frame) <= startFrame && static_cast<int64_t>(frame) > snapshotFrame_) {
+                snapshotFrame_ = frame;
+                payload.erase(payload.begin(), payload.begin() + sizeof(uint32_t));
+                snapshot_.swap(payload);
+            }
+        }
+    }
+    if (!hasReset) {
+        throw std::runtime_error(path + " has no reset to start from");
+    }
+
+    // A recording cut off right after the capture has none of its frames
+    if (snapshotFrame_ >= static_cast<int64_t>(frames_.size())) {
+        snapshotFrame_ = -1;
+        snapshot_.clear();
+    }
+    aout << "Replaying " << path << ": " << frames_.size() << " frames, snapshot of frame " << snapshotFrame_
+         << " kept for frame " << startFrame << std::endl;
+}
+
+std::vector<uint8_t> Replay::takeSnapshot() {
+    next_ = snapshotFrame_ >= 0 ? static_cast<size_t>(snapshotFrame_) : 0;
+    return std::move(snapshot_);
+}
+
+void Replay::report() const {
+    aout << "Replay of " << frameMillis_.size() << " frames: frame p50 " << Utility::percentile(frameMillis_, 0.5f)
+         << " ms, p90 " << Utility::percentile(frameMillis_, 0.9f)
+         << " ms, p99 " << Utility::percentile(frameMillis_, 0.99f)
+         << " ms, GPU simulate p50 " << Utility::percentile(gpuMillis_, 0.5f)
+         << " ms, p99 " << Utility::percentile(gpuMillis_, 0.99f) << " ms" << std::endl;
+}
@@ -0,0 +1,64 @@
+#ifndef ANDROIDGLINVESTIGATIONS_REPLAY_H
+#define ANDROIDGLINVESTIGATIONS_REPLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Recorder.h"
+
+/*!
+ * A recording made by Recorder, its frames loaded whole, fed back to the simulation frame by frame in place
+ * of the wall clock, the input and the budget. The frames run with the same parameters, so on the
+ * same GPU and kernels the particles move the same way, and the frame and GPU times of the run
+ * can be compared between builds. Only the snapshot the replay starts from is kept.
+ */
+class Replay {
+public:
+    /*!
+     * Loads the frames and the newest snapshot at or before @a startFrame, throws
+     * std::runtime_error if @a path isn't a recording this build can read
+     */
+    Replay(const std::string &path, int startFrame);
+
+    const RecordingHeader &header() const { return header_; }
+
+    //! The reset the recording starts from
+    const InitParams &reset() const { return reset_; }
+
+    /*!
+     * Skips to the frame of the snapshot kept for the start frame and hands it over
+     * @return its state blob, empty if there is none, the replay then starts from the reset
+     */
+    std::vector<uint8_t> takeSnapshot();
+
+    //! Starts over from the reset
+    void rewind() { next_ = 0; }
+
+    //! Index of the next frame nextFrame() hands out
+    int frame() const { return static_cast<int>(next_); }
+
+    //! True once every frame has been handed out
+    bool finished() const { return next_ >= frames_.size(); }
+
+    //! The next frame to simulate, only while not finished()
+    const RecordedFrame &nextFrame() { return frames_[next_++]; }
+
+    void addFrameTime(float millis) { frameMillis_.push_back(millis); }
+    void addGpuTime(float millis) { gpuMillis_.push_back(millis); }
+
+    //! Logs the percentiles of the times added since the start
+    void report() const;
+
+private:
+    RecordingHeader header_;
+    InitParams reset_;
+    std::vector<RecordedFrame> frames_;
+    int64_t snapshotFrame_;  // -1 without a snapshot
+    std::vector<uint8_t> snapshot_;
+    size_t next_;
+    std::vector<float> frameMillis_;
+    std::vector<float> gpuMillis_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_REPLAY_H
@@ -2,43 +2,57 @@
 
 #include "AndroidOut.h"
 #include "Model.h"
+#include "ProgramCache.h"
 #include "Utility.h"
 #include <GLES3/gl31.h>
+#include <algorithm>
 
 Shader *Shader::loadShader(
         const std::string &vertexSource,
         const std::string &fragmentSource,
         const std::string &positionAttributeName,
         const std::string &uvAttributeName,
-        const std::string &projectionMatrixUniformName) {
+        const std::string &projectionMatrixUniformName,
+        const Defines &defines,
+        const ProgramCache *cache) {
     // If no fragment source is provided, treat it as a compute shader
     if (fragmentSource.empty()) {
-        return loadComputeShader(vertexSource);
+        return loadComputeShader(vertexSource, defines, cache);
     }
 
     aout << "Loading shader..." << std::endl;
-    aout << "Vertex shader source:\n" << vertexSource << std::endl;
-    aout << "Fragment shader source:\n" << fragmentSource << std::endl;
+    LOG_VERBOSE("Vertex shader source:\n" << vertexSource);
+    LOG_VERBOSE("Fragment shader source:\n" << fragmentSource);
 
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
-    if (!vertexShader) {
-        aout << "Failed to compile vertex shader" << std::endl;
-        return nullptr;
-    }
+    std::vector<std::string> sources = {applyDefines(vertexSource, defines),
+                                        applyDefines(fragmentSource, defines)};
+    GLuint program = cache ? cache->load(sources) : 0;
+    if (!program) {
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, sources[0]);
+        if (!vertexShader) {
+            aout << "Failed to compile vertex shader" << std::endl;
+            return nullptr;
+        }
 
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-    if (!fragmentShader) {
-        aout << "Failed to compile fragment shader" << std::endl;
-        glDeleteShader(vertexShader);
-        return nullptr;
-    }
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, sources[1]);
+        if (!fragmentShader) {
+            aout << "Failed to compile fragment shader" << std::endl;
+            glDeleteShader(vertexShader);
+            return nullptr;
+        }
 
-    GLuint program = linkProgram(vertexShader, fragmentShader);
-    if (!program) {
-        aout << "Failed to link program" << std::endl;
+        program = linkProgram(vertexShader, fragmentShader, cache);
+        
+        // Clean up shaders
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
-        return nullptr;
+        if (!program) {
+            aout << "Failed to link program" << std::endl;
+            return nullptr;
+        }
+        if (cache) {
+            cache->store(program, sources);
+        }
     }
 
     // Get attribute and uniform locations
@@ -70,7 +84,7 @@ Shader *Shader::loadShader(
         }
     }
 
-    // Print all active attributes and uniforms
+    // Print all active attributes, uniforms are reflected and logged by the Shader itself
     GLint numAttributes = 0;
     glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &numAttributes);
     aout << "Number of active attributes: " << numAttributes << std::endl;
@@ -83,25 +97,50 @@ Shader *Shader::loadShader(
         aout << "Attribute " << i << ": " << name << " (location: " 
              << glGetAttribLocation(program, name) << ")" << std::endl;
     }
-    
-    GLint numUniforms = 0;
-    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &numUniforms);
-    aout << "Number of active uniforms: " << numUniforms << std::endl;
 
-    for (GLint i = 0; i < numUniforms; i++) {
-        char name[128];
-        GLint size;
-        GLenum type;
-        glGetActiveUniform(program, i, sizeof(name), nullptr, &size, &type, name);
-        aout << "Uniform " << i << ": " << name << " (location: " 
-             << glGetUniformLocation(program, name) << ")" << std::endl;
+    return new Shader(program, positionAttribute, uvAttribute, projectionMatrixUniform);
+}
+
+std::string Shader::withVersion(const std::string &source, const std::string &version) {
+    auto versionPos = source.find("#version");
+    if (versionPos == std::string::npos) {
+        return "#version " + version + "\n" + source;
     }
+    auto lineEnd = source.find('\n', versionPos);
+    std::string result = source;
+    result.replace(versionPos, lineEnd == std::string::npos ? std::string::npos : lineEnd - versionPos,
+                   "#version " + version);
+    return result;
+}
 
-    // Clean up shaders
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+std::string Shader::applyDefines(const std::string &source, const Defines &defines) {
+    if (defines.empty()) {
+        return source;
+    }
 
-    return new Shader(program, positionAttribute, uvAttribute, projectionMatrixUniform);
+    // #version has to stay the first line, so the defines go right after it
+    size_t insertAt = 0;
+    int versionLine = 0;
+    auto versionPos = source.find("#version");
+    if (versionPos != std::string::npos) {
+        auto lineEnd = source.find('\n', versionPos);
+        insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+        versionLine = static_cast<int>(std::count(source.begin(), source.begin() + insertAt, '\n'));
+    }
+
+    std::string defineBlock;
+    for (const auto &define : defines) {
+        defineBlock += "#define " + define.first + " " + define.second + "\n";
+    }
+    defineBlock += "#line " + std::to_string(versionLine + 1) + "\n";
+
+    std::string result = source;
+    if (insertAt == source.size() && insertAt > 0 && source.back() != '\n') {
+        result += '\n';
+        insertAt++;
+    }
+    result.insert(insertAt, defineBlock);
+    return result;
 }
 
 GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
@@ -147,7 +186,6 @@ void Shader::activate() const {
         aout << "Error activating shader program " << program_ << ": 0x" << std::hex << error << std::endl;
         throw std::runtime_error("Failed to activate shader program");
     }
-    aout << "Activated shader program " << program_ << std::endl;
 }
 
 void Shader::deactivate() const {
@@ -207,10 +245,18 @@ void Shader::setProjectionMatrix(float* projectionMatrix) const {
     }
 }
 
-Shader* Shader::loadComputeShader(const std::string& computeSource) {
+Shader* Shader::loadComputeShader(
+        const std::string& computeSource,
+        const Defines& defines,
+        const ProgramCache* cache) {
     aout << "Creating compute shader..." << std::endl;
     
-    GLuint computeShader = loadShader(GL_COMPUTE_SHADER, computeSource);
+    std::vector<std::string> sources = {applyDefines(computeSource, defines)};
+    if (GLuint cached = cache ? cache->load(sources) : 0) {
+        return new Shader(cached);
+    }
+
+    GLuint computeShader = loadShader(GL_COMPUTE_SHADER, sources[0]);
     if (!computeShader) {
         aout << "Failed to create compute shader" << std::endl;
         return nullptr;
@@ -224,6 +270,9 @@ Shader* Shader::loadComputeShader(const std::string& computeSource) {
     }
 
     glAttachShader(program, computeShader);
+    if (cache) {
+        cache->prepare(program);
+    }
     glLinkProgram(program);
 
     // Get link status and log
@@ -242,22 +291,56 @@ Shader* Shader::loadComputeShader(const std::string& computeSource) {
         return nullptr;
     }
 
-    // Print active uniforms for debugging
+    glDeleteShader(computeShader);
+    if (cache) {
+        cache->store(program, sources);
+    }
+    return new Shader(program);
+}
+
+void Shader::reflectUniforms() {
     GLint numUniforms = 0;
-    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(program_, GL_ACTIVE_UNIFORMS, &numUniforms);
     aout << "Number of active uniforms: " << numUniforms << std::endl;
-    
+
     for (GLint i = 0; i < numUniforms; i++) {
         char name[128];
         GLint size;
         GLenum type;
-        glGetActiveUniform(program, i, sizeof(name), nullptr, &size, &type, name);
-        aout << "Uniform " << i << ": " << name << " (location: " 
-             << glGetUniformLocation(program, name) << ")" << std::endl;
+        glGetActiveUniform(program_, i, sizeof(name), nullptr, &size, &type, name);
+
+        // Members of uniform blocks are active but have no location of their own
+        GLint location = glGetUniformLocation(program_, name);
+        aout << "Uniform " << i << ": " << name << " (location: " << location << ")" << std::endl;
+        if (location == -1) {
+            continue;
+        }
+
+        std::string uniformName(name);
+        uniforms_[uniformName] = location;
+        auto arraySuffix = uniformName.rfind("[0]");
+        if (arraySuffix != std::string::npos && arraySuffix + 3 == uniformName.size()) {
+            uniforms_[uniformName.substr(0, arraySuffix)] = location;
+        }
     }
 
-    glDeleteShader(computeShader);
-    return new Shader(program);
+    GLint numBlocks = 0;
+    glGetProgramiv(program_, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+    for (GLint i = 0; i < numBlocks; i++) {
+        char name[128];
+        GLint binding = -1;
+        GLint dataSize = 0;
+        glGetActiveUniformBlockName(program_, i, sizeof(name), nullptr, name);
+        glGetActiveUniformBlockiv(program_, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+        glGetActiveUniformBlockiv(program_, i, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+        aout << "Uniform block " << i << ": " << name << " (binding: " << binding
+             << ", size: " << dataSize << ")" << std::endl;
+    }
+}
+
+GLint Shader::uniformLocation(const std::string& name) const {
+    auto it = uniforms_.find(name);
+    return it != uniforms_.end() ? it->second : -1;
 }
 
 void Shader::checkError(const char* operation) const {
@@ -288,10 +371,13 @@ GLuint Shader::compileShader(GLenum type, const std::string &source) {
     return shader;
 }
 
-GLuint Shader::linkProgram(GLuint vertexShader, GLuint fragmentShader) {
+GLuint Shader::linkProgram(GLuint vertexShader, GLuint fragmentShader, const ProgramCache *cache) {
     GLuint program = glCreateProgram();
     glAttachShader(program, vertexShader);
     glAttachShader(program, fragmentShader);
+    if (cache) {
+        cache->prepare(program);
+    }
     glLinkProgram(program);
 
     GLint success;
@@ -6,12 +6,26 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "AndroidOut.h"
 
 class Model;
+class ProgramCache;
 
 class Shader {
 public:
+    //! Preprocessor definitions injected into shader sources, name and value
+    using Defines = std::vector<std::pair<std::string, std::string>>;
+
+    /*!
+     * Inserts a #define for each entry right after the #version line of @a source, followed by a
+     * #line directive so compiler errors still point at the right line of the asset
+     */
+    static std::string applyDefines(const std::string& source, const Defines& defines);
+
+    //! Replaces the #version line of @a source with "#version @a version", e.g. "300 es"
+    static std::string withVersion(const std::string& source, const std::string& version);
+
     static GLuint loadShader(GLenum shaderType, const std::string& shaderSource);
 
     static Shader* loadShader(
@@ -19,9 +33,18 @@ public:
             const std::string& fragmentSource,
             const std::string& positionAttributeName,
             const std::string& uvAttributeName,
-            const std::string& projectionMatrixUniformName);
+            const std::string& projectionMatrixUniformName,
+            const Defines& defines = {},
+            const ProgramCache* cache = nullptr);
 
-    static Shader* loadComputeShader(const std::string& computeSource);
+    /*!
+     * Builds a compute program. With a @a cache, the program is loaded from it when possible and
+     * stored in it after a source build.
+     */
+    static Shader* loadComputeShader(
+            const std::string& computeSource,
+            const Defines& defines = {},
+            const ProgramCache* cache = nullptr);
 
     Shader(GLuint program, GLint position, GLint uv, GLint projectionMatrix) :
         program_(program),
@@ -35,6 +58,7 @@ public:
              << " pos=" << position 
              << " uv=" << uv 
              << " proj=" << projectionMatrix << std::endl;
+        reflectUniforms();
     }
 
     explicit Shader(GLuint program) :
@@ -43,6 +67,7 @@ public:
         uv_(-1),
         projectionMatrix_(-1) {
         aout << "Created compute shader with program=" << program << std::endl;
+        reflectUniforms();
     }
 
     ~Shader() {
@@ -52,21 +77,43 @@ public:
         }
     }
 
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    //! Exchanges programs with @a other, a rebuilt program takes the place of this one this way
+    void swap(Shader &other) noexcept {
+        std::swap(program_, other.program_);
+        std::swap(position_, other.position_);
+        std::swap(uv_, other.uv_);
+        std::swap(projectionMatrix_, other.projectionMatrix_);
+        uniforms_.swap(other.uniforms_);
+    }
+
     void activate() const;
     void deactivate() const;
     void drawModel(const Model& model) const;
     void setProjectionMatrix(float* projectionMatrix) const;
     GLuint program() const { return program_; }
+
+    /*!
+     * Looks up a uniform in the table reflected at link time, no GL call is made
+     * @param name the uniform name, array uniforms can be looked up with or without "[0]"
+     * @return the uniform location, or -1 if the program has no such active uniform
+     */
+    GLint uniformLocation(const std::string& name) const;
     void checkError(const char* operation) const;
 
 private:
     static GLuint compileShader(GLenum type, const std::string &source);
-    static GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader);
+    static GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader, const ProgramCache* cache);
+
+    void reflectUniforms();
 
     GLuint program_;
     GLint position_;
     GLint uv_;
     GLint projectionMatrix_;
+    std::unordered_map<std::string, GLint> uniforms_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_SHADER_H
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "ShaderLibrary.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+// Includes nested deeper than this are taken for a cycle
+static constexpr int MAX_INCLUDE_DEPTH = 8;
+
+ShaderLibrary::ShaderLibrary(AAssetManager *assetManager, const ProgramCache *cache,
+                             std::string devDirectory) :
+        assetManager_(assetManager),
+        cache_(cache),
+        devDirectory_(std::move(devDirectory)),
+        lastReload_(std::chrono::steady_clock::now()) {
+    if (!devDirectory_.empty()) {
+        aout << "Shader assets can be overridden from " << devDirectory_ << std::endl;
+    }
+}
+
+Shader *ShaderLibrary::compute(const std::string &path, const Shader::Defines &defines) {
+    std::string key = path;
+    for (const auto &define : defines) {
+        key += ";" + define.first + "=" + define.second;
+    }
+    return find(key, {{path}, defines, "", "", "", {}, nullptr});
+}
+
+Shader *ShaderLibrary::graphics(const std::string &vertexPath, const std::string &fragmentPath,
+                                const Shader::Defines &defines, const std::string &positionAttribute,
+                                const std::string &projectionUniform, const std::string &version) {
+    std::string key = vertexPath + "+" + fragmentPath + "@" + version + ":" + positionAttribute + ","
+            + projectionUniform;
+    for (const auto &define : defines) {
+        key += ";" + define.first + "=" + define.second;
+    }
+    return find(key, {{vertexPath, fragmentPath}, defines, positionAttribute, projectionUniform, version,
+                      {}, nullptr});
+}
+
+Shader *ShaderLibrary::find(const std::string &key, Variant variant) {
+    auto found = variants_.find(key);
+    if (found != variants_.end()) {
+        return found->second.shader.get();
+    }
+
+    variant.shader = build(variant);
+    if (!variant.shader) {
+        return nullptr;
+    }
+    for (const auto &file : variant.files) {
+        if (modified_.find(file) == modified_.end()) {
+            modified_[file] = modifiedTime(file);
+        }
+    }
+    return variants_.emplace(key, std::move(variant)).first->second.shader.get();
+}
+
+std::unique_ptr<Shader> ShaderLibrary::build(Variant &variant) const {
+    std::vector<std::string> files;
+    std::vector<std::string> sources;
+    for (const auto &path : variant.paths) {
+        sources.push_back(source(path, &files));
+        if (!variant.version.empty()) {
+            sources.back() = Shader::withVersion(sources.back(), variant.version);
+        }
+    }
+
+    Shader *shader = sources.size() == 1
+            ? Shader::loadComputeShader(sources[0], variant.defines, cache_)
+            : Shader::loadShader(sources[0], sources[1], variant.positionAttribute, "",
+                                 variant.projectionUniform, variant.defines, cache_);
+    if (!shader) {
+        // Compiler messages name the files by their source string number
+        std::ostringstream table;
+        for (size_t i = 0; i < files.size(); i++) {
+            table << (i ? ", " : "") << i << " = " << files[i];
+        }
+        aout << "Source strings: " << table.str() << std::endl;
+        return nullptr;
+    }
+
+    // The same include can be shared by the stages, it only needs watching once
+    variant.files.clear();
+    for (const auto &file : files) {
+        if (std::find(variant.files.begin(), variant.files.end(), file) == variant.files.end()) {
+            variant.files.push_back(file);
+        }
+    }
+    return std::unique_ptr<Shader>(shader);
+}
+
+std::string ShaderLibrary::source(const std::string &path, std::vector<std::string> *outFiles) const {
+    std::vector<std::string> files;
+    std::string result;
+    append(path, 0, outFiles ? outFiles : &files, &result);
+    return result;
+}
+
+void ShaderLibrary::append(const std::string &path, int depth, std::vector<std::string> *files,
+                           std::string *outSource) const {
+    if (depth > MAX_INCLUDE_DEPTH) {
+        throw std::runtime_error("Shader includes nested too deep at " + path);
+    }
+    int number = static_cast<int>(files->size());
+    files->push_back(path);
+    auto directory = path.substr(0, path.find_last_of('/') + 1);
+
+    std::istringstream text(read(path));
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(text, line)) {
+        lineNumber++;
+        auto start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            *outSource += line + "\n";
+            continue;
+        }
+
+        auto open = line.find('"', start);
+        auto close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            throw std::runtime_error("Malformed #include at " + path + ":" + std::to_string(lineNumber));
+        }
+
+        // The included lines count from 1 in their own source string, then ours continue
+        *outSource += "#line 1 " + std::to_string(files->size()) + "\n";
+        append(directory + line.substr(open + 1, close - open - 1), depth + 1, files, outSource);
+        *outSource += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(number) + "\n";
+    }
+}
+
+std::string ShaderLibrary::read(const std::string &path) const {
+    if (!devDirectory_.empty()) {
+        std::ifstream file(devDirectory_ + "/" + path, std::ios::binary);
+        if (file) {
+            std::ostringstream contents;
+            contents << file.rdbuf();
+            return contents.str();
+        }
+    }
+    return Utility::loadAsset(assetManager_, path);
+}
+
+int64_t ShaderLibrary::modifiedTime(const std::string &path) const {
+    struct stat info{};
+    if (devDirectory_.empty() || stat((devDirectory_ + "/" + path).c_str(), &info) != 0) {
+        return 0;
+    }
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+int ShaderLibrary::reload() {
+    auto now = std::chrono::steady_clock::now();
+    if (devDirectory_.empty() || now - lastReload_ < std::chrono::milliseconds(RELOAD_INTERVAL_MS)) {
+        return 0;
+    }
+    lastReload_ = now;
+
+    std::vector<std::string> changed;
+    for (auto &entry : modified_) {
+        int64_t time = modifiedTime(entry.first);
+        if (time != entry.second) {
+            entry.second = time;
+            changed.push_back(entry.first);
+        }
+    }
+    if (changed.empty()) {
+        return 0;
+    }
+
+    int rebuilt = 0;
+    for (auto &entry : variants_) {
+        auto &variant = entry.second;
+        bool affected = false;
+        for (const auto &file : changed) {
+            affected |= std::find(variant.files.begin(), variant.files.end(), file) != variant.files.end();
+        }
+        if (!affected) {
+            continue;
+        }
+
+        // A bad edit throws from the include resolution or fails to build, the old program stays
+        std::unique_ptr<Shader> shader;
+        try {
+            shader = build(variant);
+        } catch (const std::exception &e) {
+            aout << "Shader reload failed: " << e.what() << std::endl;
+        }
+        if (!shader) {
+            aout << "Keeping the previous build of " << entry.first << std::endl;
+            continue;
+        }
+        variant.shader->swap(*shader);
+        rebuilt++;
+        aout << "Reloaded " << entry.first << std::endl;
+    }
+
+    // Edits can pull in new includes
+    for (auto &entry : variants_) {
+        for (const auto &file : entry.second.files) {
+            if (modified_.find(file) == modified_.end()) {
+                modified_[file] = modifiedTime(file);
+            }
+        }
+    }
+    return rebuilt;
+}
@@ -0,0 +1,106 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SHADERLIBRARY_H
+#define ANDROIDGLINVESTIGATIONS_SHADERLIBRARY_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+
+struct AAssetManager;
+class ProgramCache;
+
+/*!
+ * Builds the GL programs from the shader assets and owns them, one per variant: a set of sources
+ * and the defines they are specialized with. Asking for a variant that was built before returns
+ * the same Shader, so switching between kernels or layouts only compiles each once.
+ *
+ * Sources can pull in shared code with `#include "file"`, resolved relative to the including file.
+ * Each file gets its own source string number in #line directives, a failed build logs which
+ * number is which file. glslc understands the same directive, so the SPIR-V gets the same code.
+ *
+ * With a dev directory, a file found there under its asset path takes the place of the asset,
+ * and reload() rebuilds the variants whose files changed there since, e.g. after
+ * `adb push app/src/main/assets/shaders /sdcard/Android/data/dev.oasdflkjo.particles/files/`.
+ * A rebuild that fails keeps the old program.
+ */
+class ShaderLibrary {
+public:
+    //! reload() looks at the dev directory at most this often
+    static constexpr int RELOAD_INTERVAL_MS = 500;
+
+    /*!
+     * @param cache where linked programs are kept between launches, may be null
+     * @param devDirectory overrides the assets, usually the app's external files dir. Empty for none.
+     */
+    ShaderLibrary(AAssetManager *assetManager, const ProgramCache *cache, std::string devDirectory);
+
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    /*!
+     * The compute program of @a path specialized with @a defines, built on the first request
+     * @return the program, owned by the library, or null if it doesn't build
+     */
+    Shader *compute(const std::string &path, const Shader::Defines &defines = {});
+
+    /*!
+     * The vertex and fragment program of @a vertexPath and @a fragmentPath
+     * @param positionAttribute and @a projectionUniform are looked up for Shader::drawModel() and
+     *        Shader::setProjectionMatrix(), empty if the program has none
+     * @param version replaces the #version of both sources if not empty, e.g. "300 es"
+     * @return the program, owned by the library, or null if it doesn't build
+     */
+    Shader *graphics(const std::string &vertexPath, const std::string &fragmentPath,
+                     const Shader::Defines &defines = {}, const std::string &positionAttribute = "",
+                     const std::string &projectionUniform = "", const std::string &version = "");
+
+    /*!
+     * The source of @a path with its #includes resolved, throws std::runtime_error if a file
+     * can't be read
+     * @param outFiles gets every file the source was put together from, @a path first
+     */
+    std::string source(const std::string &path, std::vector<std::string> *outFiles = nullptr) const;
+
+    /*!
+     * Rebuilds the variants of files that changed in the dev directory. Cheap to call every frame.
+     * The uniforms of a rebuilt program are back at their defaults.
+     * @return how many variants were rebuilt
+     */
+    int reload();
+
+private:
+    struct Variant {
+        std::vector<std::string> paths;  // Compute, or vertex and fragment
+        Shader::Defines defines;
+        std::string positionAttribute;
+        std::string projectionUniform;
+        std::string version;
+        std::vector<std::string> files;  // Every file the sources were put together from
+        std::unique_ptr<Shader> shader;
+    };
+
+    Shader *find(const std::string &key, Variant variant);
+
+    //! Builds @a variant from the current sources and updates its files, null on failure
+    std::unique_ptr<Shader> build(Variant &variant) const;
+
+    std::string read(const std::string &path) const;
+    void append(const std::string &path, int depth, std::vector<std::string> *files,
+                std::string *outSource) const;
+
+    //! Modification time of @a path in the dev directory in nanoseconds, 0 if it isn't there
+    int64_t modifiedTime(const std::string &path) const;
+
+    AAssetManager *assetManager_;
+    const ProgramCache *cache_;
+    std::string devDirectory_;
+    std::unordered_map<std::string, Variant> variants_;
+    std::unordered_map<std::string, int64_t> modified_;  // Dev directory times of the variants' files
+    std::chrono::steady_clock::time_point lastReload_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SHADERLIBRARY_H
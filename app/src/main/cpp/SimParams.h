@@ -0,0 +1,231 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SIMPARAMS_H
+#define ANDROIDGLINVESTIGATIONS_SIMPARAMS_H
+
+#include <GLES3/gl31.h>
+#include <cstddef>
+
+//! Uniform buffer binding point of the SimParams block in particle.comp
+static constexpr GLuint SIM_PARAMS_BINDING = 0;
+
+//! Maximum number of attractors the kernel loops over, must match MAX_ATTRACTORS in particle.comp
+static constexpr int MAX_ATTRACTORS = 10;
+
+//! Maximum number of particle emitters, must match MAX_EMITTERS in the shaders with SimParams
+static constexpr int MAX_EMITTERS = 4;
+
+/*!
+ * One attraction point, a std140 vec4. Negative strength repels. Falloff 0 gives a constant pull
+ * regardless of distance, larger values weaken the pull as 1 / (1 + falloff * distance^2).
+ */
+struct Attractor {
+    float position[2];
+    float strength;
+    float falloff;
+};
+
+/*!
+ * Where particle_emit.comp adds particles when they have lifetimes, a std140 vec4. Emitted
+ * particles start around the position with the velocity plus a random spread.
+ */
+struct Emitter {
+    float position[2];
+    float velocity[2];
+};
+
+/*!
+ * Per-frame simulation parameters. Mirrors the std140 SimParams uniform block in particle.comp and
+ * is uploaded once per frame, so any field can be tuned at runtime without recompiling the shader.
+ */
+struct SimParams {
+    float deltaTime;            // Length of one step, already includes the time scale
+    float damping;
+    float terminalVelocity;
+    GLint attractorCount;
+    GLuint particleCount;       // Active particles, the buffers may hold more. The most alive with lifetimes.
+    GLint stepCount;            // Steps of deltaTime the dispatch takes, 0 leaves the state as is
+    GLuint reorder;             // Non-zero to sort the particles into Morton order on this step
+    float padding;
+    Attractor attractors[MAX_ATTRACTORS];
+    float lifetime;             // Mean seconds an emitted particle lives, only with lifetimes
+    GLuint emitterCount;
+    GLuint emitCount;           // Particles to emit on this step, spread over the emitters
+    GLuint emitSeed;            // New every frame, the random part of emission and first lifetimes
+    Emitter emitters[MAX_EMITTERS];
+};
+
+static_assert(sizeof(Attractor) == 16, "std140 vec4 mismatch");
+static_assert(sizeof(Emitter) == 16, "std140 vec4 mismatch");
+static_assert(offsetof(SimParams, deltaTime) == 0, "std140 offset mismatch");
+static_assert(offsetof(SimParams, damping) == 4, "std140 offset mismatch");
+static_assert(offsetof(SimParams, terminalVelocity) == 8, "std140 offset mismatch");
+static_assert(offsetof(SimParams, attractorCount) == 12, "std140 offset mismatch");
+static_assert(offsetof(SimParams, particleCount) == 16, "std140 offset mismatch");
+static_assert(offsetof(SimParams, stepCount) == 20, "std140 offset mismatch");
+static_assert(offsetof(SimParams, reorder) == 24, "std140 offset mismatch");
+static_assert(offsetof(SimParams, attractors) == 32, "std140 offset mismatch");
+static_assert(offsetof(SimParams, lifetime) == 192, "std140 offset mismatch");
+static_assert(offsetof(SimParams, emitSeed) == 204, "std140 offset mismatch");
+static_assert(offsetof(SimParams, emitters) == 208, "std140 offset mismatch");
+static_assert(sizeof(SimParams) % 16 == 0, "std140 block size must be a multiple of 16");
+
+//! Uniform buffer binding point of the InitParams block in particle_init.comp
+static constexpr GLuint INIT_PARAMS_BINDING = 1;
+
+/*!
+ * Parameters of one run of particle_init.comp, mirrors its std140 InitParams block
+ */
+struct InitParams {
+    GLuint seed;
+    GLuint particleCount;       // Everything up to the capacity is initialized
+    GLuint gridColumns;
+    GLuint gridCount;
+    float origin[2];            // Lower left corner of the spawn area
+    float spacing[2];           // Grid cell size
+    float extent[2];            // Size of the spawn area
+    float maxSpeed;
+    GLuint distribution;        // A ParticleDistribution
+    GLuint aliveCount;          // With lifetimes, the particles alive after the reset
+    GLuint padding[3];
+};
+
+static_assert(offsetof(InitParams, origin) == 16, "std140 offset mismatch");
+static_assert(offsetof(InitParams, spacing) == 24, "std140 offset mismatch");
+static_assert(offsetof(InitParams, extent) == 32, "std140 offset mismatch");
+static_assert(offsetof(InitParams, maxSpeed) == 40, "std140 offset mismatch");
+static_assert(offsetof(InitParams, distribution) == 44, "std140 offset mismatch");
+static_assert(offsetof(InitParams, aliveCount) == 48, "std140 offset mismatch");
+static_assert(sizeof(InitParams) % 16 == 0, "std140 block size must be a multiple of 16");
+
+//! Uniform buffer binding point of the DensityParams block in the density shaders
+static constexpr GLuint DENSITY_PARAMS_BINDING = 2;
+
+//! Storage buffer binding point of the density grid, after the four state buffers
+static constexpr GLuint DENSITY_GRID_BINDING = 4;
+
+//! Side of a density grid cell in pixels
+static constexpr int DENSITY_CELL_SIZE = 2;
+
+//! A cell with n particles is drawn at 1 - exp(-DENSITY_GAIN * n) of full brightness
+static constexpr float DENSITY_GAIN = 0.5f;
+
+/*!
+ * Bytes ahead of the cells in the density grid buffer. The LOD draw mode keeps two indirect draw
+ * commands there, filled on the GPU and drawn with glDrawArraysIndirect or vkCmdDrawIndirect: the
+ * sparse particles at LOD_POINT_DRAW_OFFSET and the dense cells at LOD_SPLAT_DRAW_OFFSET.
+ */
+static constexpr int DENSITY_GRID_HEADER = 32;
+static constexpr int LOD_POINT_DRAW_OFFSET = 0;
+static constexpr int LOD_SPLAT_DRAW_OFFSET = 16;
+
+//! Storage buffer binding points of the LOD splats and the sparse points, after the grid
+static constexpr GLuint LOD_SPLAT_BINDING = 5;
+static constexpr GLuint LOD_POINT_BINDING = 6;
+
+//! Side of an LOD grid cell in pixels, a little more than a sprite
+static constexpr int LOD_CELL_SIZE = 16;
+
+/*!
+ * Cells with more particles than this are drawn as one splat, their particles are skipped. A 14
+ * pixel sprite covers most of a cell, at this count the sprites have long saturated it.
+ */
+static constexpr int LOD_THRESHOLD = 24;
+
+//! Brightness of a splat as DENSITY_GAIN, lower since a cell is 64 times the area
+static constexpr float LOD_GAIN = 0.2f;
+
+/*!
+ * Parameters of the density and LOD draw modes, mirrors the std140 DensityParams block of the
+ * density and lod shaders. The grid holds two uints per cell, the particle count and the summed
+ * speed.
+ */
+struct DensityParams {
+    float projection[16];       // Column-major, as for the sprites
+    GLuint gridSize[2];         // Cells, the viewport rounded up to whole cells
+    GLuint viewportSize[2];     // Pixels
+    GLuint cellSize;            // Pixels per cell side
+    GLuint particleCount;
+    float rewind;               // See RenderBackend::draw()
+    float gain;
+    GLuint lodThreshold;        // LOD_THRESHOLD
+    GLuint pointCapacity;       // Sparse particles the LOD point buffer holds
+    float padding[2];
+};
+
+static_assert(offsetof(DensityParams, gridSize) == 64, "std140 offset mismatch");
+static_assert(offsetof(DensityParams, viewportSize) == 72, "std140 offset mismatch");
+static_assert(offsetof(DensityParams, cellSize) == 80, "std140 offset mismatch");
+static_assert(offsetof(DensityParams, rewind) == 88, "std140 offset mismatch");
+static_assert(offsetof(DensityParams, gain) == 92, "std140 offset mismatch");
+static_assert(offsetof(DensityParams, lodThreshold) == 96, "std140 offset mismatch");
+static_assert(offsetof(DensityParams, pointCapacity) == 100, "std140 offset mismatch");
+static_assert(sizeof(DensityParams) % 16 == 0, "std140 block size must be a multiple of 16");
+
+//! Uniform buffer binding point of the NeighbourParams block in the neighbour kernels
+static constexpr GLuint NEIGHBOUR_PARAMS_BINDING = 3;
+
+/*!
+ * Storage buffer binding points of the neighbour grid passes. They share points with the density
+ * draw, every pass binds what it uses; the force buffer at 7 is also read by the step.
+ */
+static constexpr GLuint NEIGHBOUR_COUNT_BINDING = 4;
+static constexpr GLuint NEIGHBOUR_CELL_BINDING = 5;
+static constexpr GLuint NEIGHBOUR_GRID_BINDING = 6;
+static constexpr GLuint NEIGHBOUR_FORCE_BINDING = 7;
+
+//! Entries of the cell hash table, must match TABLE_SIZE in the neighbour kernels
+static constexpr int NEIGHBOUR_TABLE_SIZE = 1 << 16;
+
+//! Interaction radius of the fluid model in world units, the grid's cell size
+static constexpr float FLUID_RADIUS = 0.12f;
+
+//! Push between two particles at the same spot, fading out quadratically over FLUID_RADIUS
+static constexpr float FLUID_PRESSURE = 20.0f;
+
+//! How fast neighbours match velocities, per second at zero distance
+static constexpr float FLUID_VISCOSITY = 2.0f;
+
+/*!
+ * Parameters of the neighbour grid passes, mirrors the std140 NeighbourParams block of the
+ * neighbour kernels
+ */
+struct NeighbourParams {
+    GLuint particleCount;
+    float cellSize;             // World units, also the interaction radius
+    float pressure;
+    float viscosity;
+};
+
+static_assert(offsetof(NeighbourParams, cellSize) == 4, "std140 offset mismatch");
+static_assert(offsetof(NeighbourParams, viscosity) == 12, "std140 offset mismatch");
+static_assert(sizeof(NeighbourParams) % 16 == 0, "std140 block size must be a multiple of 16");
+
+/*!
+ * Storage buffer binding points of the RadixSort passes: pairs in, pairs out and the histograms.
+ * Shared with the neighbour grid, every pass binds what it uses.
+ */
+static constexpr GLuint RADIX_INPUT_BINDING = 4;
+static constexpr GLuint RADIX_OUTPUT_BINDING = 5;
+static constexpr GLuint RADIX_HISTOGRAM_BINDING = 6;
+
+//! Storage buffer binding point of the sorted order the step gathers through when reordering
+static constexpr GLuint PARTICLE_ORDER_BINDING = 6;
+
+//! Bits of the Morton keys of particle_order.comp, 8 per axis, must match its AXIS_CELLS
+static constexpr int ORDER_KEY_BITS = 16;
+
+//! Morton cell size in world units, about the neighbour grid's so neighbours end up close in memory
+static constexpr float ORDER_CELL_SIZE = 0.125f;
+
+/*!
+ * Storage buffer binding points of the lifetime buffers of the front and back copy, after the
+ * state. Each starts with a header of two indirect commands: at LIFE_DRAW_OFFSET the copy's draw,
+ * whose vertex count is how many of its particles are alive, and at LIFE_DISPATCH_OFFSET the
+ * step over them. A float of seconds left per particle follows at LIFE_HEADER.
+ */
+static constexpr GLuint LIFE_INPUT_BINDING = 4;
+static constexpr GLuint LIFE_OUTPUT_BINDING = 5;
+static constexpr int LIFE_DRAW_OFFSET = 0;
+static constexpr int LIFE_DISPATCH_OFFSET = 16;
+static constexpr int LIFE_HEADER = 32;
+
+#endif //ANDROIDGLINVESTIGATIONS_SIMPARAMS_H
@@ -0,0 +1,126 @@
+#include "StreamingBuffer.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#include <cstring>
+#include <stdexcept>
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+// How long beginWrite() waits for a region's readers before it logs and waits again, a GPU that
+// far behind is stuck or throttled hard
+static constexpr GLuint64 FENCE_TIMEOUT_NS = 100000000;
+
+//! glBufferStorageEXT, null without GL_EXT_buffer_storage
+static PFNGLBUFFERSTORAGEEXTPROC bufferStorage() {
+    static PFNGLBUFFERSTORAGEEXTPROC function = Utility::hasGlExtension("GL_EXT_buffer_storage")
+            ? reinterpret_cast<PFNGLBUFFERSTORAGEEXTPROC>(eglGetProcAddress("glBufferStorageEXT"))
+            : nullptr;
+    return function;
+}
+
+StreamingBuffer::StreamingBuffer(GLenum target, GLsizeiptr regionSize) :
+        target_(target),
+        size_(regionSize),
+        regionSize_(regionSize),
+        buffer_(0),
+        fences_{},
+        region_(REGION_COUNT - 1),
+        persistent_(nullptr),
+        mapped_(false) {
+    if (target_ == GL_UNIFORM_BUFFER) {
+        GLint alignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        regionSize_ = (regionSize_ + alignment - 1) / alignment * alignment;
+    }
+
+    // Errors left by others would fail the check below
+    while (glGetError() != GL_NO_ERROR) {}
+
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(target_, buffer_);
+    GLsizeiptr size = regionSize_ * REGION_COUNT;
+    if (auto storage = bufferStorage()) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+        storage(target_, size, nullptr, flags);
+        persistent_ = static_cast<char *>(glMapBufferRange(target_, 0, size, flags));
+    } else {
+        glBufferData(target_, size, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(target_, 0);
+
+    if (glGetError() != GL_NO_ERROR) {
+        throw std::runtime_error("Failed to create a streaming buffer");
+    }
+}
+
+StreamingBuffer::~StreamingBuffer() {
+    for (auto fence : fences_) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    glDeleteBuffers(1, &buffer_);
+}
+
+void *StreamingBuffer::beginWrite() {
+    region_ = (region_ + 1) % REGION_COUNT;
+    if (auto &fence = fences_[region_]) {
+        // Usually signalled long ago, the region was last read REGION_COUNT - 1 frames back. The
+        // write goes through an unsynchronized mapping, so it never starts before the readers are done.
+        for (;;) {
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+                break;
+            }
+            if (result == GL_WAIT_FAILED) {
+                // Nothing left to wait on, all the GPU's work is finished instead
+                LOG_EVERY_MS(LogLevel::Error, 1000, "Waiting for streaming buffer region " << region_
+                             << " failed, finishing the GPU's work");
+                glFinish();
+                break;
+            }
+            LOG_EVERY_MS(LogLevel::Warn, 1000, "Streaming buffer region " << region_ << " still in use, waiting");
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (persistent_) {
+        return persistent_ + offset(region_);
+    }
+    glBindBuffer(target_, buffer_);
+    mapped_ = true;
+    return glMapBufferRange(target_, offset(region_), regionSize_,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamingBuffer::endWrite() {
+    if (mapped_) {
+        glBindBuffer(target_, buffer_);
+        glUnmapBuffer(target_);
+        glBindBuffer(target_, 0);
+        mapped_ = false;
+    }
+}
+
+void StreamingBuffer::upload(const void *data, GLsizeiptr size) {
+    void *region = beginWrite();
+    if (region) {
+        std::memcpy(region, data, size);
+    }
+    endWrite();
+}
+
+void StreamingBuffer::bindRange(GLuint index) const {
+    glBindBufferRange(target_, index, buffer_, offset(region_), size_);
+}
+
+void StreamingBuffer::fence() {
+    // A region read again without a write gets a newer fence
+    if (fences_[region_]) {
+        glDeleteSync(fences_[region_]);
+    }
+    fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
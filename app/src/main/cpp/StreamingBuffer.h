@@ -0,0 +1,62 @@
+#ifndef ANDROIDGLINVESTIGATIONS_STREAMINGBUFFER_H
+#define ANDROIDGLINVESTIGATIONS_STREAMINGBUFFER_H
+
+#include <GLES3/gl31.h>
+
+/*!
+ * A buffer for data the CPU writes every frame, as a ring of REGION_COUNT regions: a frame writes
+ * the next region while the GPU may still read the ones before it, and a fence put behind a
+ * region's last use tells when it can be written again. Writing never waits for the GPU unless
+ * it is REGION_COUNT - 1 frames behind, unlike glBufferSubData() into a buffer a pending draw or
+ * dispatch still reads.
+ *
+ * With GL_EXT_buffer_storage the buffer is mapped once, persistent and coherent. Without it each
+ * write maps its region with GL_MAP_UNSYNCHRONIZED_BIT, the fences keep that safe.
+ */
+class StreamingBuffer {
+public:
+    static constexpr int REGION_COUNT = 3;
+
+    /*!
+     * Allocates REGION_COUNT regions of at least @a regionSize bytes. Uniform buffer regions are
+     * padded to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT so bindRange() can bind any of them.
+     */
+    StreamingBuffer(GLenum target, GLsizeiptr regionSize);
+    ~StreamingBuffer();
+
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+    //! Moves on to the next region, waiting for its fence, and maps it for writing
+    void *beginWrite();
+
+    //! Unmaps the region, GL commands read it from now on
+    void endWrite();
+
+    //! beginWrite() @a size bytes of @a data and endWrite()
+    void upload(const void *data, GLsizeiptr size);
+
+    //! Binds the region last written at @a index of an indexed target
+    void bindRange(GLuint index) const;
+
+    //! Called after the last command reading the region last written, it isn't written again before that is done
+    void fence();
+
+    GLuint buffer() const { return buffer_; }
+    int region() const { return region_; }
+    GLintptr offset(int region) const { return regionSize_ * region; }
+    GLsizeiptr regionSize() const { return regionSize_; }
+    bool persistent() const { return persistent_ != nullptr; }
+
+private:
+    GLenum target_;
+    GLsizeiptr size_;        // What the caller asked for
+    GLsizeiptr regionSize_;  // Padded
+    GLuint buffer_;
+    GLsync fences_[REGION_COUNT];
+    int region_;
+    char *persistent_;  // The whole buffer, null if every write maps its region
+    bool mapped_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_STREAMINGBUFFER_H
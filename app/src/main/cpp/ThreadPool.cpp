@@ -0,0 +1,172 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sched.h>
+
+#include "AndroidOut.h"
+
+static uint64_t packRange(uint32_t begin, uint32_t end) {
+    return (static_cast<uint64_t>(begin) << 32) | end;
+}
+
+static uint32_t rangeBegin(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+static uint32_t rangeEnd(uint64_t range) { return static_cast<uint32_t>(range); }
+
+//! Highest clock of @a core in kHz, 0 if the kernel doesn't say
+static long maxFrequency(int core) {
+    std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(core) + "/cpufreq/cpuinfo_max_freq");
+    long frequency = 0;
+    file >> frequency;
+    return frequency;
+}
+
+ThreadPool::ThreadPool() :
+        participants_(std::max(1u, std::thread::hardware_concurrency())),
+        queues_(new Queue[participants_]),
+        body_(nullptr),
+        count_(0),
+        grain_(1),
+        generation_(0),
+        busy_(0),
+        quit_(false) {
+    // Fastest first, the order is stable so a cluster keeps its core order
+    std::vector<int> cores(participants_);
+    std::vector<long> frequencies(participants_);
+    for (int core = 0; core < participants_; core++) {
+        cores[core] = core;
+        frequencies[core] = maxFrequency(core);
+    }
+    std::stable_sort(cores.begin(), cores.end(),
+                     [&](int a, int b) { return frequencies[a] > frequencies[b]; });
+
+    // The calling thread isn't pinned, one of the fastest cores is left for it
+    for (int i = 1; i < participants_; i++) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i, cores[i]);
+    }
+    aout << "CPU thread pool: " << participants_ << " threads, fastest core " << cores[0] << " at "
+         << frequencies[cores[0]] / 1000 << " MHz, slowest " << cores.back() << " at "
+         << frequencies[cores.back()] / 1000 << " MHz" << std::endl;
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)> &body) {
+    if (count <= 0) {
+        return;
+    }
+    uint32_t chunks = static_cast<uint32_t>((count + grain - 1) / grain);
+    if (workers_.empty() || chunks == 1) {
+        body(0, count);
+        return;
+    }
+
+    // Equal shares to start with, stealing evens out the rest
+    body_ = &body;
+    count_ = count;
+    grain_ = grain;
+    for (int i = 0; i < participants_; i++) {
+        uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(chunks) * i / participants_);
+        uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(chunks) * (i + 1) / participants_);
+        queues_[i].range.store(packRange(begin, end), std::memory_order_relaxed);
+    }
+    {
+        // The workers read the loop after taking the lock
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_++;
+        busy_ = static_cast<int>(workers_.size());
+    }
+    wake_.notify_all();
+
+    drain(0);
+
+    // Workers may still be in their last chunk
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    body_ = nullptr;
+}
+
+void ThreadPool::workerLoop(int index, int core) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        // aout isn't for other threads, LogLine is
+        LOG_AT(LogLevel::Warn, "Failed to pin CPU worker " << index << " to core " << core);
+    }
+
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return quit_ || generation_ != seen; });
+            if (quit_) {
+                return;
+            }
+            seen = generation_;
+        }
+
+        drain(index);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::drain(int index) {
+    uint32_t chunk;
+    do {
+        while (pop(index, &chunk)) {
+            runChunk(chunk);
+        }
+    } while (steal(index));
+}
+
+bool ThreadPool::pop(int index, uint32_t *outChunk) {
+    // Own chunks from the front, thieves take from the back
+    auto &range = queues_[index].range;
+    uint64_t current = range.load(std::memory_order_acquire);
+    while (rangeBegin(current) < rangeEnd(current)) {
+        if (range.compare_exchange_weak(current, packRange(rangeBegin(current) + 1, rangeEnd(current)),
+                                        std::memory_order_acq_rel)) {
+            *outChunk = rangeBegin(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::steal(int index) {
+    for (int offset = 1; offset < participants_; offset++) {
+        auto &victim = queues_[(index + offset) % participants_].range;
+        uint64_t current = victim.load(std::memory_order_acquire);
+        while (rangeBegin(current) < rangeEnd(current)) {
+            // Half of what the victim has left, rounded up so the last chunk can be taken
+            uint32_t end = rangeEnd(current);
+            uint32_t split = end - (end - rangeBegin(current) + 1) / 2;
+            if (victim.compare_exchange_weak(current, packRange(rangeBegin(current), split),
+                                             std::memory_order_acq_rel)) {
+                // Our range is empty, nobody else writes it until it isn't
+                queues_[index].range.store(packRange(split, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runChunk(uint32_t chunk) {
+    int begin = static_cast<int>(chunk) * grain_;
+    (*body_)(begin, std::min(begin + grain_, count_));
+}
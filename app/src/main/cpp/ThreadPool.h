@@ -0,0 +1,70 @@
+#ifndef ANDROIDGLINVESTIGATIONS_THREADPOOL_H
+#define ANDROIDGLINVESTIGATIONS_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * Worker threads for data parallel loops, one per core but the one left to the calling thread.
+ * Workers are pinned to their core, the fastest cores first, so a loop spreads over the big and
+ * the little cluster alike. Every participant, the caller included, starts on an equal share of
+ * the chunks and steals half of what is left from another one when it runs out, so the big cores
+ * end up doing most of the work without the split having to know how much faster they are.
+ */
+class ThreadPool {
+public:
+    //! Starts a worker per core but one
+    ThreadPool();
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //! Threads a loop runs on, the caller included
+    int participants() const { return participants_; }
+
+    /*!
+     * Calls @a body(begin, end) over [0, @a count) in chunks of @a grain, on the workers and the
+     * calling thread, and returns when every chunk is done. Chunks start at multiples of @a grain,
+     * only the last one may be shorter.
+     */
+    void parallelFor(int count, int grain, const std::function<void(int, int)> &body);
+
+private:
+    //! Chunk indices [begin, end) a participant has left, packed so both move in one CAS
+    struct alignas(64) Queue {
+        std::atomic<uint64_t> range{0};
+    };
+
+    void workerLoop(int index, int core);
+
+    //! Runs chunks from queue @a index, then from the others, until there are none anywhere
+    void drain(int index);
+    bool pop(int index, uint32_t *outChunk);
+    bool steal(int index);
+    void runChunk(uint32_t chunk);
+
+    std::vector<std::thread> workers_;
+    int participants_;
+    std::unique_ptr<Queue[]> queues_;  // 0 is the calling thread's, then one per worker
+
+    // The loop running, set before the generation moves on
+    const std::function<void(int, int)> *body_;
+    int count_;
+    int grain_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_;  // Moves on with every loop, under mutex_
+    int busy_;             // Workers still in the current loop, under mutex_
+    bool quit_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_THREADPOOL_H
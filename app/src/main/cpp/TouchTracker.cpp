@@ -0,0 +1,130 @@
+#include "TouchTracker.h"
+
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+#include <algorithm>
+
+void TouchTracker::onMotionEvent(const GameActivityMotionEvent &motionEvent) {
+    auto action = motionEvent.action & AMOTION_EVENT_ACTION_MASK;
+    int actionIndex = (motionEvent.action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK)
+            >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+
+    // Every event carries all pointers that are down, so the set is rebuilt from scratch each time
+    switch (action) {
+        case AMOTION_EVENT_ACTION_DOWN:
+            // A new gesture, ids start over and the lingering pointers have no history to give
+            count_ = 0;
+            released_ = false;
+            updateFrom(motionEvent, -1);
+            break;
+
+        case AMOTION_EVENT_ACTION_POINTER_DOWN:
+        case AMOTION_EVENT_ACTION_MOVE:
+            released_ = false;
+            updateFrom(motionEvent, -1);
+            break;
+
+        case AMOTION_EVENT_ACTION_POINTER_UP:
+            updateFrom(motionEvent, actionIndex);
+            break;
+
+        case AMOTION_EVENT_ACTION_UP:
+        case AMOTION_EVENT_ACTION_CANCEL:
+            // Keep the last positions so the attractors linger where the fingers lifted
+            updateFrom(motionEvent, -1);
+            released_ = true;
+            break;
+
+        default:
+            break;
+    }
+}
+
+void TouchTracker::updateFrom(const GameActivityMotionEvent &motionEvent, int skipIndex) {
+    // Pointers keep their history across events by id, their index can change
+    auto previous = histories_;
+    int previousCount = count_;
+    count_ = 0;
+    for (int index = 0; index < static_cast<int>(motionEvent.pointerCount); index++) {
+        if (index == skipIndex || count_ == MAX_POINTERS) {
+            continue;
+        }
+        auto &axes = motionEvent.pointers[index];
+        History history{axes.id, 0, {}};
+        for (int i = 0; i < previousCount; i++) {
+            if (previous[i].id == axes.id) {
+                history = previous[i];
+                break;
+            }
+        }
+
+        // A move batches up the samples since the last event, oldest first
+        for (int position = 0; position < motionEvent.historySize; position++) {
+            history.add({motionEvent.historicalEventTimesNanos[position],
+                         GameActivityMotionEvent_getHistoricalX(&motionEvent, index, position),
+                         GameActivityMotionEvent_getHistoricalY(&motionEvent, index, position)});
+        }
+        Pointer pointer{
+                axes.id,
+                GameActivityPointerAxes_getX(&axes),
+                GameActivityPointerAxes_getY(&axes),
+                0.0f,
+                0.0f,
+                motionEvent.eventTime};
+        history.add({pointer.time, pointer.x, pointer.y});
+        history.fitVelocity(&pointer);
+
+        histories_[count_] = history;
+        pointers_[count_++] = pointer;
+    }
+}
+
+void TouchTracker::History::add(const Sample &sample) {
+    // An up or pointer up repeats the last move's sample, only one sample per time counts
+    if (count > 0 && samples[count - 1].time >= sample.time) {
+        samples[count - 1] = sample;
+        return;
+    }
+    if (count == HISTORY_SIZE) {
+        std::copy(samples.begin() + 1, samples.end(), samples.begin());
+        count--;
+    }
+    samples[count++] = sample;
+}
+
+void TouchTracker::History::fitVelocity(Pointer *outPointer) const {
+    int first = count - 1;
+    while (first > 0 && samples[count - 1].time - samples[first - 1].time <= VELOCITY_WINDOW_NS) {
+        first--;
+    }
+    int n = count - first;
+    if (n < 2) {
+        return;
+    }
+
+    // Times relative to the newest sample in seconds, so the sums stay well within float range
+    float meanT = 0.0f;
+    float meanX = 0.0f;
+    float meanY = 0.0f;
+    for (int i = first; i < count; i++) {
+        meanT += static_cast<float>(samples[i].time - samples[count - 1].time) * 1e-9f;
+        meanX += samples[i].x;
+        meanY += samples[i].y;
+    }
+    meanT /= static_cast<float>(n);
+    meanX /= static_cast<float>(n);
+    meanY /= static_cast<float>(n);
+
+    float varianceT = 0.0f;
+    float covarianceX = 0.0f;
+    float covarianceY = 0.0f;
+    for (int i = first; i < count; i++) {
+        float t = static_cast<float>(samples[i].time - samples[count - 1].time) * 1e-9f - meanT;
+        varianceT += t * t;
+        covarianceX += t * (samples[i].x - meanX);
+        covarianceY += t * (samples[i].y - meanY);
+    }
+    if (varianceT > 0.0f) {
+        outPointer->velocityX = covarianceX / varianceT;
+        outPointer->velocityY = covarianceY / varianceT;
+    }
+}
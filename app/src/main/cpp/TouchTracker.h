@@ -0,0 +1,75 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TOUCHTRACKER_H
+#define ANDROIDGLINVESTIGATIONS_TOUCHTRACKER_H
+
+#include <array>
+#include <cstdint>
+
+struct GameActivityMotionEvent;
+
+/*!
+ * Reduces a stream of motion events to the set of pointers currently on screen, in screen
+ * coordinates. When the last finger lifts its final position is kept, so the particles stay
+ * attracted to where the user let go until the next touch.
+ *
+ * Each pointer also gets a velocity, fitted over its samples of the last VELOCITY_WINDOW_NS
+ * including the historical ones an event batches up, so its position can be predicted ahead.
+ */
+class TouchTracker {
+public:
+    //! Upper bound on tracked pointers, GameActivity reports fewer than this per event
+    static constexpr int MAX_POINTERS = 10;
+
+    //! Samples further back than this from a pointer's newest don't count towards its velocity
+    static constexpr int64_t VELOCITY_WINDOW_NS = 40000000;
+
+    struct Pointer {
+        int32_t id;
+        float x;
+        float y;
+        float velocityX;  // Pixels per second, 0 until the pointer has two samples
+        float velocityY;
+        int64_t time;     // eventTime of the newest sample in nanoseconds, the steady_clock time base
+    };
+
+    TouchTracker() : count_(0), released_(false) {}
+
+    void onMotionEvent(const GameActivityMotionEvent &motionEvent);
+
+    //! Number of pointers in @a pointer(), including lingering ones after the last finger lifted
+    int pointerCount() const { return count_; }
+
+    const Pointer &pointer(int index) const { return pointers_[index]; }
+
+    //! True once every finger has lifted and the remaining pointers are only remembered positions
+    bool released() const { return released_; }
+
+private:
+    static constexpr int HISTORY_SIZE = 8;
+
+    struct Sample {
+        int64_t time;
+        float x;
+        float y;
+    };
+
+    //! Newest samples of a pointer, oldest first
+    struct History {
+        int32_t id;
+        int count;
+        std::array<Sample, HISTORY_SIZE> samples;
+
+        void add(const Sample &sample);
+
+        //! Least squares fit of the samples in the window, @a outPointer gets its velocity
+        void fitVelocity(Pointer *outPointer) const;
+    };
+
+    void updateFrom(const GameActivityMotionEvent &motionEvent, int skipIndex);
+
+    std::array<Pointer, MAX_POINTERS> pointers_;
+    std::array<History, MAX_POINTERS> histories_;  // Of pointers_, in the same order
+    int count_;
+    bool released_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TOUCHTRACKER_H
@@ -1,7 +1,12 @@
 #include "Utility.h"
 #include "AndroidOut.h"
 
+#include <game-activity/native_app_glue/android_native_app_glue.h>
 #include <GLES3/gl3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sys/system_properties.h>
 
 #define CHECK_ERROR(e) case e: aout << "GL Error: "#e << std::endl; break;
 
@@ -26,6 +31,18 @@ bool Utility::checkAndLogGlError(bool alwaysLog) {
     }
 }
 
+bool Utility::hasGlExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        auto extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 float *
 Utility::buildOrthographicMatrix(float *outMatrix, float halfHeight, float aspect, float near,
                                  float far) {
@@ -101,4 +118,61 @@ std::string Utility::loadAsset(AAssetManager* mgr, const std::string& path) {
     AAsset_close(asset);
     
     return content;
-}
\ No newline at end of file
+}
+
+std::string Utility::getSystemProperty(const char* name, const std::string& fallback) {
+    char value[PROP_VALUE_MAX] = {0};
+    if (__system_property_get(name, value) > 0) {
+        return value;
+    }
+    return fallback;
+}
+
+std::string Utility::getIntentExtra(android_app *app, const char *name) {
+    std::string value;
+    if (!app || !app->activity || !app->activity->vm) {
+        return value;
+    }
+    JNIEnv *env;
+    app->activity->vm->AttachCurrentThread(&env, nullptr);
+
+    jobject activity = app->activity->javaGameActivity;
+    jclass activityClass = env->GetObjectClass(activity);
+    jmethodID getIntent = env->GetMethodID(activityClass, "getIntent", "()Landroid/content/Intent;");
+    jobject intent = env->CallObjectMethod(activity, getIntent);
+    if (intent) {
+        jclass intentClass = env->GetObjectClass(intent);
+        jmethodID getStringExtra = env->GetMethodID(
+                intentClass, "getStringExtra", "(Ljava/lang/String;)Ljava/lang/String;");
+        jobject key = env->NewStringUTF(name);
+        auto extra = static_cast<jstring>(env->CallObjectMethod(intent, getStringExtra, key));
+        if (extra) {
+            const char *chars = env->GetStringUTFChars(extra, nullptr);
+            value = chars;
+            env->ReleaseStringUTFChars(extra, chars);
+            env->DeleteLocalRef(extra);
+        }
+        env->DeleteLocalRef(key);
+        env->DeleteLocalRef(intentClass);
+        env->DeleteLocalRef(intent);
+    }
+    env->DeleteLocalRef(activityClass);
+
+    app->activity->vm->DetachCurrentThread();
+    return value;
+}
+
+bool Utility::isFinite(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x7f800000u) != 0x7f800000u;
+}
+
+float Utility::percentile(std::vector<float> samples, float fraction) {
+    if (samples.empty()) {
+        return 0.0f;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t rank = static_cast<size_t>(std::ceil(fraction * samples.size()));
+    return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
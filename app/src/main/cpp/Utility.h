@@ -2,16 +2,23 @@
 #define ANDROIDGLINVESTIGATIONS_UTILITY_H
 
 #include <cassert>
+#include <cstdint>
 #include <string>
 #include <stdexcept>
+#include <vector>
 #include <android/asset_manager.h>
 
+struct android_app;
+
 class Utility {
 public:
     static bool checkAndLogGlError(bool alwaysLog = false);
 
     static inline void assertGlError() { assert(checkAndLogGlError()); }
 
+    //! Returns true if the current GL context advertises the extension @a name
+    static bool hasGlExtension(const char* name);
+
     /**
      * Generates an orthographic projection matrix given the half height, aspect ratio, near, and far
      * planes
@@ -34,6 +41,26 @@ public:
     static float *buildIdentityMatrix(float *outMatrix);
 
     static std::string loadAsset(AAssetManager* mgr, const std::string& path);
+
+    /*!
+     * Reads an Android system property, e.g. one set with `adb shell setprop debug.particles.x y`
+     *
+     * @param name the property name
+     * @param fallback returned when the property is unset or empty
+     */
+    static std::string getSystemProperty(const char* name, const std::string& fallback = "");
+
+    //! String extra @a name of the intent that started the activity, empty if it has none
+    static std::string getIntentExtra(android_app *app, const char *name);
+
+    /*!
+     * False for NaN and infinities. Reads the exponent bits, so it still works under -ffast-math,
+     * which folds std::isfinite and std::isnan to constants.
+     */
+    static bool isFinite(float value);
+
+    //! The nearest-rank @a fraction percentile of @a samples, 0 if there are none
+    static float percentile(std::vector<float> samples, float fraction);
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_UTILITY_H
\ No newline at end of file
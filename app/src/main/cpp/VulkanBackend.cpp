@@ -0,0 +1,2239 @@
+#include "VulkanBackend.h"
+
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "AndroidOut.h"
+#include "FramePacer.h"
+#include "ParticleState.h"
+#include "RadixSort.h"
+#include "Utility.h"
+
+//! Throws a std::runtime_error naming the call if it doesn't return VK_SUCCESS
+#define VK_CHECK(call) { \
+    VkResult vkCheckResult = (call); \
+    if (vkCheckResult != VK_SUCCESS) { \
+        throw std::runtime_error(std::string(#call " failed: ") + std::to_string(vkCheckResult)); \
+    } \
+}
+
+static constexpr uint32_t NO_QUEUE_FAMILY = UINT32_MAX;
+
+// particle_init.comp has a fixed workgroup size
+static constexpr uint32_t INIT_LOCAL_SIZE = 256;
+
+// And so does particle_emit.comp
+static constexpr uint32_t EMIT_LOCAL_SIZE = 256;
+
+// Floats in particle.vert's PushConstants block: the projection, uRewind and uPointSize
+static constexpr int SPRITE_CONSTANT_COUNT = 18;
+
+// Push constants of particle_order.comp and the radix sort passes, their RadixPass block
+struct SortPass {
+    uint32_t count;
+    uint32_t shift;
+    uint32_t entries;   // Histogram entries, RADIX per workgroup
+    float cellSize;
+};
+
+// Checked before anything is created, so a build without SPIR-V falls back to GL cleanly
+static constexpr const char *SPIRV_PROBE_ASSET = "shaders/spirv/particle.comp.soa.spv";
+
+/*!
+ * Finds a queue family that does graphics and compute and, if @a surface is given, can present to it
+ * @return the family index, NO_QUEUE_FAMILY if there is none
+ */
+static uint32_t findQueueFamily(VkPhysicalDevice device, VkSurfaceKHR surface) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, families.data());
+
+    constexpr VkQueueFlags required = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    for (uint32_t i = 0; i < count; i++) {
+        if ((families[i].queueFlags & required) != required) {
+            continue;
+        }
+        VkBool32 canPresent = VK_TRUE;
+        if (surface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &canPresent);
+        }
+        if (canPresent) {
+            return i;
+        }
+    }
+    return NO_QUEUE_FAMILY;
+}
+
+/*!
+ * Finds a compute queue family without graphics, the one drivers map to an async compute engine.
+ * When the graphics family has timestamps the compute family needs them too, so GPU times stay.
+ * @return the family index, NO_QUEUE_FAMILY if there is none
+ */
+static uint32_t findComputeFamily(VkPhysicalDevice device, uint32_t graphicsFamily) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, families.data());
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!(families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) || (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        if (families[i].timestampValidBits == 0 && families[graphicsFamily].timestampValidBits > 0) {
+            continue;
+        }
+        return i;
+    }
+    return NO_QUEUE_FAMILY;
+}
+
+//! The first Vulkan 1.1 device with a usable queue family, VK_NULL_HANDLE if there is none
+static VkPhysicalDevice findPhysicalDevice(VkInstance instance, VkSurfaceKHR surface) {
+    uint32_t count = 0;
+    vkEnumeratePhysicalDevices(instance, &count, nullptr);
+    std::vector<VkPhysicalDevice> devices(count);
+    vkEnumeratePhysicalDevices(instance, &count, devices.data());
+
+    for (auto device : devices) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion >= VK_API_VERSION_1_1
+                && findQueueFamily(device, surface) != NO_QUEUE_FAMILY) {
+            return device;
+        }
+    }
+    return VK_NULL_HANDLE;
+}
+
+static VkInstance createVkInstance(bool withSurface) {
+    VkApplicationInfo appInfo{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    appInfo.pApplicationName = "Particles";
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+
+    const char *extensions[] = {VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_ANDROID_SURFACE_EXTENSION_NAME};
+    VkInstanceCreateInfo createInfo{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+    createInfo.pApplicationInfo = &appInfo;
+    createInfo.enabledExtensionCount = withSurface ? 2 : 0;
+    createInfo.ppEnabledExtensionNames = extensions;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    return instance;
+}
+
+bool VulkanBackend::isSupported() {
+    uint32_t version = VK_API_VERSION_1_0;
+    if (vkEnumerateInstanceVersion(&version) != VK_SUCCESS || version < VK_API_VERSION_1_1) {
+        return false;
+    }
+
+    VkInstance instance = createVkInstance(false);
+    if (instance == VK_NULL_HANDLE) {
+        return false;
+    }
+    bool supported = findPhysicalDevice(instance, VK_NULL_HANDLE) != VK_NULL_HANDLE;
+    vkDestroyInstance(instance, nullptr);
+    return supported;
+}
+
+VulkanBackend::VulkanBackend(android_app *app, FramePacer *pacer) :
+        app_(app),
+        pacer_(pacer),
+        instance_(VK_NULL_HANDLE),
+        physicalDevice_(VK_NULL_HANDLE),
+        properties_{},
+        largePoints_(false),
+        device_(VK_NULL_HANDLE),
+        queueFamily_(NO_QUEUE_FAMILY),
+        queue_(VK_NULL_HANDLE),
+        commandPool_(VK_NULL_HANDLE),
+        asyncCompute_(false),
+        computeFamily_(NO_QUEUE_FAMILY),
+        computeQueue_(VK_NULL_HANDLE),
+        computePool_(VK_NULL_HANDLE),
+        lastStepDone_(VK_NULL_HANDLE),
+        lastDrawDone_(VK_NULL_HANDLE),
+        initDone_(VK_NULL_HANDLE),
+        surface_(VK_NULL_HANDLE),
+        swapchain_(VK_NULL_HANDLE),
+        swapchainFormat_(VK_FORMAT_UNDEFINED),
+        extent_{0, 0},
+        renderPass_(VK_NULL_HANDLE),
+        frameIndex_(0),
+        imageIndex_(0),
+        frameActive_(false),
+        passActive_(false),
+        pointSize_(DEFAULT_POINT_SIZE),
+        queryPool_(VK_NULL_HANDLE),
+        layout_(ParticleLayout::SoA32),
+        capacity_(0),
+        kernel_{0, 1},
+        stateBuffers_{},
+        stateMemory_{},
+        stateBufferCount_(0),
+        front_(0),
+        stateSetLayout_(VK_NULL_HANDLE),
+        paramsSetLayout_(VK_NULL_HANDLE),
+        descriptorPool_(VK_NULL_HANDLE),
+        stateSets_{VK_NULL_HANDLE, VK_NULL_HANDLE},
+        initParamsSet_(VK_NULL_HANDLE),
+        computeLayout_(VK_NULL_HANDLE),
+        graphicsLayout_(VK_NULL_HANDLE),
+        initPipeline_(VK_NULL_HANDLE),
+        stepPipeline_(VK_NULL_HANDLE),
+        graphicsPipeline_(VK_NULL_HANDLE),
+        drawMode_(DrawMode::Sprites),
+        densitySetLayout_(VK_NULL_HANDLE),
+        densityLayout_(VK_NULL_HANDLE),
+        densitySplatPipeline_(VK_NULL_HANDLE),
+        densityPipeline_(VK_NULL_HANDLE),
+        densityGrid_(VK_NULL_HANDLE),
+        densityMemory_(VK_NULL_HANDLE),
+        densityGridSize_{0, 0},
+        lodCellsPipeline_(VK_NULL_HANDLE),
+        lodPointsPipeline_(VK_NULL_HANDLE),
+        lodSplatPipeline_(VK_NULL_HANDLE),
+        lodPointPipeline_(VK_NULL_HANDLE),
+        lodSplats_(VK_NULL_HANDLE),
+        lodSplatMemory_(VK_NULL_HANDLE),
+        lodPoints_(VK_NULL_HANDLE),
+        lodPointMemory_(VK_NULL_HANDLE),
+        interaction_(Interaction::None),
+        neighbourParams_{},
+        neighbourSetLayout_(VK_NULL_HANDLE),
+        neighbourLayout_(VK_NULL_HANDLE),
+        neighbourCountPipeline_(VK_NULL_HANDLE),
+        neighbourScanPipeline_(VK_NULL_HANDLE),
+        neighbourScatterPipeline_(VK_NULL_HANDLE),
+        neighbourForcePipeline_(VK_NULL_HANDLE),
+        neighbourBuffers_{},
+        neighbourMemory_{},
+        neighbourCountsCleared_(false),
+        reorder_(false),
+        sortSetLayout_(VK_NULL_HANDLE),
+        sortLayout_(VK_NULL_HANDLE),
+        sortSets_{VK_NULL_HANDLE, VK_NULL_HANDLE},
+        orderPipeline_(VK_NULL_HANDLE),
+        radixHistogramPipeline_(VK_NULL_HANDLE),
+        radixScanPipeline_(VK_NULL_HANDLE),
+        radixScatterPipeline_(VK_NULL_HANDLE),
+        sortPairs_{},
+        sortPairMemory_{},
+        sortHistograms_(VK_NULL_HANDLE),
+        sortHistogramMemory_(VK_NULL_HANDLE),
+        lifetimes_(false),
+        lifeBuffers_{},
+        lifeMemory_{},
+        dispatchPipeline_(VK_NULL_HANDLE),
+        emitPipeline_(VK_NULL_HANDLE) {
+    AAsset *probe = AAssetManager_open(app_->activity->assetManager, SPIRV_PROBE_ASSET, AASSET_MODE_UNKNOWN);
+    if (!probe) {
+        throw std::runtime_error("SPIR-V shaders are missing from the assets");
+    }
+    AAsset_close(probe);
+
+    // Nothing is half built if this throws, the destructor doesn't run for a failed constructor
+    try {
+        instance_ = createVkInstance(true);
+        if (instance_ == VK_NULL_HANDLE) {
+            throw std::runtime_error("Failed to create a Vulkan 1.1 instance");
+        }
+        createSurface(app_->window);
+        pickPhysicalDevice();
+        createDevice();
+        createSwapchain();
+        createFrames();
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+VulkanBackend::~VulkanBackend() {
+    destroy();
+}
+
+void VulkanBackend::destroy() {
+    if (device_ != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device_);
+
+        vkDestroyPipeline(device_, emitPipeline_, nullptr);
+        vkDestroyPipeline(device_, dispatchPipeline_, nullptr);
+        for (int i = 0; i < 2; i++) {
+            vkDestroyBuffer(device_, lifeBuffers_[i], nullptr);
+            vkFreeMemory(device_, lifeMemory_[i], nullptr);
+        }
+        vkDestroyPipeline(device_, radixScatterPipeline_, nullptr);
+        vkDestroyPipeline(device_, radixScanPipeline_, nullptr);
+        vkDestroyPipeline(device_, radixHistogramPipeline_, nullptr);
+        vkDestroyPipeline(device_, orderPipeline_, nullptr);
+        vkDestroyPipelineLayout(device_, sortLayout_, nullptr);
+        vkDestroyDescriptorSetLayout(device_, sortSetLayout_, nullptr);
+        for (int i = 0; i < 2; i++) {
+            vkDestroyBuffer(device_, sortPairs_[i], nullptr);
+            vkFreeMemory(device_, sortPairMemory_[i], nullptr);
+        }
+        vkDestroyBuffer(device_, sortHistograms_, nullptr);
+        vkFreeMemory(device_, sortHistogramMemory_, nullptr);
+        vkDestroyPipeline(device_, neighbourForcePipeline_, nullptr);
+        vkDestroyPipeline(device_, neighbourScatterPipeline_, nullptr);
+        vkDestroyPipeline(device_, neighbourScanPipeline_, nullptr);
+        vkDestroyPipeline(device_, neighbourCountPipeline_, nullptr);
+        vkDestroyPipelineLayout(device_, neighbourLayout_, nullptr);
+        vkDestroyDescriptorSetLayout(device_, neighbourSetLayout_, nullptr);
+        for (int i = 0; i < NEIGHBOUR_BUFFER_COUNT; i++) {
+            vkDestroyBuffer(device_, neighbourBuffers_[i], nullptr);
+            vkFreeMemory(device_, neighbourMemory_[i], nullptr);
+        }
+        vkDestroyPipeline(device_, lodPointPipeline_, nullptr);
+        vkDestroyPipeline(device_, lodSplatPipeline_, nullptr);
+        vkDestroyPipeline(device_, lodPointsPipeline_, nullptr);
+        vkDestroyPipeline(device_, lodCellsPipeline_, nullptr);
+        vkDestroyBuffer(device_, lodPoints_, nullptr);
+        vkFreeMemory(device_, lodPointMemory_, nullptr);
+        vkDestroyBuffer(device_, lodSplats_, nullptr);
+        vkFreeMemory(device_, lodSplatMemory_, nullptr);
+        vkDestroyPipeline(device_, densityPipeline_, nullptr);
+        vkDestroyPipeline(device_, densitySplatPipeline_, nullptr);
+        vkDestroyPipelineLayout(device_, densityLayout_, nullptr);
+        vkDestroyDescriptorSetLayout(device_, densitySetLayout_, nullptr);
+        vkDestroyBuffer(device_, densityGrid_, nullptr);
+        vkFreeMemory(device_, densityMemory_, nullptr);
+        vkDestroyPipeline(device_, graphicsPipeline_, nullptr);
+        vkDestroyPipeline(device_, stepPipeline_, nullptr);
+        vkDestroyPipeline(device_, initPipeline_, nullptr);
+        vkDestroyPipelineLayout(device_, graphicsLayout_, nullptr);
+        vkDestroyPipelineLayout(device_, computeLayout_, nullptr);
+        vkDestroyDescriptorPool(device_, descriptorPool_, nullptr);
+        vkDestroyDescriptorSetLayout(device_, paramsSetLayout_, nullptr);
+        vkDestroyDescriptorSetLayout(device_, stateSetLayout_, nullptr);
+        for (int copy = 0; copy < 2; copy++) {
+            for (int i = 0; i < stateBufferCount_; i++) {
+                vkDestroyBuffer(device_, stateBuffers_[copy][i], nullptr);
+                vkFreeMemory(device_, stateMemory_[copy][i], nullptr);
+            }
+        }
+        destroyHostBuffer(initParams_);
+
+        for (auto &frame : frames_) {
+            for (VkPipeline pipeline : frame.retired) {
+                vkDestroyPipeline(device_, pipeline, nullptr);
+            }
+            destroyHostBuffer(frame.params);
+            destroyHostBuffer(frame.densityParams);
+            destroyHostBuffer(frame.neighbourParams);
+            vkDestroyFence(device_, frame.fence, nullptr);
+            vkDestroySemaphore(device_, frame.imageAcquired, nullptr);
+            vkDestroyFence(device_, frame.computeFence, nullptr);
+            vkDestroySemaphore(device_, frame.stepDone, nullptr);
+            vkDestroySemaphore(device_, frame.drawDone, nullptr);
+        }
+        vkDestroySemaphore(device_, initDone_, nullptr);
+        vkDestroyQueryPool(device_, queryPool_, nullptr);
+
+        destroySwapchain();
+        vkDestroyRenderPass(device_, renderPass_, nullptr);
+        vkDestroyCommandPool(device_, computePool_, nullptr);
+        vkDestroyCommandPool(device_, commandPool_, nullptr);
+        vkDestroyDevice(device_, nullptr);
+        device_ = VK_NULL_HANDLE;
+    }
+    if (surface_ != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance_, surface_, nullptr);
+        surface_ = VK_NULL_HANDLE;
+    }
+    if (instance_ != VK_NULL_HANDLE) {
+        vkDestroyInstance(instance_, nullptr);
+        instance_ = VK_NULL_HANDLE;
+    }
+}
+
+std::string VulkanBackend::deviceName() const {
+    return properties_.deviceName;
+}
+
+std::string VulkanBackend::apiVersion() const {
+    std::ostringstream version;
+    version << "Vulkan " << VK_VERSION_MAJOR(properties_.apiVersion) << "."
+            << VK_VERSION_MINOR(properties_.apiVersion) << "."
+            << VK_VERSION_PATCH(properties_.apiVersion)
+            << ", driver 0x" << std::hex << properties_.driverVersion;
+    return version.str();
+}
+
+int VulkanBackend::maxCapacity(ParticleLayout layout) const {
+    size_t stride = std::max(ParticleState::bufferStride(layout, 0), ParticleState::bufferStride(layout, 1));
+    uint64_t capacity = properties_.limits.maxStorageBufferRange / stride;
+    return static_cast<int>(std::min<uint64_t>(capacity, INT_MAX));
+}
+
+int VulkanBackend::maxLocalSize() const {
+    return static_cast<int>(std::min(properties_.limits.maxComputeWorkGroupInvocations,
+                                     properties_.limits.maxComputeWorkGroupSize[0]));
+}
+
+void VulkanBackend::createSurface(ANativeWindow *window) {
+    VkAndroidSurfaceCreateInfoKHR createInfo{VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR};
+    createInfo.window = window;
+    VK_CHECK(vkCreateAndroidSurfaceKHR(instance_, &createInfo, nullptr, &surface_));
+}
+
+void VulkanBackend::pickPhysicalDevice() {
+    physicalDevice_ = findPhysicalDevice(instance_, surface_);
+    if (physicalDevice_ == VK_NULL_HANDLE) {
+        throw std::runtime_error("No Vulkan 1.1 device with a graphics, compute and present queue");
+    }
+    queueFamily_ = findQueueFamily(physicalDevice_, surface_);
+    vkGetPhysicalDeviceProperties(physicalDevice_, &properties_);
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice_, &features);
+    largePoints_ = features.largePoints == VK_TRUE;
+
+    aout << "Vulkan device: " << properties_.deviceName << ", " << apiVersion() << std::endl;
+}
+
+void VulkanBackend::createDevice() {
+    computeFamily_ = queueFamily_;
+    if (Utility::getSystemProperty("debug.particles.async_compute", "1") != "0") {
+        uint32_t family = findComputeFamily(physicalDevice_, queueFamily_);
+        if (family != NO_QUEUE_FAMILY) {
+            computeFamily_ = family;
+            asyncCompute_ = true;
+        }
+    }
+    aout << "Vulkan step runs on " << (asyncCompute_ ? "an async compute queue" : "the graphics queue")
+         << std::endl;
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfos[2] = {};
+    for (int i = 0; i < 2; i++) {
+        queueInfos[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfos[i].queueFamilyIndex = i == 0 ? queueFamily_ : computeFamily_;
+        queueInfos[i].queueCount = 1;
+        queueInfos[i].pQueuePriorities = &priority;
+    }
+
+    // particle.vert sets gl_PointSize, without largePoints every point is a single pixel
+    VkPhysicalDeviceFeatures features{};
+    features.largePoints = largePoints_ ? VK_TRUE : VK_FALSE;
+    if (!largePoints_) {
+        aout << "Vulkan device has no largePoints, particles are drawn one pixel wide" << std::endl;
+    }
+
+    const char *extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    VkDeviceCreateInfo createInfo{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    createInfo.queueCreateInfoCount = asyncCompute_ ? 2 : 1;
+    createInfo.pQueueCreateInfos = queueInfos;
+    createInfo.enabledExtensionCount = 1;
+    createInfo.ppEnabledExtensionNames = extensions;
+    createInfo.pEnabledFeatures = &features;
+    VK_CHECK(vkCreateDevice(physicalDevice_, &createInfo, nullptr, &device_));
+    vkGetDeviceQueue(device_, queueFamily_, 0, &queue_);
+
+    VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamily_;
+    VK_CHECK(vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool_));
+
+    computeQueue_ = queue_;
+    if (asyncCompute_) {
+        vkGetDeviceQueue(device_, computeFamily_, 0, &computeQueue_);
+        poolInfo.queueFamilyIndex = computeFamily_;
+        VK_CHECK(vkCreateCommandPool(device_, &poolInfo, nullptr, &computePool_));
+    }
+
+    // GPU times need timestamps on this queue that are comparable across compute and graphics
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &familyCount, families.data());
+    if (properties_.limits.timestampComputeAndGraphics && families[queueFamily_].timestampValidBits > 0) {
+        VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = FRAMES_IN_FLIGHT * QUERIES_PER_FRAME;
+        VK_CHECK(vkCreateQueryPool(device_, &queryInfo, nullptr, &queryPool_));
+    } else {
+        aout << "Vulkan timestamps not available, profiling CPU time only" << std::endl;
+    }
+}
+
+void VulkanBackend::createSwapchain() {
+    VkSurfaceCapabilitiesKHR capabilities;
+    VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice_, surface_, &capabilities));
+    extent_ = capabilities.currentExtent;
+
+    uint32_t formatCount = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice_, surface_, &formatCount, nullptr);
+    std::vector<VkSurfaceFormatKHR> formats(formatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice_, surface_, &formatCount, formats.data());
+    if (formats.empty()) {
+        throw std::runtime_error("Surface has no formats");
+    }
+
+    // 8 bit UNORM like the EGL config, so blending looks the same on both backends
+    VkSurfaceFormatKHR format = formats[0];
+    for (auto &candidate : formats) {
+        if (candidate.format == VK_FORMAT_R8G8B8A8_UNORM) {
+            format = candidate;
+            break;
+        }
+    }
+    if (renderPass_ != VK_NULL_HANDLE && format.format != swapchainFormat_) {
+        throw std::runtime_error("Surface format changed");
+    }
+    swapchainFormat_ = format.format;
+    if (renderPass_ == VK_NULL_HANDLE) {
+        createRenderPass();
+    }
+
+    // FIFO paces like eglSwapInterval(1). Sleep pacing wants no vsync wait, mailbox is the
+    // closest that doesn't tear.
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    if (pacer_->swapInterval() == 0) {
+        uint32_t modeCount = 0;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice_, surface_, &modeCount, nullptr);
+        std::vector<VkPresentModeKHR> modes(modeCount);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice_, surface_, &modeCount, modes.data());
+        if (std::find(modes.begin(), modes.end(), VK_PRESENT_MODE_MAILBOX_KHR) != modes.end()) {
+            presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+    }
+
+    uint32_t imageCount = std::max(capabilities.minImageCount, 3u);
+    if (capabilities.maxImageCount > 0) {
+        imageCount = std::min(imageCount, capabilities.maxImageCount);
+    }
+
+    VkSwapchainCreateInfoKHR createInfo{VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR};
+    createInfo.surface = surface_;
+    createInfo.minImageCount = imageCount;
+    createInfo.imageFormat = format.format;
+    createInfo.imageColorSpace = format.colorSpace;
+    createInfo.imageExtent = extent_;
+    createInfo.imageArrayLayers = 1;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // The compositor rotates, so the projection is the same as on GL
+    createInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    createInfo.compositeAlpha = (capabilities.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR)
+            ? VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR : VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+    createInfo.presentMode = presentMode;
+    createInfo.clipped = VK_TRUE;
+    VK_CHECK(vkCreateSwapchainKHR(device_, &createInfo, nullptr, &swapchain_));
+
+    uint32_t count = 0;
+    vkGetSwapchainImagesKHR(device_, swapchain_, &count, nullptr);
+    std::vector<VkImage> images(count);
+    vkGetSwapchainImagesKHR(device_, swapchain_, &count, images.data());
+
+    images_.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewInfo.image = images[i];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = swapchainFormat_;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        VK_CHECK(vkCreateImageView(device_, &viewInfo, nullptr, &images_[i].view));
+
+        VkFramebufferCreateInfo framebufferInfo{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+        framebufferInfo.renderPass = renderPass_;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &images_[i].view;
+        framebufferInfo.width = extent_.width;
+        framebufferInfo.height = extent_.height;
+        framebufferInfo.layers = 1;
+        VK_CHECK(vkCreateFramebuffer(device_, &framebufferInfo, nullptr, &images_[i].framebuffer));
+
+        VkSemaphoreCreateInfo semaphoreInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &images_[i].renderFinished));
+    }
+
+    aout << "Vulkan swapchain " << extent_.width << " x " << extent_.height << ", " << count
+         << " images" << std::endl;
+}
+
+void VulkanBackend::destroySwapchain() {
+    if (swapchain_ == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // Frames in flight may still render into the images
+    vkDeviceWaitIdle(device_);
+    for (auto &image : images_) {
+        vkDestroySemaphore(device_, image.renderFinished, nullptr);
+        vkDestroyFramebuffer(device_, image.framebuffer, nullptr);
+        vkDestroyImageView(device_, image.view, nullptr);
+    }
+    images_.clear();
+    vkDestroySwapchainKHR(device_, swapchain_, nullptr);
+    swapchain_ = VK_NULL_HANDLE;
+}
+
+void VulkanBackend::createRenderPass() {
+    VkAttachmentDescription color{};
+    color.format = swapchainFormat_;
+    color.samples = VK_SAMPLE_COUNT_1_BIT;
+    color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference colorReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
+
+    // The acquire semaphore is waited on at color attachment output, order the clear after it
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = 0;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo createInfo{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    createInfo.attachmentCount = 1;
+    createInfo.pAttachments = &color;
+    createInfo.subpassCount = 1;
+    createInfo.pSubpasses = &subpass;
+    createInfo.dependencyCount = 1;
+    createInfo.pDependencies = &dependency;
+    VK_CHECK(vkCreateRenderPass(device_, &createInfo, nullptr, &renderPass_));
+}
+
+void VulkanBackend::createFrames() {
+    for (auto &frame : frames_) {
+        VkCommandBufferAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocateInfo.commandPool = commandPool_;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        VK_CHECK(vkAllocateCommandBuffers(device_, &allocateInfo, &frame.commands));
+
+        // Signalled, so the first wait on each frame returns right away
+        VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VK_CHECK(vkCreateFence(device_, &fenceInfo, nullptr, &frame.fence));
+
+        VkSemaphoreCreateInfo semaphoreInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &frame.imageAcquired));
+
+        frame.params = createHostBuffer(sizeof(SimParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+        if (asyncCompute_) {
+            allocateInfo.commandPool = computePool_;
+            VK_CHECK(vkAllocateCommandBuffers(device_, &allocateInfo, &frame.computeCommands));
+            VK_CHECK(vkCreateFence(device_, &fenceInfo, nullptr, &frame.computeFence));
+            VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &frame.stepDone));
+            VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &frame.drawDone));
+        }
+    }
+    if (asyncCompute_) {
+        VkSemaphoreCreateInfo semaphoreInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &initDone_));
+    }
+}
+
+VkCommandBuffer VulkanBackend::stepCommands() const {
+    auto &frame = frames_[frameIndex_];
+    return asyncCompute_ ? frame.computeCommands : frame.commands;
+}
+
+void VulkanBackend::replaceFence(VkFence &fence) const {
+    vkDestroyFence(device_, fence, nullptr);
+    VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    vkCreateFence(device_, &fenceInfo, nullptr, &fence);
+}
+
+VulkanBackend::HostBuffer VulkanBackend::createHostBuffer(VkDeviceSize size, VkBufferUsageFlags usage) const {
+    HostBuffer result;
+    VkBufferCreateInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_CHECK(vkCreateBuffer(device_, &bufferInfo, nullptr, &result.buffer));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device_, result.buffer, &requirements);
+    VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocateInfo.allocationSize = requirements.size;
+    // Coherent, so writes need no flush before the submit that reads them
+    allocateInfo.memoryTypeIndex = findMemoryType(
+            requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VK_CHECK(vkAllocateMemory(device_, &allocateInfo, nullptr, &result.memory));
+    VK_CHECK(vkBindBufferMemory(device_, result.buffer, result.memory, 0));
+    VK_CHECK(vkMapMemory(device_, result.memory, 0, VK_WHOLE_SIZE, 0, &result.mapped));
+    return result;
+}
+
+void VulkanBackend::createDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                       VkBuffer *outBuffer, VkDeviceMemory *outMemory) const {
+    VkBufferCreateInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_CHECK(vkCreateBuffer(device_, &bufferInfo, nullptr, outBuffer));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device_, *outBuffer, &requirements);
+    VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK(vkAllocateMemory(device_, &allocateInfo, nullptr, outMemory));
+    VK_CHECK(vkBindBufferMemory(device_, *outBuffer, *outMemory, 0));
+}
+
+void VulkanBackend::destroyHostBuffer(HostBuffer &buffer) const {
+    if (buffer.memory != VK_NULL_HANDLE) {
+        vkUnmapMemory(device_, buffer.memory);
+        vkFreeMemory(device_, buffer.memory, nullptr);
+    }
+    vkDestroyBuffer(device_, buffer.buffer, nullptr);
+    buffer = {};
+}
+
+uint32_t VulkanBackend::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i))
+                && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("No suitable Vulkan memory type");
+}
+
+void VulkanBackend::initParticles(ParticleLayout layout, int capacity, const StepKernel &kernel,
+                                  DrawMode drawMode, Interaction interaction, bool reorder, bool lifetimes) {
+    layout_ = layout;
+    capacity_ = capacity;
+    kernel_ = kernel;
+    drawMode_ = drawMode;
+    interaction_ = interaction;
+    reorder_ = reorder;
+    lifetimes_ = lifetimes;
+
+    // The trails are a GL draw mode only
+    if (drawMode_ == DrawMode::Trails) {
+        aout << "No trails on Vulkan, drawing sprites" << std::endl;
+        drawMode_ = DrawMode::Sprites;
+    }
+
+    // Everything but the sprite draw and the step reads the first particleCount particles, dead or
+    // alive, so lifetimes only go with those
+    if (lifetimes_ && (drawMode_ != DrawMode::Sprites || interaction_ != Interaction::None)) {
+        aout << "Particle lifetimes need the sprite draw and no interaction, particles live forever"
+             << std::endl;
+        lifetimes_ = false;
+    }
+    if (lifetimes_ && reorder_) {
+        aout << "No particle reordering with lifetimes" << std::endl;
+        reorder_ = false;
+    }
+
+    // Concurrent across the two queues, the semaphores order them and nothing changes owner
+    uint32_t families[] = {queueFamily_, computeFamily_};
+    auto createSharedBuffer = [&](VkDeviceSize size, VkBufferUsageFlags usage,
+                                  VkBuffer *outBuffer, VkDeviceMemory *outMemory) {
+        VkBufferCreateInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = asyncCompute_ ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+        bufferInfo.queueFamilyIndexCount = asyncCompute_ ? 2 : 0;
+        bufferInfo.pQueueFamilyIndices = families;
+        VK_CHECK(vkCreateBuffer(device_, &bufferInfo, nullptr, outBuffer));
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(device_, *outBuffer, &requirements);
+        VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocateInfo.allocationSize = requirements.size;
+        allocateInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits,
+                                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_CHECK(vkAllocateMemory(device_, &allocateInfo, nullptr, outMemory));
+        VK_CHECK(vkBindBufferMemory(device_, *outBuffer, *outMemory, 0));
+    };
+
+    // Same buffers and strides as ParticleState, so both backends run the same shaders. Device
+    // local, the init kernel fills them and nothing is uploaded.
+    stateBufferCount_ = ParticleState::bufferStride(layout_, 1) > 0 ? 2 : 1;
+    for (int copy = 0; copy < 2; copy++) {
+        for (int i = 0; i < stateBufferCount_; i++) {
+            createSharedBuffer(ParticleState::bufferStride(layout_, i) * capacity_,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                               &stateBuffers_[copy][i], &stateMemory_[copy][i]);
+        }
+    }
+    initParams_ = createHostBuffer(sizeof(InitParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    // The forces and the sorted order each take the step one storage buffer past the state of
+    // both copies. Reordering goes first when the device can't bind them all.
+    uint32_t stateBlocks = 2 * stateBufferCount_;
+    uint32_t maxBlocks = properties_.limits.maxPerStageDescriptorStorageBuffers;
+    if (reorder_ && maxBlocks < stateBlocks + (interaction_ != Interaction::None) + 1) {
+        aout << "The step kernel can't bind " << maxBlocks << " storage buffers, no particle reordering"
+             << std::endl;
+        reorder_ = false;
+    }
+    if (interaction_ != Interaction::None && maxBlocks < stateBlocks + 1) {
+        aout << "The step kernel can't bind " << maxBlocks << " storage buffers, no "
+             << interactionName(interaction_) << " interaction" << std::endl;
+        interaction_ = Interaction::None;
+    }
+    if (lifetimes_ && maxBlocks < stateBlocks + 2) {
+        aout << "The step kernel can't bind " << maxBlocks << " storage buffers, no particle lifetimes"
+             << std::endl;
+        lifetimes_ = false;
+    }
+    if (lifetimes_) {
+        // The draw reads the header's command on the graphics queue, the reset fills them
+        for (int copy = 0; copy < 2; copy++) {
+            createSharedBuffer(LIFE_HEADER + capacity_ * sizeof(float),
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                       | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               &lifeBuffers_[copy], &lifeMemory_[copy]);
+        }
+    }
+    switch (interaction_) {
+        case Interaction::Fluid:
+            neighbourParams_.cellSize = FLUID_RADIUS;
+            neighbourParams_.pressure = FLUID_PRESSURE;
+            neighbourParams_.viscosity = FLUID_VISCOSITY;
+            break;
+        case Interaction::None:
+            break;
+    }
+    if (interaction_ != Interaction::None) {
+        // Used by the step queue only, so exclusive to it; the counts are cleared by a transfer
+        VkDeviceSize sizes[] = {NEIGHBOUR_TABLE_SIZE * sizeof(uint32_t),
+                                capacity_ * 2 * sizeof(uint32_t),
+                                (2 * NEIGHBOUR_TABLE_SIZE + capacity_) * sizeof(uint32_t),
+                                capacity_ * 2 * sizeof(float)};
+        for (int i = 0; i < NEIGHBOUR_BUFFER_COUNT; i++) {
+            VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            if (i == NEIGHBOUR_COUNTS) {
+                usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            }
+            createDeviceBuffer(sizes[i], usage, &neighbourBuffers_[i], &neighbourMemory_[i]);
+        }
+        aout << "Neighbour grid: " << NEIGHBOUR_TABLE_SIZE << " cells of " << neighbourParams_.cellSize
+             << " units, " << interactionName(interaction_) << " forces" << std::endl;
+    }
+    if (reorder_) {
+        // A uvec2 per particle in both pair buffers, and a histogram of every workgroup
+        VkDeviceSize groups = (capacity_ + 255) / 256;
+        for (int i = 0; i < 2; i++) {
+            createDeviceBuffer(capacity_ * 2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               &sortPairs_[i], &sortPairMemory_[i]);
+        }
+        createDeviceBuffer((groups << RadixSort::RADIX_BITS) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           &sortHistograms_, &sortHistogramMemory_);
+    }
+
+    createDescriptors();
+    createPipelines();
+}
+
+void VulkanBackend::createDescriptors() {
+    // Set 0: the state buffers, at the SSBO bindings the shaders use on GL. The front copy at 0/1,
+    // the back copy at 2/3; the init kernel only declares the front one. With lifetimes the
+    // front copy's life buffer follows at 4 and the back copy's at 5.
+    VkDescriptorSetLayoutBinding stateBindings[6] = {};
+    uint32_t stateBindingCount = 0;
+    for (int i = 0; i < 2 * stateBufferCount_; i++) {
+        stateBindings[stateBindingCount++].binding = i < stateBufferCount_ ? i : 2 + i - stateBufferCount_;
+    }
+    if (lifetimes_) {
+        stateBindings[stateBindingCount++].binding = LIFE_INPUT_BINDING;
+        stateBindings[stateBindingCount++].binding = LIFE_OUTPUT_BINDING;
+    }
+    for (uint32_t i = 0; i < stateBindingCount; i++) {
+        stateBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        stateBindings[i].descriptorCount = 1;
+        stateBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo stateLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    stateLayoutInfo.bindingCount = stateBindingCount;
+    stateLayoutInfo.pBindings = stateBindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(device_, &stateLayoutInfo, nullptr, &stateSetLayout_));
+
+    // Set 1: the kernel's uniform block, SimParams for the step and InitParams for the init kernel.
+    // The step also reads the forces at 1 with an interaction and the sorted pairs at 2 with
+    // reordering, the init kernel leaves them unwritten.
+    VkDescriptorSetLayoutBinding paramsBindings[3] = {};
+    uint32_t paramsBindingCount = 0;
+    for (uint32_t i = 0; i < 3; i++) {
+        if ((i == 1 && interaction_ == Interaction::None) || (i == 2 && !reorder_)) {
+            continue;
+        }
+        auto &binding = paramsBindings[paramsBindingCount++];
+        binding.binding = i;
+        binding.descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo paramsLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    paramsLayoutInfo.bindingCount = paramsBindingCount;
+    paramsLayoutInfo.pBindings = paramsBindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(device_, &paramsLayoutInfo, nullptr, &paramsSetLayout_));
+
+    // Set 1 of the density shaders: DensityParams and the grid, plus the splats and points in the
+    // LOD mode. The LOD splats read DensityParams in the vertex shader.
+    VkDescriptorSetLayoutBinding densityBindings[4] = {};
+    for (uint32_t i = 0; i < 4; i++) {
+        densityBindings[i].binding = i;
+        densityBindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                   : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        densityBindings[i].descriptorCount = 1;
+        densityBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    densityBindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+    if (drawMode_ != DrawMode::Sprites) {
+        VkDescriptorSetLayoutCreateInfo densityLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        densityLayoutInfo.bindingCount = drawMode_ == DrawMode::Lod ? 4 : 2;
+        densityLayoutInfo.pBindings = densityBindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device_, &densityLayoutInfo, nullptr, &densitySetLayout_));
+    }
+
+    // Set 1 of the neighbour grid shaders: NeighbourParams, then the counts, cells, grid and forces
+    VkDescriptorSetLayoutBinding neighbourBindings[1 + NEIGHBOUR_BUFFER_COUNT] = {};
+    for (uint32_t i = 0; i < 1 + NEIGHBOUR_BUFFER_COUNT; i++) {
+        neighbourBindings[i].binding = i;
+        neighbourBindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                     : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        neighbourBindings[i].descriptorCount = 1;
+        neighbourBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    if (interaction_ != Interaction::None) {
+        VkDescriptorSetLayoutCreateInfo neighbourLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        neighbourLayoutInfo.bindingCount = 1 + NEIGHBOUR_BUFFER_COUNT;
+        neighbourLayoutInfo.pBindings = neighbourBindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device_, &neighbourLayoutInfo, nullptr, &neighbourSetLayout_));
+    }
+
+    // Set 1 of the sort kernels: the pairs they read, the pairs they write and the histograms
+    VkDescriptorSetLayoutBinding sortBindings[3] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        sortBindings[i].binding = i;
+        sortBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sortBindings[i].descriptorCount = 1;
+        sortBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    if (reorder_) {
+        VkDescriptorSetLayoutCreateInfo sortLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        sortLayoutInfo.bindingCount = 3;
+        sortLayoutInfo.pBindings = sortBindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(device_, &sortLayoutInfo, nullptr, &sortSetLayout_));
+    }
+
+    // Room for the density, neighbour, sort and life bindings either way, it costs next to nothing
+    VkDescriptorPoolSize poolSizes[] = {
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 12 + 6 + (5 + NEIGHBOUR_BUFFER_COUNT) * FRAMES_IN_FLIGHT},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 * FRAMES_IN_FLIGHT + 1},
+    };
+    VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets = 3 * FRAMES_IN_FLIGHT + 5;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptorPool_));
+
+    auto allocateSet = [&](VkDescriptorSetLayout setLayout) {
+        VkDescriptorSetAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        allocateInfo.descriptorPool = descriptorPool_;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &setLayout;
+        VkDescriptorSet set;
+        VK_CHECK(vkAllocateDescriptorSets(device_, &allocateInfo, &set));
+        return set;
+    };
+    stateSets_[0] = allocateSet(stateSetLayout_);
+    stateSets_[1] = allocateSet(stateSetLayout_);
+    initParamsSet_ = allocateSet(paramsSetLayout_);
+    if (reorder_) {
+        sortSets_[0] = allocateSet(sortSetLayout_);
+        sortSets_[1] = allocateSet(sortSetLayout_);
+    }
+    for (auto &frame : frames_) {
+        frame.paramsSet = allocateSet(paramsSetLayout_);
+        if (drawMode_ != DrawMode::Sprites) {
+            // The grid binding is written when the grid is allocated on the first draw
+            frame.densityParams = createHostBuffer(sizeof(DensityParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+            frame.densitySet = allocateSet(densitySetLayout_);
+        }
+        if (interaction_ != Interaction::None) {
+            frame.neighbourParams = createHostBuffer(sizeof(NeighbourParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+            frame.neighbourSet = allocateSet(neighbourSetLayout_);
+        }
+    }
+
+    // Buffer infos are reserved up front, the writes point into the vector
+    std::vector<VkDescriptorBufferInfo> bufferInfos;
+    std::vector<VkWriteDescriptorSet> writes;
+    bufferInfos.reserve(4 * stateBufferCount_ + 4 + 6 + (4 + 1 + NEIGHBOUR_BUFFER_COUNT) * FRAMES_IN_FLIGHT + 1);
+    auto write = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer) {
+        bufferInfos.push_back({buffer, 0, VK_WHOLE_SIZE});
+        VkWriteDescriptorSet descriptorWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        descriptorWrite.dstSet = set;
+        descriptorWrite.dstBinding = binding;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = type;
+        descriptorWrite.pBufferInfo = &bufferInfos.back();
+        writes.push_back(descriptorWrite);
+    };
+    for (int front = 0; front < 2; front++) {
+        for (int i = 0; i < stateBufferCount_; i++) {
+            write(stateSets_[front], i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stateBuffers_[front][i]);
+            write(stateSets_[front], 2 + i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stateBuffers_[1 - front][i]);
+        }
+        if (lifetimes_) {
+            write(stateSets_[front], LIFE_INPUT_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lifeBuffers_[front]);
+            write(stateSets_[front], LIFE_OUTPUT_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                  lifeBuffers_[1 - front]);
+        }
+    }
+    write(initParamsSet_, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, initParams_.buffer);
+    if (reorder_) {
+        for (int i = 0; i < 2; i++) {
+            write(sortSets_[i], 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sortPairs_[i]);
+            write(sortSets_[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sortPairs_[1 - i]);
+            write(sortSets_[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sortHistograms_);
+        }
+    }
+    for (auto &frame : frames_) {
+        write(frame.paramsSet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame.params.buffer);
+        if (frame.densitySet != VK_NULL_HANDLE) {
+            write(frame.densitySet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame.densityParams.buffer);
+        }
+        if (reorder_) {
+            write(frame.paramsSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sortPairs_[0]);
+        }
+        if (frame.neighbourSet != VK_NULL_HANDLE) {
+            write(frame.paramsSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, neighbourBuffers_[NEIGHBOUR_FORCES]);
+            write(frame.neighbourSet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame.neighbourParams.buffer);
+            for (uint32_t i = 0; i < NEIGHBOUR_BUFFER_COUNT; i++) {
+                write(frame.neighbourSet, 1 + i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, neighbourBuffers_[i]);
+            }
+        }
+    }
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    VkDescriptorSetLayout computeSets[] = {stateSetLayout_, paramsSetLayout_};
+    VkPipelineLayoutCreateInfo computeLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    computeLayoutInfo.setLayoutCount = 2;
+    computeLayoutInfo.pSetLayouts = computeSets;
+    VK_CHECK(vkCreatePipelineLayout(device_, &computeLayoutInfo, nullptr, &computeLayout_));
+
+    // The projection, rewind and point size are the vertex shader's only inputs besides the state,
+    // push constants
+    VkPushConstantRange projectionRange{VK_SHADER_STAGE_VERTEX_BIT, 0, SPRITE_CONSTANT_COUNT * sizeof(float)};
+    VkPipelineLayoutCreateInfo graphicsLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    graphicsLayoutInfo.pushConstantRangeCount = 1;
+    graphicsLayoutInfo.pPushConstantRanges = &projectionRange;
+    VK_CHECK(vkCreatePipelineLayout(device_, &graphicsLayoutInfo, nullptr, &graphicsLayout_));
+
+    // The splat reads the front copy like the step, the resolve only binds set 1
+    if (drawMode_ != DrawMode::Sprites) {
+        VkDescriptorSetLayout densitySets[] = {stateSetLayout_, densitySetLayout_};
+        VkPipelineLayoutCreateInfo densityLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        densityLayoutInfo.setLayoutCount = 2;
+        densityLayoutInfo.pSetLayouts = densitySets;
+        VK_CHECK(vkCreatePipelineLayout(device_, &densityLayoutInfo, nullptr, &densityLayout_));
+    }
+
+    if (interaction_ != Interaction::None) {
+        VkDescriptorSetLayout neighbourSets[] = {stateSetLayout_, neighbourSetLayout_};
+        VkPipelineLayoutCreateInfo neighbourLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        neighbourLayoutInfo.setLayoutCount = 2;
+        neighbourLayoutInfo.pSetLayouts = neighbourSets;
+        VK_CHECK(vkCreatePipelineLayout(device_, &neighbourLayoutInfo, nullptr, &neighbourLayout_));
+    }
+
+    if (reorder_) {
+        VkDescriptorSetLayout sortSets[] = {stateSetLayout_, sortSetLayout_};
+        VkPushConstantRange passRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SortPass)};
+        VkPipelineLayoutCreateInfo sortLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        sortLayoutInfo.setLayoutCount = 2;
+        sortLayoutInfo.pSetLayouts = sortSets;
+        sortLayoutInfo.pushConstantRangeCount = 1;
+        sortLayoutInfo.pPushConstantRanges = &passRange;
+        VK_CHECK(vkCreatePipelineLayout(device_, &sortLayoutInfo, nullptr, &sortLayout_));
+    }
+}
+
+std::string VulkanBackend::spirvAsset(const std::string &name, ParticleLayout layout) const {
+    return "shaders/spirv/" + name + "." + ParticleState::layoutName(layout) + ".spv";
+}
+
+VkShaderModule VulkanBackend::loadShaderModule(const std::string &name, ParticleLayout layout) const {
+    std::string code = Utility::loadAsset(app_->activity->assetManager, spirvAsset(name, layout));
+    if (code.empty() || code.size() % sizeof(uint32_t) != 0) {
+        throw std::runtime_error("Invalid SPIR-V asset " + spirvAsset(name, layout));
+    }
+
+    // Copied so the words are aligned
+    std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+    std::memcpy(words.data(), code.data(), code.size());
+
+    VkShaderModuleCreateInfo createInfo{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    createInfo.codeSize = code.size();
+    createInfo.pCode = words.data();
+    VkShaderModule module;
+    VK_CHECK(vkCreateShaderModule(device_, &createInfo, nullptr, &module));
+    return module;
+}
+
+VkPipeline VulkanBackend::createStepPipeline(const StepKernel &kernel) const {
+    // The variants only differ in reading the neighbour grid's forces, the sorted order and the
+    // lifetimes
+    std::string shader = "particle.comp";
+    if (interaction_ != Interaction::None) {
+        shader += ".forces";
+    }
+    if (reorder_) {
+        shader += ".order";
+    }
+    if (lifetimes_) {
+        shader += ".life";
+    }
+    VkShaderModule module = loadShaderModule(shader);
+
+    // particle.comp declares its workgroup size as specialization constant 0 and the particles
+    // per invocation as constant 1
+    uint32_t constants[] = {static_cast<uint32_t>(kernel.localSize),
+                            static_cast<uint32_t>(kernel.particlesPerInvocation)};
+    VkSpecializationMapEntry entries[] = {{0, 0, sizeof(uint32_t)},
+                                          {1, sizeof(uint32_t), sizeof(uint32_t)}};
+    VkSpecializationInfo specialization{2, entries, sizeof(constants), constants};
+
+    VkComputePipelineCreateInfo createInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    createInfo.stage.module = module;
+    createInfo.stage.pName = "main";
+    createInfo.stage.pSpecializationInfo = &specialization;
+    createInfo.layout = computeLayout_;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateComputePipelines(device_, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device_, module, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create step pipeline: " + std::to_string(result));
+    }
+    return pipeline;
+}
+
+void VulkanBackend::createPipelines() {
+    VkShaderModule initModule = loadShaderModule("particle_init.comp");
+    VkComputePipelineCreateInfo initInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    initInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    initInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    initInfo.stage.module = initModule;
+    initInfo.stage.pName = "main";
+    initInfo.layout = computeLayout_;
+    VkResult result = vkCreateComputePipelines(device_, VK_NULL_HANDLE, 1, &initInfo, nullptr, &initPipeline_);
+    vkDestroyShaderModule(device_, initModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create init pipeline: " + std::to_string(result));
+    }
+
+    stepPipeline_ = createStepPipeline(kernel_);
+    if (lifetimes_) {
+        dispatchPipeline_ = createDispatchPipeline(kernel_);
+        emitPipeline_ = createComputePipeline("particle_emit.comp", computeLayout_);
+    }
+
+    // Vertex input matches the VAO ParticleState sets up for the same layout
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    switch (layout_) {
+        case ParticleLayout::Interleaved32:
+            bindings = {{0, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX}};
+            attributes = {{0, 0, VK_FORMAT_R32G32_SFLOAT, 0},
+                          {1, 0, VK_FORMAT_R32G32_SFLOAT, 2 * sizeof(float)}};
+            break;
+        case ParticleLayout::PackedHalf:
+            bindings = {{0, 2 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX},
+                        {1, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_VERTEX}};
+            attributes = {{0, 0, VK_FORMAT_R32G32_SFLOAT, 0},
+                          {1, 1, VK_FORMAT_R32_UINT, 0}};
+            break;
+        case ParticleLayout::SoA32:
+        default:
+            bindings = {{0, 2 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX},
+                        {1, 2 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX}};
+            attributes = {{0, 0, VK_FORMAT_R32G32_SFLOAT, 0},
+                          {1, 1, VK_FORMAT_R32G32_SFLOAT, 0}};
+            break;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInput{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+    vertexInput.pVertexBindingDescriptions = bindings.data();
+    vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+    vertexInput.pVertexAttributeDescriptions = attributes.data();
+
+    graphicsPipeline_ = createGraphicsPipeline("particle.vert", "particle.frag", vertexInput,
+                                               VK_PRIMITIVE_TOPOLOGY_POINT_LIST, true, graphicsLayout_, layout_);
+    if (drawMode_ != DrawMode::Sprites) {
+        createDensityPipelines();
+    }
+    if (interaction_ != Interaction::None) {
+        createNeighbourPipelines();
+    }
+    if (reorder_) {
+        createSortPipelines();
+    }
+}
+
+VkPipeline VulkanBackend::createGraphicsPipeline(const std::string &vertexShader,
+                                                 const std::string &fragmentShader,
+                                                 const VkPipelineVertexInputStateCreateInfo &vertexInput,
+                                                 VkPrimitiveTopology topology, bool blendEnable,
+                                                 VkPipelineLayout layout,
+                                                 ParticleLayout shaderLayout) const {
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+    inputAssembly.topology = topology;
+
+    // Viewport and scissor follow the swapchain, set per frame
+    VkPipelineViewportStateCreateInfo viewport{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates = dynamicStates;
+
+    VkPipelineRasterizationStateCreateInfo rasterization{VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // When enabled the same as glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) on GL
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.blendEnable = blendEnable ? VK_TRUE : VK_FALSE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+            | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo blend{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blendAttachment;
+
+    VkShaderModule vertModule = loadShaderModule(vertexShader, shaderLayout);
+    VkShaderModule fragModule = loadShaderModule(fragmentShader, shaderLayout);
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertModule;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragModule;
+    stages[1].pName = "main";
+
+    VkGraphicsPipelineCreateInfo createInfo{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    createInfo.stageCount = 2;
+    createInfo.pStages = stages;
+    createInfo.pVertexInputState = &vertexInput;
+    createInfo.pInputAssemblyState = &inputAssembly;
+    createInfo.pViewportState = &viewport;
+    createInfo.pRasterizationState = &rasterization;
+    createInfo.pMultisampleState = &multisample;
+    createInfo.pColorBlendState = &blend;
+    createInfo.pDynamicState = &dynamic;
+    createInfo.layout = layout;
+    createInfo.renderPass = renderPass_;
+    createInfo.subpass = 0;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device_, vertModule, nullptr);
+    vkDestroyShaderModule(device_, fragModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create " + vertexShader + " pipeline: " + std::to_string(result));
+    }
+    return pipeline;
+}
+
+
+VkPipeline VulkanBackend::createComputePipeline(const std::string &shader, VkPipelineLayout layout,
+                                                const VkSpecializationInfo *specialization) const {
+    VkShaderModule module = loadShaderModule(shader);
+    VkComputePipelineCreateInfo createInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    createInfo.stage.module = module;
+    createInfo.stage.pName = "main";
+    createInfo.stage.pSpecializationInfo = specialization;
+    createInfo.layout = layout;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateComputePipelines(device_, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device_, module, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create " + shader + " pipeline: " + std::to_string(result));
+    }
+    return pipeline;
+}
+
+VkPipeline VulkanBackend::createDispatchPipeline(const StepKernel &kernel) const {
+    // particle_dispatch.comp sizes the step's dispatch with the kernel's particles per group,
+    // specialization constant 0
+    uint32_t groupParticles = kernel.groupParticles();
+    VkSpecializationMapEntry entry{0, 0, sizeof(uint32_t)};
+    VkSpecializationInfo specialization{1, &entry, sizeof(groupParticles), &groupParticles};
+    return createComputePipeline("particle_dispatch.comp", computeLayout_, &specialization);
+}
+
+void VulkanBackend::createDensityPipelines() {
+    densitySplatPipeline_ = createComputePipeline("density_splat.comp", densityLayout_);
+
+    if (drawMode_ == DrawMode::Density) {
+        // A fullscreen triangle from gl_VertexID, it writes every pixel so nothing blends
+        VkPipelineVertexInputStateCreateInfo noVertexInput{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+        densityPipeline_ = createGraphicsPipeline("density.vert", "density.frag", noVertexInput,
+                                                  VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, false, densityLayout_, layout_);
+        return;
+    }
+
+    lodCellsPipeline_ = createComputePipeline("lod_cells.comp", densityLayout_);
+    lodPointsPipeline_ = createComputePipeline("lod_points.comp", densityLayout_);
+
+    // One vec4 per dense cell, advanced per instance; the quad comes from gl_VertexID
+    VkVertexInputBindingDescription splatBinding{0, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_INSTANCE};
+    VkVertexInputAttributeDescription splatAttribute{0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0};
+    VkPipelineVertexInputStateCreateInfo splatInput{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    splatInput.vertexBindingDescriptionCount = 1;
+    splatInput.pVertexBindingDescriptions = &splatBinding;
+    splatInput.vertexAttributeDescriptionCount = 1;
+    splatInput.pVertexAttributeDescriptions = &splatAttribute;
+    lodSplatPipeline_ = createGraphicsPipeline("lod_splat.vert", "lod_splat.frag", splatInput,
+                                               VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, true, densityLayout_, layout_);
+
+    // Points are interleaved whatever the state layout, so they use the Interleaved32 sprite shaders
+    VkVertexInputBindingDescription pointBinding{0, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX};
+    VkVertexInputAttributeDescription pointAttributes[] = {{0, 0, VK_FORMAT_R32G32_SFLOAT, 0},
+                                                           {1, 0, VK_FORMAT_R32G32_SFLOAT, 2 * sizeof(float)}};
+    VkPipelineVertexInputStateCreateInfo pointInput{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    pointInput.vertexBindingDescriptionCount = 1;
+    pointInput.pVertexBindingDescriptions = &pointBinding;
+    pointInput.vertexAttributeDescriptionCount = 2;
+    pointInput.pVertexAttributeDescriptions = pointAttributes;
+    lodPointPipeline_ = createGraphicsPipeline("particle.vert", "particle.frag", pointInput,
+                                               VK_PRIMITIVE_TOPOLOGY_POINT_LIST, true, graphicsLayout_,
+                                               ParticleLayout::Interleaved32);
+}
+
+void VulkanBackend::createNeighbourPipelines() {
+    neighbourCountPipeline_ = createComputePipeline("neighbour_count.comp", neighbourLayout_);
+    neighbourScanPipeline_ = createComputePipeline("neighbour_scan.comp", neighbourLayout_);
+    neighbourScatterPipeline_ = createComputePipeline("neighbour_scatter.comp", neighbourLayout_);
+    switch (interaction_) {
+        case Interaction::Fluid:
+            neighbourForcePipeline_ = createComputePipeline("neighbour_fluid.comp", neighbourLayout_);
+            break;
+        case Interaction::None:
+            break;
+    }
+}
+
+void VulkanBackend::createSortPipelines() {
+    orderPipeline_ = createComputePipeline("particle_order.comp", sortLayout_);
+    radixHistogramPipeline_ = createComputePipeline("radix_histogram.comp", sortLayout_);
+    radixScanPipeline_ = createComputePipeline("radix_scan.comp", sortLayout_);
+    radixScatterPipeline_ = createComputePipeline("radix_scatter.comp", sortLayout_);
+}
+
+void VulkanBackend::resizeDensityGrid(uint32_t width, uint32_t height) {
+    bool lod = drawMode_ == DrawMode::Lod;
+    uint32_t cellSize = lod ? LOD_CELL_SIZE : DENSITY_CELL_SIZE;
+    VkExtent2D size{(width + cellSize - 1) / cellSize, (height + cellSize - 1) / cellSize};
+    if (densityGrid_ != VK_NULL_HANDLE && size.width == densityGridSize_.width
+        && size.height == densityGridSize_.height) {
+        return;
+    }
+
+    // Only on a surface size change, frames in flight may still use the old grid
+    vkDeviceWaitIdle(device_);
+    vkDestroyBuffer(device_, densityGrid_, nullptr);
+    vkFreeMemory(device_, densityMemory_, nullptr);
+    vkDestroyBuffer(device_, lodSplats_, nullptr);
+    vkFreeMemory(device_, lodSplatMemory_, nullptr);
+    vkDestroyBuffer(device_, lodPoints_, nullptr);
+    vkFreeMemory(device_, lodPointMemory_, nullptr);
+    densityGridSize_ = size;
+
+    // The LOD draws read their commands from the grid's header
+    VkDeviceSize cellCount = size.width * size.height;
+    createDeviceBuffer(DENSITY_GRID_HEADER + 2 * sizeof(uint32_t) * cellCount,
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                       | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                       &densityGrid_, &densityMemory_);
+    if (lod) {
+        // At worst every cell is a splat, or every cell passes the threshold in points
+        createDeviceBuffer(4 * sizeof(float) * cellCount,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           &lodSplats_, &lodSplatMemory_);
+        createDeviceBuffer(4 * sizeof(float) * LOD_THRESHOLD * cellCount,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           &lodPoints_, &lodPointMemory_);
+    }
+
+    VkDescriptorBufferInfo bufferInfos[] = {{densityGrid_, 0, VK_WHOLE_SIZE},
+                                            {lodSplats_, 0, VK_WHOLE_SIZE},
+                                            {lodPoints_, 0, VK_WHOLE_SIZE}};
+    std::vector<VkWriteDescriptorSet> writes;
+    for (auto &frame : frames_) {
+        VkWriteDescriptorSet descriptorWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        descriptorWrite.dstSet = frame.densitySet;
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        for (uint32_t i = 0; i < (lod ? 3 : 1); i++) {
+            descriptorWrite.dstBinding = 1 + i;
+            descriptorWrite.pBufferInfo = &bufferInfos[i];
+            writes.push_back(descriptorWrite);
+        }
+    }
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void VulkanBackend::recordDensitySplat(const float *projection, int count, float rewind) {
+    resizeDensityGrid(extent_.width, extent_.height);
+    auto &frame = frames_[frameIndex_];
+    auto commands = frame.commands;
+    bool lod = drawMode_ == DrawMode::Lod;
+
+    // GL's projection, the resolve flips its window coordinates to match
+    DensityParams params{};
+    std::memcpy(params.projection, projection, sizeof(params.projection));
+    params.gridSize[0] = densityGridSize_.width;
+    params.gridSize[1] = densityGridSize_.height;
+    params.viewportSize[0] = extent_.width;
+    params.viewportSize[1] = extent_.height;
+    params.cellSize = lod ? LOD_CELL_SIZE : DENSITY_CELL_SIZE;
+    params.particleCount = count;
+    params.rewind = rewind;
+    params.gain = lod ? LOD_GAIN : DENSITY_GAIN;
+    params.lodThreshold = LOD_THRESHOLD;
+    params.pointCapacity = lod ? LOD_THRESHOLD * densityGridSize_.width * densityGridSize_.height : 0;
+    std::memcpy(frame.densityParams.mapped, &params, sizeof(params));
+
+    auto gridBarrier = [&](VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                           VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = densityGrid_;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commands, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    };
+
+    // The previous frame's splat wrote the grid and its resolve, or its indirect draws, read it.
+    // The vertex input stage also orders that frame's LOD draws before this frame's LOD passes
+    // overwrite their splats and points.
+    gridBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(commands, densityGrid_, 0, VK_WHOLE_SIZE, 0);
+    gridBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // The front copy, beginFrame() or the step semaphore made the last step's writes visible
+    VkDescriptorSet sets[] = {stateSets_[front_], frame.densitySet};
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, densitySplatPipeline_);
+    vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_COMPUTE, densityLayout_, 0, 2, sets, 0, nullptr);
+    vkCmdDispatch(commands, (count + 255) / 256, 1, 1);
+
+    // Read by the resolve, or by the LOD passes
+    gridBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                lod ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                lod ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT);
+}
+
+void VulkanBackend::recordLodSelect(int count) {
+    auto &frame = frames_[frameIndex_];
+    auto commands = frame.commands;
+
+    // The sets recordDensitySplat() bound stay, all three kernels share the layout
+    uint32_t cellCount = densityGridSize_.width * densityGridSize_.height;
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, lodCellsPipeline_);
+    vkCmdDispatch(commands, (cellCount + 255) / 256, 1, 1);
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, lodPointsPipeline_);
+    vkCmdDispatch(commands, (count + 255) / 256, 1, 1);
+
+    // The header becomes the indirect draws, the splats and points their vertices
+    VkBufferMemoryBarrier barriers[3] = {};
+    VkBuffer buffers[] = {densityGrid_, lodSplats_, lodPoints_};
+    for (int i = 0; i < 3; i++) {
+        barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[i].dstAccessMask = i == 0 ? VK_ACCESS_INDIRECT_COMMAND_READ_BIT : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].buffer = buffers[i];
+        barriers[i].offset = 0;
+        barriers[i].size = VK_WHOLE_SIZE;
+    }
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         0, 0, nullptr, 3, barriers, 0, nullptr);
+}
+
+void VulkanBackend::setStepKernel(const StepKernel &kernel) {
+    if (kernel == kernel_) {
+        return;
+    }
+
+    // This frame's commands may already bind the old pipelines, and frames in flight do. They go
+    // with this frame and are destroyed once its fence passed, the queue finished the ones before.
+    VkPipeline pipeline = createStepPipeline(kernel);
+    VkPipeline dispatchPipeline = lifetimes_ ? createDispatchPipeline(kernel) : VK_NULL_HANDLE;
+    auto &retired = frames_[frameIndex_].retired;
+    retired.push_back(stepPipeline_);
+    if (dispatchPipeline_ != VK_NULL_HANDLE) {
+        retired.push_back(dispatchPipeline_);
+    }
+    stepPipeline_ = pipeline;
+    dispatchPipeline_ = dispatchPipeline;
+    kernel_ = kernel;
+}
+
+void VulkanBackend::recordStateBarrier(VkCommandBuffer commands,
+                                       VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                                       VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const {
+    VkBufferMemoryBarrier barriers[6] = {};
+    int count = 0;
+    auto add = [&](VkBuffer buffer) {
+        auto &barrier = barriers[count++];
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+    };
+    for (int copy = 0; copy < 2; copy++) {
+        for (int i = 0; i < stateBufferCount_; i++) {
+            add(stateBuffers_[copy][i]);
+        }
+        if (lifetimes_) {
+            add(lifeBuffers_[copy]);
+        }
+    }
+    vkCmdPipelineBarrier(commands, srcStage, dstStage, 0, 0, nullptr, count, barriers, 0, nullptr);
+}
+
+void VulkanBackend::recordLifeBarrier(VkCommandBuffer commands) const {
+    // The header's counts are read as dispatch arguments and by the next kernel's atomics, the
+    // life and state writes of the step and the emitters don't overlap
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+            | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+bool VulkanBackend::requestSnapshot(int count) {
+    // The state isn't read back here, recordings of this backend replay from their reset
+    return false;
+}
+
+bool VulkanBackend::collectSnapshot(std::vector<uint8_t> *outBlob) {
+    return false;
+}
+
+int VulkanBackend::restoreSnapshot(const std::vector<uint8_t> &blob) {
+    return 0;
+}
+
+void VulkanBackend::resetParticles(const InitParams &params) {
+    if (initPipeline_ == VK_NULL_HANDLE) return;
+
+    // Only happens at startup and between benchmark configurations, so it gets its own submit and
+    // waits for the device rather than going through the frame command buffers. It goes to the
+    // queue the step runs on, which orders it before the next step.
+    VK_CHECK(vkDeviceWaitIdle(device_));
+    std::memcpy(initParams_.mapped, &params, sizeof(InitParams));
+
+    VkCommandPool pool = asyncCompute_ ? computePool_ : commandPool_;
+    VkCommandBufferAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    allocateInfo.commandPool = pool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    VkCommandBuffer commands;
+    VK_CHECK(vkAllocateCommandBuffers(device_, &allocateInfo, &commands));
+
+    VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commands, &beginInfo);
+
+    // Both copies, the step only writes the active range and the budget may grow into the rest.
+    // Each state set has its front copy at the bindings the init kernel writes.
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, initPipeline_);
+    for (auto stateSet : stateSets_) {
+        VkDescriptorSet sets[] = {stateSet, initParamsSet_};
+        vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout_, 0, 2, sets, 0, nullptr);
+        vkCmdDispatch(commands, (params.particleCount + INIT_LOCAL_SIZE - 1) / INIT_LOCAL_SIZE, 1, 1);
+    }
+
+    // Unset lifetimes in both copies, and the front copy's header counts the alive particles.
+    // The back copy's header is written by the first step's dispatch kernel.
+    if (lifetimes_) {
+        const uint32_t header[LIFE_HEADER / sizeof(uint32_t)] = {params.aliveCount, 1, 0, 0, 0, 1, 1, 0};
+        for (auto buffer : lifeBuffers_) {
+            vkCmdFillBuffer(commands, buffer, 0, VK_WHOLE_SIZE, 0);
+        }
+        VkBufferMemoryBarrier fillBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        fillBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        fillBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        fillBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        fillBarrier.buffer = lifeBuffers_[front_];
+        fillBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 1, &fillBarrier, 0, nullptr);
+        vkCmdUpdateBuffer(commands, lifeBuffers_[front_], 0, sizeof(header), header);
+    }
+
+    // The state is next read by the step kernel or, on the same queue, the vertex fetch and the
+    // indirect draw. The compute queue has neither stage, the graphics queue waits on initDone_
+    // instead.
+    const VkPipelineStageFlags writeStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    const VkAccessFlags writeAccess = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    if (asyncCompute_) {
+        recordStateBarrier(commands, writeStages, writeAccess,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    } else {
+        recordStateBarrier(commands, writeStages, writeAccess,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                                   | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                           VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+                                   | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+    vkEndCommandBuffer(commands);
+
+    VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commands;
+    if (asyncCompute_) {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &initDone_;
+    }
+    VkResult result = vkQueueSubmit(computeQueue_, 1, &submitInfo, VK_NULL_HANDLE);
+    if (result == VK_SUCCESS && asyncCompute_) {
+        // An empty batch on the graphics queue consumes the semaphore, later draws are ordered
+        // after its wait
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        VkSubmitInfo waitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        waitInfo.waitSemaphoreCount = 1;
+        waitInfo.pWaitSemaphores = &initDone_;
+        waitInfo.pWaitDstStageMask = &waitStage;
+        result = vkQueueSubmit(queue_, 1, &waitInfo, VK_NULL_HANDLE);
+    }
+    if (result == VK_SUCCESS) {
+        vkDeviceWaitIdle(device_);
+    } else {
+        aout << "Failed to submit particle init: " << result << std::endl;
+    }
+    vkFreeCommandBuffers(device_, pool, 1, &commands);
+}
+
+void VulkanBackend::onSurfaceDestroyed(int activeParticles) {
+    if (surface_ == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // The device and the particle state don't depend on the window, only the swapchain goes
+    destroySwapchain();
+    vkDestroySurfaceKHR(instance_, surface_, nullptr);
+    surface_ = VK_NULL_HANDLE;
+}
+
+void VulkanBackend::onSurfaceCreated(ANativeWindow *window) {
+    if (surface_ != VK_NULL_HANDLE) {
+        return;
+    }
+
+    try {
+        createSurface(window);
+        VkBool32 canPresent = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice_, queueFamily_, surface_, &canPresent);
+        if (!canPresent) {
+            throw std::runtime_error("Queue can't present to the new surface");
+        }
+        createSwapchain();
+        aout << "Resumed on the existing Vulkan device" << std::endl;
+    } catch (const std::exception& e) {
+        aout << "Failed to attach to the new window: " << e.what() << std::endl;
+        destroySwapchain();
+        if (surface_ != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance_, surface_, nullptr);
+            surface_ = VK_NULL_HANDLE;
+        }
+    }
+}
+
+void VulkanBackend::retireFrame(int index) {
+    auto &frame = frames_[index];
+    vkWaitForFences(device_, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+    if (asyncCompute_) {
+        // The draw may finish before the step that was submitted with it
+        vkWaitForFences(device_, 1, &frame.computeFence, VK_TRUE, UINT64_MAX);
+    }
+    for (VkPipeline pipeline : frame.retired) {
+        vkDestroyPipeline(device_, pipeline, nullptr);
+    }
+    frame.retired.clear();
+    bool sorted = frame.sorted;
+    frame.sorted = false;
+    if (!frame.timed) {
+        return;
+    }
+    frame.timed = false;
+
+    // The fence passed, so the results are there without waiting. The sort's pair was only
+    // written if it ran.
+    uint64_t timestamps[QUERIES_PER_FRAME];
+    uint32_t queries = sorted ? QUERIES_PER_FRAME : SORT_QUERY;
+    VkResult result = vkGetQueryPoolResults(
+            device_, queryPool_, index * QUERIES_PER_FRAME, queries, queries * sizeof(uint64_t),
+            timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+        float ticksToMillis = properties_.limits.timestampPeriod / 1.0e6f;
+        gpuTimes_.emplace_back((timestamps[1] - timestamps[0]) * ticksToMillis,
+                               (timestamps[3] - timestamps[2]) * ticksToMillis);
+        if (sorted) {
+            sortTimes_.push_back((timestamps[SORT_QUERY + 1] - timestamps[SORT_QUERY]) * ticksToMillis);
+        }
+    }
+}
+
+bool VulkanBackend::collectGpuTimes(float *outSimulateMillis, float *outDrawMillis) {
+    if (gpuTimes_.empty()) {
+        return false;
+    }
+    *outSimulateMillis = gpuTimes_.front().first;
+    *outDrawMillis = gpuTimes_.front().second;
+    gpuTimes_.pop_front();
+    return true;
+}
+
+bool VulkanBackend::collectSortTime(float *outMillis) {
+    if (sortTimes_.empty()) {
+        return false;
+    }
+    *outMillis = sortTimes_.front();
+    sortTimes_.pop_front();
+    return true;
+}
+
+void VulkanBackend::beginFrame(int *outWidth, int *outHeight) {
+    frameActive_ = false;
+    passActive_ = false;
+    frames_[frameIndex_].stepped = false;
+    *outWidth = static_cast<int>(extent_.width);
+    *outHeight = static_cast<int>(extent_.height);
+    if (swapchain_ == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // The slot's previous use has to be done before its command buffer and params are reused
+    retireFrame(frameIndex_);
+    auto &frame = frames_[frameIndex_];
+
+    VkResult result = vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX, frame.imageAcquired,
+                                            VK_NULL_HANDLE, &imageIndex_);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // Resized or rotated, try once more on a swapchain of the new size
+        destroySwapchain();
+        createSwapchain();
+        *outWidth = static_cast<int>(extent_.width);
+        *outHeight = static_cast<int>(extent_.height);
+        result = vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX, frame.imageAcquired,
+                                       VK_NULL_HANDLE, &imageIndex_);
+    }
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        LOG_EVERY_MS(LogLevel::Error, 1000, "Failed to acquire a swapchain image: " << result);
+        return;
+    }
+
+    vkResetCommandBuffer(frame.commands, 0);
+    VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(frame.commands, &beginInfo);
+    if (asyncCompute_) {
+        vkResetCommandBuffer(frame.computeCommands, 0);
+        vkBeginCommandBuffer(frame.computeCommands, &beginInfo);
+    }
+
+    // Each queue resets the queries it writes: the step's and the sort's pairs, and the draw's pair
+    uint32_t firstQuery = frameIndex_ * QUERIES_PER_FRAME;
+    if (queryPool_ != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(stepCommands(), queryPool_, firstQuery, 2);
+        vkCmdResetQueryPool(frame.commands, queryPool_, firstQuery + 2, 2);
+        vkCmdResetQueryPool(stepCommands(), queryPool_, firstQuery + SORT_QUERY, 2);
+    }
+
+    // The last step wrote the copy that is now the front. This frame's step reads it and writes
+    // the other copy, which the last draw read, and this frame's draw fetches it. On the
+    // graphics queue one barrier covers all of that; with async compute the last draw and the
+    // next draw are ordered by semaphores, and only the step to step dependency is left here.
+    if (stateBufferCount_ > 0) {
+        if (asyncCompute_) {
+            recordStateBarrier(frame.computeCommands,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                               VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        } else {
+            recordStateBarrier(frame.commands,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                                       | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                               VK_ACCESS_SHADER_WRITE_BIT,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                                       | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                               VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+                                       | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        }
+    }
+    frameActive_ = true;
+}
+
+void VulkanBackend::recordNeighbourGrid(VkCommandBuffer commands, int count) {
+    auto &frame = frames_[frameIndex_];
+    neighbourParams_.particleCount = count;
+    std::memcpy(frame.neighbourParams.mapped, &neighbourParams_, sizeof(NeighbourParams));
+
+    auto gridBarrier = [&](VkPipelineStageFlags srcStage, VkAccessFlags srcAccess) {
+        VkBufferMemoryBarrier barriers[NEIGHBOUR_BUFFER_COUNT] = {};
+        for (int i = 0; i < NEIGHBOUR_BUFFER_COUNT; i++) {
+            barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barriers[i].srcAccessMask = srcAccess;
+            barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].buffer = neighbourBuffers_[i];
+            barriers[i].offset = 0;
+            barriers[i].size = VK_WHOLE_SIZE;
+        }
+        vkCmdPipelineBarrier(commands, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                             NEIGHBOUR_BUFFER_COUNT, barriers, 0, nullptr);
+    };
+
+    // The previous frame's passes and step, on this queue, wrote and read the same buffers
+    if (!neighbourCountsCleared_) {
+        vkCmdFillBuffer(commands, neighbourBuffers_[NEIGHBOUR_COUNTS], 0, VK_WHOLE_SIZE, 0);
+        gridBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        neighbourCountsCleared_ = true;
+    } else {
+        gridBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    // The front copy, the barrier in beginFrame() made the last step's writes visible
+    VkDescriptorSet sets[] = {stateSets_[front_], frame.neighbourSet};
+    vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_COMPUTE, neighbourLayout_, 0, 2, sets, 0, nullptr);
+    uint32_t groups = (count + 255) / 256;
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, neighbourCountPipeline_);
+    vkCmdDispatch(commands, groups, 1, 1);
+    gridBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    // One workgroup scans the whole table
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, neighbourScanPipeline_);
+    vkCmdDispatch(commands, 1, 1, 1);
+    gridBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, neighbourScatterPipeline_);
+    vkCmdDispatch(commands, groups, 1, 1);
+    gridBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    // Read by the step
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, neighbourForcePipeline_);
+    vkCmdDispatch(commands, groups, 1, 1);
+    gridBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void VulkanBackend::recordSort(VkCommandBuffer commands, int count) {
+    auto sortBarrier = [&]() {
+        VkBufferMemoryBarrier barriers[3] = {};
+        VkBuffer buffers[] = {sortPairs_[0], sortPairs_[1], sortHistograms_};
+        for (int i = 0; i < 3; i++) {
+            barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barriers[i].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].buffer = buffers[i];
+            barriers[i].offset = 0;
+            barriers[i].size = VK_WHOLE_SIZE;
+        }
+        vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 3, barriers, 0, nullptr);
+    };
+
+    uint32_t groups = (count + 255) / 256;
+    SortPass pass{static_cast<uint32_t>(count), 0, groups << RadixSort::RADIX_BITS, ORDER_CELL_SIZE};
+
+    // The previous frame's step read the pairs on this queue. The keys go into sortPairs_[0],
+    // written through sortSets_[1].
+    sortBarrier();
+    VkDescriptorSet sets[] = {stateSets_[front_], sortSets_[1]};
+    vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_COMPUTE, sortLayout_, 0, 2, sets, 0, nullptr);
+    vkCmdPushConstants(commands, sortLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pass), &pass);
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, orderPipeline_);
+    vkCmdDispatch(commands, groups, 1, 1);
+    sortBarrier();
+
+    // An even number of passes, so the sorted pairs end up back in sortPairs_[0]
+    int passes = (ORDER_KEY_BITS + RadixSort::RADIX_BITS - 1) / RadixSort::RADIX_BITS;
+    passes += passes % 2;
+    for (int i = 0; i < passes; i++) {
+        pass.shift = i * RadixSort::RADIX_BITS;
+        vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_COMPUTE, sortLayout_, 1, 1, &sortSets_[i % 2],
+                                0, nullptr);
+        vkCmdPushConstants(commands, sortLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pass), &pass);
+        vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, radixHistogramPipeline_);
+        vkCmdDispatch(commands, groups, 1, 1);
+        sortBarrier();
+        // One workgroup scans every histogram
+        vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, radixScanPipeline_);
+        vkCmdDispatch(commands, 1, 1, 1);
+        sortBarrier();
+        vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, radixScatterPipeline_);
+        vkCmdDispatch(commands, groups, 1, 1);
+        sortBarrier();
+    }
+}
+
+void VulkanBackend::simulate(const SimParams &params) {
+    if (!frameActive_ || stepPipeline_ == VK_NULL_HANDLE) return;
+    auto &frame = frames_[frameIndex_];
+    auto commands = stepCommands();
+    uint32_t firstQuery = frameIndex_ * QUERIES_PER_FRAME;
+
+    // This frame's fences have passed, the GPU is done reading the previous contents
+    std::memcpy(frame.params.mapped, &params, sizeof(SimParams));
+
+    // Timed on its own so the step's time, which the kernel tuner goes by, stays comparable
+    if (reorder_ && params.reorder != 0 && params.stepCount > 0) {
+        if (queryPool_ != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool_, firstQuery + SORT_QUERY);
+        }
+        recordSort(commands, params.particleCount);
+        if (queryPool_ != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool_,
+                                firstQuery + SORT_QUERY + 1);
+        }
+        frame.sorted = true;
+    }
+
+    if (queryPool_ != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool_, firstQuery);
+    }
+
+    if (params.stepCount > 0 && interaction_ != Interaction::None) {
+        recordNeighbourGrid(commands, params.particleCount);
+    }
+
+    // Front copy in, back copy out
+    VkDescriptorSet sets[] = {stateSets_[front_], frame.paramsSet};
+    vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout_, 0, 2, sets, 0, nullptr);
+    if (lifetimes_ && params.stepCount > 0) {
+        // The step runs over the front copy's live particles, appending survivors to the back
+        // copy, and the emitters append behind them. Nothing comes back to the CPU.
+        vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, dispatchPipeline_);
+        vkCmdDispatch(commands, 1, 1, 1);
+        recordLifeBarrier(commands);
+        vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, stepPipeline_);
+        vkCmdDispatchIndirect(commands, lifeBuffers_[front_], LIFE_DISPATCH_OFFSET);
+        if (params.emitCount > 0) {
+            recordLifeBarrier(commands);
+            vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, emitPipeline_);
+            vkCmdDispatch(commands, (params.emitCount + EMIT_LOCAL_SIZE - 1) / EMIT_LOCAL_SIZE, 1, 1);
+        }
+    } else if (params.stepCount > 0) {
+        uint32_t groupParticles = kernel_.groupParticles();
+        uint32_t groups = (params.particleCount + groupParticles - 1) / groupParticles;
+        vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, stepPipeline_);
+        vkCmdDispatch(commands, groups, 1, 1);
+    }
+
+    if (queryPool_ != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool_, firstQuery + 1);
+    }
+
+    // No barrier towards this frame's draw, it fetches the front copy. The next frame's
+    // beginFrame() orders these writes before their readers. Without steps the timestamps are
+    // still written, so the frame's queries stay available, but the copies don't swap.
+    frame.stepped = params.stepCount > 0;
+}
+
+void VulkanBackend::beginRenderPass() {
+    VkClearValue clear{};
+    clear.color = {{0.0f, 0.0f, 0.0f, 1.0f}};  // Pure black background
+    VkRenderPassBeginInfo beginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+    beginInfo.renderPass = renderPass_;
+    beginInfo.framebuffer = images_[imageIndex_].framebuffer;
+    beginInfo.renderArea = {{0, 0}, extent_};
+    beginInfo.clearValueCount = 1;
+    beginInfo.pClearValues = &clear;
+    vkCmdBeginRenderPass(frames_[frameIndex_].commands, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    passActive_ = true;
+}
+
+void VulkanBackend::draw(const float *projection, int count, float rewind) {
+    if (!frameActive_ || graphicsPipeline_ == VK_NULL_HANDLE) return;
+    auto &frame = frames_[frameIndex_];
+    auto commands = frame.commands;
+    uint32_t firstQuery = frameIndex_ * QUERIES_PER_FRAME;
+
+    if (queryPool_ != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool_, firstQuery + 2);
+    }
+    if (drawMode_ != DrawMode::Sprites) {
+        recordDensitySplat(projection, count, rewind);
+    }
+    if (drawMode_ == DrawMode::Lod) {
+        recordLodSelect(count);
+    }
+    beginRenderPass();
+
+    VkViewport viewport{0.0f, 0.0f, static_cast<float>(extent_.width), static_cast<float>(extent_.height),
+                        0.0f, 1.0f};
+    VkRect2D scissor{{0, 0}, extent_};
+    vkCmdSetViewport(commands, 0, 1, &viewport);
+    vkCmdSetScissor(commands, 0, 1, &scissor);
+
+    switch (drawMode_) {
+        case DrawMode::Sprites:
+        case DrawMode::Trails:  // Not after initParticles()
+            recordSprites(projection, count, rewind);
+            break;
+        case DrawMode::Density:
+            vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, densityPipeline_);
+            vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, densityLayout_, 1, 1,
+                                    &frame.densitySet, 0, nullptr);
+            vkCmdDraw(commands, 3, 1, 0, 0);
+            break;
+        case DrawMode::Lod:
+            recordLod(projection, rewind);
+            break;
+    }
+
+    if (queryPool_ != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool_, firstQuery + 3);
+        frame.timed = true;
+    }
+}
+
+void VulkanBackend::recordSprites(const float *projection, int count, float rewind) {
+    auto commands = frames_[frameIndex_].commands;
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline_);
+
+    // The front copy, this frame's step writes the other one
+    VkDeviceSize offsets[2] = {0, 0};
+    vkCmdBindVertexBuffers(commands, 0, stateBufferCount_, stateBuffers_[front_], offsets);
+
+    pushSpriteConstants(projection, rewind);
+    if (lifetimes_) {
+        // The live particles of the front copy, counted by the step that wrote it
+        vkCmdDrawIndirect(commands, lifeBuffers_[front_], LIFE_DRAW_OFFSET, 1, sizeof(VkDrawIndirectCommand));
+    } else {
+        vkCmdDraw(commands, count, 1, 0, 0);
+    }
+}
+
+void VulkanBackend::recordLod(const float *projection, float rewind) {
+    auto &frame = frames_[frameIndex_];
+    auto commands = frame.commands;
+    VkDeviceSize offset = 0;
+
+    // The splats only need DensityParams from set 1
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, lodSplatPipeline_);
+    vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, densityLayout_, 1, 1,
+                            &frame.densitySet, 0, nullptr);
+    vkCmdBindVertexBuffers(commands, 0, 1, &lodSplats_, &offset);
+    vkCmdDrawIndirect(commands, densityGrid_, LOD_SPLAT_DRAW_OFFSET, 1, sizeof(VkDrawIndirectCommand));
+
+    // Sparse particles over the splats, as sprites
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, lodPointPipeline_);
+    vkCmdBindVertexBuffers(commands, 0, 1, &lodPoints_, &offset);
+    pushSpriteConstants(projection, rewind);
+    vkCmdDrawIndirect(commands, densityGrid_, LOD_POINT_DRAW_OFFSET, 1, sizeof(VkDrawIndirectCommand));
+}
+
+void VulkanBackend::pushSpriteConstants(const float *projection, float rewind) {
+    auto commands = frames_[frameIndex_].commands;
+
+    // Vulkan clip space has Y pointing down, flip it so the view matches GL. uRewind and
+    // uPointSize follow the matrix in the push constant block.
+    float constants[SPRITE_CONSTANT_COUNT];
+    std::memcpy(constants, projection, 16 * sizeof(float));
+    for (int column = 0; column < 4; column++) {
+        constants[column * 4 + 1] = -constants[column * 4 + 1];
+    }
+    constants[16] = rewind;
+    constants[17] = pointSize_;
+    vkCmdPushConstants(commands, graphicsLayout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), constants);
+}
+
+void VulkanBackend::drawOverlay(const std::vector<Profiler::OverlayRect> &rects) {
+    if (!passActive_) return;
+
+    // Clear rects share the overlay's top left origin, they only have to stay inside the render area
+    for (auto &rect : rects) {
+        int x = std::max(rect.x, 0);
+        int y = std::max(rect.y, 0);
+        int width = std::min(rect.x + rect.width, static_cast<int>(extent_.width)) - x;
+        int height = std::min(rect.y + rect.height, static_cast<int>(extent_.height)) - y;
+        if (width <= 0 || height <= 0) {
+            continue;
+        }
+
+        VkClearAttachment attachment{};
+        attachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        attachment.colorAttachment = 0;
+        attachment.clearValue.color = {{rect.color[0], rect.color[1], rect.color[2], 1.0f}};
+        VkClearRect clearRect{{{x, y}, {static_cast<uint32_t>(width), static_cast<uint32_t>(height)}}, 0, 1};
+        vkCmdClearAttachments(frames_[frameIndex_].commands, 1, &attachment, 1, &clearRect);
+    }
+}
+
+void VulkanBackend::present() {
+    if (!frameActive_) return;
+    frameActive_ = false;
+    auto &frame = frames_[frameIndex_];
+
+    // The image still has to be cleared and moved to the present layout if nothing was drawn
+    if (!passActive_) {
+        beginRenderPass();
+    }
+    vkCmdEndRenderPass(frame.commands);
+    passActive_ = false;
+    vkEndCommandBuffer(frame.commands);
+
+    // The step reads its parameters when it runs, and they are coherent, so the attractors can
+    // still change up to the submit
+    if (frame.stepped) {
+        latchAttractors(*static_cast<SimParams *>(frame.params.mapped));
+    }
+
+    // With async compute the step goes first on its own queue. Every frame submits one, empty or
+    // not, so each semaphore it signals is waited on exactly once by the next frame.
+    VkSemaphore stepDone = VK_NULL_HANDLE;
+    if (asyncCompute_) {
+        vkEndCommandBuffer(frame.computeCommands);
+
+        // The step writes the copy the last draw read
+        VkPipelineStageFlags stepWaitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        VkSubmitInfo stepInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        stepInfo.waitSemaphoreCount = lastDrawDone_ != VK_NULL_HANDLE ? 1 : 0;
+        stepInfo.pWaitSemaphores = &lastDrawDone_;
+        stepInfo.pWaitDstStageMask = &stepWaitStage;
+        stepInfo.commandBufferCount = 1;
+        stepInfo.pCommandBuffers = &frame.computeCommands;
+        stepInfo.signalSemaphoreCount = 1;
+        stepInfo.pSignalSemaphores = &frame.stepDone;
+
+        vkResetFences(device_, 1, &frame.computeFence);
+        VkResult result = vkQueueSubmit(computeQueue_, 1, &stepInfo, frame.computeFence);
+        if (result == VK_SUCCESS) {
+            lastDrawDone_ = VK_NULL_HANDLE;
+            stepDone = frame.stepDone;
+        } else {
+            LOG_EVERY_MS(LogLevel::Error, 1000, "Failed to submit step: " << result);
+            replaceFence(frame.computeFence);
+            frame.stepped = false;
+        }
+    }
+
+    // Compute doesn't touch the image, so only color output waits for the acquire. With async
+    // compute the vertex fetch, or the density splat, also waits for the last step, which wrote
+    // the front copy.
+    VkSemaphore waitSemaphores[] = {frame.imageAcquired, lastStepDone_};
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                                                 | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+    VkSemaphore signalSemaphores[] = {images_[imageIndex_].renderFinished, frame.drawDone};
+    VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.waitSemaphoreCount = lastStepDone_ != VK_NULL_HANDLE ? 2 : 1;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.commands;
+    submitInfo.signalSemaphoreCount = asyncCompute_ ? 2 : 1;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    vkResetFences(device_, 1, &frame.fence);
+    VkResult result = vkQueueSubmit(queue_, 1, &submitInfo, frame.fence);
+    lastStepDone_ = stepDone;
+    if (result != VK_SUCCESS) {
+        LOG_EVERY_MS(LogLevel::Error, 1000, "Failed to submit frame: " << result);
+        replaceFence(frame.fence);
+        frame.timed = false;
+        if (asyncCompute_ && frame.stepped) {
+            // The step went out on its own
+            front_ = 1 - front_;
+        }
+        return;
+    }
+    if (asyncCompute_) {
+        lastDrawDone_ = frame.drawDone;
+    }
+
+    // The step's output is what the next frame draws and steps from
+    if (frame.stepped) {
+        front_ = 1 - front_;
+    }
+
+    VkPresentInfoKHR presentInfo{VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &signalSemaphores[0];
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapchain_;
+    presentInfo.pImageIndices = &imageIndex_;
+    result = vkQueuePresentKHR(queue_, &presentInfo);
+    frameIndex_ = (frameIndex_ + 1) % FRAMES_IN_FLIGHT;
+
+    if (result == VK_SUBOPTIMAL_KHR) {
+        // Android reports suboptimal for every frame of a rotated display we let the compositor
+        // rotate, only a size change is worth a new swapchain
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice_, surface_, &capabilities);
+        if (capabilities.currentExtent.width != extent_.width
+                || capabilities.currentExtent.height != extent_.height) {
+            result = VK_ERROR_OUT_OF_DATE_KHR;
+        }
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        destroySwapchain();
+        createSwapchain();
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        LOG_EVERY_MS(LogLevel::Error, 1000, "Failed to present: " << result);
+    }
+}
@@ -0,0 +1,352 @@
+#ifndef ANDROIDGLINVESTIGATIONS_VULKANBACKEND_H
+#define ANDROIDGLINVESTIGATIONS_VULKANBACKEND_H
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include "RenderBackend.h"
+
+/*!
+ * Vulkan 1.1 backend. The particle state is double buffered: frame N draws the front copy, which
+ * the step of frame N-1 wrote, while the step of frame N reads it and writes the back copy. The
+ * copies swap when the frame is submitted. A frame is recorded as
+ *
+ *   buffer barrier (last step's writes -> step and vertex attribute reads) -> step dispatch
+ *   -> render pass, draw
+ *
+ * with nothing ordering the dispatch before the draw, so the two can overlap. The state buffers
+ * are device local and used both as storage and as vertex buffers, so nothing is copied, and the
+ * barrier covers only them. Two frames are in flight, each with its own command buffers, fences
+ * and host mapped SimParams buffer.
+ *
+ * If the device has a compute-only queue family the step goes to a queue of its own (async
+ * compute), unless debug.particles.async_compute is 0. The barrier is then split into semaphores:
+ * a frame's draw waits for the previous frame's step, and a frame's step waits for the previous
+ * frame's draw, which read the copy it writes.
+ *
+ * In the density draw mode the graphics command buffer clears a grid of DENSITY_CELL_SIZE pixel
+ * cells, counts the front copy into it with density_splat.comp, and the render pass colors the
+ * screen from it with a fullscreen triangle instead of drawing sprites. The LOD draw mode counts
+ * into LOD_CELL_SIZE pixel cells, splits them into splats and sparse points with lod_cells.comp and
+ * lod_points.comp, and draws both with vkCmdDrawIndirect from the grid buffer's header.
+ *
+ * With an interaction the step command buffer runs the neighbour grid passes over the front copy
+ * before the step, see NeighbourGrid for what they do. The step is then built from the
+ * particle.comp.forces variant, which reads the forces at set 1 binding 1.
+ *
+ * With reordering, frames that ask for it record particle_order.comp and the radix sort passes of
+ * RadixSort into the step command buffer ahead of the step, between timestamps of their own. The
+ * step is then built from the .order variant and gathers through the sorted pairs at set 1
+ * binding 2. The pass shift and counts are push constants, the two sort sets swap the pair
+ * buffers between passes.
+ *
+ * With lifetimes each copy has a lifetime buffer next to its state, at set 0 bindings 4 and 5 like
+ * on GL, with the copy's indirect commands in front (see ParticleLife). particle_dispatch.comp
+ * sizes the step's vkCmdDispatchIndirect, the .life variant of the step packs the survivors,
+ * particle_emit.comp appends behind them and the sprites are drawn with vkCmdDrawIndirect. The
+ * lifetime buffers are shared between the queues like the state.
+ *
+ * Kernels come precompiled as SPIR-V assets (shaders/spirv/<name>.<layout>.spv, built by the
+ * compileShaders Gradle task) with the workgroup size as specialization constant 0.
+ *
+ * Unlike GL there is no context loss to recover from on surface loss, only the swapchain goes.
+ */
+class VulkanBackend : public RenderBackend {
+public:
+    //! True if a Vulkan 1.1 device with a queue doing both graphics and compute is present
+    static bool isSupported();
+
+    /*!
+     * Creates the instance, device and a swapchain on the app's window
+     * @param pacer picks the present mode, FIFO unless it paces without vsync; must outlive the backend
+     */
+    VulkanBackend(android_app *app, FramePacer *pacer);
+    ~VulkanBackend() override;
+
+    VulkanBackend(const VulkanBackend&) = delete;
+    VulkanBackend& operator=(const VulkanBackend&) = delete;
+
+    Type type() const override { return Type::Vulkan; }
+    std::string deviceName() const override;
+    std::string apiVersion() const override;
+    int maxCapacity(ParticleLayout layout) const override;
+    int maxLocalSize() const override;
+
+    void initParticles(ParticleLayout layout, int capacity, const StepKernel &kernel,
+                       DrawMode drawMode, Interaction interaction, bool reorder, bool lifetimes) override;
+    DrawMode drawMode() const override { return drawMode_; }
+    Interaction interaction() const override { return interaction_; }
+    bool reorders() const override { return reorder_; }
+    bool hasLifetimes() const override { return lifetimes_; }
+    void setStepKernel(const StepKernel &kernel) override;
+    void resetParticles(const InitParams &params) override;
+    bool requestSnapshot(int count) override;
+    bool collectSnapshot(std::vector<uint8_t> *outBlob) override;
+    int restoreSnapshot(const std::vector<uint8_t> &blob) override;
+
+    bool hasSurface() const override { return surface_ != VK_NULL_HANDLE; }
+    void onSurfaceDestroyed(int activeParticles) override;
+    void onSurfaceCreated(ANativeWindow *window) override;
+
+    bool hasGpuTiming() const override { return queryPool_ != VK_NULL_HANDLE; }
+    bool collectGpuTimes(float *outSimulateMillis, float *outDrawMillis) override;
+    bool collectSortTime(float *outMillis) override;
+
+    void beginFrame(int *outWidth, int *outHeight) override;
+    void simulate(const SimParams &params) override;
+    void draw(const float *projection, int count, float rewind) override;
+    void drawOverlay(const std::vector<Profiler::OverlayRect> &rects) override;
+    void present() override;
+    void setPointSize(float pixels) override { pointSize_ = pixels; }
+    void setTrails(float decay, float stretch) override {}
+    void setRenderScale(float scale) override {}
+    bool hasRenderScale() const override { return false; }
+
+private:
+    static constexpr int FRAMES_IN_FLIGHT = 2;
+
+    // Timestamps written per frame: simulate start/end, draw start/end, then sort start/end on
+    // the frames that sort
+    static constexpr uint32_t SORT_QUERY = 4;
+    static constexpr uint32_t QUERIES_PER_FRAME = 6;
+
+    //! A host visible buffer, mapped for its whole lifetime
+    struct HostBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+    };
+
+    struct Frame {
+        VkCommandBuffer commands = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;          // Signalled when the GPU is done with this frame
+        VkSemaphore imageAcquired = VK_NULL_HANDLE;
+        HostBuffer params;                       // SimParams of this frame
+        VkDescriptorSet paramsSet = VK_NULL_HANDLE;
+        bool timed = false;                      // Timestamps were written and not yet read
+        bool stepped = false;                    // The step was recorded, the copies swap on submit
+        bool sorted = false;                     // The sort was recorded, with its timestamps
+        HostBuffer densityParams;                // Density draw mode only
+        VkDescriptorSet densitySet = VK_NULL_HANDLE;
+        HostBuffer neighbourParams;              // With an interaction only
+        VkDescriptorSet neighbourSet = VK_NULL_HANDLE;
+        std::vector<VkPipeline> retired;         // Replaced while this frame recorded, freed with it
+
+        // Async compute only, the step's own submission
+        VkCommandBuffer computeCommands = VK_NULL_HANDLE;
+        VkFence computeFence = VK_NULL_HANDLE;
+        VkSemaphore stepDone = VK_NULL_HANDLE;   // Waited on by the next frame's draw
+        VkSemaphore drawDone = VK_NULL_HANDLE;   // Waited on by the next frame's step
+    };
+
+    struct SwapchainImage {
+        VkImageView view = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkSemaphore renderFinished = VK_NULL_HANDLE;  // Per image, a present may still hold it
+    };
+
+    void destroy();
+    void pickPhysicalDevice();
+    void createDevice();
+    void createSurface(ANativeWindow *window);
+    void createSwapchain();
+    void destroySwapchain();
+    void createRenderPass();
+    void createFrames();
+    void createDescriptors();
+    void createPipelines();
+    VkPipeline createStepPipeline(const StepKernel &kernel) const;
+    VkPipeline createGraphicsPipeline(const std::string &vertexShader, const std::string &fragmentShader,
+                                      const VkPipelineVertexInputStateCreateInfo &vertexInput,
+                                      VkPrimitiveTopology topology, bool blendEnable,
+                                      VkPipelineLayout layout, ParticleLayout shaderLayout) const;
+    void createDensityPipelines();
+    VkPipeline createComputePipeline(const std::string &shader, VkPipelineLayout layout,
+                                     const VkSpecializationInfo *specialization = nullptr) const;
+
+    //! particle_dispatch.comp for a step of @a kernel, which it gets as specialization constant 0
+    VkPipeline createDispatchPipeline(const StepKernel &kernel) const;
+    void createNeighbourPipelines();
+    void createSortPipelines();
+
+    //! Reallocates the density grid, and the LOD buffers, for a surface of @a width x @a height pixels
+    void resizeDensityGrid(uint32_t width, uint32_t height);
+
+    //! Clears the density grid and counts the front copy into it, before the render pass
+    void recordDensitySplat(const float *projection, int count, float rewind);
+
+    //! Splits the counted grid into the LOD splats and points, before the render pass
+    void recordLodSelect(int count);
+
+    //! Sorts the front copy into the neighbour grid and runs the force model, before the step
+    void recordNeighbourGrid(VkCommandBuffer commands, int count);
+
+    //! Sorts the front copy by Morton code into sortPairs_[0], before the step
+    void recordSort(VkCommandBuffer commands, int count);
+
+    //! Records the point sprite draw, inside the render pass
+    void recordSprites(const float *projection, int count, float rewind);
+
+    //! Records the indirect LOD splat and point draws, inside the render pass
+    void recordLod(const float *projection, float rewind);
+
+    //! Pushes the sprites' projection and rewind for the bound pipeline
+    void pushSpriteConstants(const float *projection, float rewind);
+
+    //! Shaders are compiled per particle layout, these pick the variant for @a layout
+    VkShaderModule loadShaderModule(const std::string &name, ParticleLayout layout) const;
+    VkShaderModule loadShaderModule(const std::string &name) const { return loadShaderModule(name, layout_); }
+    std::string spirvAsset(const std::string &name, ParticleLayout layout) const;
+
+    //! The command buffer the step of the current frame is recorded into
+    VkCommandBuffer stepCommands() const;
+
+    //! Replaces a fence a failed submit won't signal, so the next wait on it doesn't hang
+    void replaceFence(VkFence &fence) const;
+
+    HostBuffer createHostBuffer(VkDeviceSize size, VkBufferUsageFlags usage) const;
+
+    //! A device local buffer, freed by the caller
+    void createDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                            VkBuffer *outBuffer, VkDeviceMemory *outMemory) const;
+    void destroyHostBuffer(HostBuffer &buffer) const;
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+
+    //! Records a buffer barrier over the particle state buffers of both copies, and their lifetimes
+    void recordStateBarrier(VkCommandBuffer commands,
+                            VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                            VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const;
+
+    //! Orders the life kernels of a step, each reads the header counts the last one wrote
+    void recordLifeBarrier(VkCommandBuffer commands) const;
+
+    //! Clears the acquired image, the pass stays open until present()
+    void beginRenderPass();
+
+    //! Waits for frames_[@a index] and queues the GPU times it recorded
+    void retireFrame(int index);
+
+    android_app *app_;
+    FramePacer *pacer_;
+
+    VkInstance instance_;
+    VkPhysicalDevice physicalDevice_;
+    VkPhysicalDeviceProperties properties_;
+    bool largePoints_;
+    VkDevice device_;
+    uint32_t queueFamily_;
+    VkQueue queue_;
+    VkCommandPool commandPool_;
+
+    // With async compute a second family, queue and pool for the step, otherwise the above
+    bool asyncCompute_;
+    uint32_t computeFamily_;
+    VkQueue computeQueue_;
+    VkCommandPool computePool_;
+    VkSemaphore lastStepDone_;   // Signalled by the last step submitted, not waited on yet
+    VkSemaphore lastDrawDone_;   // Same for the last draw
+    VkSemaphore initDone_;
+
+    VkSurfaceKHR surface_;
+    VkSwapchainKHR swapchain_;
+    VkFormat swapchainFormat_;
+    VkExtent2D extent_;
+    std::vector<SwapchainImage> images_;
+    VkRenderPass renderPass_;
+
+    Frame frames_[FRAMES_IN_FLIGHT];
+    int frameIndex_;
+    uint32_t imageIndex_;
+    bool frameActive_;   // A command buffer is being recorded for an acquired image
+    bool passActive_;    // The render pass of the current frame has begun
+    float pointSize_;
+
+    VkQueryPool queryPool_;
+    std::deque<std::pair<float, float>> gpuTimes_;
+    std::deque<float> sortTimes_;
+
+    // Particle state and kernels
+    ParticleLayout layout_;
+    int capacity_;
+    StepKernel kernel_;
+    VkBuffer stateBuffers_[2][2];  // [copy][buffer]
+    VkDeviceMemory stateMemory_[2][2];
+    int stateBufferCount_;         // Buffers per copy
+    int front_;                    // The copy drawn this frame and read by its step
+    HostBuffer initParams_;
+    VkDescriptorSetLayout stateSetLayout_;
+    VkDescriptorSetLayout paramsSetLayout_;
+    VkDescriptorPool descriptorPool_;
+    VkDescriptorSet stateSets_[2];  // Per front copy: the front at bindings 0/1, the back at 2/3
+    VkDescriptorSet initParamsSet_;
+    VkPipelineLayout computeLayout_;
+    VkPipelineLayout graphicsLayout_;
+    VkPipeline initPipeline_;
+    VkPipeline stepPipeline_;
+    VkPipeline graphicsPipeline_;
+
+    // Density and LOD draw modes only
+    DrawMode drawMode_;
+    VkDescriptorSetLayout densitySetLayout_;  // DensityParams at 0, the grid at 1, LOD splats and points at 2/3
+    VkPipelineLayout densityLayout_;          // The state set and the density set
+    VkPipeline densitySplatPipeline_;
+    VkPipeline densityPipeline_;
+    VkBuffer densityGrid_;
+    VkDeviceMemory densityMemory_;
+    VkExtent2D densityGridSize_;              // Cells
+
+    // LOD draw mode only
+    VkPipeline lodCellsPipeline_;
+    VkPipeline lodPointsPipeline_;
+    VkPipeline lodSplatPipeline_;
+    VkPipeline lodPointPipeline_;             // particle.vert over the interleaved point buffer
+    VkBuffer lodSplats_;
+    VkDeviceMemory lodSplatMemory_;
+    VkBuffer lodPoints_;
+    VkDeviceMemory lodPointMemory_;
+
+    // Interactions only, the buffers are indexed like NeighbourGrid's
+    enum NeighbourBuffer {
+        NEIGHBOUR_COUNTS,
+        NEIGHBOUR_CELLS,
+        NEIGHBOUR_GRID,
+        NEIGHBOUR_FORCES,
+        NEIGHBOUR_BUFFER_COUNT
+    };
+    Interaction interaction_;
+    NeighbourParams neighbourParams_;
+    VkDescriptorSetLayout neighbourSetLayout_;  // NeighbourParams at 0, the buffers at 1-4
+    VkPipelineLayout neighbourLayout_;          // The state set and the neighbour set
+    VkPipeline neighbourCountPipeline_;
+    VkPipeline neighbourScanPipeline_;
+    VkPipeline neighbourScatterPipeline_;
+    VkPipeline neighbourForcePipeline_;
+    VkBuffer neighbourBuffers_[NEIGHBOUR_BUFFER_COUNT];
+    VkDeviceMemory neighbourMemory_[NEIGHBOUR_BUFFER_COUNT];
+    bool neighbourCountsCleared_;               // The counts start at zero once, the scan clears them after
+
+    // Reordering only
+    bool reorder_;
+    VkDescriptorSetLayout sortSetLayout_;       // Pairs in at 0, pairs out at 1, the histograms at 2
+    VkPipelineLayout sortLayout_;               // The state set and a sort set, plus the pass constants
+    VkDescriptorSet sortSets_[2];               // Reading sortPairs_[i], writing the other one
+    VkPipeline orderPipeline_;
+    VkPipeline radixHistogramPipeline_;
+    VkPipeline radixScanPipeline_;
+    VkPipeline radixScatterPipeline_;
+    VkBuffer sortPairs_[2];
+    VkDeviceMemory sortPairMemory_[2];
+    VkBuffer sortHistograms_;
+    VkDeviceMemory sortHistogramMemory_;
+
+    // Lifetimes only
+    bool lifetimes_;
+    VkBuffer lifeBuffers_[2];                   // Per copy, the header and then a float per particle
+    VkDeviceMemory lifeMemory_[2];
+    VkPipeline dispatchPipeline_;
+    VkPipeline emitPipeline_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_VULKANBACKEND_H
@@ -1,5 +1,8 @@
 #include "AndroidOut.h"
 #include "Renderer.h"
+#include "FramePacer.h"
+
+#include <memory>
 
 #include <game-activity/GameActivity.cpp>
 #include <game-text-input/gametextinput.cpp>
@@ -8,6 +11,23 @@ extern "C" {
 
 #include <game-activity/native_app_glue/android_native_app_glue.c>
 
+//! Paces the main loop; lives as long as android_main so pending vsync callbacks stay valid
+static std::unique_ptr<FramePacer> framePacer;
+
+//! Deletes the renderer, if there is one
+static void destroyRenderer(android_app *pApp) {
+    if (pApp->userData) {
+        try {
+            auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
+            pApp->userData = nullptr;
+            delete pRenderer;
+            aout << "Renderer cleanup successful" << std::endl;
+        } catch (const std::exception& e) {
+            aout << "Error during renderer cleanup: " << e.what() << std::endl;
+        }
+    }
+}
+
 /*!
  * Handles commands sent to this Android application
  * @param pApp the app the commands are coming from
@@ -18,9 +38,15 @@ void handle_cmd(android_app *pApp, int32_t cmd) {
     
     switch (cmd) {
         case APP_CMD_INIT_WINDOW:
+            // Coming back from the background the renderer is still there, it only needs the window
+            if (pApp->userData) {
+                aout << "APP_CMD_INIT_WINDOW: Reattaching renderer" << std::endl;
+                reinterpret_cast<Renderer *>(pApp->userData)->onSurfaceCreated();
+                break;
+            }
             aout << "APP_CMD_INIT_WINDOW: Creating renderer" << std::endl;
             try {
-                pApp->userData = new Renderer(pApp);
+                pApp->userData = new Renderer(pApp, framePacer.get());
                 aout << "Renderer created successfully" << std::endl;
             } catch (const std::exception& e) {
                 aout << "Failed to create renderer: " << e.what() << std::endl;
@@ -30,19 +56,18 @@ void handle_cmd(android_app *pApp, int32_t cmd) {
             break;
             
         case APP_CMD_TERM_WINDOW:
-            aout << "APP_CMD_TERM_WINDOW: Cleaning up" << std::endl;
+            // Only the surface goes, the simulation carries on when the window comes back
+            aout << "APP_CMD_TERM_WINDOW: Releasing surface" << std::endl;
             if (pApp->userData) {
-                try {
-                    auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
-                    pApp->userData = nullptr;
-                    delete pRenderer;
-                    aout << "Renderer cleanup successful" << std::endl;
-                } catch (const std::exception& e) {
-                    aout << "Error during renderer cleanup: " << e.what() << std::endl;
-                }
+                reinterpret_cast<Renderer *>(pApp->userData)->onSurfaceDestroyed();
             }
             break;
             
+        case APP_CMD_DESTROY:
+            aout << "APP_CMD_DESTROY: Cleaning up" << std::endl;
+            destroyRenderer(pApp);
+            break;
+            
         default:
             aout << "Unhandled command: " << cmd << std::endl;
             break;
@@ -76,12 +101,17 @@ void android_main(struct android_app *pApp) {
 
         aout << "Entering main loop" << std::endl;
         
+        framePacer = std::unique_ptr<FramePacer>(FramePacer::create());
+
         do {
+            // Block until the next frame is due, or until an event arrives if there's nothing to draw
+            auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
+            bool canRender = pRenderer && pRenderer->hasSurface();
+            int timeout = canRender ? framePacer->pollTimeoutMillis() : -1;
             bool done = false;
             while (!done) {
-                int timeout = 0;
                 int events;
-                android_poll_source *pSource;
+                android_poll_source *pSource = nullptr;
                 
                 int result = ALooper_pollOnce(timeout, nullptr, &events,
                                             reinterpret_cast<void**>(&pSource));
@@ -91,20 +121,27 @@ void android_main(struct android_app *pApp) {
                     case ALOOPER_POLL_WAKE:
                         done = true;
                         break;
-                    case ALOOPER_EVENT_ERROR:
+                    case ALOOPER_POLL_CALLBACK:
+                        // A looper callback (e.g. the Choreographer frame callback) already ran
+                        break;
+                    case ALOOPER_POLL_ERROR:
                         aout << "Error in ALooper_pollOnce" << std::endl;
+                        done = true;
                         break;
                     default:
                         if (pSource) {
                             pSource->process(pApp, pSource);
                         }
                 }
+
+                // Drain whatever else is queued without blocking again
+                timeout = 0;
             }
 
-            if (pApp->userData) {
+            // Commands processed above may have replaced or dropped the renderer or its surface
+            pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
+            if (pRenderer && pRenderer->hasSurface() && framePacer->frameDue()) {
                 try {
-                    auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
-                    pRenderer->handleInput();
                     pRenderer->render();
                 } catch (const std::exception& e) {
                     aout << "Error during render loop: " << e.what() << std::endl;
@@ -115,6 +152,8 @@ void android_main(struct android_app *pApp) {
         } while (!pApp->destroyRequested);
         
         aout << "Main loop ended" << std::endl;
+        destroyRenderer(pApp);
+        framePacer.reset();
         
     } catch (const std::exception& e) {
         aout << "Fatal error in android_main: " << e.what() << std::endl;
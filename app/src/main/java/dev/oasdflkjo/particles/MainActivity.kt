@@ -2,7 +2,12 @@ package dev.oasdflkjo.particles
 
 import android.app.AlertDialog
 import android.app.NativeActivity
+import android.content.BroadcastReceiver
+import android.content.Context
 import android.content.Intent
+import android.content.IntentFilter
+import android.content.pm.ApplicationInfo
+import android.os.Build
 import android.os.Bundle
 import android.widget.TextView
 import android.view.View
@@ -11,8 +16,14 @@ import android.graphics.drawable.ColorDrawable
 import com.google.androidgamesdk.GameActivity
 
 class MainActivity : GameActivity() {
+    // Hands the broadcast's extras to the native config, whose keys they override until the next reload
+    private var configReceiver: BroadcastReceiver? = null
+
+    private external fun nativeReloadConfig(overrides: String)
+
     companion object {
         private const val DEBUG_FORCE_SHOW_PRIVACY = false  // Disabled for release
+        private const val ACTION_RELOAD_CONFIG = "dev.oasdflkjo.particles.RELOAD_CONFIG"
         init {
             System.loadLibrary("particles")
         }
@@ -37,6 +48,35 @@ class MainActivity : GameActivity() {
             showPrivacyDialog()
         }
         // Note: We don't call launchNativeActivity() here because GameActivity is already our native activity
+
+        // Debuggable builds reload their config on `adb shell am broadcast -a dev.oasdflkjo.particles.RELOAD_CONFIG`
+        if (applicationInfo.flags and ApplicationInfo.FLAG_DEBUGGABLE != 0) {
+            registerConfigReceiver()
+        }
+    }
+
+    override fun onDestroy() {
+        configReceiver?.let { unregisterReceiver(it) }
+        configReceiver = null
+        super.onDestroy()
+    }
+
+    private fun registerConfigReceiver() {
+        val receiver = object : BroadcastReceiver() {
+            @Suppress("DEPRECATION")  // Bundle.get, the extras can be of any type
+            override fun onReceive(context: Context, intent: Intent) {
+                val extras = intent.extras
+                val overrides = extras?.keySet()?.joinToString("\n") { key -> "$key=${extras.get(key)}" } ?: ""
+                nativeReloadConfig(overrides)
+            }
+        }
+        val filter = IntentFilter(ACTION_RELOAD_CONFIG)
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+            registerReceiver(receiver, filter, Context.RECEIVER_EXPORTED)
+        } else {
+            registerReceiver(receiver, filter)
+        }
+        configReceiver = receiver
     }
     
     private fun showPrivacyDialog() {
@@ -0,0 +1,191 @@
+// Native tests of CpuSimulation: its scalar and NEON steps against a double precision reference
+// of particle.comp's integrator. Built with PARTICLES_TESTS, see the CMakeLists next to the sources.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "CpuSimulation.h"
+#include "ParticleState.h"
+
+// Largest relative difference from the reference. Floats against doubles over a few steps, with
+// NEON's refined reciprocal square root estimates on top.
+static constexpr double TOLERANCE = 1e-4;
+
+static int failures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            std::printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__); \
+            std::printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+struct State {
+    std::vector<float> positions;   // vec2s, as CpuSimulation::step() writes them
+    std::vector<float> velocities;
+};
+
+static InitParams initParams(int count, ParticleDistribution distribution) {
+    InitParams params{};
+    params.seed = 12345;
+    params.particleCount = static_cast<uint32_t>(count);
+    params.gridColumns = 64;
+    params.gridCount = static_cast<uint32_t>(count / 2);
+    params.extent[0] = 16.0f * 0.5f;
+    params.extent[1] = 16.0f;
+    params.origin[0] = -0.5f * params.extent[0];
+    params.origin[1] = -0.5f * params.extent[1];
+    params.spacing[0] = params.extent[0] / 64.0f;
+    params.spacing[1] = params.extent[1] / static_cast<float>(count / 128 + 1);
+    params.maxSpeed = 2.0f;
+    params.distribution = static_cast<uint32_t>(distribution);
+    return params;
+}
+
+static SimParams simParams(int count, int steps) {
+    SimParams params{};
+    params.deltaTime = 1.0f / 60.0f;
+    params.damping = 0.995f;
+    params.terminalVelocity = 3.0f;
+    params.particleCount = static_cast<uint32_t>(count);
+    params.stepCount = steps;
+
+    // Constant and falling off pulls, and a repeller, away from the spawn area's lattice points
+    const Attractor attractors[] = {
+            {{1.3f, 2.7f}, 20.0f, 0.0f},
+            {{-3.1f, -1.9f}, 35.0f, 0.5f},
+            {{0.4f, -5.3f}, -10.0f, 2.0f},
+    };
+    params.attractorCount = 3;
+    std::copy(std::begin(attractors), std::end(attractors), params.attractors);
+    return params;
+}
+
+static State run(bool vectorized, const InitParams &init, const SimParams &params) {
+    CpuSimulation simulation(static_cast<int>(init.particleCount), vectorized);
+    simulation.reset(init);
+    int padded = simulation.capacity();
+    State state{std::vector<float>(2 * padded), std::vector<float>(2 * padded)};
+    simulation.step(params, state.positions.data(), state.velocities.data());
+    return state;
+}
+
+// particle.comp's attractor step in doubles, from the state the reset left
+static State reference(const State &initial, const SimParams &params) {
+    State state = initial;
+    int count = static_cast<int>(params.particleCount);
+    for (int i = 0; i < count; i++) {
+        double x = state.positions[2 * i];
+        double y = state.positions[2 * i + 1];
+        double vx = state.velocities[2 * i];
+        double vy = state.velocities[2 * i + 1];
+        for (int step = 0; step < params.stepCount; step++) {
+            double forceX = 0.0;
+            double forceY = 0.0;
+            for (int a = 0; a < params.attractorCount; a++) {
+                const auto &attractor = params.attractors[a];
+                double toX = attractor.position[0] - x;
+                double toY = attractor.position[1] - y;
+                double distSq = toX * toX + toY * toY;
+                double pull = attractor.strength / (1.0 + attractor.falloff * distSq);
+                forceX += toX / std::sqrt(distSq) * pull;
+                forceY += toY / std::sqrt(distSq) * pull;
+            }
+            vx += forceX * params.deltaTime;
+            vy += forceY * params.deltaTime;
+
+            double speedSq = vx * vx + vy * vy;
+            double terminal = params.terminalVelocity;
+            if (speedSq > terminal * terminal) {
+                vx *= terminal / std::sqrt(speedSq);
+                vy *= terminal / std::sqrt(speedSq);
+            }
+            vx *= params.damping;
+            vy *= params.damping;
+
+            x += vx * params.deltaTime;
+            y += vy * params.deltaTime;
+        }
+        state.positions[2 * i] = static_cast<float>(x);
+        state.positions[2 * i + 1] = static_cast<float>(y);
+        state.velocities[2 * i] = static_cast<float>(vx);
+        state.velocities[2 * i + 1] = static_cast<float>(vy);
+    }
+    return state;
+}
+
+// Largest difference over the first @a count particles, relative to the expected value past 1
+static double maxDifference(const State &state, const State &expected, int count) {
+    double difference = 0.0;
+    for (int i = 0; i < 2 * count; i++) {
+        double position = expected.positions[i];
+        double velocity = expected.velocities[i];
+        difference = std::max(difference, std::abs(state.positions[i] - position) / std::max(1.0, std::abs(position)));
+        difference = std::max(difference, std::abs(state.velocities[i] - velocity) / std::max(1.0, std::abs(velocity)));
+    }
+    return difference;
+}
+
+static void testStep(bool vectorized, ParticleDistribution distribution, int count, int steps) {
+    auto init = initParams(count, distribution);
+    auto params = simParams(count, steps);
+    SimParams unstepped = params;
+    unstepped.stepCount = 0;
+
+    State initial = run(vectorized, init, unstepped);
+    State stepped = run(vectorized, init, params);
+    double difference = maxDifference(stepped, reference(initial, params), count);
+    CHECK(difference <= TOLERANCE, "%s step of %d particles in distribution %d over %d steps is off by %g",
+          vectorized ? "vectorized" : "scalar", count, static_cast<int>(distribution), steps, difference);
+}
+
+static void testNoSteps(bool vectorized) {
+    // Without steps the reset state is written out untouched
+    int count = 1001;
+    auto init = initParams(count, ParticleDistribution::Disc);
+    auto params = simParams(count, 0);
+    State first = run(vectorized, init, params);
+    State second = run(vectorized, init, params);
+    CHECK(maxDifference(first, second, count) == 0.0, "%s reset isn't deterministic",
+          vectorized ? "vectorized" : "scalar");
+}
+
+static void testScalarMatchesVectorized() {
+    // Both paths are one integrator, they may only differ in rounding
+    int count = 4099;
+    auto init = initParams(count, ParticleDistribution::Ring);
+    auto params = simParams(count, 8);
+    State scalar = run(false, init, params);
+    State vectorized = run(true, init, params);
+    double difference = maxDifference(vectorized, scalar, count);
+    CHECK(difference <= TOLERANCE, "scalar and vectorized steps differ by %g", difference);
+}
+
+int main() {
+    const ParticleDistribution distributions[] = {
+            ParticleDistribution::Grid, ParticleDistribution::Disc,
+            ParticleDistribution::Ring, ParticleDistribution::Noise,
+    };
+    for (bool vectorized : {false, true}) {
+        // Counts that aren't whole vectors, and one past a pool chunk
+        for (auto distribution : distributions) {
+            testStep(vectorized, distribution, 1001, 1);
+            testStep(vectorized, distribution, 5003, 4);
+        }
+        testNoSteps(vectorized);
+    }
+    testScalarMatchesVectorized();
+
+#if defined(__ARM_NEON)
+    std::printf("NEON path tested\n");
+#else
+    std::printf("No NEON on this target, both runs took the scalar path\n");
+#endif
+    std::printf(failures ? "%d checks failed\n" : "All checks passed\n", failures);
+    return failures ? 1 : 0;
+}